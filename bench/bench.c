@@ -0,0 +1,559 @@
+/**
+ * libpickle Benchmark Suite
+ * Measures the throughput of the different stages of the parser so that
+ * performance regressions can be caught early.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+/* Make sure we get the POSIX bits (clock_gettime, getrusage) on UNIX systems. */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+	#define _POSIX_C_SOURCE 200112L
+#endif /* !_WIN32 && !_POSIX_C_SOURCE */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__unix) || \
+	(defined(__APPLE__) && defined(__MACH__))
+	#define BENCH_HAS_POSIX
+	#include <sys/resource.h>
+#endif /* POSIX */
+
+#include "../src/pickle.h"
+
+/* Minimum amount of time in seconds that each benchmark must run for. */
+#define BENCH_MIN_TIME 0.5
+
+/* Document being used as benchmarking material. */
+typedef struct {
+	const char *fname;
+	char *buf;
+	size_t len;
+	size_t lines;
+
+	char **props;
+	size_t len_props;
+	char **cats;
+	size_t len_cats;
+	const char *body;
+} bench_doc_t;
+
+/* Amount of work done by a single run of a benchmark. */
+typedef struct {
+	size_t bytes;
+	size_t lines;
+} bench_work_t;
+
+/* Benchmark function. */
+typedef void (*bench_fn_t)(const bench_doc_t *doc, bench_work_t *work);
+
+/* Private methods. */
+int bench_load(bench_doc_t *doc, const char *fname);
+void bench_unload(bench_doc_t *doc);
+char **bench_lines_add(char **lines, size_t *len, const char *line,
+					   size_t llen);
+double bench_now(void);
+void bench_run(const char *name, bench_fn_t fn, const bench_doc_t *doc);
+void bench_error(const char *name);
+void bench_nextline(const bench_doc_t *doc, bench_work_t *work);
+void bench_getline(const bench_doc_t *doc, bench_work_t *work);
+void bench_property(const bench_doc_t *doc, bench_work_t *work);
+void bench_category(const bench_doc_t *doc, bench_work_t *work);
+void bench_component(const bench_doc_t *doc, bench_work_t *work);
+void bench_parse_file(const bench_doc_t *doc, bench_work_t *work);
+void bench_parse_mem(const bench_doc_t *doc, bench_work_t *work);
+void bench_parse_mmap(const bench_doc_t *doc, bench_work_t *work);
+void bench_parse_parallel(const bench_doc_t *doc, bench_work_t *work);
+void bench_validate(const bench_doc_t *doc, bench_work_t *work);
+
+/* Allocations made by the library. (Only counted when malloc is wrapped) */
+static size_t bench_allocs = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+	bench_allocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	bench_allocs++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	bench_allocs++;
+	return __real_realloc(ptr, size);
+}
+#endif /* BENCH_COUNT_ALLOCS */
+
+int main(int argc, char **argv) {
+	bench_doc_t doc;
+	int i;
+#ifdef BENCH_HAS_POSIX
+	struct rusage usage;
+#endif /* BENCH_HAS_POSIX */
+
+	/* Quick argument check. */
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s pickledoc...\n", argv[0]);
+		return 1;
+	}
+
+	printf("libpickle Benchmark Suite\n");
+	for (i = 1; i < argc; i++) {
+		/* Load up the benchmarking material. */
+		if (bench_load(&doc, argv[i]) != 0)
+			return 1;
+		printf("\n%s: %lu bytes, %lu lines, %lu properties, %lu categories\n",
+			   doc.fname, (unsigned long)doc.len, (unsigned long)doc.lines,
+			   (unsigned long)doc.len_props, (unsigned long)doc.len_cats);
+		printf("%-28s %10s %12s %10s %12s\n", "Benchmark", "MB/s", "lines/s",
+			   "runs", "allocs/run");
+
+		/* Go through the stages of the parser. */
+		bench_run("pickle_doc_nextline", bench_nextline, &doc);
+		bench_run("pickle_doc_getline", bench_getline, &doc);
+		bench_run("pickle_property_parse", bench_property, &doc);
+		bench_run("pickle_category_parse", bench_category, &doc);
+		bench_run("pickle_parse_component", bench_component, &doc);
+		bench_run("pickle_doc_parse (file)", bench_parse_file, &doc);
+		bench_run("pickle_doc_parse (memory)", bench_parse_mem, &doc);
+		bench_run("pickle_doc_parse (mmap)", bench_parse_mmap, &doc);
+		bench_run("pickle_doc_parse_parallel", bench_parse_parallel, &doc);
+		bench_run("pickle_doc_validate", bench_validate, &doc);
+
+		bench_unload(&doc);
+	}
+
+	/* How much memory did we need? */
+#ifdef BENCH_HAS_POSIX
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+	#ifdef __APPLE__
+		usage.ru_maxrss /= 1024;
+	#endif /* __APPLE__ */
+		printf("\nPeak RSS: %ld KiB\n", (long)usage.ru_maxrss);
+	}
+#endif /* BENCH_HAS_POSIX */
+
+	return 0;
+}
+
+/**
+ * Runs a benchmark for at least BENCH_MIN_TIME seconds and prints out its
+ * results.
+ *
+ * @param name Name of the benchmark.
+ * @param fn   Function that performs a single run of the benchmark.
+ * @param doc  Benchmarking material.
+ */
+void bench_run(const char *name, bench_fn_t fn, const bench_doc_t *doc) {
+	bench_work_t work;
+	double start;
+	double elapsed;
+	size_t allocs;
+	size_t runs;
+	double bytes;
+	double lines;
+
+	/* Keep running until we've got a decent sample. */
+	runs = 0;
+	bytes = 0;
+	lines = 0;
+	bench_allocs = 0;
+	start = bench_now();
+	do {
+		work.bytes = 0;
+		work.lines = 0;
+		fn(doc, &work);
+		bytes += work.bytes;
+		lines += work.lines;
+		runs++;
+		elapsed = bench_now() - start;
+	} while (elapsed < BENCH_MIN_TIME);
+	allocs = bench_allocs;
+
+	/* Report back. */
+	printf("%-28s %10.1f %12.0f %10lu ", name, (bytes / elapsed) / 1000000.0,
+		   lines / elapsed, (unsigned long)runs);
+#ifdef BENCH_COUNT_ALLOCS
+	printf("%12lu\n", (unsigned long)(allocs / runs));
+#else
+	(void)allocs;
+	printf("%12s\n", "-");
+#endif /* BENCH_COUNT_ALLOCS */
+}
+
+/**
+ * Line reader without any copies.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_nextline(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+	const char *line;
+	size_t len;
+	pickle_err_t err;
+
+	pdoc = pickle_doc_new();
+	pickle_doc_open_mem(pdoc, doc->buf, doc->len);
+	while ((err = pickle_doc_nextline(pdoc, &line, &len)) !=
+			PICKLE_FINISHED_PARSING) {
+		IF_PICKLE_ERROR(err) {
+			bench_error("pickle_doc_nextline");
+		}
+		work->lines++;
+	}
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+}
+
+/**
+ * Line reader reading from a file and handing out copies of each line.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_getline(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+	char *line;
+	pickle_err_t err;
+
+	pdoc = pickle_doc_new();
+	if (pickle_doc_fopen(pdoc, doc->fname, "r") != PICKLE_OK)
+		bench_error("pickle_doc_fopen");
+	while ((err = pickle_doc_getline(pdoc, &line)) != PICKLE_FINISHED_PARSING) {
+		IF_PICKLE_ERROR(err) {
+			bench_error("pickle_doc_getline");
+		}
+		if (line != NULL)
+			pickle_free(line);
+		work->lines++;
+	}
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+}
+
+/**
+ * Standalone property line parser.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_property(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_property_t *prop;
+	size_t i;
+
+	for (i = 0; i < doc->len_props; i++) {
+		if (pickle_property_parse(doc->props[i], &prop) != PICKLE_OK)
+			bench_error("pickle_property_parse");
+		pickle_property_free(prop);
+
+		work->bytes += strlen(doc->props[i]) + 1;
+		work->lines++;
+	}
+}
+
+/**
+ * Standalone category line parser.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_category(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_category_t *cat;
+	size_t i;
+
+	for (i = 0; i < doc->len_cats; i++) {
+		if (pickle_category_parse(doc->cats[i], &cat) != PICKLE_OK)
+			bench_error("pickle_category_parse");
+		pickle_category_free(cat);
+
+		work->bytes += strlen(doc->cats[i]) + 1;
+		work->lines++;
+	}
+}
+
+/**
+ * Component parser going through everything after the first category line.
+ * Other category lines get skipped over by the reader.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_component(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+	pickle_component_t *comp;
+	const char *line;
+	size_t len;
+	pickle_err_t err;
+
+	/* Components need a category to belong to. */
+	pdoc = pickle_doc_new();
+	pickle_doc_category_add(pdoc, pickle_doc_category_new(pdoc));
+	pickle_doc_open_mem(pdoc, doc->body, doc->len - (doc->body - doc->buf));
+
+	for (;;) {
+		err = pickle_parse_component(pdoc, &comp);
+		IF_PICKLE_ERROR(err) {
+			bench_error("pickle_parse_component");
+		}
+
+		/* Skip over category lines. */
+		if (err == PICKLE_FINISHED_PARSING) {
+			if (pickle_doc_nextline(pdoc, &line, &len) ==
+					PICKLE_FINISHED_PARSING) {
+				break;
+			}
+			continue;
+		}
+
+		pickle_doc_component_add(pdoc, comp);
+		work->lines += 2;
+	}
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len - (doc->body - doc->buf);
+}
+
+/**
+ * Full document parse reading from a file.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_parse_file(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+
+	pdoc = pickle_doc_new();
+	if ((pickle_doc_fopen(pdoc, doc->fname, "r") != PICKLE_OK) ||
+			(pickle_doc_parse(pdoc) != PICKLE_OK)) {
+		bench_error("pickle_doc_parse");
+	}
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+	work->lines = doc->lines;
+}
+
+/**
+ * Full document parse of an in-memory document.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_parse_mem(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+
+	pdoc = pickle_doc_new();
+	pickle_doc_open_mem(pdoc, doc->buf, doc->len);
+	if (pickle_doc_parse(pdoc) != PICKLE_OK)
+		bench_error("pickle_doc_parse");
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+	work->lines = doc->lines;
+}
+
+/**
+ * Full document parse of a memory-mapped document.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_parse_mmap(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+
+	pdoc = pickle_doc_new();
+	if ((pickle_doc_mmap(pdoc, doc->fname) != PICKLE_OK) ||
+			(pickle_doc_parse(pdoc) != PICKLE_OK)) {
+		bench_error("pickle_doc_parse");
+	}
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+	work->lines = doc->lines;
+}
+
+/**
+ * Full document parse of an in-memory document using every processor core.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_parse_parallel(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+
+	pdoc = pickle_doc_new();
+	pickle_doc_open_mem(pdoc, doc->buf, doc->len);
+	if (pickle_doc_parse_parallel(pdoc, 0, 0) != PICKLE_OK)
+		bench_error("pickle_doc_parse_parallel");
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+	work->lines = doc->lines;
+}
+
+/**
+ * Validation of an in-memory document without building any objects.
+ *
+ * @param doc  Benchmarking material.
+ * @param work Amount of work done.
+ */
+void bench_validate(const bench_doc_t *doc, bench_work_t *work) {
+	pickle_doc_t *pdoc;
+
+	pdoc = pickle_doc_new();
+	pickle_doc_open_mem(pdoc, doc->buf, doc->len);
+	if (pickle_doc_validate(pdoc, 1, NULL, NULL) != PICKLE_OK)
+		bench_error("pickle_doc_validate");
+	pickle_doc_free(pdoc);
+
+	work->bytes = doc->len;
+	work->lines = doc->lines;
+}
+
+/**
+ * Loads a document into memory and picks out the lines that are used by the
+ * standalone line parser benchmarks.
+ *
+ * @param doc   Benchmarking material to be populated.
+ * @param fname Path to the document.
+ *
+ * @return 0 if everything went fine.
+ */
+int bench_load(bench_doc_t *doc, const char *fname) {
+	FILE *fh;
+	const char *line;
+	const char *nl;
+	const char *end;
+	size_t len;
+	int body;
+
+	/* Read the whole file. */
+	memset(doc, 0, sizeof(bench_doc_t));
+	doc->fname = fname;
+	fh = fopen(fname, "rb");
+	if (fh == NULL) {
+		perror(fname);
+		return 1;
+	}
+	fseek(fh, 0, SEEK_END);
+	doc->len = (size_t)ftell(fh);
+	fseek(fh, 0, SEEK_SET);
+	doc->buf = (char *)malloc(doc->len + 1);
+	if ((doc->buf == NULL) ||
+			(fread(doc->buf, 1, doc->len, fh) != doc->len)) {
+		perror(fname);
+		fclose(fh);
+		return 1;
+	}
+	doc->buf[doc->len] = '\0';
+	fclose(fh);
+
+	/* Pick out the property and category lines. */
+	body = 0;
+	end = doc->buf + doc->len;
+	for (line = doc->buf; line < end; line = nl + 1) {
+		nl = (const char *)memchr(line, '\n', end - line);
+		if (nl == NULL)
+			nl = end;
+		len = nl - line;
+		if ((len > 0) && (line[len - 1] == '\r'))
+			len--;
+		doc->lines++;
+
+		if (len == 0)
+			continue;
+		if (!body) {
+			if ((len == 3) && (strncmp(line, "---", 3) == 0)) {
+				body = 1;
+				continue;
+			}
+			doc->props = bench_lines_add(doc->props, &doc->len_props, line,
+										 len);
+		} else if ((line[0] != '[') && (line[len - 1] == ':')) {
+			if (doc->body == NULL)
+				doc->body = nl + 1;
+			doc->cats = bench_lines_add(doc->cats, &doc->len_cats, line, len);
+		}
+	}
+	if (doc->body == NULL)
+		doc->body = end;
+
+	return 0;
+}
+
+/**
+ * Frees up everything allocated by bench_load.
+ *
+ * @param doc Benchmarking material.
+ */
+void bench_unload(bench_doc_t *doc) {
+	size_t i;
+
+	for (i = 0; i < doc->len_props; i++)
+		free(doc->props[i]);
+	for (i = 0; i < doc->len_cats; i++)
+		free(doc->cats[i]);
+	free(doc->props);
+	free(doc->cats);
+	free(doc->buf);
+}
+
+/**
+ * Appends a NULL terminated copy of a line to a list of lines.
+ *
+ * @param lines List of lines.
+ * @param len   Number of lines in the list. (Incremented by this function)
+ * @param line  Line to be copied.
+ * @param llen  Length of the line.
+ *
+ * @return Reallocated list of lines.
+ */
+char **bench_lines_add(char **lines, size_t *len, const char *line,
+					   size_t llen) {
+	lines = (char **)realloc(lines, (*len + 1) * sizeof(char *));
+	lines[*len] = (char *)malloc(llen + 1);
+	memcpy(lines[*len], line, llen);
+	lines[*len][llen] = '\0';
+	(*len)++;
+
+	return lines;
+}
+
+/**
+ * Gets the current time with the best resolution we've got.
+ *
+ * @return Time in seconds from an arbitrary point in time.
+ */
+double bench_now(void) {
+#ifdef BENCH_HAS_POSIX
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif /* BENCH_HAS_POSIX */
+}
+
+/**
+ * Bails out after a benchmark failed.
+ *
+ * @param name Name of the function that failed.
+ */
+void bench_error(const char *name) {
+	fprintf(stderr, "%s failed: ", name);
+	pickle_error_print();
+	exit(1);
+}
@@ -0,0 +1,139 @@
+/**
+ * libpickle Document Generator
+ * Generates synthetic PickLE documents of any size to be used as benchmarking
+ * material.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Sample data used to make up the components. */
+static const char *prefixes[] = { "R", "C", "L", "D", "Q", "U", "J", "SW" };
+static const char *values[] = { "10k", "100n", "4.7u", "1N4148", "2N3904",
+								"220", "1M", "22p" };
+static const char *descriptions[] = { "Resistor", "Ceramic Capacitor",
+									  "Inductor", "Signal Diode",
+									  "NPN Transistor",
+									  "Operational Amplifier" };
+static const char *packages[] = { "0805", "1206", "SOT-23", "SOIC-8", "DIP-8",
+								  "TO-92" };
+
+/* Private methods. */
+unsigned long gen_rand(void);
+void gen_component(FILE *fh, unsigned long index, unsigned long refdes);
+
+/* State of our pseudo-random number generator. */
+static unsigned long gen_state = 1;
+
+int main(int argc, char **argv) {
+	FILE *fh;
+	unsigned long categories;
+	unsigned long components;
+	unsigned long refdes;
+	unsigned long percat;
+	unsigned long i;
+	unsigned long j;
+	unsigned long n;
+
+	/* Quick argument check. */
+	if (argc != 5) {
+		fprintf(stderr, "Usage: %s output categories components refdes\n",
+				argv[0]);
+		return 1;
+	}
+	categories = strtoul(argv[2], NULL, 10);
+	components = strtoul(argv[3], NULL, 10);
+	refdes = strtoul(argv[4], NULL, 10);
+	if (categories == 0)
+		categories = 1;
+	if (refdes == 0)
+		refdes = 1;
+
+	/* Open up the output file. */
+	fh = fopen(argv[1], "w");
+	if (fh == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	/* Document header. */
+	fprintf(fh, "Name: Synthetic Benchmark Board\n");
+	fprintf(fh, "Revision: A\n");
+	fprintf(fh, "Description: Generated with %lu categories, %lu components "
+			"and about %lu reference designators each\n", categories,
+			components, refdes);
+	fprintf(fh, "\n---\n");
+
+	/* Spread the components evenly through the categories. */
+	n = 0;
+	percat = (components + categories - 1) / categories;
+	for (i = 0; (i < categories) && (n < components); i++) {
+		fprintf(fh, "\nCategory %lu:\n", i);
+		for (j = 0; (j < percat) && (n < components); j++, n++) {
+			if (j > 0)
+				fputc('\n', fh);
+			gen_component(fh, n, refdes);
+		}
+	}
+
+	/* Make sure everything made its way to the file. */
+	if (fclose(fh) != 0) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Writes out a single random component and its reference designators.
+ *
+ * @param fh     File to write the component to.
+ * @param index  Index of the component in the document.
+ * @param refdes Average number of reference designators per component.
+ */
+void gen_component(FILE *fh, unsigned long index, unsigned long refdes) {
+	const char *prefix;
+	unsigned long count;
+	unsigned long i;
+
+	/* Picked state, quantity and name. */
+	prefix = prefixes[gen_rand() % (sizeof(prefixes) / sizeof(prefixes[0]))];
+	count = (gen_rand() % (refdes * 2)) + 1;
+	fprintf(fh, "[%c]\t%lu\t%s%lu", (gen_rand() % 3) ? ' ' : 'X', count,
+			prefix, index);
+
+	/* Optional fields. */
+	if (gen_rand() % 4) {
+		fprintf(fh, "\t(%s)",
+				values[gen_rand() % (sizeof(values) / sizeof(values[0]))]);
+	}
+	if (gen_rand() % 4) {
+		fprintf(fh, "\t\"%s\"", descriptions[gen_rand() %
+				(sizeof(descriptions) / sizeof(descriptions[0]))]);
+	}
+	if (gen_rand() % 4) {
+		fprintf(fh, "\t[%s]",
+				packages[gen_rand() % (sizeof(packages) / sizeof(packages[0]))]);
+	}
+	fputc('\n', fh);
+
+	/* Reference designators. */
+	for (i = 0; i < count; i++)
+		fprintf(fh, "%s%s%lu", (i > 0) ? " " : "", prefix,
+				(index * refdes * 2) + i);
+	fputc('\n', fh);
+}
+
+/**
+ * Simple and portable pseudo-random number generator, so that the same
+ * arguments always generate the exact same document.
+ *
+ * @return Next pseudo-random number.
+ */
+unsigned long gen_rand(void) {
+	gen_state = (gen_state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+	return gen_state >> 8;
+}
@@ -5,6 +5,11 @@
  * @author Nathan Campos <nathan@innoveworkshop.com>
  */
 
+/* Make sure we get the POSIX bits (mmap, fstat, etc.) on UNIX systems. */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+	#define _POSIX_C_SOURCE 200112L
+#endif /* !_WIN32 && !_POSIX_C_SOURCE */
+
 #include "pickle.h"
 
 #include <errno.h>
@@ -13,6 +18,133 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* Memory-mapped files are only available on POSIX systems. */
+#if defined(__unix__) || defined(__unix) || \
+	(defined(__APPLE__) && defined(__MACH__))
+	#define PICKLE_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif /* POSIX */
+
+/* Querying the size and modification time of files. */
+#if defined(_WIN32)
+	#define PICKLE_HAS_STAT
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#define STAT_T             struct _stat
+	#define STAT(fname, st)    _stat((fname), (st))
+#elif defined(PICKLE_HAS_MMAP)
+	#define PICKLE_HAS_STAT
+	#define STAT_T             struct stat
+	#define STAT(fname, st)    stat((fname), (st))
+#endif /* _WIN32 */
+#include <time.h>
+
+/* Writing straight to file descriptors. */
+#if defined(_WIN32)
+	#define PICKLE_HAS_FD
+	#include <io.h>
+	#define FD_WRITE(fd, buf, len) _write((fd), (buf), (unsigned int)(len))
+#elif defined(PICKLE_HAS_MMAP)
+	#define PICKLE_HAS_FD
+	#define FD_WRITE(fd, buf, len) write((fd), (buf), (len))
+#endif /* _WIN32 */
+
+/* Worker threads for batch parsing. */
+#ifndef PICKLE_NO_THREADS
+	#if defined(_WIN32)
+		#define PICKLE_HAS_THREADS
+		#include <windows.h>
+		#define THREAD_T       HANDLE
+		#define MUTEX_T        CRITICAL_SECTION
+		#define MUTEX_INIT(m)  InitializeCriticalSection(m)
+		#define MUTEX_LOCK(m)  EnterCriticalSection(m)
+		#define MUTEX_UNLOCK(m) LeaveCriticalSection(m)
+		#define MUTEX_FREE(m)  DeleteCriticalSection(m)
+	#elif defined(PICKLE_HAS_MMAP)
+		#define PICKLE_HAS_THREADS
+		#include <pthread.h>
+		#define THREAD_T       pthread_t
+		#define MUTEX_T        pthread_mutex_t
+		#define MUTEX_INIT(m)  pthread_mutex_init((m), NULL)
+		#define MUTEX_LOCK(m)  pthread_mutex_lock(m)
+		#define MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+		#define MUTEX_FREE(m)  pthread_mutex_destroy(m)
+	#endif /* _WIN32 */
+#endif /* !PICKLE_NO_THREADS */
+
+/* Vectorized line scanning. (AVX2 is only used if available at runtime) */
+#ifndef PICKLE_NO_SIMD
+	#if defined(__SSE2__) || defined(_M_X64) || \
+		(defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+		#define PICKLE_HAS_SSE2
+		#include <emmintrin.h>
+		#if (defined(__GNUC__) && ((__GNUC__ > 4) || \
+			((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))) || defined(__clang__)
+			#define PICKLE_HAS_AVX2
+			#include <immintrin.h>
+		#endif /* GCC >= 4.9 || clang */
+	#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#define PICKLE_HAS_NEON
+		#include <arm_neon.h>
+	#endif /* __SSE2__ */
+
+	#if defined(PICKLE_HAS_SSE2) || defined(PICKLE_HAS_NEON)
+		#define PICKLE_HAS_SIMD
+	#endif /* PICKLE_HAS_SSE2 || PICKLE_HAS_NEON */
+#endif /* !PICKLE_NO_SIMD */
+
+/* Compressed documents. (Each codec is only available if asked for) */
+#ifdef PICKLE_WITH_ZLIB
+	#include <zlib.h>
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	#include <zstd.h>
+#endif /* PICKLE_WITH_ZSTD */
+#define SOURCE_IS_STREAM(src) (((src) == PICKLE_SOURCE_FILE) || \
+							   ((src) == PICKLE_SOURCE_GZIP) || \
+							   ((src) == PICKLE_SOURCE_ZSTD))
+
+/* Parsing instrumentation. (Compiled out entirely unless asked for) */
+#ifdef PICKLE_STATS
+	#if defined(_WIN32)
+		#include <windows.h>
+	#else
+		#include <time.h>
+	#endif /* _WIN32 */
+	#define STATS_BEGIN(doc, ph, mark) pickle_stats_begin((doc), (ph), (mark))
+	#define STATS_SWITCH(doc, ph, mark) \
+		(((mark)->phase != (ph)) ? pickle_stats_switch((doc), (ph), (mark)) : \
+		 (void)0)
+	#define STATS_REBASE(doc, mark) \
+		((mark)->allocs = pickle_stats_allocs, \
+		 (mark)->allocated = pickle_stats_allocated)
+	#define STATS_END(doc, mark)       pickle_stats_end((doc), (mark))
+	#define STATS_COUNT(doc, field)    ((doc)->stats.field++)
+	#define STATS_ALLOC(ptr, size) \
+		(((ptr) != NULL) ? (pickle_stats_allocs++, \
+		 pickle_stats_allocated += (size), (void)0) : (void)0)
+#else
+	#define STATS_BEGIN(doc, ph, mark)  (void)(mark)
+	#define STATS_SWITCH(doc, ph, mark) (void)(mark)
+	#define STATS_REBASE(doc, mark)     (void)(mark)
+	#define STATS_END(doc, mark)        (void)(mark)
+	#define STATS_COUNT(doc, field)     (void)(doc)
+	#define STATS_ALLOC(ptr, size)      (void)(ptr)
+#endif /* PICKLE_STATS */
+
+/* Compilers without threads don't need any locking. */
+#ifndef PICKLE_HAS_THREADS
+	#define THREAD_T       int
+	#define MUTEX_T        int
+	#define MUTEX_INIT(m)  (void)(m)
+	#define MUTEX_LOCK(m)  (void)(m)
+	#define MUTEX_UNLOCK(m) (void)(m)
+	#define MUTEX_FREE(m)  (void)(m)
+#endif /* !PICKLE_HAS_THREADS */
+
 /* Decorate the error message with more information. */
 #ifdef DEBUG
 	#define STRINGIZE(x) STRINGIZE_WRAPPER(x)
@@ -25,109 +157,866 @@
 	#define DEBUG_LOG(msg) (void)0
 #endif /* DEBUG */
 
-/* Work with compilers that don't provide an vsnprintf implementation. */
-#ifndef vsnprintf
-	#define VSNPRINTF_MAX_LEN 1024 /* Horrible, I know... */
-#endif /* vsnprintf */
+/* Older versions of MSVC only have a non-standard vsnprintf. */
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+	#define vsnprintf _vsnprintf
+#endif /* _MSC_VER < 1900 */
+
+/* Keep the error state per thread where the compiler supports it. */
+#if defined(_MSC_VER)
+	#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__) || defined(__SUNPRO_C) || \
+	defined(__INTEL_COMPILER)
+	#define THREAD_LOCAL __thread
+#else
+	#define THREAD_LOCAL /* Errors aren't thread-safe on this compiler. */
+#endif /* THREAD_LOCAL */
 
 /* Private definitions. */
-#define LINEBUF_MAX_LEN  1024
+#define READBUF_BLOCK_LEN 65536
+#define WRITEBUF_BLOCK_LEN 65536
+#define WRITER_UNCATEGORIZED "Uncategorized"
+#define ARENA_CHUNK_LEN   65536
+#define COLLECTION_MIN_CAP 8
+#define STRTAB_MIN_CAP    256
+#define INDEX_MIN_CAP     16
+#define HASH_FNV_OFFSET   2166136261UL
+#define HASH_FNV_PRIME    16777619UL
+#define ARENA_ALIGN       8
+#define ARENA_HEADER_LEN  ((sizeof(pickle_arena_chunk_t) + ARENA_ALIGN - 1) & \
+						   ~(size_t)(ARENA_ALIGN - 1))
 #define VALID_WHITESPACE " \t"
+#define PARALLEL_MIN_CHUNK 1048576
+#define PARALLEL_CHUNKS_PER_THREAD 4
+#define MERGE_MIN_COMPONENTS 65536
+#define SCAN_BLOCK_LEN    32
+#define CODEC_MAGIC_LEN   4
+
+/* Character classes of the line scanner. */
+#define SCAN_WTSPC        (1 << 0)
+#define SCAN_COLON        (1 << 1)
+#define SCAN_QUOTE        (1 << 2)
+#define SCAN_RPAREN       (1 << 3)
+#define SCAN_RBRACKET     (1 << 4)
+#define SCAN_CLASSES      5
+#define SCAN_MASK(scan, classes) \
+	((((classes) & SCAN_WTSPC) ? (scan)->masks[0] : 0) | \
+	 (((classes) & SCAN_COLON) ? (scan)->masks[1] : 0) | \
+	 (((classes) & SCAN_QUOTE) ? (scan)->masks[2] : 0) | \
+	 (((classes) & SCAN_RPAREN) ? (scan)->masks[3] : 0) | \
+	 (((classes) & SCAN_RBRACKET) ? (scan)->masks[4] : 0))
+
+/* Compiled document format. */
+#define COMPILED_MAGIC     "PKLC"
+#define COMPILED_VERSION   2
+#define COMPILED_BYTEORDER 0x01020304UL
+#define COMPILED_NULL      0xFFFFFFFFUL
+#define COMPILED_PICKED    (1 << 0)
+
+/* Private document flags. */
+#define DOC_FLAG_SCRATCH  (1 << 15)
+#define DOC_FLAG_VALIDATE (1 << 14)
+
+/* State of a document at the start of a parsing phase. */
+typedef struct {
+	pickle_phase_t phase;
+	uint64_t ns;
+	size_t offset;
+	size_t line;
+	size_t allocs;
+	size_t allocated;
+} pickle_stats_mark_t;
+
+/* Header of a compiled document. */
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t byteorder;
+	uint32_t src_hash;
+	uint32_t src_len;
+	uint32_t src_mtime;
+	uint32_t built;
+	uint32_t len_properties;
+	uint32_t len_categories;
+	uint32_t len_components;
+	uint32_t len_refdes;
+	uint32_t len_strings;
+} pickle_compiled_hdr_t;
+
+/* Compiled property record. (Strings are offsets into the string pool) */
+typedef struct {
+	uint32_t name;
+	uint32_t len_name;
+	uint32_t value;
+	uint32_t len_value;
+} pickle_compiled_prop_t;
+
+/* Compiled category record. */
+typedef struct {
+	uint32_t name;
+	uint32_t len_name;
+} pickle_compiled_cat_t;
+
+/* Compiled component record. */
+typedef struct {
+	uint32_t flags;
+	uint32_t quantity;
+	uint32_t category;
+	uint32_t name;
+	uint32_t len_name;
+	uint32_t value;
+	uint32_t len_value;
+	uint32_t description;
+	uint32_t len_description;
+	uint32_t package;
+	uint32_t len_package;
+	uint32_t refdes;
+	uint32_t len_refdes;
+} pickle_compiled_comp_t;
+
+/* Worker thread. Owns a range of items that others may steal from. */
+typedef struct pickle_worker_s {
+	void (*run)(struct pickle_worker_s *worker, size_t index);
+	void *ctx;
+	unsigned int flags;
+	struct pickle_worker_s *workers;
+	size_t len_workers;
+
+	size_t next;
+	size_t end;
+	MUTEX_T lock;
 
-/* Private variables. */
-static char *pickle_error_msg_buf = NULL;
+	pickle_doc_t *doc;
+	THREAD_T thread;
+	bool running;
+} pickle_worker_t;
+
+/* Category-aligned piece of a document that's parsed on its own. */
+typedef struct {
+	const char *data;
+	size_t start;
+	size_t end;
+
+	const pickle_allocator_t *allocator;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	pickle_error_t error;
+} pickle_chunk_t;
+
+/* Line scanner. Classifies a block of a line at a time into bitmasks. */
+typedef struct {
+	const char *line;
+	size_t len;
+	size_t avail;
+
+	size_t block;
+	uint32_t masks[SCAN_CLASSES];
+} pickle_scan_t;
+
+/* Destinations of the document writer. */
+typedef enum {
+	PICKLE_SINK_FILE = 0,
+	PICKLE_SINK_FD,
+	PICKLE_SINK_MEM
+} pickle_sink_t;
+
+/* Buffered document writer. */
+typedef struct {
+	pickle_sink_t sink;
+	FILE *fh;
+	int fd;
+
+	char *buf;
+	size_t len;
+	size_t size;
+	pickle_err_t err;
+} pickle_writer_t;
+
+/* Decompression state of a compressed file source. */
+typedef struct {
+	unsigned char in[READBUF_BLOCK_LEN];
+	size_t in_len;
+	size_t in_pos;
+
+	bool eof;
+	bool inside;
+	bool done;
+
+#ifdef PICKLE_WITH_ZLIB
+	z_stream zs;
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	ZSTD_DStream *zds;
+#endif /* PICKLE_WITH_ZSTD */
+} pickle_codec_t;
+
+/* Components of the old document being matched up during a diff. Components
+ * that share the same name, value and package are chained together, and are
+ * unlinked from their chain as soon as they get matched. */
+typedef struct {
+	pickle_doc_t *doc;
+	size_t cap;
+	size_t *ptrs;
+	size_t *keys;
+	size_t *heads;
+
+	size_t *slot;
+	size_t *prev;
+	size_t *next;
+	bool *matched;
+} pickle_diff_t;
+
+/* Part of a merged document. Made up of every component of the input
+ * documents that shares the same name, value and package. */
+typedef struct {
+	const pickle_component_t *comp;
+	const char *description;
+	size_t len_description;
+	size_t category;
+	unsigned int quantity;
+	bool picked;
+	size_t len_refdes;
+	pickle_component_t *out;
+} pickle_merge_part_t;
+
+/* Category of a merged document. (cat is NULL for uncategorized parts) */
+typedef struct {
+	const pickle_category_t *cat;
+	size_t len_parts;
+	size_t next;
+	pickle_category_t *out;
+} pickle_merge_cat_t;
+
+/* Parts and categories of the documents being merged, hashed by what they
+ * are. Every input component is mapped to its part in order. */
+typedef struct {
+	size_t cap;
+	size_t *slots_parts;
+	size_t *slots_cats;
+	size_t *which;
+
+	pickle_merge_part_t *parts;
+	size_t len_parts;
+	pickle_merge_cat_t *cats;
+	size_t len_cats;
+} pickle_merge_t;
+
+/* Group of documents whose parts are collected on their own. */
+typedef struct {
+	pickle_doc_t **docs;
+	size_t len;
+
+	pickle_merge_t merge;
+	pickle_err_t err;
+	pickle_error_t error;
+} pickle_merge_group_t;
+
+/* Slot of the string pool hash table. */
+typedef struct {
+	uint32_t off;
+	uint32_t len;
+	uint32_t hash;
+} pickle_pool_slot_t;
+
+/* Deduplicated string pool used while compiling a document. */
+typedef struct {
+	char *buf;
+	size_t len;
+	size_t size;
+
+	pickle_pool_slot_t *slots;
+	size_t count;
+	size_t cap;
+} pickle_pool_t;
+
+/* Mapping that objects parsed in view mode keep pointing into after their
+ * document was closed. */
+typedef struct pickle_view_s {
+	void *map;
+	size_t len;
+	struct pickle_view_s *next;
+} pickle_view_t;
 
 /* Private methods. */
-bool pickle_util_iswtspc(const char *buf);
+void *pickle_mem_alloc(const pickle_allocator_t *allocator, size_t size);
+void *pickle_mem_calloc(const pickle_allocator_t *allocator, size_t nmemb, size_t size);
+void *pickle_mem_realloc(const pickle_allocator_t *allocator, void *ptr, size_t size);
+void pickle_mem_free(const pickle_allocator_t *allocator, void *ptr);
+void *pickle_mem_default_alloc(size_t size, void *ctx);
+void *pickle_mem_default_realloc(void *ptr, size_t size, void *ctx);
+void pickle_mem_default_free(void *ptr, void *ctx);
+bool pickle_util_iswtspc(const char *buf, size_t len);
 size_t pickle_util_strcpy(char **dest, const char *src);
-size_t pickle_util_strstrcpy(char **dest, const char *start, const char *end);
-int pickle_util_getline(FILE *fh, char **line, size_t *rlen, size_t mlen);
-bool pickle_parser_iscat(const char *line);
-pickle_err_t pickle_parser_enclstr(const char *delim, const char *buf, const char **start, const char **end);
-void pickle_error_free(void);
-void pickle_error_msg_set(const char *msg);
-void pickle_error_msg_format(const char *format, ...);
+bool pickle_util_grow(const pickle_allocator_t *allocator, void **arr, size_t *cap, size_t need, size_t size);
+uint32_t pickle_util_hash(const char *str, size_t len);
+uint32_t pickle_util_hashcont(uint32_t hash, const char *str, size_t len);
+bool pickle_util_streq(const char *a, size_t len_a, const char *b, size_t len_b);
+pickle_err_t pickle_util_hashfile(const char *fname, uint32_t *hash, size_t *len);
+pickle_err_t pickle_util_stat(const char *fname, size_t *len, uint32_t *mtime);
+unsigned int pickle_util_popcount(uint32_t mask);
+void pickle_reader_init(pickle_reader_t *rd);
+#ifdef PICKLE_STATS
+void pickle_stats_begin(pickle_doc_t *doc, pickle_phase_t phase, pickle_stats_mark_t *mark);
+void pickle_stats_switch(pickle_doc_t *doc, pickle_phase_t phase, pickle_stats_mark_t *mark);
+void pickle_stats_end(pickle_doc_t *doc, const pickle_stats_mark_t *mark);
+uint64_t pickle_stats_now(void);
+#endif /* PICKLE_STATS */
+pickle_err_t pickle_writer_init(pickle_writer_t *wr, pickle_sink_t sink);
+void pickle_writer_put(pickle_writer_t *wr, const char *str, size_t len);
+void pickle_writer_field(pickle_writer_t *wr, char open, const char *str, size_t len, char close);
+void pickle_writer_flush(pickle_writer_t *wr);
+void pickle_writer_doc(pickle_writer_t *wr, const pickle_doc_t *doc);
+void pickle_writer_orphans(pickle_writer_t *wr, const pickle_doc_t *doc, bool ranges, bool blank);
+bool pickle_writer_listed(const pickle_doc_t *doc, size_t index, bool ranges);
+void pickle_writer_comp(pickle_writer_t *wr, const pickle_component_t *comp);
+void pickle_reader_free(pickle_reader_t *rd);
+pickle_err_t pickle_reader_close(pickle_reader_t *rd);
+int pickle_reader_getline(pickle_reader_t *rd, const char **line, size_t *rlen);
+void pickle_reader_unget(pickle_reader_t *rd, const char *line);
+size_t pickle_reader_tell(const pickle_reader_t *rd);
+pickle_err_t pickle_reader_seek(pickle_reader_t *rd, size_t offset, size_t line);
+int pickle_reader_read(pickle_reader_t *rd, char *dst, size_t len, size_t *nread);
+pickle_source_t pickle_codec_detect(const unsigned char *magic, size_t len);
+pickle_err_t pickle_codec_open(pickle_reader_t *rd, pickle_source_t source);
+int pickle_codec_read(pickle_reader_t *rd, char *dst, size_t len, size_t *nread);
+int pickle_codec_step(pickle_reader_t *rd, char *dst, size_t len, size_t *nread);
+pickle_err_t pickle_codec_rewind(pickle_reader_t *rd);
+void pickle_codec_close(pickle_reader_t *rd);
+#ifdef PICKLE_WITH_ZLIB
+voidpf pickle_codec_zalloc(voidpf opaque, uInt items, uInt size);
+void pickle_codec_zfree(voidpf opaque, voidpf ptr);
+#endif /* PICKLE_WITH_ZLIB */
+void pickle_arena_init(pickle_arena_t *arena);
+void *pickle_arena_alloc(pickle_arena_t *arena, size_t size);
+char *pickle_arena_strndup(pickle_arena_t *arena, const char *str, size_t len);
+void pickle_arena_mark(pickle_arena_t *arena, pickle_arena_mark_t *mark);
+void pickle_arena_release(pickle_arena_t *arena, const pickle_arena_mark_t *mark);
+void pickle_arena_reset(pickle_arena_t *arena);
+void pickle_arena_free(pickle_arena_t *arena);
+void pickle_arena_adopt(pickle_arena_t *arena, pickle_arena_t *other);
+void pickle_doc_clear(pickle_doc_t *doc);
+pickle_err_t pickle_doc_detach(pickle_doc_t *doc);
+pickle_err_t pickle_doc_keepmap(pickle_doc_t *doc);
+void pickle_doc_dropmaps(pickle_doc_t *doc);
+bool pickle_doc_setfname(pickle_doc_t *doc, const char *fname);
+pickle_err_t pickle_doc_adopt(pickle_doc_t *doc, pickle_doc_t *other);
+void pickle_component_init(pickle_component_t *comp, pickle_arena_t *arena);
+void pickle_category_track(pickle_category_t *cat, size_t index);
+void pickle_strtab_init(pickle_strtab_t *tab);
+const char *pickle_strtab_intern(pickle_strtab_t *tab, const pickle_allocator_t *allocator, pickle_arena_t *arena, const char *str, size_t len);
+void pickle_strtab_clear(pickle_strtab_t *tab);
+void pickle_strtab_free(pickle_strtab_t *tab, const pickle_allocator_t *allocator);
+void pickle_index_init(pickle_index_t *idx);
+bool pickle_index_grow(const pickle_allocator_t *allocator, void **slots, size_t *cap, size_t len, size_t size);
+bool pickle_index_reset(pickle_index_t *idx, const pickle_allocator_t *allocator, size_t len);
+void pickle_index_free(pickle_index_t *idx, const pickle_allocator_t *allocator);
+void pickle_refdes_index_init(pickle_refdes_index_t *idx);
+void pickle_refdes_index_free(pickle_refdes_index_t *idx, const pickle_allocator_t *allocator);
+bool pickle_doc_property_index(pickle_doc_t *doc);
+const pickle_property_t *pickle_doc_property_findn(pickle_doc_t *doc, const char *name, size_t len);
+bool pickle_doc_refdes_index(pickle_doc_t *doc);
+pickle_err_t pickle_diff_init(pickle_diff_t *diff, pickle_doc_t *doc);
+void pickle_diff_free(pickle_diff_t *diff);
+uint32_t pickle_component_hash(const pickle_component_t *comp);
+bool pickle_component_samekey(const pickle_component_t *a, const pickle_component_t *b);
+size_t pickle_diff_find(const pickle_diff_t *diff, const pickle_component_t *comp);
+size_t pickle_diff_match(pickle_diff_t *diff, const pickle_component_t *comp);
+void pickle_diff_take(pickle_diff_t *diff, size_t index);
+unsigned int pickle_diff_fields(pickle_doc_t *a, const pickle_component_t *ca, const pickle_component_t *cb);
+pickle_err_t pickle_diff_props(pickle_doc_t *a, pickle_doc_t *b, const pickle_diff_handlers_t *handlers, void *userdata);
+pickle_err_t pickle_merge_run(pickle_doc_t *doc, pickle_doc_t **docs, const char **prefixes, size_t len);
+void pickle_merge_group(pickle_worker_t *worker, size_t index);
+pickle_err_t pickle_merge_init(pickle_merge_t *merge, pickle_doc_t **docs, size_t len);
+void pickle_merge_free(pickle_merge_t *merge);
+void pickle_merge_collect(pickle_merge_t *merge, pickle_doc_t **docs, size_t len);
+pickle_err_t pickle_merge_combine(pickle_merge_t *merge, const pickle_merge_group_t *groups, size_t len);
+pickle_merge_part_t *pickle_merge_part(pickle_merge_t *merge, const pickle_component_t *comp);
+void pickle_merge_fold(pickle_merge_part_t *part, unsigned int quantity, bool picked, size_t len_refdes, const char *description, size_t len_description);
+size_t pickle_merge_cat(pickle_merge_t *merge, const pickle_category_t *cat);
+pickle_err_t pickle_merge_build(pickle_merge_t *merge, pickle_doc_t *doc);
+bool pickle_merge_copy(pickle_doc_t *doc, char **dest, size_t *len, const char *str, size_t length, bool intern);
+pickle_err_t pickle_merge_refdes(pickle_merge_t *merge, pickle_doc_t *doc, pickle_doc_t **docs, const char **prefixes, size_t len);
+void pickle_columns_init(pickle_columns_t *cols);
+pickle_err_t pickle_worker_run(size_t len, unsigned int threads, void (*run)(pickle_worker_t *worker, size_t index), void *ctx, unsigned int flags);
+void pickle_worker_loop(pickle_worker_t *worker);
+bool pickle_worker_take(pickle_worker_t *worker, size_t *index);
+unsigned int pickle_worker_cores(void);
+bool pickle_worker_start(pickle_worker_t *worker);
+void pickle_worker_join(pickle_worker_t *worker);
+void pickle_batch_item(pickle_worker_t *worker, size_t index);
+void pickle_pool_init(pickle_pool_t *pool);
+bool pickle_pool_add(pickle_pool_t *pool, const char *str, size_t len, uint32_t *off);
+void pickle_pool_free(pickle_pool_t *pool);
+pickle_err_t pickle_compiled_srchash(pickle_doc_t *doc, uint32_t *hash, size_t *len, uint32_t *mtime);
+pickle_err_t pickle_compiled_write(pickle_doc_t *doc, const char *cname, uint32_t hash, size_t len, uint32_t mtime);
+bool pickle_compiled_fresh(const pickle_doc_t *doc, const char *fname, uint32_t *hash, size_t *len, uint32_t *mtime);
+pickle_err_t pickle_compiled_map(pickle_doc_t *doc, const char *cname);
+void pickle_compiled_unmap(pickle_doc_t *doc);
+pickle_err_t pickle_compiled_fixup(pickle_doc_t *doc);
+bool pickle_compiled_str(const char *pool, uint32_t len_pool, uint32_t off, uint32_t len, char **dest, size_t *rlen);
+pickle_err_t pickle_parser_strfield(pickle_doc_t *doc, char **dest, size_t *dlen, const char *start, size_t len);
+pickle_err_t pickle_parser_strintern(pickle_doc_t *doc, char **dest, size_t *dlen, const char *start, size_t len);
+size_t pickle_parser_avail(const pickle_doc_t *doc, const char *line, size_t len);
+pickle_err_t pickle_iter_step(pickle_doc_t *doc, pickle_iter_t *iter, pickle_event_t *event);
+pickle_err_t pickle_parser_run(pickle_doc_t *doc, pickle_iter_t *state);
+pickle_err_t pickle_parser_next(pickle_doc_t *doc, pickle_iter_t *state, pickle_event_t *event);
+pickle_err_t pickle_parser_emit(pickle_parser_t *parser, pickle_event_t *event);
+pickle_err_t pickle_parser_pump(pickle_parser_t *parser);
+size_t pickle_parser_nextcat(const char *data, size_t len, size_t pos);
+void pickle_parser_chunk(pickle_worker_t *worker, size_t index);
+pickle_err_t pickle_parser_readcomp(pickle_doc_t *doc, pickle_category_t *cat, pickle_component_t **comp);
+pickle_err_t pickle_parser_prop(pickle_doc_t *doc, const char *line, size_t len, pickle_property_t **prop);
+pickle_err_t pickle_parser_cat(pickle_doc_t *doc, const char *line, size_t len, pickle_category_t **cat);
+pickle_err_t pickle_parser_comp(pickle_doc_t *doc, const char *line, size_t len, pickle_component_t **comp);
+pickle_err_t pickle_parser_refdes(pickle_doc_t *doc, const char *line, size_t len, pickle_component_t *comp);
+bool pickle_parser_iscat(const char *line, size_t len);
+bool pickle_parser_iscomp(const char *line, size_t len);
+pickle_err_t pickle_parser_enclstr(pickle_scan_t *scan, unsigned int close, size_t pos, const char **start, const char **end);
+void pickle_scan_init(pickle_scan_t *scan, const char *line, size_t len, size_t avail);
+void pickle_scan_load(pickle_scan_t *scan, size_t block);
+size_t pickle_scan_find(pickle_scan_t *scan, size_t pos, unsigned int classes);
+size_t pickle_scan_skip(pickle_scan_t *scan, size_t pos, unsigned int classes);
+size_t pickle_scan_words(pickle_scan_t *scan);
+bool pickle_scan_word(pickle_scan_t *scan, size_t *pos, size_t *end);
+unsigned int pickle_scan_ctz(uint32_t mask);
+void pickle_scan_classify(const char *block, uint32_t *masks);
+void pickle_scan_classify_c(const char *block, size_t len, uint32_t *masks);
+#ifdef PICKLE_HAS_SSE2
+void pickle_scan_classify_sse2(const char *block, uint32_t *masks);
+#endif /* PICKLE_HAS_SSE2 */
+#ifdef PICKLE_HAS_AVX2
+void pickle_scan_classify_avx2(const char *block, uint32_t *masks);
+#endif /* PICKLE_HAS_AVX2 */
+#ifdef PICKLE_HAS_NEON
+void pickle_scan_classify_neon(const char *block, uint32_t *masks);
+uint32_t pickle_scan_neon_mask(uint8x16_t v);
+#endif /* PICKLE_HAS_NEON */
+void pickle_error_set(pickle_err_t code, const char *msg);
+void pickle_error_format(pickle_err_t code, const char *format, ...);
+void pickle_error_col(size_t column);
+void pickle_error_loc(const pickle_reader_t *rd);
+
+/* Private variables. */
+static THREAD_LOCAL pickle_error_t pickle_error_state;
+static pickle_allocator_t pickle_allocator_global = {
+	pickle_mem_default_alloc,
+	pickle_mem_default_realloc,
+	pickle_mem_default_free,
+	NULL
+};
+#ifdef PICKLE_STATS
+static THREAD_LOCAL size_t pickle_stats_allocs = 0;
+static THREAD_LOCAL size_t pickle_stats_allocated = 0;
+#endif /* PICKLE_STATS */
+#ifdef PICKLE_HAS_AVX2
+static void (*pickle_scan_classifier)(const char *block, uint32_t *masks) = NULL;
+#endif /* PICKLE_HAS_AVX2 */
+
+/**
+ * Replaces the allocator used for every allocation that isn't tied to a
+ * document, including the strings and buffers that are handed back to the
+ * caller and documents created without an allocator of their own.
+ * @warning Memory must always be free'd by the allocator that allocated it, so
+ *          only change the allocator while nothing allocated by the previous
+ *          one is still around.
+ * @warning This isn't synchronized with anything, so don't call it while other
+ *          threads may be using the library, for example during
+ *          pickle_batch_parse.
+ *
+ * @param allocator Allocator to be used from now on. (Copied, doesn't need to
+ *                  outlive the call) NULL restores the standard malloc family.
+ *
+ * @see pickle_allocator_get
+ * @see pickle_doc_new_allocator
+ */
+void pickle_allocator_set(const pickle_allocator_t *allocator) {
+	if (allocator == NULL) {
+		pickle_allocator_global.alloc = pickle_mem_default_alloc;
+		pickle_allocator_global.realloc = pickle_mem_default_realloc;
+		pickle_allocator_global.free = pickle_mem_default_free;
+		pickle_allocator_global.ctx = NULL;
+		return;
+	}
+
+	pickle_allocator_global = *allocator;
+}
+
+/**
+ * Gets the allocator that's currently used for every allocation that isn't
+ * tied to a document.
+ *
+ * @return Global allocator of the library.
+ *
+ * @see pickle_allocator_set
+ */
+const pickle_allocator_t *pickle_allocator_get(void) {
+	return &pickle_allocator_global;
+}
+
+/**
+ * Frees up a string or buffer that was handed to us by the library, such as
+ * the lines from pickle_doc_getline or the output of pickle_doc_write_mem.
+ *
+ * @param ptr Memory to be free'd. Can be NULL.
+ *
+ * @see pickle_allocator_set
+ */
+void pickle_free(void *ptr) {
+	pickle_mem_free(NULL, ptr);
+}
 
 /**
  * Allocates a brand new PickLE document object.
  * @warning This function allocates memory that you are responsible for freeing.
  *
  * @return A brand new allocated PickLE document object.
+ * @see pickle_doc_new_allocator
  * @see pickle_doc_free
  */
 pickle_doc_t *pickle_doc_new(void) {
+	return pickle_doc_new_allocator(NULL);
+}
+
+/**
+ * Allocates a brand new PickLE document object whose memory (the object itself,
+ * its arena, collections, lookup tables and reader buffer) all comes from a
+ * specific allocator.
+ * @warning This function allocates memory that you are responsible for freeing.
+ *
+ * @param allocator Allocator to be used by the document. NULL uses the global
+ *                  allocator. (Copied, doesn't need to outlive the call) Must
+ *                  be thread-safe if the document is going to be parsed by
+ *                  pickle_doc_parse_parallel with more than one thread.
+ *
+ * @return A brand new allocated PickLE document object or NULL if we ran out of
+ *         memory.
+ * @see pickle_allocator_set
+ * @see pickle_doc_free
+ */
+pickle_doc_t *pickle_doc_new_allocator(const pickle_allocator_t *allocator) {
 	pickle_doc_t *doc;
 
 	/* Allocate our object. */
-	doc = (pickle_doc_t *)malloc(sizeof(pickle_doc_t));
+	if (allocator == NULL)
+		allocator = pickle_allocator_get();
+	doc = (pickle_doc_t *)pickle_mem_alloc(allocator, sizeof(pickle_doc_t));
+	if (doc == NULL)
+		return NULL;
+	doc->allocator = *allocator;
 
 	/* Reset everything. */
 	doc->fname = NULL;
 	doc->fh = NULL;
-	memset(doc->fmode, '\0', 3);
+	memset(doc->fmode, '\0', 4);
+	pickle_reader_init(&doc->reader);
+	doc->reader.allocator = &doc->allocator;
+	doc->flags = 0;
+	pickle_arena_init(&doc->arena);
+	doc->arena.allocator = &doc->allocator;
+	pickle_strtab_init(&doc->strtab);
+	doc->adopted = false;
+	doc->compiled = NULL;
+	doc->len_compiled = 0;
+	doc->views = NULL;
 	doc->properties = NULL;
 	doc->len_properties = 0;
+	doc->cap_properties = 0;
+	pickle_index_init(&doc->index_properties);
 	doc->categories = NULL;
 	doc->len_categories = 0;
+	doc->cap_categories = 0;
 	doc->components = NULL;
 	doc->len_components = 0;
+	doc->cap_components = 0;
+	pickle_refdes_index_init(&doc->index_refdes);
+	doc->iter_window = false;
+	memset(&doc->stats, 0, sizeof(pickle_stats_t));
+	doc->stats_hook = NULL;
+	doc->stats_userdata = NULL;
 
 	return doc;
 }
 
+/**
+ * Keeps a copy of the path of the document's file.
+ *
+ * @param doc   PickLE document object.
+ * @param fname Document file path.
+ *
+ * @return TRUE if the path was copied. FALSE if we ran out of memory.
+ */
+bool pickle_doc_setfname(pickle_doc_t *doc, const char *fname) {
+	char *buf;
+
+	buf = (char *)pickle_mem_realloc(&doc->allocator, doc->fname,
+									 (strlen(fname) + 1) * sizeof(char));
+	if (buf == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "path of the document's file."));
+		return false;
+	}
+	strcpy(buf, fname);
+	doc->fname = buf;
+
+	return true;
+}
+
 /**
  * Opens an existing or brand new PickLE document file for parsing/saving.
+ * Files opened for reading that are gzip or zstd compressed (detected by their
+ * magic bytes) are decompressed on the fly as they're read, as long as the
+ * library was built with PICKLE_WITH_ZLIB or PICKLE_WITH_ZSTD.
  *
  * @param doc   Pointer to a PickLE document object.
  * @param fname Document file path.
  * @param fmode File opening mode string. (see fopen)
  *
  * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
- *         error occurred while trying to open the file.
+ *         error occurred while trying to open the file. PICKLE_ERROR_NOT_IMPL
+ *         if the file is compressed with a codec we weren't built with.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
  */
 pickle_err_t pickle_doc_fopen(pickle_doc_t *doc, const char *fname, const char *fmode) {
+	unsigned char magic[CODEC_MAGIC_LEN];
+	pickle_source_t source;
+	pickle_err_t err;
+	size_t len;
+
 	/* Check if a document is still opened. */
-	if (doc->fh != NULL) {
-		pickle_error_msg_set(EMSG("A document is already open. Close it before "
-							 "opening another one."));
+	if (doc->reader.source != PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("A document is already open. "
+						 "Close it before opening another one."));
 		return PICKLE_ERROR_FILE;
 	}
 
 	/* Allocate space for the filename and copy it over. */
-	doc->fname = (char *)realloc(doc->fname,
-								 (strlen(fname) + 1) * sizeof(char));
-	strcpy(doc->fname, fname);
+	if (!pickle_doc_setfname(doc, fname))
+		return PICKLE_ERROR_MEMORY;
 
 	/* Set the file opening mode. */
-	strncpy(doc->fmode, fmode, 2);
+	strncpy(doc->fmode, fmode, 3);
 
 	/* Finally open the file. */
 	doc->fh = fopen(fname, fmode);
 	if (doc->fh == NULL) {
-		pickle_error_msg_format(EMSG("Couldn't open file \"%s\": %s."), fname,
-								strerror(errno));
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't open file "
+							"\"%s\": %s."), fname, strerror(errno));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Check if we'll have to decompress the file as we go. */
+	source = PICKLE_SOURCE_FILE;
+	if (fmode[0] == 'r') {
+		len = fread(magic, sizeof(unsigned char), CODEC_MAGIC_LEN, doc->fh);
+		source = pickle_codec_detect(magic, len);
+		if (fseek(doc->fh, 0, SEEK_SET) != 0) {
+			pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't rewind file "
+								"\"%s\": %s."), fname, strerror(errno));
+			fclose(doc->fh);
+			doc->fh = NULL;
+			return PICKLE_ERROR_FILE;
+		}
+	}
+
+	/* Get the decompressor ready. */
+	doc->reader.fh = doc->fh;
+	if (source != PICKLE_SOURCE_FILE) {
+		err = pickle_codec_open(&doc->reader, source);
+		IF_PICKLE_ERROR(err) {
+			fclose(doc->fh);
+			doc->fh = NULL;
+			doc->reader.fh = NULL;
+			return err;
+		}
+	}
+
+	/* Start reading from a clean slate. */
+	doc->reader.source = source;
+	doc->reader.data = doc->reader.buf;
+	doc->reader.base = 0;
+	doc->reader.len = 0;
+	doc->reader.pos = 0;
+	doc->reader.eof = false;
+	doc->reader.line = 0;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Opens a PickLE document that is already in memory for parsing. The buffer is
+ * used as-is, nothing is copied out of it.
+ *
+ * @warning The buffer must stay valid until the document is closed. In view mode
+ *          (PICKLE_FLAG_VIEW) the parsed objects point straight into it, so it
+ *          must stay valid until the document is freed or reset instead.
+ * @warning Compressed documents can only be decompressed as they're read from
+ *          a file, so they must be opened with pickle_doc_fopen instead.
+ *
+ * @param doc Pointer to a PickLE document object.
+ * @param buf Buffer holding the contents of the document.
+ * @param len Length of the buffer.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if a
+ *         document is already open. PICKLE_ERROR_NOT_IMPL if the buffer holds
+ *         a compressed document.
+ */
+pickle_err_t pickle_doc_open_mem(pickle_doc_t *doc, const char *buf, size_t len) {
+	/* Check if a document is still opened. */
+	if (doc->reader.source != PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("A document is already open. "
+						 "Close it before opening another one."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* We can't decompress straight from memory. */
+	if (pickle_codec_detect((const unsigned char *)buf, (len < CODEC_MAGIC_LEN) ?
+							len : CODEC_MAGIC_LEN) != PICKLE_SOURCE_FILE) {
+		pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("Compressed documents "
+						 "can only be opened from a file."));
+		return PICKLE_ERROR_NOT_IMPL;
+	}
+
+	/* Point the reader straight at the caller's buffer. */
+	doc->reader.source = PICKLE_SOURCE_MEM;
+	doc->reader.data = buf;
+	doc->reader.len = len;
+	doc->reader.pos = 0;
+	doc->reader.eof = true;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Opens an existing PickLE document file by mapping it into memory. This avoids
+ * going through stdio at all when parsing. Compressed files can't be parsed
+ * straight from the mapping, so they're opened with pickle_doc_fopen instead.
+ *
+ * @warning In view mode (PICKLE_FLAG_VIEW) the parsed objects point straight
+ *          into the mapping, so closing the document doesn't unmap it. It's
+ *          only unmapped once the document is freed or reset.
+ *
+ * @param doc   Pointer to a PickLE document object.
+ * @param fname Document file path.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
+ *         error occurred while trying to map the file. PICKLE_ERROR_NOT_IMPL if
+ *         the platform doesn't support memory-mapped files, or the file is
+ *         compressed with a codec we weren't built with.
+ */
+pickle_err_t pickle_doc_mmap(pickle_doc_t *doc, const char *fname) {
+#ifdef PICKLE_HAS_MMAP
+	struct stat st;
+	void *map;
+	int fd;
+
+	/* Check if a document is still opened. */
+	if (doc->reader.source != PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("A document is already open. "
+						 "Close it before opening another one."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Allocate space for the filename and copy it over. */
+	if (!pickle_doc_setfname(doc, fname))
+		return PICKLE_ERROR_MEMORY;
+	strncpy(doc->fmode, "r", 2);
+
+	/* Open the file and get its size. */
+	fd = open(fname, O_RDONLY);
+	if ((fd < 0) || (fstat(fd, &st) != 0)) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't open file "
+							"\"%s\": %s."), fname, strerror(errno));
+		if (fd >= 0)
+			close(fd);
 		return PICKLE_ERROR_FILE;
 	}
 
+	/* Map the whole file. (Empty files can't be mapped) */
+	map = NULL;
+	if (st.st_size > 0) {
+		map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't map file "
+								"\"%s\": %s."), fname, strerror(errno));
+			close(fd);
+			return PICKLE_ERROR_FILE;
+		}
+	}
+	close(fd);
+
+	/* Compressed files have to be decompressed as they're read. */
+	if ((map != NULL) && (pickle_codec_detect((const unsigned char *)map,
+			((size_t)st.st_size < CODEC_MAGIC_LEN) ? (size_t)st.st_size :
+			CODEC_MAGIC_LEN) != PICKLE_SOURCE_FILE)) {
+		munmap(map, (size_t)st.st_size);
+		return pickle_doc_fopen(doc, fname, "r");
+	}
+
+	/* Point the reader at the mapping. */
+	doc->reader.source = PICKLE_SOURCE_MMAP;
+	doc->reader.data = (const char *)map;
+	doc->reader.len = (size_t)st.st_size;
+	doc->reader.pos = 0;
+	doc->reader.eof = true;
+
 	return PICKLE_OK;
+#else
+	pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("Memory-mapped files are not "
+					 "supported on this platform."));
+	return PICKLE_ERROR_NOT_IMPL;
+#endif /* PICKLE_HAS_MMAP */
 }
 
 /**
- * Closes the file handle for a PickLE document.
+ * Closes the file handle (or memory mapping) for a PickLE document.
+ *
+ * @warning Objects parsed in view mode (PICKLE_FLAG_VIEW) from a memory mapping
+ *          point straight into it, so the mapping is kept around until the
+ *          document is freed or reset. Those parsed from a buffer given to
+ *          pickle_doc_open_mem need it to stay valid for just as long.
  *
  * @param doc PickLE document object to have its file handle closed.
  *
  * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
- *         error occurred while trying to close the file.
+ *         error occurred while trying to close the file. PICKLE_ERROR_MEMORY if
+ *         we ran out of memory while holding on to the mapping of a view mode
+ *         document, in which case it's left open.
  *
  * @see pickle_doc_free
  */
 pickle_err_t pickle_doc_fclose(pickle_doc_t *doc) {
-	/* Try to close the file handle. */
-	if (fclose(doc->fh) != 0) {
-		pickle_error_msg_format(EMSG("Couldn't close file \"%s\": %s."),
-								doc->fname, strerror(errno));
-		return PICKLE_ERROR_FILE;
+	pickle_err_t err;
+
+	/* Views still point into the mapping, so hold on to it. */
+	if (doc->flags & PICKLE_FLAG_VIEW) {
+		err = pickle_doc_keepmap(doc);
+		IF_PICKLE_ERROR(err) {
+			return err;
+		}
+	}
+
+	return pickle_doc_detach(doc);
+}
+
+/**
+ * Closes the source of a document no matter what still points into it.
+ *
+ * @param doc PickLE document object to have its source closed.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
+ *         error occurred while trying to close the file.
+ *
+ * @see pickle_doc_fclose
+ */
+pickle_err_t pickle_doc_detach(pickle_doc_t *doc) {
+	pickle_err_t err;
+
+	/* Try to close the source. */
+	err = pickle_reader_close(&doc->reader);
+	IF_PICKLE_ERROR(err) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't close file "
+							"\"%s\": %s."), doc->fname, strerror(errno));
+		return err;
 	}
 
 	/* NULL out the file handle and return. */
@@ -136,41 +1025,183 @@ pickle_err_t pickle_doc_fclose(pickle_doc_t *doc) {
 }
 
 /**
- * Frees up everything in the document object and closes the file handle. This
- * is what you want to call for a proper clean up.
+ * Takes the memory mapping of the document away from its reader and keeps it
+ * until the document is cleared, so that closing the document doesn't pull it
+ * out from under the objects that were parsed in view mode.
+ *
+ * @param doc PickLE document object about to be closed.
+ *
+ * @return PICKLE_OK if the mapping is being kept or there's none.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
+ */
+pickle_err_t pickle_doc_keepmap(pickle_doc_t *doc) {
+#ifdef PICKLE_HAS_MMAP
+	pickle_view_t *view;
+
+	/* Only mappings are owned by the document. */
+	if ((doc->reader.source != PICKLE_SOURCE_MMAP) ||
+			(doc->reader.data == NULL)) {
+		return PICKLE_OK;
+	}
+
+	/* Keep track of the mapping. */
+	view = (pickle_view_t *)pickle_mem_alloc(&doc->allocator,
+											 sizeof(pickle_view_t));
+	if (view == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't hold on to the "
+						 "mapping of a view mode document."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	view->map = (void *)doc->reader.data;
+	view->len = doc->reader.len;
+	view->next = (pickle_view_t *)doc->views;
+	doc->views = view;
+
+	/* Make sure the reader doesn't unmap it. */
+	doc->reader.data = NULL;
+#else
+	(void)doc;
+#endif /* PICKLE_HAS_MMAP */
+
+	return PICKLE_OK;
+}
+
+/**
+ * Unmaps every mapping that was kept around for objects parsed in view mode.
+ *
+ * @param doc PickLE document object whose objects were thrown away.
+ */
+void pickle_doc_dropmaps(pickle_doc_t *doc) {
+#ifdef PICKLE_HAS_MMAP
+	pickle_view_t *view;
+
+	while (doc->views != NULL) {
+		view = (pickle_view_t *)doc->views;
+		doc->views = view->next;
+		munmap(view->map, view->len);
+		pickle_mem_free(&doc->allocator, view);
+	}
+#else
+	(void)doc;
+#endif /* PICKLE_HAS_MMAP */
+}
+
+/**
+ * Frees up everything in the document object, closes the file handle and frees
+ * the document object itself. This is what you want to call for a proper clean
+ * up.
  *
  * @param doc Document object to be completely cleaned up.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
+ *         error occurred while trying to close the file.
+ *
+ * @see pickle_doc_reset
  */
 pickle_err_t pickle_doc_free(pickle_doc_t *doc) {
+	pickle_allocator_t allocator;
 	pickle_err_t err;
-	size_t i;
 
 	/* Start by closing the file handle. */
-	err = pickle_doc_fclose(doc);
+	err = pickle_doc_detach(doc);
 	IF_PICKLE_ERROR(err) {
 		return err;
 	}
 
-	/* Free file name. */
-	free(doc->fname);
+	/* Get rid of the objects and drop every arena chunk at once. */
+	pickle_doc_clear(doc);
+	pickle_strtab_free(&doc->strtab, &doc->allocator);
+	pickle_arena_free(&doc->arena);
+
+	/* Free the collections, file name, and the line reader buffer. */
+	allocator = doc->allocator;
+	if (doc->properties != NULL)
+		pickle_mem_free(&allocator, doc->properties);
+	pickle_index_free(&doc->index_properties, &allocator);
+	if (doc->categories != NULL)
+		pickle_mem_free(&allocator, doc->categories);
+	if (doc->components != NULL)
+		pickle_mem_free(&allocator, doc->components);
+	pickle_refdes_index_free(&doc->index_refdes, &allocator);
+	if (doc->fname != NULL)
+		pickle_mem_free(&allocator, doc->fname);
+	pickle_reader_free(&doc->reader);
 
-	/* Free the properties. */
-	for (i = 0; i < doc->len_properties; i++) {
-		pickle_property_free(doc->properties[i]);
+	/* Free up our object. */
+	pickle_mem_free(&allocator, doc);
+
+	return PICKLE_OK;
+}
+
+/**
+ * Closes the document and throws away everything that was parsed while keeping
+ * the arena chunks, collections and reader buffer around, so that the next
+ * document parsed with this object doesn't have to allocate anything new.
+ *
+ * @param doc Document object to be reset.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
+ *         error occurred while trying to close the file.
+ *
+ * @see pickle_doc_free
+ */
+pickle_err_t pickle_doc_reset(pickle_doc_t *doc) {
+	pickle_err_t err;
+
+	/* Start by closing the file handle. */
+	err = pickle_doc_detach(doc);
+	IF_PICKLE_ERROR(err) {
+		return err;
 	}
-	doc->properties = NULL;
-	doc->len_properties = 0;
 
-	/* TODO: Free the categories and components. */
+	/* Empty the document while keeping its memory around. */
+	pickle_doc_clear(doc);
+	pickle_strtab_clear(&doc->strtab);
+	pickle_arena_reset(&doc->arena);
+	memset(&doc->stats, 0, sizeof(pickle_stats_t));
 
 	return PICKLE_OK;
 }
 
+/**
+ * Frees up the objects that were individually allocated and added to the
+ * document by the user (everything else lives in the arena) and empties the
+ * collections.
+ *
+ * @param doc Document object to be emptied.
+ */
+void pickle_doc_clear(pickle_doc_t *doc) {
+	size_t i;
+
+	/* Only objects that weren't allocated from the arena need any work. */
+	if (doc->adopted) {
+		for (i = 0; i < doc->len_properties; i++)
+			pickle_property_free(doc->properties[i]);
+		for (i = 0; i < doc->len_categories; i++)
+			pickle_category_free(doc->categories[i]);
+		for (i = 0; i < doc->len_components; i++)
+			pickle_component_free(doc->components[i]);
+		doc->adopted = false;
+	}
+
+	doc->len_properties = 0;
+	doc->len_categories = 0;
+	doc->len_components = 0;
+	doc->index_properties.valid = false;
+	doc->index_refdes.valid = false;
+	doc->iter_window = false;
+
+	/* Loaded objects point straight into the compiled document, and views
+	 * into the mappings of closed documents. */
+	pickle_compiled_unmap(doc);
+	pickle_doc_dropmaps(doc);
+}
+
 /**
  * Reads a line from the document file.
  *
  * @warning This function automatically allocates memory for the line. You are
- *          responsible for freeing this later.
+ *          responsible for freeing this later with pickle_free.
  *
  * @param doc  Opened PickLE document object.
  * @param line Line that was read from the file. (Allocated by this function)
@@ -178,36 +1209,85 @@ pickle_err_t pickle_doc_free(pickle_doc_t *doc) {
  * @return PICKLE_OK if we were able to get a line with contents from the file.
  *         PICKLE_PARSED_BLANK if we got an empty or just whitespace line.
  *         PICKLE_ERROR_FILE if there was an error while trying to read the file.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
  */
 pickle_err_t pickle_doc_getline(pickle_doc_t *doc, char **line) {
+	pickle_err_t err;
+	const char *view;
 	size_t len;
+
+	/* Read our line straight from the buffer. */
+	*line = NULL;
+	err = pickle_doc_nextline(doc, &view, &len);
+	if (err != PICKLE_OK)
+		return err;
+
+	/* Give the caller a copy that they own. */
+	*line = (char *)pickle_mem_alloc(NULL, (len + 1) * sizeof(char));
+	if (*line == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "line that was read from the document."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	memcpy(*line, view, len);
+	(*line)[len] = '\0';
+
+	return PICKLE_OK;
+}
+
+/**
+ * Reads a line from the document without copying it out of the source.
+ *
+ * @warning The line points into the document's source (or reader buffer) and
+ *          is only guaranteed to be valid until the next read. It isn't NULL
+ *          terminated and must not be free'd.
+ *
+ * @param doc  Opened PickLE document object.
+ * @param line Pointer to the start of the line.
+ * @param len  Length of the line.
+ *
+ * @return PICKLE_OK if we were able to get a line with contents from the file.
+ *         PICKLE_PARSED_BLANK if we got an empty or just whitespace line.
+ *         PICKLE_FINISHED_PARSING if we've reached the end of the file.
+ *         PICKLE_NEED_DATA if the whole line hasn't been fed to a push parser
+ *         yet. PICKLE_ERROR_FILE if there was an error while trying to read
+ *         the file. PICKLE_ERROR_MEMORY if we ran out of memory.
+ *
+ * @see pickle_doc_getline
+ */
+pickle_err_t pickle_doc_nextline(pickle_doc_t *doc, const char **line, size_t *len) {
 	int ret;
 
 	/* Read our line. */
-	ret = pickle_util_getline(doc->fh, line, &len, LINEBUF_MAX_LEN);
+	ret = pickle_reader_getline(&doc->reader, line, len);
 	if (ret != 0) {
+		*line = NULL;
+
 		/* Check if we've reached the end of the file. */
 		if (ret == -2)
 			return PICKLE_FINISHED_PARSING;
 
-		/* Set the error message. */
-		pickle_error_msg_set(EMSG("An error occurred while reading a line from "
-			"the document."));
+		/* Is the rest of the line yet to be fed to us? */
+		if (ret == 1)
+			return PICKLE_NEED_DATA;
 
-		/* Ensure that we free any resources. */
-		if (*line != NULL) {
-			free(*line);
-			*line = NULL;
+		/* Did the line not fit in memory? */
+		if (ret == -3) {
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+							 "buffer for a line of the document."));
+			return PICKLE_ERROR_MEMORY;
 		}
 
+		/* Set the error message. */
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("An error occurred while "
+						 "reading a line from the document."));
+
 		return PICKLE_ERROR_FILE;
 	}
 
 	/* Check if we have an empty line. */
-	if (pickle_util_iswtspc(*line)) {
-		free(*line);
-		*line = NULL;
-
+	if (pickle_util_iswtspc(*line, *len)) {
+		STATS_COUNT(doc, blank_lines);
 		return PICKLE_PARSED_BLANK;
 	}
 
@@ -224,717 +1304,7433 @@ pickle_err_t pickle_doc_getline(pickle_doc_t *doc, char **line) {
  *         something in the document couldn't be parsed.
  */
 pickle_err_t pickle_doc_parse(pickle_doc_t *doc) {
-	char *line;
-	pickle_err_t err;
-	pickle_property_t *prop;
-	pickle_category_t *cat;
-	pickle_component_t *comp;
+	pickle_iter_t state;
 
 	/* Check if the file has been opened. */
-	if (doc->fh == NULL) {
-		pickle_error_msg_set(EMSG(
-			"Can't parse a document that hasn't been opened yet."));
+	if (doc->reader.source == PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Can't parse a document that "
+						 "hasn't been opened yet."));
 		return PICKLE_ERROR_FILE;
 	}
 
-	/* Start by parsing the document's properties. */
-	line = NULL;
-	prop = NULL;
-	do {
-		/* Get line from document file. */
-		err = pickle_doc_getline(doc, &line);
-		IF_PICKLE_ERROR(err) {
-			if (line != NULL) {
-				free(line);
-				line = NULL;
-			}
-
-			return err;
-		}
-
-		/* Check if we only had whitespace. */
-		if (err == PICKLE_PARSED_BLANK)
-			continue;
-
-		/* Try to parse a property. */
-		err = pickle_property_parse(line, &prop);
-		IF_PICKLE_ERROR(err) {
-			if (line != NULL) {
-				free(line);
-				line = NULL;
-			}
+	/* Go through the document appending everything to our collections. */
+	pickle_iter_init(&state);
+	return pickle_parser_run(doc, &state);
+}
 
-			return err;
-		}
+/**
+ * Parses a whole document using several threads. The body of the document is
+ * cut into pieces that start at category lines, which are parsed concurrently
+ * and stitched back together in order. The end result is exactly the same as
+ * pickle_doc_parse.
+ *
+ * @warning Only in-memory and memory-mapped documents can be split. Documents
+ *          opened with pickle_doc_fopen are simply parsed by pickle_doc_parse.
+ * @warning Every thread allocates the pieces it parses from the document's
+ *          allocator, so it must be safe to call from several threads at once.
+ *          (The default one is)
+ *
+ * @param doc       Opened PickLE document object.
+ * @param threads   Number of threads to use. 0 uses one per processor core.
+ * @param min_chunk Minimum size in bytes of each piece of the document. 0 uses
+ *                  a sensible default. Documents smaller than twice this are
+ *                  parsed on the calling thread.
+ *
+ * @return Same as pickle_doc_parse.
+ *
+ * @see pickle_doc_parse
+ */
+pickle_err_t pickle_doc_parse_parallel(pickle_doc_t *doc, unsigned int threads, size_t min_chunk) {
+	pickle_stats_mark_t mark;
+	pickle_property_t *prop;
+	pickle_chunk_t *chunks;
+	pickle_iter_t state;
+	const char *line;
+	const char *data;
+	size_t len_chunks;
+	size_t target;
+	size_t start;
+	size_t total;
+	size_t len;
+	size_t i;
+	pickle_err_t err;
 
-		/* Append property to the collection. */
-		if (err == PICKLE_OK)
-			pickle_doc_property_add(doc, prop);
+	/* Only documents we have random access to can be split. */
+	if ((doc->reader.source != PICKLE_SOURCE_MEM) &&
+			(doc->reader.source != PICKLE_SOURCE_MMAP)) {
+		return pickle_doc_parse(doc);
+	}
 
-		/* Free up our resources. */
-		if (line != NULL) {
-			free(line);
-			line = NULL;
+	/* Parse the properties on our own. */
+	STATS_BEGIN(doc, PICKLE_PHASE_PROPERTIES, &mark);
+	for (;;) {
+		err = pickle_doc_nextline(doc, &line, &len);
+		if (err == PICKLE_PARSED_BLANK)
+			continue;
+		if (err != PICKLE_OK) {
+			STATS_END(doc, &mark);
+			return (err == PICKLE_FINISHED_PARSING) ? PICKLE_OK : err;
 		}
-	} while (err != PICKLE_FINISHED_PARSING);
-
-	/* Try to parse categories and components. */
-	line = NULL;
-	prop = NULL;
-	cat = NULL;
-	comp = NULL;
-	do {
-		/* TODO: Check if first parsed thing was a category. */
 
-		/* Get line from document file. */
-		err = pickle_doc_getline(doc, &line);
+		/* Have we reached the end of the properties? */
+		err = pickle_parser_prop(doc, line, len, &prop);
 		IF_PICKLE_ERROR(err) {
-			if (line != NULL) {
-				free(line);
-				line = NULL;
-			}
-
+			pickle_error_loc(&doc->reader);
+			STATS_END(doc, &mark);
 			return err;
 		}
-
-		/* Check if we only had whitespace. */
-		if (err == PICKLE_PARSED_BLANK) {
-			continue;
-		} else if (err == PICKLE_FINISHED_PARSING) {
-			/* Have we reached the end of the file? */
+		if (err == PICKLE_FINISHED_PARSING)
 			break;
+
+		err = pickle_doc_property_add(doc, prop);
+		IF_PICKLE_ERROR(err) {
+			STATS_END(doc, &mark);
+			return err;
 		}
+	}
+	STATS_END(doc, &mark);
+
+	/* Figure out how big each piece should be. */
+	if (threads == 0)
+		threads = pickle_worker_cores();
+	if (min_chunk == 0)
+		min_chunk = PARALLEL_MIN_CHUNK;
+	data = doc->reader.data;
+	total = doc->reader.len;
+	start = pickle_reader_tell(&doc->reader);
+	target = (total - start) / (threads * PARALLEL_CHUNKS_PER_THREAD);
+	if (target < min_chunk)
+		target = min_chunk;
+
+	/* Small documents aren't worth the trouble. */
+	if ((threads < 2) || ((total - start) < (min_chunk * 2))) {
+		pickle_iter_init(&state);
+		state.body = true;
+		return pickle_parser_run(doc, &state);
+	}
 
-		/* Check if we have a category. */
-		if (pickle_parser_iscat(line)) {
-			/* Try to parse a category. */
-			err = pickle_category_parse(line, &cat);
-			IF_PICKLE_ERROR(err) {
-				if (line != NULL) {
-					free(line);
-					line = NULL;
-				}
+	/* Cut the body of the document at category lines. */
+	STATS_BEGIN(doc, PICKLE_PHASE_BODY, &mark);
+	len_chunks = ((total - start) / target) + 1;
+	chunks = (pickle_chunk_t *)pickle_mem_alloc(&doc->allocator,
+		len_chunks * sizeof(pickle_chunk_t));
+	if (chunks == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "document pieces."));
+		STATS_END(doc, &mark);
+		return PICKLE_ERROR_MEMORY;
+	}
+	for (i = 0; (i < len_chunks) && (start < total); i++) {
+		chunks[i].data = data;
+		chunks[i].start = start;
+		chunks[i].end = ((total - start) <= target) ? total :
+			pickle_parser_nextcat(data, total, start + target);
+		chunks[i].allocator = &doc->allocator;
+		chunks[i].doc = NULL;
+		chunks[i].err = PICKLE_OK;
+		start = chunks[i].end;
+	}
+	len_chunks = i;
 
-				return err;
-			}
+	/* Parse every piece. */
+	err = pickle_worker_run(len_chunks, threads, pickle_parser_chunk, chunks,
+							doc->flags);
 
-			/* Append category to the collection. */
-			if (err == PICKLE_OK)
-				pickle_doc_category_add(doc, cat);
+	/* The pieces account for the memory they allocated themselves. */
+	STATS_REBASE(doc, &mark);
+
+	/* Stitch everything back together in order, stopping at the first error. */
+	for (i = 0; (err == PICKLE_OK) && (i < len_chunks); i++) {
+		if (chunks[i].doc != NULL) {
+			err = pickle_doc_adopt(doc, chunks[i].doc);
+			IF_PICKLE_ERROR(err) {
+				break;
+			}
 		}
 
-		/* Free up our resources. */
-		if (line != NULL) {
-			free(line);
-			line = NULL;
+		if (chunks[i].err != PICKLE_OK) {
+			pickle_error_state = chunks[i].error;
+			err = chunks[i].err;
 		}
-	} while ((err <= PICKLE_OK) && (err != PICKLE_FINISHED_PARSING));
+	}
 
-	return PICKLE_OK;
+	/* Clean up. */
+	for (i = 0; i < len_chunks; i++) {
+		if (chunks[i].doc != NULL)
+			pickle_doc_free(chunks[i].doc);
+	}
+	pickle_mem_free(&doc->allocator, chunks);
+
+	/* We've consumed the whole document. */
+	if (err == PICKLE_OK)
+		doc->reader.pos = doc->reader.len;
+
+	STATS_END(doc, &mark);
+
+	return err;
 }
 
 /**
- * Appends a property to the document object properties collection.
+ * Parses the rest of a document appending everything to its collections.
  *
- * @param doc  PickLE document object.
- * @param prop Property to be appended to the properties collection.
+ * @param doc   Opened PickLE document object.
+ * @param state Parser state to start from.
  *
- * @return PICKLE_OK if everything went fine.
+ * @return Same as pickle_doc_parse.
+ *
+ * @see pickle_doc_parse
  */
-pickle_err_t pickle_doc_property_add(pickle_doc_t *doc, pickle_property_t *prop) {
-	doc->properties = (pickle_property_t **)realloc(
-		doc->properties,
-		(doc->len_properties + 1) * sizeof(pickle_property_t *));
-	doc->properties[doc->len_properties] = prop;
-	doc->len_properties++;
+pickle_err_t pickle_parser_run(pickle_doc_t *doc, pickle_iter_t *state) {
+	pickle_stats_mark_t mark;
+	pickle_event_t event;
+	pickle_err_t err;
+
+	STATS_BEGIN(doc, (state->body) ? PICKLE_PHASE_BODY :
+				PICKLE_PHASE_PROPERTIES, &mark);
+	for (;;) {
+		/* Parse the next object in the document. */
+		err = pickle_parser_next(doc, state, &event);
+		IF_PICKLE_ERROR(err) {
+			STATS_END(doc, &mark);
+			return err;
+		}
+
+		/* Have we reached the end of the file? */
+		if (err == PICKLE_FINISHED_PARSING)
+			break;
+		STATS_SWITCH(doc, (state->body) ? PICKLE_PHASE_BODY :
+					 PICKLE_PHASE_PROPERTIES, &mark);
+
+		/* Append the object to its collection. */
+		switch (event.type) {
+		case PICKLE_EVENT_PROPERTY:
+			err = pickle_doc_property_add(doc, event.property);
+			break;
+		case PICKLE_EVENT_CATEGORY:
+			err = pickle_doc_category_add(doc, event.category);
+			break;
+		case PICKLE_EVENT_COMPONENT:
+			err = pickle_doc_component_add(doc, event.component);
+			break;
+		default:
+			break;
+		}
+		IF_PICKLE_ERROR(err) {
+			STATS_END(doc, &mark);
+			return err;
+		}
+	}
+	STATS_END(doc, &mark);
 
 	return PICKLE_OK;
 }
 
 /**
- * Appends a category to the document object categories collection.
+ * Gets the parsing statistics of a document, which are accumulated from every
+ * parse until the document is reset.
+ *
+ * @warning Statistics are only collected if the library was built with
+ *          PICKLE_STATS defined. Otherwise everything is always zero.
  *
  * @param doc PickLE document object.
- * @param cat Category to be appended to the categories collection.
  *
- * @return PICKLE_OK if everything went fine.
+ * @return Parsing statistics of the document.
+ *
+ * @see pickle_doc_stats_hook
  */
-pickle_err_t pickle_doc_category_add(pickle_doc_t *doc, pickle_category_t *cat) {
-	doc->categories = (pickle_category_t **)realloc(
-		doc->categories,
-		(doc->len_categories + 1) * sizeof(pickle_category_t *));
-	doc->categories[doc->len_categories] = cat;
-	doc->len_categories++;
-
-	return PICKLE_OK;
+const pickle_stats_t *pickle_doc_stats(const pickle_doc_t *doc) {
+	return &doc->stats;
 }
 
 /**
- * Allocates a brand new property object.
- * @warning This function allocates memory that you are responsible for freeing.
+ * Registers a hook to be called at the start and end of each parsing phase of
+ * a document. Useful for feeding the statistics into a tracing system.
  *
- * @return A brand new allocated property object.
- * @see pickle_property_free
+ * @param doc      PickLE document object.
+ * @param hook     Function to be called or NULL to remove the current hook.
+ * @param userdata Pointer that is handed over to the hook.
+ *
+ * @return PICKLE_OK if the hook was registered. PICKLE_ERROR_NOT_IMPL if the
+ *         library was built without PICKLE_STATS.
+ *
+ * @see pickle_doc_stats
  */
-pickle_property_t *pickle_property_new(void) {
-	/* Allocate the structure. */
-	pickle_property_t *prop =
-		(pickle_property_t *)malloc(sizeof(pickle_property_t));
+pickle_err_t pickle_doc_stats_hook(pickle_doc_t *doc, pickle_stats_hook_t hook, void *userdata) {
+#ifdef PICKLE_STATS
+	doc->stats_hook = hook;
+	doc->stats_userdata = userdata;
 
-	/* Put it in a default state. */
-	prop->name = NULL;
-	prop->value = NULL;
+	return PICKLE_OK;
+#else
+	(void)doc;
+	(void)hook;
+	(void)userdata;
 
-	return prop;
+	pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("Parsing statistics weren't "
+					 "built into the library."));
+	return PICKLE_ERROR_NOT_IMPL;
+#endif /* PICKLE_STATS */
 }
 
 /**
- * Gets the name of a property.
+ * Saves a compiled (binary) version of a parsed document, which can be loaded
+ * back much faster than parsing the text version. The compiled document keeps
+ * a hash of its source, so that stale versions can be detected when loading.
  *
- * @param prop Property to get the name from.
+ * @warning The compiled format uses the native byte order and is only meant as
+ *          a cache on the machine that created it.
  *
- * @return Name of the property or NULL if one wasn't defined yet.
- */
-const char *pickle_property_name_get(const pickle_property_t *prop) {
-	return (const char *)prop->name;
-}
-
-/**
- * Sets the name of a property.
+ * @param doc   Parsed PickLE document object. Its source (an in-memory buffer
+ *              that is still open, or the file it was opened from) is hashed
+ *              to identify it.
+ * @param cname Path to the compiled document file to be written.
  *
- * @param prop Property to set the name of.
- * @param name Name to be set.
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         source couldn't be hashed or the file couldn't be written.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
+ *
+ * @see pickle_doc_load_compiled
  */
-void pickle_property_name_set(pickle_property_t *prop, const char *name) {
-	pickle_util_strcpy(&prop->name, name);
+pickle_err_t pickle_doc_save_compiled(pickle_doc_t *doc, const char *cname) {
+	uint32_t mtime;
+	uint32_t hash;
+	size_t len;
+	pickle_err_t err;
+
+	/* Identify the source of the document. */
+	err = pickle_compiled_srchash(doc, &hash, &len, &mtime);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+
+	return pickle_compiled_write(doc, cname, hash, len, mtime);
 }
 
 /**
- * Gets the value of a property.
+ * Loads a compiled document, mapping it into memory and pointing the objects
+ * straight at its strings. If the compiled document is missing, corrupted, or
+ * older than its source, the source is parsed as text instead and the compiled
+ * document is written again for the next time around. The source is only
+ * hashed to tell if it changed when its size or modification time don't match
+ * the ones it had when it was compiled.
  *
- * @param prop Property to get the value from.
+ * @warning The document must be empty and must not have an open source. Strings
+ *          of loaded objects are read-only, the setters must be used to change
+ *          them.
  *
- * @return Value of the property or NULL if one wasn't defined yet.
+ * @param doc   Empty PickLE document object to be populated.
+ * @param cname Path to the compiled document file.
+ * @param fname Path to the source document file. If NULL the compiled document
+ *              is trusted as-is and there's nothing to fall back to.
+ *
+ * @return PICKLE_OK if the document was loaded (or parsed) fine.
+ *         PICKLE_ERROR_FILE if neither the compiled document nor its source
+ *         could be read. PICKLE_ERROR_PARSING if the source couldn't be parsed.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
+ *
+ * @see pickle_doc_save_compiled
  */
-const char *pickle_property_value_get(const pickle_property_t *prop) {
-	return (const char *)prop->value;
+pickle_err_t pickle_doc_load_compiled(pickle_doc_t *doc, const char *cname, const char *fname) {
+	uint32_t mtime;
+	uint32_t hash;
+	size_t len;
+	pickle_err_t err;
+
+	/* Loading only makes sense into a clean document. */
+	if ((doc->reader.source != PICKLE_SOURCE_NONE) || (doc->compiled != NULL) ||
+			(doc->len_properties > 0) || (doc->len_categories > 0) ||
+			(doc->len_components > 0)) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Compiled documents can only "
+						 "be loaded into an empty document."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Try to use the compiled document. (The source is only looked at once the
+	 * compiled document is mapped, so it can't change under us in between) */
+	hash = 0;
+	len = 0;
+	mtime = 0;
+	err = pickle_compiled_map(doc, cname);
+	if (err == PICKLE_OK) {
+		if ((fname == NULL) ||
+				pickle_compiled_fresh(doc, fname, &hash, &len, &mtime)) {
+			err = pickle_compiled_fixup(doc);
+			if (err == PICKLE_OK) {
+				if ((fname != NULL) && !pickle_doc_setfname(doc, fname))
+					return PICKLE_ERROR_MEMORY;
+
+				return PICKLE_OK;
+			}
+		}
+
+		/* Throw away the stale or corrupted compiled document. */
+		pickle_doc_clear(doc);
+	}
+	if (fname == NULL) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Compiled document \"%s\" "
+							"is missing or invalid."), cname);
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Identify the source before parsing it, so that it looks stale next time
+	 * if it changes while we're at it. */
+	if (len == 0) {
+		if (pickle_util_stat(fname, &len, &mtime) != PICKLE_OK)
+			mtime = 0;
+		err = pickle_util_hashfile(fname, &hash, &len);
+		IF_PICKLE_ERROR(err) {
+			return err;
+		}
+	}
+
+	/* Fall back to parsing the source document. */
+	err = pickle_doc_fopen(doc, fname, "r");
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+	err = pickle_doc_parse(doc);
+	IF_PICKLE_ERROR(err) {
+		pickle_doc_fclose(doc);
+		return err;
+	}
+	err = pickle_doc_fclose(doc);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+
+	/* Refresh the compiled document. (Not being able to cache isn't fatal) */
+	pickle_compiled_write(doc, cname, hash, len, mtime);
+
+	return PICKLE_OK;
 }
 
 /**
- * Sets the value of a property.
+ * Writes a document out as canonical PickLE text to a file. The output is put
+ * together in large blocks, so only a handful of writes are actually issued.
  *
- * @param prop Property to set the value of.
- * @param value Value to be set.
+ * @param doc PickLE document object.
+ * @param fh  File to write the document to. (Opened for writing)
+ *
+ * @return PICKLE_OK if the document was written. PICKLE_ERROR_FILE if writing
+ *         to the file failed. PICKLE_ERROR_MEMORY if we couldn't allocate the
+ *         write buffer.
+ *
+ * @see pickle_doc_write_fd
+ * @see pickle_doc_write_mem
  */
-void pickle_property_value_set(pickle_property_t *prop, const char *value) {
-	pickle_util_strcpy(&prop->value, value);
+pickle_err_t pickle_doc_write(const pickle_doc_t *doc, FILE *fh) {
+	pickle_writer_t wr;
+	pickle_err_t err;
+
+	/* Set up the writer. */
+	err = pickle_writer_init(&wr, PICKLE_SINK_FILE);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+	wr.fh = fh;
+
+	/* Write everything out. */
+	pickle_writer_doc(&wr, doc);
+	pickle_writer_flush(&wr);
+	pickle_mem_free(NULL, wr.buf);
+
+	/* Make sure it actually reached the file. */
+	if ((wr.err == PICKLE_OK) && (fflush(fh) != 0)) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Couldn't write the document "
+						 "to the file."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	return wr.err;
 }
 
 /**
- * Frees up the resources allocated by a property object.
+ * Writes a document out as canonical PickLE text to a file descriptor.
  *
- * @param prop Property object to be free'd.
+ * @param doc PickLE document object.
+ * @param fd  File descriptor to write the document to.
  *
- * @return PICKLE_OK if the operation was successful.
+ * @return PICKLE_OK if the document was written. PICKLE_ERROR_FILE if writing
+ *         to the file descriptor failed. PICKLE_ERROR_MEMORY if we couldn't
+ *         allocate the write buffer. PICKLE_ERROR_NOT_IMPL if the platform
+ *         doesn't have file descriptors.
+ *
+ * @see pickle_doc_write
  */
-pickle_err_t pickle_property_free(pickle_property_t *prop) {
-	/* Check if we have anything to do. */
-	if (prop == NULL)
-		return PICKLE_OK;
+pickle_err_t pickle_doc_write_fd(const pickle_doc_t *doc, int fd) {
+#ifdef PICKLE_HAS_FD
+	pickle_writer_t wr;
+	pickle_err_t err;
 
-	/* Free up any internal allocations first. */
-	if (prop->name != NULL)
-		free(prop->name);
-	if (prop->value != NULL)
-		free(prop->value);
+	/* Set up the writer. */
+	err = pickle_writer_init(&wr, PICKLE_SINK_FD);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+	wr.fd = fd;
 
-	/* Free up our object. */
-	free(prop);
-	prop = NULL;
+	/* Write everything out. */
+	pickle_writer_doc(&wr, doc);
+	pickle_writer_flush(&wr);
+	pickle_mem_free(NULL, wr.buf);
 
-	return PICKLE_OK;
+	return wr.err;
+#else
+	(void)doc;
+	(void)fd;
+
+	pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("File descriptors aren't "
+					 "supported on this platform."));
+	return PICKLE_ERROR_NOT_IMPL;
+#endif /* PICKLE_HAS_FD */
 }
 
 /**
- * Parses a property line.
+ * Writes a document out as canonical PickLE text to a brand new memory buffer.
  *
- * @warning prop will be allocated by this function and must be free'd by you.
+ * @warning This function allocates memory that you are responsible for freeing
+ *          with pickle_free.
  *
- * @param line Line to be parsed.
- * @param prop Property object to be populated by this function. Will be set to
- *             NULL if there isn't a valid property to parse.
+ * @param doc PickLE document object.
+ * @param buf Buffer with the NULL terminated text. (Allocated by this function)
+ * @param len Length of the text.
  *
- * @return PICKLE_OK if a property was parsed. PICKLE_PARSED_BLANK if a blank
- *         line was found. PICKLE_FINISHED_PARSING when there are no more
- *         properties to be parsed. PICKLE_ERROR_PARSING if the line we tried to
- *         parse was malformed.
+ * @return PICKLE_OK if the document was written. PICKLE_ERROR_MEMORY if we ran
+ *         out of memory.
  *
- * @see pickle_doc_parse
+ * @see pickle_doc_write
  */
-pickle_err_t pickle_property_parse(const char *line, pickle_property_t **prop) {
-	const char *cur;
-
-	/* Check if we have finished parsing. */
-	if (line[0] == '-') {
-		if (strcmp(line, "---") == 0)
-			return PICKLE_FINISHED_PARSING;
+pickle_err_t pickle_doc_write_mem(const pickle_doc_t *doc, char **buf, size_t *len) {
+	pickle_writer_t wr;
+	pickle_err_t err;
 
-		/* Invalid property name. */
-		pickle_error_msg_set(EMSG("A property can't start with a dash."));
-		return PICKLE_ERROR_PARSING;
+	/* Set up the writer. */
+	*buf = NULL;
+	*len = 0;
+	err = pickle_writer_init(&wr, PICKLE_SINK_MEM);
+	IF_PICKLE_ERROR(err) {
+		return err;
 	}
 
-	/* Check if line starts with a colon. */
-	if (line[0] == ':') {
-		pickle_error_msg_set(EMSG("Property line must not start with a colon."));
-		return PICKLE_ERROR_PARSING;
+	/* Write everything out and NULL terminate it. */
+	pickle_writer_doc(&wr, doc);
+	pickle_writer_put(&wr, "", 1);
+	if (wr.err != PICKLE_OK) {
+		pickle_mem_free(NULL, wr.buf);
+		return wr.err;
 	}
 
-	/* Allocate the brand new property. */
-	*prop = pickle_property_new();
+	/* Hand the buffer over. */
+	*buf = wr.buf;
+	*len = wr.len - 1;
 
-	/* Find the first occurrence of a colon. */
-	cur = strpbrk(line, ":");
-	if (cur == NULL) {
-		pickle_error_msg_set(EMSG("Property line does not contain a colon."));
-		goto parsing_error;
+	return PICKLE_OK;
+}
+
+/**
+ * Moves every object of another document (and the memory backing them) to the
+ * end of a document's collections, interning their strings again in the
+ * document's string table.
+ *
+ * @param doc   PickLE document object that will receive the objects.
+ * @param other PickLE document object that will be left empty.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_MEMORY if we
+ *         ran out of memory.
+ */
+pickle_err_t pickle_doc_adopt(pickle_doc_t *doc, pickle_doc_t *other) {
+	pickle_component_t *comp;
+	const char *str;
+	size_t i;
+	size_t j;
+
+	/* Make sure we have space for everything. */
+	if (!pickle_util_grow(&doc->allocator,
+						  (void **)&doc->properties, &doc->cap_properties,
+						  doc->len_properties + other->len_properties,
+						  sizeof(pickle_property_t *)) ||
+			!pickle_util_grow(&doc->allocator,
+							  (void **)&doc->categories, &doc->cap_categories,
+							  doc->len_categories + other->len_categories,
+							  sizeof(pickle_category_t *)) ||
+			!pickle_util_grow(&doc->allocator,
+							  (void **)&doc->components, &doc->cap_components,
+							  doc->len_components + other->len_components,
+							  sizeof(pickle_component_t *))) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+						 "collections."));
+		return PICKLE_ERROR_MEMORY;
 	}
 
-	/* Copy the property name over. */
-	pickle_util_strstrcpy(&((*prop)->name), line, cur - 1);
+	/* Take over the memory of the objects. */
+	pickle_arena_adopt(&doc->arena, &other->arena);
+#ifdef PICKLE_STATS
+	doc->stats.lines += other->stats.lines;
+	doc->stats.blank_lines += other->stats.blank_lines;
+	doc->stats.allocs += other->stats.allocs;
+	doc->stats.bytes_allocated += other->stats.bytes_allocated;
+#endif /* PICKLE_STATS */
+	if (other->adopted)
+		doc->adopted = true;
+
+	/* Move the objects over. */
+	doc->index_properties.valid = false;
+	doc->index_refdes.valid = false;
+	for (i = 0; i < other->len_properties; i++) {
+		if (other->properties[i]->arena != NULL)
+			other->properties[i]->arena = &doc->arena;
+		doc->properties[doc->len_properties++] = other->properties[i];
+	}
+	for (i = 0; i < other->len_categories; i++) {
+		if (other->categories[i]->arena != NULL)
+			other->categories[i]->arena = &doc->arena;
+		if (other->categories[i]->len_components > 0)
+			other->categories[i]->first_component += doc->len_components;
+		doc->categories[doc->len_categories++] = other->categories[i];
+	}
+	for (i = 0; i < other->len_components; i++) {
+		comp = other->components[i];
+		doc->components[doc->len_components++] = comp;
+		if (comp->arena == NULL)
+			continue;
+		comp->arena = &doc->arena;
 
-	/* Move the cursor over to skip the colon and any whitespace. */
-	cur += strspn(cur, ":" VALID_WHITESPACE);
-	if (*cur == '\0') {
-		pickle_error_msg_set(EMSG("Property line does not contain a value."));
-		goto parsing_error;
+		/* Interned strings must be unique across the whole document. */
+		if (doc->flags & DOC_FLAG_SCRATCH)
+			continue;
+		if ((comp->package != NULL) && ((str = pickle_strtab_intern(
+				&doc->strtab, &doc->allocator, NULL, comp->package, comp->len_package)) != NULL)) {
+			comp->package = (char *)str;
+		}
+		if ((comp->description != NULL) && ((str = pickle_strtab_intern(
+				&doc->strtab, &doc->allocator, NULL, comp->description,
+				comp->len_description)) != NULL)) {
+			comp->description = (char *)str;
+		}
+		for (j = 0; j < comp->refdes.length; j++) {
+			str = pickle_strtab_intern(&doc->strtab, &doc->allocator, NULL,
+									   comp->refdes.refdes[j],
+									   strlen(comp->refdes.refdes[j]));
+			if (str != NULL)
+				comp->refdes.refdes[j] = (char *)str;
+		}
 	}
 
-	/* Copy the property value over and return. */
-	pickle_property_value_set(*prop, cur);
-	return PICKLE_OK;
+	/* Leave the other document empty. */
+	other->len_properties = 0;
+	other->len_categories = 0;
+	other->len_components = 0;
+	other->adopted = false;
+	pickle_strtab_clear(&other->strtab);
 
-parsing_error:
-	pickle_property_free(*prop);
-	return PICKLE_ERROR_PARSING;
+	return PICKLE_OK;
 }
 
 /**
- * Allocates a brand new category object.
- * @warning This function allocates memory that you are responsible for freeing.
+ * Interns a string in the document's string table. Interning the same string
+ * twice returns the exact same pointer, so interned strings (like the package,
+ * description, and reference designators of parsed components) can be compared
+ * with a simple pointer comparison.
  *
- * @return A brand new allocated category object.
- * @see pickle_category_free
+ * @warning Interned strings live and die with the document and must never be
+ *          modified.
+ *
+ * @param doc PickLE document object.
+ * @param str String to be interned. (Doesn't need to be NULL terminated)
+ * @param len Length of the string.
+ *
+ * @return Canonical NULL terminated copy of the string or NULL if we ran out
+ *         of memory.
  */
-pickle_category_t *pickle_category_new(void) {
-	/* Allocate the structure. */
-	pickle_category_t *cat =
-		(pickle_category_t *)malloc(sizeof(pickle_category_t));
+const char *pickle_doc_intern(pickle_doc_t *doc, const char *str, size_t len) {
+	return pickle_strtab_intern(&doc->strtab, &doc->allocator, &doc->arena,
+								str, len);
+}
+
+/**
+ * Pre-allocates the components collection of a document. Use this when you know
+ * roughly how many components are going to be added to the document so that it
+ * only has to be allocated once.
+ *
+ * @param doc        PickLE document object.
+ * @param components Number of components expected to be in the document.
+ *
+ * @return PICKLE_OK if everything went fine. PICKLE_ERROR_MEMORY if we couldn't
+ *         allocate the collection.
+ */
+pickle_err_t pickle_doc_reserve(pickle_doc_t *doc, size_t components) {
+	pickle_component_t **comps;
+
+	/* Do we already have enough space? */
+	if (components <= doc->cap_components)
+		return PICKLE_OK;
+
+	/* Allocate exactly what was asked for. (Growing geometrically would waste
+	 * up to half of it when the estimate is right) */
+	comps = (pickle_component_t **)pickle_mem_realloc(&doc->allocator,
+				doc->components, components * sizeof(pickle_component_t *));
+	if (comps == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "components collection."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	doc->components = comps;
+	doc->cap_components = components;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Appends a property to the document object properties collection. The
+ * document takes ownership of the property.
+ *
+ * @param doc  PickLE document object.
+ * @param prop Property to be appended to the properties collection.
+ *
+ * @return PICKLE_OK if everything went fine. PICKLE_ERROR_MEMORY if we couldn't
+ *         grow the collection.
+ */
+pickle_err_t pickle_doc_property_add(pickle_doc_t *doc, pickle_property_t *prop) {
+	/* Make sure we have space for it. */
+	if (!pickle_util_grow(&doc->allocator,
+						  (void **)&doc->properties, &doc->cap_properties,
+						  doc->len_properties + 1,
+						  sizeof(pickle_property_t *))) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+						 "properties collection."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Remember that we'll have to free individually allocated objects. */
+	if (prop->arena == NULL)
+		doc->adopted = true;
+
+	doc->properties[doc->len_properties] = prop;
+	doc->len_properties++;
+	doc->index_properties.valid = false;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Appends a category to the document object categories collection. The
+ * document takes ownership of the category.
+ *
+ * @param doc PickLE document object.
+ * @param cat Category to be appended to the categories collection.
+ *
+ * @return PICKLE_OK if everything went fine. PICKLE_ERROR_MEMORY if we couldn't
+ *         grow the collection.
+ */
+pickle_err_t pickle_doc_category_add(pickle_doc_t *doc, pickle_category_t *cat) {
+	/* Make sure we have space for it. */
+	if (!pickle_util_grow(&doc->allocator,
+						  (void **)&doc->categories, &doc->cap_categories,
+						  doc->len_categories + 1,
+						  sizeof(pickle_category_t *))) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+						 "categories collection."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Remember that we'll have to free individually allocated objects. */
+	if (cat->arena == NULL)
+		doc->adopted = true;
+
+	doc->categories[doc->len_categories] = cat;
+	doc->len_categories++;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Appends a component to the document object components collection. The
+ * document takes ownership of the component.
+ *
+ * @param doc  PickLE document object.
+ * @param comp Component to be appended to the components collection.
+ *
+ * @return PICKLE_OK if everything went fine. PICKLE_ERROR_MEMORY if we couldn't
+ *         grow the collection.
+ */
+pickle_err_t pickle_doc_component_add(pickle_doc_t *doc, pickle_component_t *comp) {
+	/* Make sure we have space for it. */
+	if (!pickle_util_grow(&doc->allocator,
+						  (void **)&doc->components, &doc->cap_components,
+						  doc->len_components + 1,
+						  sizeof(pickle_component_t *))) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+						 "components collection."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Remember that we'll have to free individually allocated objects. */
+	if (comp->arena == NULL)
+		doc->adopted = true;
+
+	/* Keep track of the range of components of its category. */
+	if (comp->category != NULL)
+		pickle_category_track(comp->category, doc->len_components);
+
+	doc->components[doc->len_components] = comp;
+	doc->len_components++;
+	doc->index_refdes.valid = false;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Finds a property of the document by its name. The first time this is called
+ * (and after any property gets added) a hash index of the property names is
+ * built, so lookups take constant time.
+ *
+ * @warning Renaming a property that's already in the document isn't picked up
+ *          by the index until another property is added.
+ *
+ * @param doc  PickLE document object.
+ * @param name Name of the property to look for. (Case-sensitive)
+ *
+ * @return First property with the requested name or NULL if there isn't one.
+ */
+const pickle_property_t *pickle_doc_property_find(pickle_doc_t *doc, const char *name) {
+	return pickle_doc_property_findn(doc, name, strlen(name));
+}
+
+/**
+ * Finds a property of the document by a name that isn't necessarily NULL
+ * terminated.
+ *
+ * @param doc  PickLE document object.
+ * @param name Name of the property to look for. (Case-sensitive)
+ * @param len  Length of the name.
+ *
+ * @return First property with the requested name or NULL if there isn't one.
+ *
+ * @see pickle_doc_property_find
+ */
+const pickle_property_t *pickle_doc_property_findn(pickle_doc_t *doc, const char *name, size_t len) {
+	const pickle_index_t *idx;
+	const pickle_property_t *prop;
+	size_t mask;
+	size_t i;
+
+	/* Make sure we have an index. */
+	idx = &doc->index_properties;
+	if (!idx->valid && !pickle_doc_property_index(doc)) {
+		/* Fall back to a linear search if we ran out of memory. */
+		for (i = 0; i < doc->len_properties; i++) {
+			prop = doc->properties[i];
+			if ((prop->name != NULL) && (prop->len_name == len) &&
+					(memcmp(prop->name, name, len) == 0)) {
+				return prop;
+			}
+		}
+
+		return NULL;
+	}
+
+	/* Look the name up using linear probing. */
+	mask = idx->cap - 1;
+	for (i = pickle_util_hash(name, len) & mask; idx->slots[i] != 0;
+			i = (i + 1) & mask) {
+		prop = doc->properties[idx->slots[i] - 1];
+		if ((prop->len_name == len) && (memcmp(prop->name, name, len) == 0))
+			return prop;
+	}
+
+	return NULL;
+}
+
+/**
+ * Builds the hash index of the document's property names. Only the first of
+ * any properties that share a name gets indexed.
+ *
+ * @param doc PickLE document object.
+ *
+ * @return TRUE if the index was built. FALSE if we ran out of memory.
+ */
+bool pickle_doc_property_index(pickle_doc_t *doc) {
+	pickle_index_t *idx;
+	const pickle_property_t *prop;
+	const pickle_property_t *other;
+	size_t mask;
+	size_t i;
+	size_t j;
+
+	/* Start with an empty index that's at most half full. */
+	idx = &doc->index_properties;
+	if (!pickle_index_reset(idx, &doc->allocator, doc->len_properties))
+		return false;
+
+	/* Index every named property. */
+	mask = idx->cap - 1;
+	for (i = 0; i < doc->len_properties; i++) {
+		prop = doc->properties[i];
+		if (prop->name == NULL)
+			continue;
+
+		for (j = pickle_util_hash(prop->name, prop->len_name) & mask;
+				idx->slots[j] != 0; j = (j + 1) & mask) {
+			other = doc->properties[idx->slots[j] - 1];
+			if ((other->len_name == prop->len_name) &&
+					(memcmp(other->name, prop->name, prop->len_name) == 0)) {
+				break;
+			}
+		}
+		if (idx->slots[j] == 0)
+			idx->slots[j] = i + 1;
+	}
+
+	idx->valid = true;
+	return true;
+}
+
+/**
+ * Finds the component that a reference designator belongs to. The first time
+ * this is called (and after any component gets added) a hash index of every
+ * reference designator in the document is built, so lookups take constant
+ * time.
+ *
+ * @warning Changing the reference designators of a component that's already in
+ *          the document isn't picked up by the index until another component
+ *          is added.
+ *
+ * @param doc    PickLE document object.
+ * @param refdes Reference designator to look for. (Case-sensitive)
+ *
+ * @return First component with the requested reference designator or NULL if
+ *         there isn't one.
+ */
+pickle_component_t *pickle_doc_find_refdes(pickle_doc_t *doc, const char *refdes) {
+	const pickle_refdes_index_t *idx;
+	pickle_component_t *comp;
+	uint32_t hash;
+	size_t mask;
+	size_t i;
+	size_t j;
+
+	/* Make sure we have an index. */
+	idx = &doc->index_refdes;
+	if (!idx->valid && !pickle_doc_refdes_index(doc)) {
+		/* Fall back to a linear search if we ran out of memory. */
+		for (i = 0; i < doc->len_components; i++) {
+			comp = doc->components[i];
+			for (j = 0; j < comp->refdes.length; j++) {
+				if ((comp->refdes.refdes[j] != NULL) &&
+						(strcmp(comp->refdes.refdes[j], refdes) == 0)) {
+					return comp;
+				}
+			}
+		}
+
+		return NULL;
+	}
+
+	/* Look the designator up using linear probing. */
+	hash = pickle_util_hash(refdes, strlen(refdes));
+	mask = idx->cap - 1;
+	for (i = hash & mask; idx->entries[i].refdes != NULL; i = (i + 1) & mask) {
+		if ((idx->entries[i].hash == hash) &&
+				(strcmp(idx->entries[i].refdes, refdes) == 0)) {
+			return idx->entries[i].component;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Changes the picked state of a component and patches its marker straight in
+ * the document's file, without having to write the whole document back out.
+ *
+ * @warning Only works for documents opened with pickle_doc_fopen for reading
+ *          and updating ("r+" or "rb+"), and that are still open. Modes such
+ *          as "a+" would append the marker and "w+" would have truncated the
+ *          file.
+ *
+ * @param doc    PickLE document object the component was parsed from.
+ * @param comp   Component to have its picked state changed.
+ * @param picked Has the component been picked?
+ *
+ * @return PICKLE_OK if the file was updated. PICKLE_ERROR_FILE if the document
+ *         wasn't opened for writing, the component doesn't have a location in
+ *         the file, or the file couldn't be written to.
+ */
+pickle_err_t pickle_doc_set_picked(pickle_doc_t *doc, pickle_component_t *comp, bool picked) {
+	pickle_reader_t *rd;
+	char marker;
+	long pos;
+
+	/* Check if we are able to write to the file. */
+	rd = &doc->reader;
+	if ((rd->source != PICKLE_SOURCE_FILE) || (doc->fmode[0] != 'r') ||
+			(strchr(doc->fmode, '+') == NULL)) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Document must be opened for "
+						 "reading and writing in order to be updated."));
+		return PICKLE_ERROR_FILE;
+	}
+	if (comp->offset_picked == PICKLE_OFFSET_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Component doesn't have a "
+						 "location in the document's file."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Patch the marker in the file and go back to where the reader was. */
+	marker = (picked) ? 'X' : ' ';
+	pos = ftell(rd->fh);
+	if ((pos < 0) || (fseek(rd->fh, (long)comp->offset_picked, SEEK_SET) != 0) ||
+			(fputc(marker, rd->fh) == EOF) || (fflush(rd->fh) != 0) ||
+			(fseek(rd->fh, pos, SEEK_SET) != 0)) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't update the "
+							"picked state in \"%s\": %s."), doc->fname,
+							strerror(errno));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Keep the block buffer in sync with the file. */
+	if ((comp->offset_picked >= rd->base) &&
+			(comp->offset_picked < (rd->base + rd->len))) {
+		rd->buf[comp->offset_picked - rd->base] = marker;
+	}
+	comp->picked = picked;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Builds the reference designator index of the document. Only the first
+ * component that uses a designator gets indexed for it.
+ *
+ * @param doc PickLE document object.
+ *
+ * @return TRUE if the index was built. FALSE if we ran out of memory.
+ */
+bool pickle_doc_refdes_index(pickle_doc_t *doc) {
+	pickle_refdes_index_t *idx;
+	pickle_refdes_entry_t *entry;
+	pickle_component_t *comp;
+	const char *refdes;
+	uint32_t hash;
+	size_t count;
+	size_t mask;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	/* Start with an empty index that's at most half full. */
+	idx = &doc->index_refdes;
+	idx->valid = false;
+	count = 0;
+	for (i = 0; i < doc->len_components; i++)
+		count += doc->components[i]->refdes.length;
+	if (!pickle_index_grow(&doc->allocator, (void **)&idx->entries, &idx->cap,
+						   count, sizeof(pickle_refdes_entry_t))) {
+		return false;
+	}
+	for (i = 0; i < idx->cap; i++)
+		idx->entries[i].refdes = NULL;
+
+	/* Index every designator of every component. */
+	mask = idx->cap - 1;
+	for (i = 0; i < doc->len_components; i++) {
+		comp = doc->components[i];
+		for (j = 0; j < comp->refdes.length; j++) {
+			refdes = comp->refdes.refdes[j];
+			if (refdes == NULL)
+				continue;
+
+			hash = pickle_util_hash(refdes, strlen(refdes));
+			for (k = hash & mask; idx->entries[k].refdes != NULL;
+					k = (k + 1) & mask) {
+				if ((idx->entries[k].hash == hash) &&
+						(strcmp(idx->entries[k].refdes, refdes) == 0)) {
+					break;
+				}
+			}
+
+			entry = &idx->entries[k];
+			if (entry->refdes == NULL) {
+				entry->refdes = refdes;
+				entry->component = comp;
+				entry->hash = hash;
+			}
+		}
+	}
+
+	idx->valid = true;
+	return true;
+}
+
+/**
+ * Compares two revisions of a document and reports everything that was added,
+ * removed, changed, or moved to another category between them. Properties are
+ * matched by their names. Components are matched first by their reference
+ * designators and then by their name, value and package, all through hash
+ * tables, so the whole thing runs in linear time.
+ *
+ * Differences are reported in order: properties of the new document, then the
+ * ones that were removed from the old one; components of the new document,
+ * then the ones that were removed from the old one.
+ *
+ * @param a        Old revision of the document.
+ * @param b        New revision of the document.
+ * @param handlers Callbacks to be fired. Either of them may be NULL. Returning
+ *                 PICKLE_FINISHED_PARSING from a callback stops early, while
+ *                 returning an error aborts the diff.
+ * @param userdata Pointer passed along to every callback.
+ *
+ * @return PICKLE_OK if the documents were compared (or a callback stopped us
+ *         early). PICKLE_ERROR_MEMORY if we ran out of memory. Any error
+ *         returned by a callback.
+ */
+pickle_err_t pickle_doc_diff(pickle_doc_t *a, pickle_doc_t *b, const pickle_diff_handlers_t *handlers, void *userdata) {
+	pickle_diff_t diff;
+	pickle_component_t *ca;
+	pickle_component_t *cb;
+	size_t *partner;
+	unsigned int fields;
+	pickle_err_t err;
+	size_t i;
+	size_t j;
+
+	/* Start with the properties. */
+	err = pickle_diff_props(a, b, handlers, userdata);
+	if (err != PICKLE_OK)
+		return (err == PICKLE_FINISHED_PARSING) ? PICKLE_OK : err;
+
+	/* Make sure both documents are indexed by their reference designators. */
+	if ((!a->index_refdes.valid && !pickle_doc_refdes_index(a)) ||
+			(!b->index_refdes.valid && !pickle_doc_refdes_index(b))) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't build the "
+						 "reference designator index of the documents."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Index the components of the old document. */
+	err = pickle_diff_init(&diff, a);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+	partner = (size_t *)pickle_mem_calloc(NULL, b->len_components + 1,
+										  sizeof(size_t));
+	if (partner == NULL) {
+		pickle_diff_free(&diff);
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "component matches."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Match components that still use any of the same designators. */
+	for (i = 0; i < b->len_components; i++) {
+		cb = b->components[i];
+		for (j = 0; (j < cb->refdes.length) && (partner[i] == 0); j++) {
+			if (cb->refdes.refdes[j] == NULL)
+				continue;
+
+			ca = pickle_doc_find_refdes(a, cb->refdes.refdes[j]);
+			if (ca == NULL)
+				continue;
+			partner[i] = pickle_diff_find(&diff, ca);
+			if ((partner[i] != 0) && diff.matched[partner[i] - 1])
+				partner[i] = 0;
+			if (partner[i] != 0)
+				pickle_diff_take(&diff, partner[i] - 1);
+		}
+	}
+
+	/* Match whatever is left by what the components actually are. */
+	for (i = 0; i < b->len_components; i++) {
+		if (partner[i] == 0)
+			partner[i] = pickle_diff_match(&diff, b->components[i]);
+	}
+
+	/* Report the new and changed components. */
+	for (i = 0; (i < b->len_components) && (err == PICKLE_OK); i++) {
+		cb = b->components[i];
+		if (partner[i] == 0) {
+			if (handlers->on_component != NULL) {
+				err = handlers->on_component(PICKLE_DIFF_ADDED, 0, NULL, cb,
+											 userdata);
+			}
+			continue;
+		}
+
+		ca = a->components[partner[i] - 1];
+		fields = pickle_diff_fields(a, ca, cb);
+		if ((fields != 0) && (handlers->on_component != NULL)) {
+			err = handlers->on_component((fields & PICKLE_DIFF_CATEGORY) ?
+										 PICKLE_DIFF_MOVED : PICKLE_DIFF_CHANGED,
+										 fields, ca, cb, userdata);
+		}
+	}
+
+	/* Report the components that are gone. */
+	for (i = 0; (i < a->len_components) && (err == PICKLE_OK); i++) {
+		if (!diff.matched[i] && (handlers->on_component != NULL)) {
+			err = handlers->on_component(PICKLE_DIFF_REMOVED, 0,
+										 a->components[i], NULL, userdata);
+		}
+	}
+
+	/* Clean up. */
+	pickle_mem_free(NULL, partner);
+	pickle_diff_free(&diff);
+
+	return (err == PICKLE_FINISHED_PARSING) ? PICKLE_OK : err;
+}
+
+/**
+ * Reports the properties that were added, removed, or changed between two
+ * revisions of a document. Only the first of any properties that share a name
+ * is compared.
+ *
+ * @param a        Old revision of the document.
+ * @param b        New revision of the document.
+ * @param handlers Callbacks to be fired.
+ * @param userdata Pointer passed along to every callback.
+ *
+ * @return PICKLE_OK if everything was reported. Otherwise whatever a callback
+ *         returned.
+ */
+pickle_err_t pickle_diff_props(pickle_doc_t *a, pickle_doc_t *b, const pickle_diff_handlers_t *handlers, void *userdata) {
+	const pickle_property_t *pa;
+	const pickle_property_t *pb;
+	pickle_err_t err;
+	size_t i;
+
+	/* Nothing to do if nobody is listening. */
+	if (handlers->on_property == NULL)
+		return PICKLE_OK;
+
+	/* Properties of the new document. */
+	err = PICKLE_OK;
+	for (i = 0; (i < b->len_properties) && (err == PICKLE_OK); i++) {
+		pb = b->properties[i];
+		if ((pb->name == NULL) ||
+				(pickle_doc_property_findn(b, pb->name, pb->len_name) != pb)) {
+			continue;
+		}
+
+		pa = pickle_doc_property_findn(a, pb->name, pb->len_name);
+		if (pa == NULL) {
+			err = handlers->on_property(PICKLE_DIFF_ADDED, NULL, pb, userdata);
+		} else if (!pickle_util_streq(pa->value, pa->len_value, pb->value,
+									  pb->len_value)) {
+			err = handlers->on_property(PICKLE_DIFF_CHANGED, pa, pb, userdata);
+		}
+	}
+
+	/* Properties that are gone. */
+	for (i = 0; (i < a->len_properties) && (err == PICKLE_OK); i++) {
+		pa = a->properties[i];
+		if ((pa->name == NULL) ||
+				(pickle_doc_property_findn(a, pa->name, pa->len_name) != pa)) {
+			continue;
+		}
+
+		if (pickle_doc_property_findn(b, pa->name, pa->len_name) == NULL)
+			err = handlers->on_property(PICKLE_DIFF_REMOVED, pa, NULL, userdata);
+	}
+
+	return err;
+}
+
+/**
+ * Indexes the components of the old document of a diff, both by their address
+ * and by their name, value and package.
+ *
+ * @param diff Diff state to be initialized.
+ * @param doc  Old revision of the document.
+ *
+ * @return PICKLE_OK if the components were indexed. PICKLE_ERROR_MEMORY if we
+ *         ran out of memory.
+ */
+pickle_err_t pickle_diff_init(pickle_diff_t *diff, pickle_doc_t *doc) {
+	const pickle_component_t *comp;
+	size_t len;
+	size_t mask;
+	size_t i;
+	size_t j;
+
+	/* Keep the tables at most half full. */
+	len = doc->len_components;
+	diff->doc = doc;
+	diff->cap = INDEX_MIN_CAP;
+	while ((len + 1) > (diff->cap / 2))
+		diff->cap *= 2;
+	diff->ptrs = (size_t *)pickle_mem_calloc(NULL, diff->cap, sizeof(size_t));
+	diff->keys = (size_t *)pickle_mem_calloc(NULL, diff->cap, sizeof(size_t));
+	diff->heads = (size_t *)pickle_mem_calloc(NULL, diff->cap, sizeof(size_t));
+	diff->slot = (size_t *)pickle_mem_calloc(NULL, len + 1, sizeof(size_t));
+	diff->prev = (size_t *)pickle_mem_calloc(NULL, len + 1, sizeof(size_t));
+	diff->next = (size_t *)pickle_mem_calloc(NULL, len + 1, sizeof(size_t));
+	diff->matched = (bool *)pickle_mem_calloc(NULL, len + 1, sizeof(bool));
+	if ((diff->ptrs == NULL) || (diff->keys == NULL) ||
+			(diff->heads == NULL) || (diff->slot == NULL) ||
+			(diff->prev == NULL) || (diff->next == NULL) ||
+			(diff->matched == NULL)) {
+		pickle_diff_free(diff);
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "component tables of the diff."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Index every component. (Backwards so that the chains end up in order) */
+	mask = diff->cap - 1;
+	for (i = len; i > 0; i--) {
+		comp = doc->components[i - 1];
+
+		/* By its address. */
+		for (j = pickle_util_hash((const char *)&comp, sizeof(comp)) & mask;
+				diff->ptrs[j] != 0; j = (j + 1) & mask)
+			;
+		diff->ptrs[j] = i;
+
+		/* By what it is. */
+		for (j = pickle_component_hash(comp) & mask; diff->keys[j] != 0;
+				j = (j + 1) & mask) {
+			if (pickle_component_samekey(doc->components[diff->keys[j] - 1],
+										 comp)) {
+				break;
+			}
+		}
+		diff->keys[j] = i;
+		diff->slot[i - 1] = j;
+		diff->next[i - 1] = diff->heads[j];
+		if (diff->heads[j] != 0)
+			diff->prev[diff->heads[j] - 1] = i;
+		diff->heads[j] = i;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Frees up the tables of a diff.
+ *
+ * @param diff Diff state to be free'd.
+ */
+void pickle_diff_free(pickle_diff_t *diff) {
+	pickle_mem_free(NULL, diff->ptrs);
+	pickle_mem_free(NULL, diff->keys);
+	pickle_mem_free(NULL, diff->heads);
+	pickle_mem_free(NULL, diff->slot);
+	pickle_mem_free(NULL, diff->prev);
+	pickle_mem_free(NULL, diff->next);
+	pickle_mem_free(NULL, diff->matched);
+	diff->ptrs = NULL;
+	diff->keys = NULL;
+	diff->heads = NULL;
+	diff->slot = NULL;
+	diff->prev = NULL;
+	diff->next = NULL;
+	diff->matched = NULL;
+}
+
+/**
+ * Finds the position of a component of the old document.
+ *
+ * @param diff Diff state.
+ * @param comp Component of the old document.
+ *
+ * @return Position of the component plus one or 0 if it isn't in the document.
+ */
+size_t pickle_diff_find(const pickle_diff_t *diff, const pickle_component_t *comp) {
+	size_t mask;
+	size_t i;
+
+	mask = diff->cap - 1;
+	for (i = pickle_util_hash((const char *)&comp, sizeof(comp)) & mask;
+			diff->ptrs[i] != 0; i = (i + 1) & mask) {
+		if (diff->doc->components[diff->ptrs[i] - 1] == comp)
+			return diff->ptrs[i];
+	}
+
+	return 0;
+}
+
+/**
+ * Takes the first unmatched component of the old document that has the same
+ * name, value and package as a component of the new one.
+ *
+ * @param diff Diff state.
+ * @param comp Component of the new document.
+ *
+ * @return Position of the matched component plus one or 0 if there isn't one.
+ */
+size_t pickle_diff_match(pickle_diff_t *diff, const pickle_component_t *comp) {
+	size_t mask;
+	size_t head;
+	size_t i;
+
+	mask = diff->cap - 1;
+	for (i = pickle_component_hash(comp) & mask; diff->keys[i] != 0;
+			i = (i + 1) & mask) {
+		if (pickle_component_samekey(diff->doc->components[diff->keys[i] - 1],
+									 comp)) {
+			head = diff->heads[i];
+			if (head != 0)
+				pickle_diff_take(diff, head - 1);
+
+			return head;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Marks a component of the old document as matched and takes it out of its
+ * chain.
+ *
+ * @param diff  Diff state.
+ * @param index Position of the component in the old document.
+ */
+void pickle_diff_take(pickle_diff_t *diff, size_t index) {
+	if (diff->prev[index] != 0) {
+		diff->next[diff->prev[index] - 1] = diff->next[index];
+	} else {
+		diff->heads[diff->slot[index]] = diff->next[index];
+	}
+	if (diff->next[index] != 0)
+		diff->prev[diff->next[index] - 1] = diff->prev[index];
+
+	diff->matched[index] = true;
+}
+
+/**
+ * Hashes the name, value and package of a component.
+ *
+ * @param comp Component to be hashed.
+ *
+ * @return FNV-1a hash of the component's key.
+ */
+uint32_t pickle_component_hash(const pickle_component_t *comp) {
+	uint32_t hash;
+
+	hash = pickle_util_hash((comp->name != NULL) ? comp->name : "",
+							comp->len_name);
+	hash = pickle_util_hashcont(hash, "\t", 1);
+	if (comp->value != NULL)
+		hash = pickle_util_hashcont(hash, comp->value, comp->len_value);
+	hash = pickle_util_hashcont(hash, "\t", 1);
+	if (comp->package != NULL)
+		hash = pickle_util_hashcont(hash, comp->package, comp->len_package);
+
+	return hash;
+}
+
+/**
+ * Checks if two components have the same name, value and package.
+ *
+ * @param a First component.
+ * @param b Second component.
+ *
+ * @return TRUE if both components have the same key.
+ */
+bool pickle_component_samekey(const pickle_component_t *a, const pickle_component_t *b) {
+	return pickle_util_streq(a->name, a->len_name, b->name, b->len_name) &&
+		pickle_util_streq(a->value, a->len_value, b->value, b->len_value) &&
+		pickle_util_streq(a->package, a->len_package, b->package,
+						  b->len_package);
+}
+
+/**
+ * Checks if two optional strings (that may not be NULL terminated) are equal.
+ *
+ * @param a     First string or NULL.
+ * @param len_a Length of the first string.
+ * @param b     Second string or NULL.
+ * @param len_b Length of the second string.
+ *
+ * @return TRUE if both strings are equal or both are NULL.
+ */
+bool pickle_util_streq(const char *a, size_t len_a, const char *b, size_t len_b) {
+	if ((a == NULL) || (b == NULL))
+		return a == b;
+
+	return (len_a == len_b) && (memcmp(a, b, len_a) == 0);
+}
+
+/**
+ * Figures out which fields of a component have changed between revisions.
+ *
+ * @param a  Old revision of the document.
+ * @param ca Component in the old revision.
+ * @param cb Component in the new revision.
+ *
+ * @return Fields that are different. (see pickle_diff_field_t)
+ */
+unsigned int pickle_diff_fields(pickle_doc_t *a, const pickle_component_t *ca, const pickle_component_t *cb) {
+	unsigned int fields;
+	size_t i;
+
+	fields = 0;
+	if (ca->picked != cb->picked)
+		fields |= PICKLE_DIFF_PICKED;
+	if (ca->quantity != cb->quantity)
+		fields |= PICKLE_DIFF_QUANTITY;
+	if (!pickle_util_streq(ca->name, ca->len_name, cb->name, cb->len_name))
+		fields |= PICKLE_DIFF_NAME;
+	if (!pickle_util_streq(ca->value, ca->len_value, cb->value, cb->len_value))
+		fields |= PICKLE_DIFF_VALUE;
+	if (!pickle_util_streq(ca->description, ca->len_description,
+						   cb->description, cb->len_description)) {
+		fields |= PICKLE_DIFF_DESCRIPTION;
+	}
+	if (!pickle_util_streq(ca->package, ca->len_package, cb->package,
+						   cb->len_package)) {
+		fields |= PICKLE_DIFF_PACKAGE;
+	}
+
+	/* Same designators if they're in the same order or, failing that, if every
+	 * one of them still points to the old component. */
+	if (ca->refdes.length != cb->refdes.length) {
+		fields |= PICKLE_DIFF_REFDES;
+	} else {
+		for (i = 0; i < cb->refdes.length; i++) {
+			if ((ca->refdes.refdes[i] == NULL) ||
+					(cb->refdes.refdes[i] == NULL) ||
+					(strcmp(ca->refdes.refdes[i], cb->refdes.refdes[i]) != 0)) {
+				break;
+			}
+		}
+		for (; i < cb->refdes.length; i++) {
+			if ((cb->refdes.refdes[i] == NULL) ||
+					(pickle_doc_find_refdes(a, cb->refdes.refdes[i]) != ca)) {
+				fields |= PICKLE_DIFF_REFDES;
+				break;
+			}
+		}
+	}
+
+	/* Categories are compared by name. */
+	if ((ca->category == NULL) || (cb->category == NULL)) {
+		if (ca->category != cb->category)
+			fields |= PICKLE_DIFF_CATEGORY;
+	} else if (!pickle_util_streq(ca->category->name, ca->category->len_name,
+								  cb->category->name, cb->category->len_name)) {
+		fields |= PICKLE_DIFF_CATEGORY;
+	}
+
+	return fields;
+}
+
+/**
+ * Merges several documents (like the boards of a kitting order) into a single
+ * consolidated pick list. Components that share the same name, value and
+ * package are folded into a single part that adds up their quantities (capped
+ * at UINT_MAX), that's only picked if all of them were, and that carries every
+ * one of their reference designators, prefixed by the prefix of the document
+ * they came from. Parts end up in the category where they first showed up, in order of
+ * appearance. Everything is looked up through hash tables, so the whole thing
+ * runs in linear time.
+ *
+ * Large orders are split into groups of documents whose parts are collected in
+ * parallel and then folded together in order, which gives the exact same result
+ * as merging them one after the other.
+ *
+ * @warning The merged document has its own copy of everything, so the input
+ *          documents may be free'd right afterwards. If anything goes wrong
+ *          the merged document is left with whatever was merged so far.
+ * @warning Groups are collected using the global allocator from several
+ *          threads at once, so it must be thread-safe when more than one
+ *          worker is used. (The default one is)
+ *
+ * @param doc      Document that will receive the merged parts. It may already
+ *                 have properties, but no categories or components.
+ * @param docs     Documents to be merged.
+ * @param prefixes Prefix of the reference designators of each document (for
+ *                 example "B1-"). Either the whole array or any of its items
+ *                 may be NULL if designators shouldn't be prefixed.
+ * @param len      Number of documents.
+ * @param threads  Number of workers to use. 0 uses one per processor core.
+ *
+ * @return PICKLE_OK if the documents were merged. PICKLE_ERROR_UNKNOWN if the
+ *         document already had categories or components. PICKLE_ERROR_MEMORY
+ *         if we ran out of memory.
+ */
+pickle_err_t pickle_doc_merge(pickle_doc_t *doc, pickle_doc_t **docs, const char **prefixes, size_t len, unsigned int threads) {
+	pickle_merge_group_t *groups;
+	pickle_merge_t merge;
+	size_t len_groups;
+	size_t total;
+	size_t first;
+	pickle_err_t err;
+	size_t i;
+
+	/* Merging only makes sense into a document without any parts. */
+	if ((doc->len_categories > 0) || (doc->len_components > 0)) {
+		pickle_error_set(PICKLE_ERROR_UNKNOWN, EMSG("Documents can only be "
+						 "merged into a document without any components."));
+		return PICKLE_ERROR_UNKNOWN;
+	}
+
+	/* Figure out how many groups are worth merging on their own. */
+	if (threads == 0)
+		threads = pickle_worker_cores();
+	total = 0;
+	for (i = 0; i < len; i++)
+		total += docs[i]->len_components;
+	len_groups = total / MERGE_MIN_COMPONENTS;
+	if (len_groups > threads)
+		len_groups = threads;
+	if (len_groups > len)
+		len_groups = len;
+#ifndef PICKLE_HAS_THREADS
+	len_groups = 1;
+#endif /* !PICKLE_HAS_THREADS */
+
+	/* Small orders aren't worth the trouble. */
+	if (len_groups < 2)
+		return pickle_merge_run(doc, docs, prefixes, len);
+
+	/* Split the documents evenly between the groups. */
+	groups = (pickle_merge_group_t *)pickle_mem_calloc(&doc->allocator,
+		len_groups, sizeof(pickle_merge_group_t));
+	if (groups == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "groups of documents."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	for (i = 0; i < len_groups; i++) {
+		first = (i * len) / len_groups;
+		groups[i].docs = docs + first;
+		groups[i].len = (((i + 1) * len) / len_groups) - first;
+		groups[i].err = PICKLE_OK;
+	}
+
+	/* Collect the parts of every group, stopping at the first error. */
+	err = pickle_worker_run(len_groups, threads, pickle_merge_group, groups, 0);
+	for (i = 0; (err == PICKLE_OK) && (i < len_groups); i++) {
+		if (groups[i].err != PICKLE_OK) {
+			pickle_error_state = groups[i].error;
+			err = groups[i].err;
+		}
+	}
+
+	/* Fold the groups together in order and put the merged document together
+	 * just like a serial merge would. */
+	if (err == PICKLE_OK) {
+		err = pickle_merge_init(&merge, docs, len);
+		if (err == PICKLE_OK) {
+			err = pickle_merge_combine(&merge, groups, len_groups);
+			if (err == PICKLE_OK)
+				err = pickle_merge_build(&merge, doc);
+			if (err == PICKLE_OK)
+				err = pickle_merge_refdes(&merge, doc, docs, prefixes, len);
+			pickle_merge_free(&merge);
+		}
+	}
+
+	/* Clean up. */
+	for (i = 0; i < len_groups; i++)
+		pickle_merge_free(&groups[i].merge);
+	pickle_mem_free(&doc->allocator, groups);
+
+	return err;
+}
+
+/**
+ * Collects the parts of a group of documents.
+ *
+ * @param worker Worker thread.
+ * @param index  Index of the group to be collected.
+ */
+void pickle_merge_group(pickle_worker_t *worker, size_t index) {
+	pickle_merge_group_t *group;
+
+	group = &((pickle_merge_group_t *)worker->ctx)[index];
+	pickle_error_clear();
+	group->err = pickle_merge_init(&group->merge, group->docs, group->len);
+	if (group->err != PICKLE_OK) {
+		group->error = *pickle_error_last();
+		return;
+	}
+
+	pickle_merge_collect(&group->merge, group->docs, group->len);
+}
+
+/**
+ * Merges a list of documents into another one, one after the other.
+ *
+ * @param doc      Document that will receive the merged parts.
+ * @param docs     Documents to be merged.
+ * @param prefixes Prefix of the reference designators of each document or
+ *                 NULL.
+ * @param len      Number of documents.
+ *
+ * @return PICKLE_OK if the documents were merged. PICKLE_ERROR_MEMORY if we
+ *         ran out of memory.
+ */
+pickle_err_t pickle_merge_run(pickle_doc_t *doc, pickle_doc_t **docs, const char **prefixes, size_t len) {
+	pickle_merge_t merge;
+	pickle_err_t err;
+
+	/* Figure out the parts. */
+	err = pickle_merge_init(&merge, docs, len);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+	pickle_merge_collect(&merge, docs, len);
+
+	/* Put together the merged document. */
+	err = pickle_merge_build(&merge, doc);
+	if (err == PICKLE_OK)
+		err = pickle_merge_refdes(&merge, doc, docs, prefixes, len);
+	pickle_merge_free(&merge);
+
+	return err;
+}
+
+/**
+ * Allocates the tables of a merge. They're sized for the worst case, where no
+ * two components are the same part, so they never have to grow.
+ *
+ * @param merge Merge state to be initialized.
+ * @param docs  Documents to be merged.
+ * @param len   Number of documents.
+ *
+ * @return PICKLE_OK if the tables were allocated. PICKLE_ERROR_MEMORY if we
+ *         ran out of memory.
+ */
+pickle_err_t pickle_merge_init(pickle_merge_t *merge, pickle_doc_t **docs, size_t len) {
+	size_t total;
+	size_t i;
+
+	/* Keep the tables at most half full. */
+	total = 0;
+	for (i = 0; i < len; i++)
+		total += docs[i]->len_components;
+	merge->cap = INDEX_MIN_CAP;
+	while ((total + 1) > (merge->cap / 2))
+		merge->cap *= 2;
+	merge->slots_parts = (size_t *)pickle_mem_calloc(NULL, merge->cap,
+													 sizeof(size_t));
+	merge->slots_cats = (size_t *)pickle_mem_calloc(NULL, merge->cap,
+													sizeof(size_t));
+	merge->which = (size_t *)pickle_mem_calloc(NULL, total + 1,
+											   sizeof(size_t));
+	merge->parts = (pickle_merge_part_t *)pickle_mem_calloc(NULL, total + 1,
+		sizeof(pickle_merge_part_t));
+	merge->cats = (pickle_merge_cat_t *)pickle_mem_calloc(NULL, total + 1,
+		sizeof(pickle_merge_cat_t));
+	merge->len_parts = 0;
+	merge->len_cats = 0;
+	if ((merge->slots_parts == NULL) || (merge->slots_cats == NULL) ||
+			(merge->which == NULL) || (merge->parts == NULL) ||
+			(merge->cats == NULL)) {
+		pickle_merge_free(merge);
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "part tables of the merge."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Frees up the tables of a merge.
+ *
+ * @param merge Merge state to be free'd.
+ */
+void pickle_merge_free(pickle_merge_t *merge) {
+	pickle_mem_free(NULL, merge->slots_parts);
+	pickle_mem_free(NULL, merge->slots_cats);
+	pickle_mem_free(NULL, merge->which);
+	pickle_mem_free(NULL, merge->parts);
+	pickle_mem_free(NULL, merge->cats);
+	merge->slots_parts = NULL;
+	merge->slots_cats = NULL;
+	merge->which = NULL;
+	merge->parts = NULL;
+	merge->cats = NULL;
+}
+
+/**
+ * Sorts every component of the documents being merged into its part, adding
+ * up their quantities and picked states as we go.
+ *
+ * @param merge Merge state.
+ * @param docs  Documents to be merged.
+ * @param len   Number of documents.
+ */
+void pickle_merge_collect(pickle_merge_t *merge, pickle_doc_t **docs, size_t len) {
+	const pickle_component_t *comp;
+	pickle_merge_part_t *part;
+	size_t k;
+	size_t i;
+	size_t j;
+
+	k = 0;
+	for (i = 0; i < len; i++) {
+		for (j = 0; j < docs[i]->len_components; j++, k++) {
+			comp = docs[i]->components[j];
+			part = pickle_merge_part(merge, comp);
+			merge->which[k] = part - merge->parts;
+			pickle_merge_fold(part, comp->quantity, comp->picked,
+							  comp->refdes.length, comp->description,
+							  comp->len_description);
+		}
+	}
+}
+
+/**
+ * Folds the parts that were collected by each group into a merge, in order.
+ * Since each group has its parts in order of appearance, the merge ends up
+ * with the same parts, categories and order as if it had collected every
+ * document itself.
+ *
+ * @param merge  Merge state sized for every document of the groups.
+ * @param groups Groups of documents with their parts already collected.
+ * @param len    Number of groups.
+ *
+ * @return PICKLE_OK if the groups were folded. PICKLE_ERROR_MEMORY if we ran
+ *         out of memory.
+ */
+pickle_err_t pickle_merge_combine(pickle_merge_t *merge, const pickle_merge_group_t *groups, size_t len) {
+	const pickle_merge_part_t *other;
+	const pickle_merge_t *group;
+	pickle_merge_part_t *part;
+	size_t *map;
+	size_t total;
+	size_t k;
+	size_t i;
+	size_t j;
+
+	k = 0;
+	for (i = 0; i < len; i++) {
+		group = &groups[i].merge;
+		map = (size_t *)pickle_mem_alloc(NULL, (group->len_parts + 1) *
+										 sizeof(size_t));
+		if (map == NULL) {
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+							 "parts map of a group."));
+			return PICKLE_ERROR_MEMORY;
+		}
+
+		/* Fold each part of the group into its part of the merge. */
+		for (j = 0; j < group->len_parts; j++) {
+			other = &group->parts[j];
+			part = pickle_merge_part(merge, other->comp);
+			map[j] = part - merge->parts;
+			pickle_merge_fold(part, other->quantity, other->picked,
+							  other->len_refdes, other->description,
+							  other->len_description);
+		}
+
+		/* Point every component of the group at its part of the merge. */
+		total = 0;
+		for (j = 0; j < groups[i].len; j++)
+			total += groups[i].docs[j]->len_components;
+		for (j = 0; j < total; j++, k++)
+			merge->which[k] = map[group->which[j]];
+
+		pickle_mem_free(NULL, map);
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Finds the part of a merge that a component belongs to, starting a new one
+ * the first time it shows up.
+ *
+ * @param merge Merge state.
+ * @param comp  Component of one of the documents being merged.
+ *
+ * @return Part of the merge the component belongs to.
+ */
+pickle_merge_part_t *pickle_merge_part(pickle_merge_t *merge, const pickle_component_t *comp) {
+	pickle_merge_part_t *part;
+	size_t mask;
+	size_t slot;
+
+	mask = merge->cap - 1;
+	for (slot = pickle_component_hash(comp) & mask;
+			merge->slots_parts[slot] != 0; slot = (slot + 1) & mask) {
+		if (pickle_component_samekey(
+				merge->parts[merge->slots_parts[slot] - 1].comp, comp)) {
+			return &merge->parts[merge->slots_parts[slot] - 1];
+		}
+	}
+
+	/* Start a new part in the category where it first showed up. */
+	part = &merge->parts[merge->len_parts++];
+	part->comp = comp;
+	part->description = NULL;
+	part->len_description = 0;
+	part->category = pickle_merge_cat(merge, comp->category);
+	part->quantity = 0;
+	part->picked = true;
+	part->len_refdes = 0;
+	part->out = NULL;
+	merge->cats[part->category].len_parts++;
+	merge->slots_parts[slot] = merge->len_parts;
+
+	return part;
+}
+
+/**
+ * Adds up a component (or a part that was collected elsewhere) into a part.
+ *
+ * @param part            Part to add up into.
+ * @param quantity        Quantity to be added. (Saturating instead of wrapping
+ *                        around)
+ * @param picked          Has it been picked?
+ * @param len_refdes      Number of reference designators it has.
+ * @param description     Its description or NULL. (Only the first one sticks)
+ * @param len_description Length of its description.
+ */
+void pickle_merge_fold(pickle_merge_part_t *part, unsigned int quantity, bool picked, size_t len_refdes, const char *description, size_t len_description) {
+	part->quantity = (quantity > (UINT_MAX - part->quantity)) ?
+		UINT_MAX : (part->quantity + quantity);
+	part->picked = part->picked && picked;
+	part->len_refdes += len_refdes;
+	if ((part->description == NULL) && (description != NULL)) {
+		part->description = description;
+		part->len_description = len_description;
+	}
+}
+
+/**
+ * Finds the category of a merge with the same name as a category of one of
+ * the documents being merged, adding it if it's the first time we see it.
+ *
+ * @param merge Merge state.
+ * @param cat   Category of a component or NULL if it doesn't have one.
+ *
+ * @return Position of the category in the merge.
+ */
+size_t pickle_merge_cat(pickle_merge_t *merge, const pickle_category_t *cat) {
+	const pickle_category_t *other;
+	size_t mask;
+	size_t i;
+
+	mask = merge->cap - 1;
+	for (i = ((cat != NULL) && (cat->name != NULL)) ?
+			(pickle_util_hash(cat->name, cat->len_name) & mask) : 0;
+			merge->slots_cats[i] != 0; i = (i + 1) & mask) {
+		other = merge->cats[merge->slots_cats[i] - 1].cat;
+		if ((cat == NULL) || (other == NULL)) {
+			if (cat == other)
+				return merge->slots_cats[i] - 1;
+		} else if (pickle_util_streq(cat->name, cat->len_name, other->name,
+									 other->len_name)) {
+			return merge->slots_cats[i] - 1;
+		}
+	}
+
+	/* First time we see this one. */
+	merge->cats[merge->len_cats].cat = cat;
+	merge->cats[merge->len_cats].len_parts = 0;
+	merge->cats[merge->len_cats].out = NULL;
+	merge->slots_cats[i] = ++merge->len_cats;
+
+	return merge->len_cats - 1;
+}
+
+/**
+ * Creates the categories and components of the merged document with their
+ * reference designators lists allocated, but still empty.
+ *
+ * @param merge Merge state.
+ * @param doc   Document that will receive the merged parts.
+ *
+ * @return PICKLE_OK if everything was created. PICKLE_ERROR_MEMORY if we ran
+ *         out of memory.
+ */
+pickle_err_t pickle_merge_build(pickle_merge_t *merge, pickle_doc_t *doc) {
+	const pickle_merge_part_t *part;
+	pickle_merge_cat_t *mcat;
+	pickle_component_t *comp;
+	size_t *order;
+	size_t next;
+	pickle_err_t err;
+	bool ok;
+	size_t i;
+
+	/* Lay the parts out grouped by category, in order of appearance. */
+	order = (size_t *)pickle_mem_alloc(NULL, (merge->len_parts + 1) *
+									   sizeof(size_t));
+	if (order == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "order of the merged parts."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	next = 0;
+	for (i = 0; i < merge->len_cats; i++) {
+		merge->cats[i].next = next;
+		next += merge->cats[i].len_parts;
+	}
+	for (i = 0; i < merge->len_parts; i++)
+		order[merge->cats[merge->parts[i].category].next++] = i;
+
+	/* Create the categories. */
+	err = pickle_doc_reserve(doc, merge->len_parts);
+	for (i = 0; (err == PICKLE_OK) && (i < merge->len_cats); i++) {
+		mcat = &merge->cats[i];
+		if (mcat->cat == NULL)
+			continue;
+
+		mcat->out = pickle_doc_category_new(doc);
+		ok = mcat->out != NULL;
+		if (ok && (mcat->cat->name != NULL)) {
+			mcat->out->name = pickle_arena_strndup(&doc->arena,
+				mcat->cat->name, mcat->cat->len_name);
+			mcat->out->len_name = mcat->cat->len_name;
+			ok = mcat->out->name != NULL;
+		}
+		if (!ok) {
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a "
+							 "merged category."));
+			err = PICKLE_ERROR_MEMORY;
+			break;
+		}
+
+		err = pickle_doc_category_add(doc, mcat->out);
+	}
+
+	/* Create the components. */
+	for (i = 0; (err == PICKLE_OK) && (i < merge->len_parts); i++) {
+		part = &merge->parts[order[i]];
+		comp = pickle_doc_component_new(doc);
+		ok = comp != NULL;
+		if (ok) {
+			comp->picked = part->picked;
+			comp->quantity = part->quantity;
+			comp->category = merge->cats[part->category].out;
+			ok = pickle_merge_copy(doc, &comp->name, &comp->len_name,
+								   part->comp->name, part->comp->len_name,
+								   false) &&
+				pickle_merge_copy(doc, &comp->value, &comp->len_value,
+								  part->comp->value, part->comp->len_value,
+								  false) &&
+				pickle_merge_copy(doc, &comp->description,
+								  &comp->len_description, part->description,
+								  part->len_description, true) &&
+				pickle_merge_copy(doc, &comp->package, &comp->len_package,
+								  part->comp->package, part->comp->len_package,
+								  true);
+		}
+		if (ok && (part->len_refdes > 0)) {
+			comp->refdes.refdes = (char **)pickle_arena_alloc(&doc->arena,
+				part->len_refdes * sizeof(char *));
+			ok = comp->refdes.refdes != NULL;
+		}
+		if (!ok) {
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a "
+							 "merged component."));
+			err = PICKLE_ERROR_MEMORY;
+			break;
+		}
+
+		merge->parts[order[i]].out = comp;
+		err = pickle_doc_component_add(doc, comp);
+	}
+
+	pickle_mem_free(NULL, order);
+	return err;
+}
+
+/**
+ * Copies an optional string field over to a merged component.
+ *
+ * @param doc    Document that owns the merged component.
+ * @param dest   Field to be populated.
+ * @param len    Length field to be populated.
+ * @param str    String to be copied or NULL.
+ * @param length Length of the string.
+ * @param intern Should the string be interned?
+ *
+ * @return FALSE if we ran out of memory.
+ */
+bool pickle_merge_copy(pickle_doc_t *doc, char **dest, size_t *len, const char *str, size_t length, bool intern) {
+	if (str == NULL)
+		return true;
+
+	if (intern) {
+		*dest = (char *)pickle_doc_intern(doc, str, length);
+	} else {
+		*dest = pickle_arena_strndup(&doc->arena, str, length);
+	}
+	*len = length;
+
+	return *dest != NULL;
+}
+
+/**
+ * Fills up the reference designators of the merged components, in the order
+ * of the documents they came from.
+ *
+ * @param merge    Merge state.
+ * @param doc      Document that received the merged parts.
+ * @param docs     Documents being merged.
+ * @param prefixes Prefix of the reference designators of each document or
+ *                 NULL.
+ * @param len      Number of documents.
+ *
+ * @return PICKLE_OK if every designator was copied. PICKLE_ERROR_MEMORY if we
+ *         ran out of memory.
+ */
+pickle_err_t pickle_merge_refdes(pickle_merge_t *merge, pickle_doc_t *doc, pickle_doc_t **docs, const char **prefixes, size_t len) {
+	const pickle_component_t *comp;
+	pickle_component_t *out;
+	const char *prefix;
+	const char *refdes;
+	const char *str;
+	char *buf;
+	size_t cap;
+	size_t len_prefix;
+	size_t len_refdes;
+	size_t k;
+	size_t i;
+	size_t j;
+	size_t r;
+
+	buf = NULL;
+	cap = 0;
+	k = 0;
+	for (i = 0; i < len; i++) {
+		prefix = ((prefixes != NULL) && (prefixes[i] != NULL)) ?
+			prefixes[i] : "";
+		len_prefix = strlen(prefix);
+
+		for (j = 0; j < docs[i]->len_components; j++, k++) {
+			comp = docs[i]->components[j];
+			out = merge->parts[merge->which[k]].out;
+			for (r = 0; r < comp->refdes.length; r++) {
+				refdes = comp->refdes.refdes[r];
+				if (refdes == NULL)
+					continue;
+
+				/* Glue the prefix of the board to the designator. */
+				len_refdes = strlen(refdes);
+				if (len_prefix == 0) {
+					str = pickle_doc_intern(doc, refdes, len_refdes);
+				} else if (pickle_util_grow(NULL, (void **)&buf, &cap,
+											len_prefix + len_refdes,
+											sizeof(char))) {
+					memcpy(buf, prefix, len_prefix);
+					memcpy(buf + len_prefix, refdes, len_refdes);
+					str = pickle_doc_intern(doc, buf, len_prefix + len_refdes);
+				} else {
+					str = NULL;
+				}
+				if (str == NULL) {
+					pickle_mem_free(NULL, buf);
+					pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't "
+									 "allocate a merged reference "
+									 "designator."));
+					return PICKLE_ERROR_MEMORY;
+				}
+
+				out->refdes.refdes[out->refdes.length++] = (char *)str;
+			}
+		}
+	}
+
+	pickle_mem_free(NULL, buf);
+	return PICKLE_OK;
+}
+
+/**
+ * Builds a columnar view of the components of a document. Each field lives in
+ * its own packed array (the picked states in a bitset) and every string is
+ * deduplicated into a single pool, so bulk queries stream through contiguous
+ * memory instead of chasing component pointers.
+ *
+ * @warning The view is a snapshot. Changes made to the document afterwards
+ *          aren't reflected in it. Category indices refer to the document's
+ *          categories collection.
+ *
+ * @param cols View to be populated. Free it with pickle_columns_free.
+ * @param doc  Parsed PickLE document object.
+ *
+ * @return PICKLE_OK if the view was built. PICKLE_ERROR_MEMORY if we ran out of
+ *         memory.
+ *
+ * @see pickle_columns_free
+ */
+pickle_err_t pickle_columns_build(pickle_columns_t *cols, const pickle_doc_t *doc) {
+	const pickle_component_t *comp;
+	pickle_pool_t pool;
+	uint32_t *block;
+	size_t words;
+	size_t cat;
+	size_t len;
+	size_t i;
+	bool ok;
+
+	/* Allocate every numeric column in a single block. */
+	pickle_columns_init(cols);
+	len = doc->len_components;
+	words = (len + 31) / 32;
+	block = (uint32_t *)pickle_mem_calloc(NULL, words + (len * 6) + 1, sizeof(uint32_t));
+	if (block == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "component columns."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	cols->len = len;
+	cols->picked = block;
+	cols->quantity = cols->picked + words;
+	cols->category = cols->quantity + len;
+	cols->name = cols->category + len;
+	cols->value = cols->name + len;
+	cols->description = cols->value + len;
+	cols->package = cols->description + len;
+
+	/* Fill in the columns. */
+	pickle_pool_init(&pool);
+	ok = true;
+	cat = 0;
+	for (i = 0; ok && (i < len); i++) {
+		comp = doc->components[i];
+		if (comp->picked)
+			cols->picked[i / 32] |= (uint32_t)1 << (i % 32);
+		cols->quantity[i] = (uint32_t)comp->quantity;
+
+		/* Components are usually grouped by category, so look ahead first. */
+		cols->category[i] = (uint32_t)PICKLE_COLUMN_NULL;
+		if ((cat < doc->len_categories) &&
+				(doc->categories[cat] != comp->category)) {
+			if (((cat + 1) < doc->len_categories) &&
+					(doc->categories[cat + 1] == comp->category)) {
+				cat++;
+			} else {
+				for (cat = 0; (cat < doc->len_categories) &&
+						(doc->categories[cat] != comp->category); cat++)
+					;
+			}
+		}
+		if (cat < doc->len_categories) {
+			cols->category[i] = (uint32_t)cat;
+		} else {
+			cat = 0;
+		}
+
+		/* Put the strings in the pool. */
+#define COLUMN_STR(col, str, slen)                                   \
+		cols->col[i] = (uint32_t)PICKLE_COLUMN_NULL;                 \
+		if (ok && ((str) != NULL))                                   \
+			ok = pickle_pool_add(&pool, (str), (slen), &cols->col[i]);
+		COLUMN_STR(name, comp->name, comp->len_name);
+		COLUMN_STR(value, comp->value, comp->len_value);
+		COLUMN_STR(description, comp->description, comp->len_description);
+		COLUMN_STR(package, comp->package, comp->len_package);
+#undef COLUMN_STR
+	}
+
+	/* Keep the pool's buffer as the strings of the view. */
+	if (pool.slots != NULL)
+		pickle_mem_free(NULL, pool.slots);
+	cols->strings = pool.buf;
+	cols->len_strings = pool.len;
+	if (!ok) {
+		pickle_columns_free(cols);
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't build the string "
+						 "pool of the component columns."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Puts a columnar view in an empty state.
+ *
+ * @param cols View to be initialized.
+ */
+void pickle_columns_init(pickle_columns_t *cols) {
+	cols->len = 0;
+	cols->picked = NULL;
+	cols->quantity = NULL;
+	cols->category = NULL;
+	cols->name = NULL;
+	cols->value = NULL;
+	cols->description = NULL;
+	cols->package = NULL;
+	cols->strings = NULL;
+	cols->len_strings = 0;
+}
+
+/**
+ * Frees up everything allocated by a columnar view.
+ *
+ * @param cols View to be free'd.
+ *
+ * @see pickle_columns_build
+ */
+void pickle_columns_free(pickle_columns_t *cols) {
+	if (cols->picked != NULL)
+		pickle_mem_free(NULL, cols->picked);
+	if (cols->strings != NULL)
+		pickle_mem_free(NULL, cols->strings);
+	pickle_columns_init(cols);
+}
+
+/**
+ * Checks if a component of a columnar view has been picked.
+ *
+ * @param cols  Columnar view.
+ * @param index Index of the component.
+ *
+ * @return Has the component been picked?
+ */
+bool pickle_columns_picked(const pickle_columns_t *cols, size_t index) {
+	return (cols->picked[index / 32] >> (index % 32)) & 1;
+}
+
+/**
+ * Counts the picked components of a columnar view straight from the bitset.
+ *
+ * @param cols Columnar view.
+ *
+ * @return Number of components that have been picked.
+ */
+size_t pickle_columns_count_picked(const pickle_columns_t *cols) {
+	size_t count;
+	size_t i;
+
+	count = 0;
+	for (i = 0; i < ((cols->len + 31) / 32); i++)
+		count += pickle_util_popcount(cols->picked[i]);
+
+	return count;
+}
+
+/**
+ * Gets a string out of the pool of a columnar view.
+ *
+ * @param cols Columnar view.
+ * @param off  Offset of the string taken from one of the string columns.
+ *
+ * @return NULL terminated string or NULL if the field wasn't set.
+ */
+const char *pickle_columns_str(const pickle_columns_t *cols, uint32_t off) {
+	if (off == (uint32_t)PICKLE_COLUMN_NULL)
+		return NULL;
+
+	return cols->strings + off;
+}
+
+/**
+ * Allocates a brand new property object.
+ * @warning This function allocates memory that you are responsible for freeing.
+ *
+ * @return A brand new allocated property object or NULL if we ran out of
+ *         memory.
+ * @see pickle_property_free
+ */
+pickle_property_t *pickle_property_new(void) {
+	/* Allocate the structure. */
+	pickle_property_t *prop =
+		(pickle_property_t *)pickle_mem_alloc(NULL, sizeof(pickle_property_t));
+	if (prop == NULL)
+		return NULL;
+
+	/* Put it in a default state. */
+	prop->name = NULL;
+	prop->value = NULL;
+	prop->len_name = 0;
+	prop->len_value = 0;
+	prop->arena = NULL;
+
+	return prop;
+}
+
+/**
+ * Allocates a brand new property object from a document's arena.
+ *
+ * @param doc Document that will own the property.
+ *
+ * @return A brand new property object that lives and dies with the document,
+ *         or NULL if we ran out of memory.
+ */
+pickle_property_t *pickle_doc_property_new(pickle_doc_t *doc) {
+	pickle_property_t *prop;
+
+	/* Allocate the structure. */
+	prop = (pickle_property_t *)pickle_arena_alloc(&doc->arena,
+												   sizeof(pickle_property_t));
+	if (prop == NULL)
+		return NULL;
+
+	/* Put it in a default state. */
+	prop->name = NULL;
+	prop->value = NULL;
+	prop->len_name = 0;
+	prop->len_value = 0;
+	prop->arena = &doc->arena;
+
+	return prop;
+}
+
+/**
+ * Gets the name of a property.
+ *
+ * @warning Properties parsed in view mode (PICKLE_FLAG_VIEW) aren't NULL
+ *          terminated. Use len_name to get its length.
+ *
+ * @param prop Property to get the name from.
+ *
+ * @return Name of the property or NULL if one wasn't defined yet.
+ */
+const char *pickle_property_name_get(const pickle_property_t *prop) {
+	return (const char *)prop->name;
+}
+
+/**
+ * Sets the name of a property.
+ *
+ * @param prop Property to set the name of.
+ * @param name Name to be set.
+ */
+void pickle_property_name_set(pickle_property_t *prop, const char *name) {
+	if (prop->arena != NULL) {
+		prop->len_name = strlen(name);
+		prop->name = pickle_arena_strndup(prop->arena, name, prop->len_name);
+		return;
+	}
+
+	prop->len_name = pickle_util_strcpy(&prop->name, name);
+}
+
+/**
+ * Gets the value of a property.
+ *
+ * @warning Properties parsed in view mode (PICKLE_FLAG_VIEW) aren't NULL
+ *          terminated. Use len_value to get its length.
+ *
+ * @param prop Property to get the value from.
+ *
+ * @return Value of the property or NULL if one wasn't defined yet.
+ */
+const char *pickle_property_value_get(const pickle_property_t *prop) {
+	return (const char *)prop->value;
+}
+
+/**
+ * Sets the value of a property.
+ *
+ * @param prop Property to set the value of.
+ * @param value Value to be set.
+ */
+void pickle_property_value_set(pickle_property_t *prop, const char *value) {
+	if (prop->arena != NULL) {
+		prop->len_value = strlen(value);
+		prop->value = pickle_arena_strndup(prop->arena, value, prop->len_value);
+		return;
+	}
+
+	prop->len_value = pickle_util_strcpy(&prop->value, value);
+}
+
+/**
+ * Frees up the resources allocated by a property object.
+ *
+ * @param prop Property object to be free'd.
+ *
+ * @return PICKLE_OK if the operation was successful.
+ */
+pickle_err_t pickle_property_free(pickle_property_t *prop) {
+	/* Check if we have anything to do. (Arena objects live with the arena) */
+	if ((prop == NULL) || (prop->arena != NULL))
+		return PICKLE_OK;
+
+	/* Free up any internal allocations first. */
+	if (prop->name != NULL)
+		pickle_mem_free(NULL, prop->name);
+	if (prop->value != NULL)
+		pickle_mem_free(NULL, prop->value);
+
+	/* Free up our object. */
+	pickle_mem_free(NULL, prop);
+	prop = NULL;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses a property line.
+ *
+ * @warning prop will be allocated by this function and must be free'd by you.
+ *
+ * @param line Line to be parsed.
+ * @param prop Property object to be populated by this function. Will be set to
+ *             NULL if there isn't a valid property to parse.
+ *
+ * @return PICKLE_OK if a property was parsed. PICKLE_PARSED_BLANK if a blank
+ *         line was found. PICKLE_FINISHED_PARSING when there are no more
+ *         properties to be parsed. PICKLE_ERROR_PARSING if the line we tried to
+ *         parse was malformed. PICKLE_ERROR_MEMORY if we ran out of memory.
+ *
+ * @see pickle_doc_parse
+ */
+pickle_err_t pickle_property_parse(const char *line, pickle_property_t **prop) {
+	return pickle_parser_prop(NULL, line, strlen(line), prop);
+}
+
+/**
+ * Parses a property line that isn't necessarily NULL terminated.
+ *
+ * @warning prop will be allocated by this function and must be free'd by you.
+ *
+ * @param doc  Document being parsed or NULL if this is a standalone property.
+ * @param line Line to be parsed.
+ * @param len  Length of the line.
+ * @param prop Property object to be populated by this function. Will be set to
+ *             NULL if there isn't a valid property to parse.
+ *
+ * @return Same as pickle_property_parse.
+ *
+ * @see pickle_property_parse
+ */
+pickle_err_t pickle_parser_prop(pickle_doc_t *doc, const char *line, size_t len, pickle_property_t **prop) {
+	pickle_scan_t scan;
+	const char *cur;
+	const char *end;
+
+	/* Check if we have finished parsing. */
+	end = line + len;
+	if (line[0] == '-') {
+		if ((len == 3) && (memcmp(line, "---", 3) == 0))
+			return PICKLE_FINISHED_PARSING;
+
+		/* Invalid property name. */
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("A property can't start "
+						 "with a dash."));
+		pickle_error_col(1);
+		return PICKLE_ERROR_PARSING;
+	}
+
+	/* Check if line starts with a colon. */
+	if (line[0] == ':') {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Property line must not "
+						 "start with a colon."));
+		pickle_error_col(1);
+		return PICKLE_ERROR_PARSING;
+	}
+
+	/* Allocate the brand new property. */
+	*prop = (doc != NULL) ? pickle_doc_property_new(doc) : pickle_property_new();
+	if (*prop == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a new "
+						 "property."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Find the first occurrence of a colon. */
+	pickle_scan_init(&scan, line, len, pickle_parser_avail(doc, line, len));
+	cur = line + pickle_scan_find(&scan, 0, SCAN_COLON);
+	if (cur == end) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Property line does not "
+						 "contain a colon."));
+		pickle_error_col(len + 1);
+		goto parsing_error;
+	}
+
+	/* Copy the property name over. */
+	if (pickle_parser_strfield(doc, &((*prop)->name), &((*prop)->len_name),
+							   line, cur - line) != PICKLE_OK) {
+		goto memory_error;
+	}
+
+	/* Move the cursor over to skip the colon and any whitespace. */
+	cur = line + pickle_scan_skip(&scan, cur - line, SCAN_COLON | SCAN_WTSPC);
+	if (cur == end) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Property line does not "
+						 "contain a value."));
+		pickle_error_col((cur - line) + 1);
+		goto parsing_error;
+	}
+
+	/* Copy the property value over and return. */
+	if (pickle_parser_strfield(doc, &((*prop)->value), &((*prop)->len_value),
+							   cur, end - cur) != PICKLE_OK) {
+		goto memory_error;
+	}
+	return PICKLE_OK;
+
+parsing_error:
+	pickle_property_free(*prop);
+	return PICKLE_ERROR_PARSING;
+
+memory_error:
+	pickle_property_free(*prop);
+	return PICKLE_ERROR_MEMORY;
+}
+
+/**
+ * Allocates a brand new category object.
+ * @warning This function allocates memory that you are responsible for freeing.
+ *
+ * @return A brand new allocated category object or NULL if we ran out of
+ *         memory.
+ * @see pickle_category_free
+ */
+pickle_category_t *pickle_category_new(void) {
+	/* Allocate the structure. */
+	pickle_category_t *cat =
+		(pickle_category_t *)pickle_mem_alloc(NULL, sizeof(pickle_category_t));
+	if (cat == NULL)
+		return NULL;
+
+	/* Put it in a default state. */
+	cat->name = NULL;
+	cat->len_name = 0;
+	cat->first_component = 0;
+	cat->len_components = 0;
+	cat->arena = NULL;
+
+	return cat;
+}
+
+/**
+ * Allocates a brand new category object from a document's arena.
+ *
+ * @param doc Document that will own the category.
+ *
+ * @return A brand new category object that lives and dies with the document,
+ *         or NULL if we ran out of memory.
+ */
+pickle_category_t *pickle_doc_category_new(pickle_doc_t *doc) {
+	pickle_category_t *cat;
+
+	/* Allocate the structure. */
+	cat = (pickle_category_t *)pickle_arena_alloc(&doc->arena,
+												  sizeof(pickle_category_t));
+	if (cat == NULL)
+		return NULL;
+
+	/* Put it in a default state. */
+	cat->name = NULL;
+	cat->len_name = 0;
+	cat->first_component = 0;
+	cat->len_components = 0;
+	cat->arena = &doc->arena;
+
+	return cat;
+}
+
+/**
+ * Extends the range of components of a category with a component that was
+ * just placed in the document's components collection.
+ *
+ * @warning Components are expected to be grouped by category, as they are in
+ *          a document. A component that isn't placed right after the others of
+ *          its category is left out of the range.
+ *
+ * @param cat   Category of the component.
+ * @param index Position of the component in the components collection.
+ */
+void pickle_category_track(pickle_category_t *cat, size_t index) {
+	if (cat->len_components == 0) {
+		cat->first_component = index;
+		cat->len_components = 1;
+	} else if ((cat->first_component + cat->len_components) == index) {
+		cat->len_components++;
+	}
+}
+
+/**
+ * Gets the name of a category.
+ *
+ * @warning Categories parsed in view mode (PICKLE_FLAG_VIEW) aren't NULL
+ *          terminated. Use len_name to get its length.
+ *
+ * @param cat Category to get the name from.
+ *
+ * @return Name of the category or NULL if one wasn't defined yet.
+ */
+const char *pickle_category_name_get(const pickle_category_t *cat) {
+	return (const char *)cat->name;
+}
+
+/**
+ * Sets the name of a category.
+ *
+ * @param cat  Category to set the name of.
+ * @param name Name to be set.
+ */
+void pickle_category_name_set(pickle_category_t *cat, const char *name) {
+	if (cat->arena != NULL) {
+		cat->len_name = strlen(name);
+		cat->name = pickle_arena_strndup(cat->arena, name, cat->len_name);
+		return;
+	}
+
+	cat->len_name = pickle_util_strcpy(&cat->name, name);
+}
+
+/**
+ * Frees up the resources allocated by a category object.
+ *
+ * @param cat Category object to be free'd.
+ *
+ * @return PICKLE_OK if the operation was successful.
+ */
+pickle_err_t pickle_category_free(pickle_category_t *cat) {
+	/* Check if we have anything to do. (Arena objects live with the arena) */
+	if ((cat == NULL) || (cat->arena != NULL))
+		return PICKLE_OK;
+
+	/* Free up any internal allocations first. */
+	if (cat->name != NULL)
+		pickle_mem_free(NULL, cat->name);
+
+	/* Free up our object. */
+	pickle_mem_free(NULL, cat);
+	cat = NULL;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses a category line.
+ *
+ * @warning cat will be allocated by this function and must be free'd by you.
+ *
+ * @param line Line to be parsed.
+ * @param cat  Category object to be populated by this function. Will be set to
+ *             NULL if there isn't a valid category to parse.
+ *
+ * @return PICKLE_OK if a category was parsed. PICKLE_PARSED_BLANK if a blank
+ *         line was found. PICKLE_ERROR_PARSING if the line we tried to
+ *         parse was malformed. PICKLE_ERROR_MEMORY if we ran out of memory.
+ *
+ * @see pickle_doc_parse
+ */
+pickle_err_t pickle_category_parse(const char *line, pickle_category_t **cat) {
+	return pickle_parser_cat(NULL, line, strlen(line), cat);
+}
+
+/**
+ * Parses a category line that isn't necessarily NULL terminated.
+ *
+ * @warning cat will be allocated by this function and must be free'd by you.
+ *
+ * @param doc  Document being parsed or NULL if this is a standalone category.
+ * @param line Line to be parsed.
+ * @param len  Length of the line.
+ * @param cat  Category object to be populated by this function. Will be set to
+ *             NULL if there isn't a valid category to parse.
+ *
+ * @return Same as pickle_category_parse.
+ *
+ * @see pickle_category_parse
+ */
+pickle_err_t pickle_parser_cat(pickle_doc_t *doc, const char *line, size_t len, pickle_category_t **cat) {
+	pickle_scan_t scan;
+	const char *cur;
+
+	/* Check if line starts with a colon. */
+	if (line[0] == ':') {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Category line must not "
+						 "start with a colon."));
+		pickle_error_col(1);
+		return PICKLE_ERROR_PARSING;
+	}
+
+	/* Allocate the brand new category. */
+	*cat = (doc != NULL) ? pickle_doc_category_new(doc) : pickle_category_new();
+	if (*cat == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a new "
+						 "category."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Find the first occurrence of a colon. */
+	pickle_scan_init(&scan, line, len, pickle_parser_avail(doc, line, len));
+	cur = line + pickle_scan_find(&scan, 0, SCAN_COLON);
+	if (cur == (line + len)) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Category line does not "
+						 "contain a colon."));
+		pickle_error_col(len + 1);
+		goto parsing_error;
+	}
+
+	/* Copy the category name over and return. */
+	if (pickle_parser_strfield(doc, &((*cat)->name), &((*cat)->len_name),
+							   line, cur - line) != PICKLE_OK) {
+		pickle_category_free(*cat);
+		return PICKLE_ERROR_MEMORY;
+	}
+	return PICKLE_OK;
+
+parsing_error:
+	pickle_category_free(*cat);
+	return PICKLE_ERROR_PARSING;
+}
+
+/**
+ * Allocates a brand new component object.
+ * @warning This function allocates memory that you are responsible for freeing.
+ *
+ * @return A brand new allocated component object or NULL if we ran out of
+ *         memory.
+ * @see pickle_component_free
+ */
+pickle_component_t *pickle_component_new(void) {
+	/* Allocate the structure. */
+	pickle_component_t *comp =
+		(pickle_component_t *)pickle_mem_alloc(NULL, sizeof(pickle_component_t));
+	if (comp == NULL)
+		return NULL;
 
 	/* Put it in a default state. */
-	cat->name = NULL;
+	pickle_component_init(comp, NULL);
+
+	return comp;
+}
+
+/**
+ * Allocates a brand new component object from a document's arena.
+ *
+ * @param doc Document that will own the component.
+ *
+ * @return A brand new component object that lives and dies with the document,
+ *         or NULL if we ran out of memory.
+ */
+pickle_component_t *pickle_doc_component_new(pickle_doc_t *doc) {
+	pickle_component_t *comp;
+
+	/* Allocate the structure. */
+	comp = (pickle_component_t *)pickle_arena_alloc(&doc->arena,
+													sizeof(pickle_component_t));
+	if (comp == NULL)
+		return NULL;
+
+	/* Put it in a default state. */
+	pickle_component_init(comp, &doc->arena);
+
+	return comp;
+}
+
+/**
+ * Puts a component object in its default state.
+ *
+ * @param comp  Component object to be initialized.
+ * @param arena Arena that owns the component or NULL if it was individually
+ *              allocated.
+ */
+void pickle_component_init(pickle_component_t *comp, pickle_arena_t *arena) {
+	comp->picked = false;
+	comp->quantity = 0;
+	comp->name = NULL;
+	comp->value = NULL;
+	comp->description = NULL;
+	comp->package = NULL;
+	comp->len_name = 0;
+	comp->len_value = 0;
+	comp->len_description = 0;
+	comp->len_package = 0;
+	comp->refdes.length = 0;
+	comp->refdes.refdes = NULL;
+	comp->offset_picked = PICKLE_OFFSET_NONE;
+	comp->category = NULL;
+	comp->arena = arena;
+}
+
+/**
+ * Frees up the resources allocated by a component object.
+ *
+ * @param comp Component object to be free'd.
+ *
+ * @return PICKLE_OK if the operation was successful.
+ */
+pickle_err_t pickle_component_free(pickle_component_t *comp) {
+	/* Check if we have anything to do. (Arena objects live with the arena) */
+	if ((comp == NULL) || (comp->arena != NULL))
+		return PICKLE_OK;
+
+	/* Free up any internal allocations first. */
+	if (comp->name != NULL)
+		pickle_mem_free(NULL, comp->name);
+	if (comp->value != NULL)
+		pickle_mem_free(NULL, comp->value);
+	if (comp->description != NULL)
+		pickle_mem_free(NULL, comp->description);
+	if (comp->package != NULL)
+		pickle_mem_free(NULL, comp->package);
+	if (comp->refdes.refdes != NULL)
+		pickle_mem_free(NULL, comp->refdes.refdes);
+
+	/* Free up our object. */
+	pickle_mem_free(NULL, comp);
+	comp = NULL;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses a component item in the document. This will read the component line
+ * and the reference designators line that follows it.
+ *
+ * @warning comp will be allocated from the document's arena, so it lives and
+ *          dies with the document.
+ *
+ * @param doc  PickLE document object.
+ * @param comp Component object to be populated by this function. Will be set to
+ *             NULL if there isn't a valid component to parse.
+ *
+ * @return PICKLE_OK if a component was parsed. PICKLE_FINISHED_PARSING when
+ *         there are no more components to be parsed in the current category.
+ *         PICKLE_ERROR_PARSING if the line we tried to parse was malformed.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
+ *
+ * @see pickle_doc_parse
+ */
+pickle_err_t pickle_parse_component(pickle_doc_t *doc, pickle_component_t **comp) {
+	pickle_category_t *cat;
+
+	/* Components belong to the last category that was parsed. */
+	cat = NULL;
+	if (doc->len_categories > 0)
+		cat = doc->categories[doc->len_categories - 1];
+
+	return pickle_parser_readcomp(doc, cat, comp);
+}
+
+/**
+ * Parses a PickLE document as a stream of events, firing the callbacks as each
+ * object is parsed without ever adding anything to the document's collections.
+ * Memory usage stays flat no matter how big the document is.
+ *
+ * @warning The objects handed to the callbacks are only valid during the
+ *          callback. Copy anything you want to keep around.
+ *
+ * @param doc      Opened PickLE document object. Only used as the source of
+ *                 the document and as scratch space.
+ * @param handlers Callbacks to be fired. Any of them may be NULL. Returning
+ *                 PICKLE_FINISHED_PARSING from a callback stops the parser
+ *                 early, while returning an error aborts it.
+ * @param userdata Pointer passed along to every callback.
+ *
+ * @return PICKLE_OK if everything was parsed fine (or a callback stopped the
+ *         parser early). PICKLE_ERROR_PARSING if something in the document
+ *         couldn't be parsed. Any error returned by a callback.
+ */
+pickle_err_t pickle_parse_stream(pickle_doc_t *doc, const pickle_handlers_t *handlers, void *userdata) {
+	pickle_parser_t parser;
+	pickle_arena_mark_t mark;
+	pickle_event_t event;
+	unsigned int flags;
+	pickle_err_t err;
+
+	/* Check if the file has been opened. */
+	if (doc->reader.source == PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Can't parse a document that "
+						 "hasn't been opened yet."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Objects are thrown away right after their callback. */
+	flags = doc->flags;
+	doc->flags |= DOC_FLAG_SCRATCH;
+	pickle_arena_mark(&doc->arena, &mark);
+	parser.doc = doc;
+	pickle_iter_init(&parser.iter);
+	parser.handlers = *handlers;
+	parser.userdata = userdata;
+	parser.catbuf = NULL;
+	parser.catlen = 0;
+
+	/* Go through the document firing events. */
+	for (;;) {
+		/* Parse the next object in the document. */
+		err = pickle_parser_next(doc, &parser.iter, &event);
+		if (err != PICKLE_OK)
+			break;
+
+		/* Fire the callback and throw away everything that was allocated. */
+		err = pickle_parser_emit(&parser, &event);
+		pickle_arena_release(&doc->arena, &mark);
+		if (err != PICKLE_OK)
+			break;
+	}
+
+	/* Clean up. */
+	doc->flags = flags;
+	if (parser.catbuf != NULL)
+		pickle_mem_free(NULL, parser.catbuf);
+
+	/* Were we asked to stop early or did we reach the end of the file? */
+	if (err == PICKLE_FINISHED_PARSING)
+		return PICKLE_OK;
+
+	return err;
+}
+
+/**
+ * Checks if a document is well-formed without building any of its objects.
+ * Unlike a regular parse this doesn't stop at the first error: every line that
+ * couldn't be parsed gets reported along with its location. Objects are only
+ * parsed far enough to be checked and are thrown away right after, none of
+ * their strings are copied, and reference designators are skipped altogether,
+ * so memory usage stays flat and the document is checked about as fast as it
+ * can be read.
+ *
+ * @param doc        Opened PickLE document object. Only used as the source of
+ *                   the document and as scratch space.
+ * @param max_errors Stop after this many errors. 0 to go through the whole
+ *                   document.
+ * @param errors     Where to store the errors (in order of appearance) or NULL
+ *                   if you only want to know whether the document is valid.
+ *                   Set to NULL if there weren't any, otherwise free it with
+ *                   pickle_free.
+ * @param len        Number of errors that were found. May be NULL.
+ *
+ * @return PICKLE_OK if the document is well-formed. PICKLE_ERROR_PARSING if it
+ *         isn't, with the first error available through pickle_error_last.
+ *         PICKLE_ERROR_FILE if the document couldn't be read.
+ *         PICKLE_ERROR_MEMORY if we ran out of memory.
+ */
+pickle_err_t pickle_doc_validate(pickle_doc_t *doc, size_t max_errors, pickle_error_t **errors, size_t *len) {
+	pickle_arena_mark_t mark;
+	pickle_property_t *prop;
+	pickle_category_t *cat;
+	pickle_category_t scope;
+	pickle_component_t *comp;
+	pickle_error_t first;
+	pickle_error_t *list;
+	const char *line;
+	size_t llen;
+	size_t cap;
+	size_t count;
+	unsigned int flags;
+	bool body;
+	bool incat;
+	bool orphan;
+	pickle_err_t err;
+
+	/* Check if the file has been opened. */
+	if (errors != NULL)
+		*errors = NULL;
+	if (len != NULL)
+		*len = 0;
+	if (doc->reader.source == PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Can't validate a document "
+						 "that hasn't been opened yet."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Objects are thrown away right after they're checked. */
+	flags = doc->flags;
+	doc->flags |= DOC_FLAG_SCRATCH | DOC_FLAG_VALIDATE;
+	pickle_arena_mark(&doc->arena, &mark);
+	list = NULL;
+	cap = 0;
+	count = 0;
+	body = false;
+	incat = false;
+	orphan = false;
+
+	/* Categories don't outlive their line, so components get an empty one that
+	 * stands in for whichever they're in. */
+	memset(&scope, 0, sizeof(pickle_category_t));
+
+	/* Go through the document line by line. */
+	for (;;) {
+		pickle_arena_release(&doc->arena, &mark);
+		err = pickle_doc_nextline(doc, &line, &llen);
+		IF_PICKLE_ERROR(err) {
+			break;
+		}
+		if (err == PICKLE_PARSED_BLANK)
+			continue;
+		if ((err == PICKLE_FINISHED_PARSING) || (err == PICKLE_NEED_DATA)) {
+			err = PICKLE_OK;
+			break;
+		}
+
+		/* Designators of a component that was just reported are skipped. */
+		if (orphan) {
+			orphan = false;
+			if (!pickle_parser_iscat(line, llen) &&
+					!pickle_parser_iscomp(line, llen)) {
+				continue;
+			}
+		}
+
+		/* Check the line for what it's supposed to be. */
+		if (!body) {
+			err = pickle_parser_prop(doc, line, llen, &prop);
+			if (err == PICKLE_FINISHED_PARSING) {
+				body = true;
+				continue;
+			}
+			IF_PICKLE_ERROR(err) {
+				pickle_error_loc(&doc->reader);
+			}
+		} else if (pickle_parser_iscat(line, llen)) {
+			err = pickle_parser_cat(doc, line, llen, &cat);
+			IF_PICKLE_ERROR(err) {
+				pickle_error_loc(&doc->reader);
+			} else {
+				incat = true;
+			}
+		} else if (pickle_parser_iscomp(line, llen)) {
+			/* Only whether we're inside a category matters here. */
+			pickle_reader_unget(&doc->reader, line);
+			err = pickle_parser_readcomp(doc, (incat) ? &scope : NULL, &comp);
+			orphan = err == PICKLE_ERROR_PARSING;
+		} else {
+			pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Line is neither a "
+							 "category nor a component."));
+			pickle_error_loc(&doc->reader);
+			err = PICKLE_ERROR_PARSING;
+		}
+
+		/* Anything other than a malformed line is fatal. */
+		if ((err == PICKLE_FINISHED_PARSING) || (err == PICKLE_NEED_DATA)) {
+			err = PICKLE_OK;
+			break;
+		}
+		if (err != PICKLE_ERROR_PARSING) {
+			IF_PICKLE_ERROR(err) {
+				break;
+			}
+			continue;
+		}
+
+		/* Take note of the error. */
+		if (count == 0)
+			first = *pickle_error_last();
+		if (errors != NULL) {
+			if (!pickle_util_grow(NULL, (void **)&list, &cap, count + 1,
+								  sizeof(pickle_error_t))) {
+				pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+								 "list of errors."));
+				err = PICKLE_ERROR_MEMORY;
+				break;
+			}
+			list[count] = *pickle_error_last();
+		}
+		count++;
+		err = PICKLE_OK;
+
+		/* Have we seen enough? */
+		if ((max_errors > 0) && (count >= max_errors))
+			break;
+	}
+
+	/* Clean up. */
+	pickle_arena_release(&doc->arena, &mark);
+	doc->flags = flags;
+	IF_PICKLE_ERROR(err) {
+		pickle_mem_free(NULL, list);
+		return err;
+	}
+
+	/* Hand over the errors. */
+	if (errors != NULL)
+		*errors = list;
+	if (len != NULL)
+		*len = count;
+	if (count > 0) {
+		pickle_error_state = first;
+		return PICKLE_ERROR_PARSING;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses a whole batch of documents (files or in-memory buffers) on a pool of
+ * worker threads. The items are split evenly between the workers, and workers
+ * that run out of items steal half of what's left from the others. The calling
+ * thread is one of the workers.
+ *
+ * Unless PICKLE_FLAG_KEEP is set the documents are only validated, and each
+ * worker reuses a single document (and its arena) for all of its items.
+ *
+ * @warning Every document is allocated from the global allocator by several
+ *          threads at once, so it must be thread-safe and must not be replaced
+ *          with pickle_allocator_set until the batch is done.
+ *
+ * @param items   Items to be parsed. Each one must either have a file name or
+ *                a buffer. The result of each item is stored in its err and
+ *                error fields, and its parsed document in doc if
+ *                PICKLE_FLAG_KEEP is set.
+ * @param len     Number of items.
+ * @param threads Number of workers to use. 0 uses one per processor core.
+ * @param flags   Document flags. (see pickle_flag_t)
+ *
+ * @return PICKLE_OK if every document was parsed fine. Otherwise the error of
+ *         the first item (in order) that failed.
+ */
+pickle_err_t pickle_batch_parse(pickle_batch_item_t *items, size_t len, unsigned int threads, unsigned int flags) {
+	pickle_err_t err;
+	size_t i;
+
+	/* Parse everything. */
+	err = pickle_worker_run(len, threads, pickle_batch_item, items, flags);
+	IF_PICKLE_ERROR(err) {
+		return err;
+	}
+
+	/* Report the first error. */
+	for (i = 0; i < len; i++) {
+		if (items[i].err != PICKLE_OK) {
+			pickle_error_state = items[i].error;
+			return items[i].err;
+		}
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Puts an iterator in its initial position, right at the start of a document.
+ *
+ * @param iter Iterator to be initialized.
+ */
+void pickle_iter_init(pickle_iter_t *iter) {
+	iter->body = false;
+	iter->category = NULL;
+	iter->offset = 0;
+	iter->line = 0;
+}
+
+/**
+ * Pulls the next object (property, category, or component) out of a document.
+ * The iterator only holds a byte offset and the category we're in, so it can be
+ * copied around freely and any copy can be resumed later on. When the iterator
+ * doesn't match the current position of the document it'll seek back to where
+ * it left off, so several iterators may walk the same document at once.
+ *
+ * @warning The objects are allocated in the document's arena but aren't added
+ *          to its collections. They're only valid until the next call to this
+ *          function on the same document (through any iterator), which reuses
+ *          their memory, or until the document is reset or free'd. Categories
+ *          are the exception, they're kept until the document is reset so that
+ *          the components that follow them may refer to them. Copy anything
+ *          you want to keep around.
+ *
+ * @param doc   Opened PickLE document object.
+ * @param iter  Iterator to be advanced.
+ * @param event Event describing the object that was parsed.
+ *
+ * @return PICKLE_OK if an object was parsed. PICKLE_FINISHED_PARSING when
+ *         we've reached the end of the document. PICKLE_ERROR_PARSING if
+ *         something in the document couldn't be parsed. PICKLE_ERROR_FILE if
+ *         the document isn't open or we couldn't get back to the position of
+ *         the iterator.
+ */
+pickle_err_t pickle_iter_next(pickle_doc_t *doc, pickle_iter_t *iter, pickle_event_t *event) {
+	pickle_arena_mark_t mark;
+	unsigned int flags;
+	pickle_err_t err;
+
+	/* Throw away the objects of the last call, as long as nothing else has
+	 * been allocated from the arena since. */
+	pickle_arena_mark(&doc->arena, &mark);
+	if (doc->iter_window && (mark.chunk == doc->iter_end.chunk) &&
+			(mark.used == doc->iter_end.used)) {
+		pickle_arena_release(&doc->arena, &doc->iter_start);
+	}
+	pickle_arena_mark(&doc->arena, &doc->iter_start);
+
+	/* Parse the next object. (Interning would leave the string table pointing
+	 * to memory that's about to be reused) */
+	flags = doc->flags;
+	doc->flags |= DOC_FLAG_SCRATCH;
+	err = pickle_iter_step(doc, iter, event);
+	doc->flags = flags;
+
+	/* Categories are kept around for the components that follow them. */
+	doc->iter_window = (err != PICKLE_OK) ||
+		(event->type != PICKLE_EVENT_CATEGORY);
+	pickle_arena_mark(&doc->arena, &doc->iter_end);
+
+	return err;
+}
+
+/**
+ * Advances an iterator by a single object without throwing anything away.
+ *
+ * @param doc   Opened PickLE document object.
+ * @param iter  Iterator to be advanced.
+ * @param event Event describing the object that was parsed.
+ *
+ * @return Same as pickle_iter_next. PICKLE_NEED_DATA if the next object hasn't
+ *         been completely fed to a push parser yet.
+ *
+ * @see pickle_iter_next
+ */
+pickle_err_t pickle_iter_step(pickle_doc_t *doc, pickle_iter_t *iter, pickle_event_t *event) {
+	pickle_err_t err;
+
+	/* Check if the file has been opened. */
+	if (doc->reader.source == PICKLE_SOURCE_NONE) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Can't iterate over a "
+						 "document that hasn't been opened yet."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Get back to where the iterator left off. */
+	if (pickle_reader_tell(&doc->reader) != iter->offset) {
+		if (pickle_reader_seek(&doc->reader, iter->offset, iter->line) !=
+				PICKLE_OK) {
+			pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't seek to "
+								"offset %lu of the document."),
+								(unsigned long)iter->offset);
+			return PICKLE_ERROR_FILE;
+		}
+	}
+
+	/* Parse the next object and remember where we stopped. */
+	err = pickle_parser_next(doc, iter, event);
+	iter->offset = pickle_reader_tell(&doc->reader);
+	iter->line = doc->reader.line;
+
+	return err;
+}
+
+/**
+ * Gets the byte offset an iterator will resume from, which is always the start
+ * of the line right after the last object it has returned.
+ *
+ * @param iter Iterator to be queried.
+ *
+ * @return Byte offset from the start of the document.
+ */
+size_t pickle_iter_tell(const pickle_iter_t *iter) {
+	return iter->offset;
+}
+
+/**
+ * Sets up a push parser. Instead of reading a source the parser is fed chunks
+ * of a document of any size (as they arrive from a socket, for example) and
+ * fires the callbacks as soon as each object is complete, so it never blocks.
+ * Partial lines are kept around until the rest of them is fed.
+ *
+ * @warning This function allocates memory that you are responsible for freeing
+ *          with pickle_parser_free. The parser refers to itself, so it must
+ *          stay put in memory while it's in use.
+ * @warning The objects handed to the callbacks are only valid during the
+ *          callback. Copy anything you want to keep around.
+ *
+ * @param parser   Push parser to be initialized.
+ * @param handlers Callbacks to be fired. Any of them may be NULL. Returning
+ *                 PICKLE_FINISHED_PARSING from a callback stops the parser
+ *                 early, while returning an error aborts it.
+ * @param userdata Pointer passed along to every callback.
+ *
+ * @return PICKLE_OK if the parser is ready to be fed. PICKLE_ERROR_MEMORY if
+ *         we ran out of memory.
+ *
+ * @see pickle_parser_feed
+ * @see pickle_parser_free
+ */
+pickle_err_t pickle_parser_init(pickle_parser_t *parser, const pickle_handlers_t *handlers, void *userdata) {
+	/* Objects are parsed into a scratch document. */
+	parser->doc = pickle_doc_new();
+	if (parser->doc == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "document of the push parser."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	parser->doc->flags |= DOC_FLAG_SCRATCH;
+	parser->doc->reader.source = PICKLE_SOURCE_FEED;
+
+	/* Reset everything else. */
+	pickle_iter_init(&parser->iter);
+	parser->err = PICKLE_OK;
+	parser->handlers = *handlers;
+	parser->userdata = userdata;
+	parser->catbuf = NULL;
+	parser->catlen = 0;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Feeds the next chunk of a document to a push parser, firing the callbacks of
+ * every object that's been completed by it.
+ *
+ * @param parser Push parser object.
+ * @param buf    Next chunk of the document. (Copied, may be reused right away)
+ * @param len    Length of the chunk.
+ *
+ * @return PICKLE_OK if the chunk was taken in and is ready for the next one.
+ *         PICKLE_FINISHED_PARSING if a callback stopped the parser early.
+ *         PICKLE_ERROR_PARSING if something in the document couldn't be
+ *         parsed. PICKLE_ERROR_MEMORY if we ran out of memory. Any error
+ *         returned by a callback. Errors are sticky, every call after one just
+ *         returns it again.
+ *
+ * @see pickle_parser_finish
+ */
+pickle_err_t pickle_parser_feed(pickle_parser_t *parser, const char *buf, size_t len) {
+	pickle_reader_t *rd;
+	size_t consumed;
+
+	/* Have we already stopped? */
+	if (parser->err != PICKLE_OK)
+		return parser->err;
+	rd = &parser->doc->reader;
+	if (rd->eof) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Can't feed a push parser "
+						 "that has already been finished."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Throw away everything that has already been parsed. */
+	consumed = parser->iter.offset - rd->base;
+	if (consumed > 0) {
+		memmove(rd->buf, rd->buf + consumed, rd->len - consumed);
+		rd->base += consumed;
+		rd->len -= consumed;
+	}
+	rd->pos = 0;
+	rd->line = parser->iter.line;
+
+	/* Append the chunk to what's left over. */
+	if (!pickle_util_grow(rd->allocator, (void **)&rd->buf, &rd->size,
+						  rd->len + len, sizeof(char))) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the buffer "
+						 "of the push parser."));
+		parser->err = PICKLE_ERROR_MEMORY;
+		return parser->err;
+	}
+	rd->data = rd->buf;
+	if (len > 0)
+		memcpy(rd->buf + rd->len, buf, len);
+	rd->len += len;
+
+	/* Objects end at a newline, so the partial one that's waiting for the rest
+	 * of its lines can't be any closer to done without a new one. */
+	if ((len == 0) || (memchr(buf, '\n', len) == NULL))
+		return PICKLE_OK;
+
+	return pickle_parser_pump(parser);
+}
+
+/**
+ * Tells a push parser that the whole document has been fed to it, so that the
+ * last line may be parsed even without a trailing newline.
+ *
+ * @param parser Push parser object.
+ *
+ * @return PICKLE_OK if the whole document was parsed fine (or a callback
+ *         stopped the parser early). Otherwise the same errors as
+ *         pickle_parser_feed.
+ *
+ * @see pickle_parser_feed
+ */
+pickle_err_t pickle_parser_finish(pickle_parser_t *parser) {
+	if (parser->err == PICKLE_OK) {
+		parser->doc->reader.eof = true;
+		pickle_parser_pump(parser);
+	}
+
+	/* Were we asked to stop early or did we reach the end of the document? */
+	if (parser->err == PICKLE_FINISHED_PARSING)
+		return PICKLE_OK;
+
+	return parser->err;
+}
+
+/**
+ * Frees up everything allocated by a push parser.
+ *
+ * @param parser Push parser to be free'd.
+ */
+void pickle_parser_free(pickle_parser_t *parser) {
+	if (parser->doc != NULL) {
+		pickle_doc_free(parser->doc);
+		parser->doc = NULL;
+	}
+	if (parser->catbuf != NULL) {
+		pickle_mem_free(NULL, parser->catbuf);
+		parser->catbuf = NULL;
+	}
+	parser->catlen = 0;
+}
+
+/**
+ * Parses every object that's been completely fed to a push parser, firing
+ * their callbacks. Stops right before the first incomplete object.
+ *
+ * @param parser Push parser object.
+ *
+ * @return PICKLE_OK if we need more data. Otherwise the error that stopped the
+ *         parser, which is also stored in it.
+ */
+pickle_err_t pickle_parser_pump(pickle_parser_t *parser) {
+	pickle_arena_mark_t mark;
+	pickle_event_t event;
+	pickle_iter_t state;
+	pickle_err_t err;
+
+	pickle_arena_mark(&parser->doc->arena, &mark);
+	for (;;) {
+		/* Parse the next object, starting over if it isn't all here yet. */
+		state = parser->iter;
+		err = pickle_iter_step(parser->doc, &parser->iter, &event);
+		if (err == PICKLE_NEED_DATA) {
+			parser->iter = state;
+			pickle_arena_release(&parser->doc->arena, &mark);
+			return PICKLE_OK;
+		}
+		if (err != PICKLE_OK)
+			break;
+
+		/* Fire the callback and throw away everything that was allocated. */
+		err = pickle_parser_emit(parser, &event);
+		pickle_arena_release(&parser->doc->arena, &mark);
+		if (err != PICKLE_OK)
+			break;
+	}
+
+	parser->err = err;
+	return err;
+}
+
+/**
+ * Fires the callback of an object that was just parsed by a streaming parser.
+ *
+ * @param parser Streaming parser state.
+ * @param event  Event describing the object that was parsed.
+ *
+ * @return Whatever the callback returned. PICKLE_ERROR_MEMORY if we ran out of
+ *         memory.
+ */
+pickle_err_t pickle_parser_emit(pickle_parser_t *parser, pickle_event_t *event) {
+	const pickle_handlers_t *handlers;
+	pickle_category_t *cat;
+
+	handlers = &parser->handlers;
+	switch (event->type) {
+	case PICKLE_EVENT_PROPERTY:
+		if (handlers->on_property != NULL)
+			return handlers->on_property(event->property, parser->userdata);
+		break;
+	case PICKLE_EVENT_CATEGORY:
+		/* Keep the category around for the components that follow it. */
+		if (!pickle_util_grow(NULL, (void **)&parser->catbuf, &parser->catlen,
+							  event->category->len_name + 1, sizeof(char))) {
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate "
+							 "the category name."));
+			return PICKLE_ERROR_MEMORY;
+		}
+		memcpy(parser->catbuf, event->category->name,
+			   event->category->len_name);
+		parser->catbuf[event->category->len_name] = '\0';
+		cat = &parser->category;
+		cat->name = parser->catbuf;
+		cat->len_name = event->category->len_name;
+		cat->first_component = 0;
+		cat->len_components = 0;
+		cat->arena = &parser->doc->arena;
+		parser->iter.category = cat;
+
+		if (handlers->on_category != NULL)
+			return handlers->on_category(cat, parser->userdata);
+		break;
+	case PICKLE_EVENT_COMPONENT:
+		if (handlers->on_component != NULL)
+			return handlers->on_component(event->component, parser->userdata);
+		break;
+	default:
+		break;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses the next object (property, category, or component) in a document.
+ *
+ * @param doc   Opened PickLE document object.
+ * @param state Parser state that's carried between calls.
+ * @param event Event describing the object that was parsed.
+ *
+ * @return PICKLE_OK if an object was parsed. PICKLE_FINISHED_PARSING when
+ *         we've reached the end of the document. PICKLE_NEED_DATA if the next
+ *         object hasn't been completely fed to a push parser yet, in which case
+ *         the state must be rolled back. PICKLE_ERROR_PARSING if something in
+ *         the document couldn't be parsed.
+ */
+pickle_err_t pickle_parser_next(pickle_doc_t *doc, pickle_iter_t *state, pickle_event_t *event) {
+	const char *line;
+	size_t len;
+	pickle_err_t err;
+
+	event->type = PICKLE_EVENT_NONE;
+	event->property = NULL;
+	event->category = NULL;
+	event->component = NULL;
+
+	for (;;) {
+		/* Get line from document file. */
+		err = pickle_doc_nextline(doc, &line, &len);
+		IF_PICKLE_ERROR(err) {
+			return err;
+		}
+
+		/* Check if we only had whitespace. */
+		if (err == PICKLE_PARSED_BLANK)
+			continue;
+
+		/* Have we reached the end of the file or of what's been fed to us? */
+		if ((err == PICKLE_FINISHED_PARSING) || (err == PICKLE_NEED_DATA))
+			return err;
+
+		/* Start by parsing the document's properties. */
+		if (!state->body) {
+			err = pickle_parser_prop(doc, line, len, &event->property);
+			IF_PICKLE_ERROR(err) {
+				pickle_error_loc(&doc->reader);
+				return err;
+			}
+
+			/* Have we reached the end of the properties? */
+			if (err == PICKLE_FINISHED_PARSING) {
+				state->body = true;
+				continue;
+			}
+
+			event->type = PICKLE_EVENT_PROPERTY;
+			return PICKLE_OK;
+		}
+
+		/* Check if we have a category. */
+		if (pickle_parser_iscat(line, len)) {
+			err = pickle_parser_cat(doc, line, len, &event->category);
+			IF_PICKLE_ERROR(err) {
+				pickle_error_loc(&doc->reader);
+				return err;
+			}
+
+			state->category = event->category;
+			event->type = PICKLE_EVENT_CATEGORY;
+			return PICKLE_OK;
+		}
+
+		/* Check if we have a component. */
+		if (pickle_parser_iscomp(line, len)) {
+			/* Let the component parser read it along with its refdes line. */
+			pickle_reader_unget(&doc->reader, line);
+			err = pickle_parser_readcomp(doc, state->category,
+										 &event->component);
+			if (err != PICKLE_OK)
+				return err;
+
+			event->type = PICKLE_EVENT_COMPONENT;
+			return PICKLE_OK;
+		}
+
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Line is neither a "
+						 "category nor a component."));
+		pickle_error_loc(&doc->reader);
+		return PICKLE_ERROR_PARSING;
+	}
+}
+
+/**
+ * Finds the start of the first category line at or after a position.
+ *
+ * @param data Contents of the document.
+ * @param len  Length of the document.
+ * @param pos  Position to start looking from. If it's in the middle of a line
+ *             we'll start from the next one.
+ *
+ * @return Offset of the category line or the length of the document if there
+ *         aren't any more categories.
+ */
+size_t pickle_parser_nextcat(const char *data, size_t len, size_t pos) {
+	const char *nl;
+	size_t llen;
+
+	/* Get to the start of a line. */
+	if ((pos > 0) && (pos < len) && (data[pos - 1] != '\n')) {
+		nl = (const char *)memchr(data + pos, '\n', len - pos);
+		if (nl == NULL)
+			return len;
+		pos = (nl - data) + 1;
+	}
+
+	/* Go through the lines looking for a category. */
+	while (pos < len) {
+		nl = (const char *)memchr(data + pos, '\n', len - pos);
+		llen = (nl == NULL) ? len - pos : (size_t)(nl - (data + pos));
+		if ((llen > 0) && (data[pos + llen - 1] == '\r'))
+			llen--;
+
+		if (pickle_parser_iscat(data + pos, llen))
+			return pos;
+		if (nl == NULL)
+			break;
+		pos = (nl - data) + 1;
+	}
+
+	return len;
+}
+
+/**
+ * Parses a piece of a document on its own brand new document.
+ *
+ * @param worker Worker thread.
+ * @param index  Index of the piece of the document to be parsed.
+ */
+void pickle_parser_chunk(pickle_worker_t *worker, size_t index) {
+	pickle_chunk_t *chunk;
+	pickle_iter_t state;
+	const char *cur;
+	const char *nl;
+	size_t lines;
+	size_t i;
+
+	/* Get a document to parse into. */
+	chunk = &((pickle_chunk_t *)worker->ctx)[index];
+	pickle_error_clear();
+	chunk->doc = pickle_doc_new_allocator(chunk->allocator);
+	if (chunk->doc == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a "
+						 "document."));
+		chunk->err = PICKLE_ERROR_MEMORY;
+		chunk->error = *pickle_error_last();
+		return;
+	}
+	chunk->doc->flags = worker->flags;
+
+	/* Parse the piece as if it was the body of a document. */
+	pickle_doc_open_mem(chunk->doc, chunk->data + chunk->start,
+						chunk->end - chunk->start);
+	pickle_iter_init(&state);
+	state.body = true;
+	chunk->err = pickle_parser_run(chunk->doc, &state);
+	if (chunk->err == PICKLE_OK) {
+		/* Make the picked state markers relative to the whole document. */
+		for (i = 0; i < chunk->doc->len_components; i++)
+			chunk->doc->components[i]->offset_picked += chunk->start;
+
+		return;
+	}
+
+	/* Make the location of the error relative to the whole document. */
+	chunk->error = *pickle_error_last();
+	if (chunk->error.line > 0) {
+		lines = 0;
+		cur = chunk->data;
+		while ((nl = (const char *)memchr(
+				cur, '\n', (chunk->data + chunk->start) - cur)) != NULL) {
+			lines++;
+			cur = nl + 1;
+		}
+
+		chunk->error.line += lines;
+		chunk->error.offset += chunk->start;
+	}
+}
+
+/**
+ * Reads a component item from the document. This will read the component line
+ * and the reference designators line that follows it.
+ *
+ * @param doc  PickLE document object.
+ * @param cat  Category the component belongs to.
+ * @param comp Component object to be populated by this function. Will be set to
+ *             NULL if there isn't a valid component to parse.
+ *
+ * @return Same as pickle_parse_component.
+ *
+ * @see pickle_parse_component
+ */
+pickle_err_t pickle_parser_readcomp(pickle_doc_t *doc, pickle_category_t *cat, pickle_component_t **comp) {
+	const char *line;
+	size_t len;
+	pickle_err_t err;
+
+	/* Get the component line, skipping any blank ones. */
+	*comp = NULL;
+	do {
+		err = pickle_doc_nextline(doc, &line, &len);
+		IF_PICKLE_ERROR(err) {
+			return err;
+		}
+	} while (err == PICKLE_PARSED_BLANK);
+
+	/* Have we reached the end of the file or of what's been fed to us? */
+	if ((err == PICKLE_FINISHED_PARSING) || (err == PICKLE_NEED_DATA))
+		return err;
+
+	/* Have we reached the end of the category? */
+	if (pickle_parser_iscat(line, len)) {
+		pickle_reader_unget(&doc->reader, line);
+		return PICKLE_FINISHED_PARSING;
+	}
+
+	/* Components must always be inside a category. */
+	if (cat == NULL) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component defined outside "
+						 "of a category."));
+		pickle_error_loc(&doc->reader);
+		return PICKLE_ERROR_PARSING;
+	}
+
+	/* Parse the component line itself. */
+	err = pickle_parser_comp(doc, line, len, comp);
+	IF_PICKLE_ERROR(err) {
+		pickle_error_loc(&doc->reader);
+		return err;
+	}
+	(*comp)->category = cat;
+	(*comp)->offset_picked = doc->reader.lstart + 1;
+
+	/* Get the reference designators line. */
+	do {
+		err = pickle_doc_nextline(doc, &line, &len);
+		IF_PICKLE_ERROR(err) {
+			*comp = NULL;
+			return err;
+		}
+	} while (err == PICKLE_PARSED_BLANK);
+
+	/* We can't tell what comes next until the whole line is here. */
+	if (err == PICKLE_NEED_DATA) {
+		*comp = NULL;
+		return err;
+	}
+
+	/* Components may not have any reference designators. */
+	if (err == PICKLE_FINISHED_PARSING)
+		return PICKLE_OK;
+	if (pickle_parser_iscat(line, len) || pickle_parser_iscomp(line, len)) {
+		pickle_reader_unget(&doc->reader, line);
+		return PICKLE_OK;
+	}
+
+	/* Designators can't be malformed, so there's nothing to validate. */
+	if (doc->flags & DOC_FLAG_VALIDATE)
+		return PICKLE_OK;
+
+	/* Parse the reference designators. */
+	err = pickle_parser_refdes(doc, line, len, *comp);
+	IF_PICKLE_ERROR(err) {
+		pickle_error_loc(&doc->reader);
+		*comp = NULL;
+		return err;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses a component line in a single forward pass. The line is expected to
+ * be in the form of: [X] qty name (value) "description" [package]
+ *
+ * @param doc  Document being parsed or NULL if this is a standalone component.
+ * @param line Line to be parsed.
+ * @param len  Length of the line.
+ * @param comp Component object to be populated by this function. Will be set to
+ *             NULL if the line was malformed.
+ *
+ * @return PICKLE_OK if a component was parsed. PICKLE_ERROR_PARSING if the line
+ *         we tried to parse was malformed. PICKLE_ERROR_MEMORY if we couldn't
+ *         store one of its fields.
+ */
+pickle_err_t pickle_parser_comp(pickle_doc_t *doc, const char *line, size_t len, pickle_component_t **comp) {
+	pickle_scan_t scan;
+	unsigned int digit;
+	const char *cur;
+	const char *end;
+	const char *fstart;
+	const char *fend;
+	pickle_err_t err;
+
+	/* Check the picked state. */
+	end = line + len;
+	if ((len < 3) || (line[0] != '[') || (line[2] != ']')) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component line must start "
+						 "with its picked state."));
+		pickle_error_col(1);
+		return PICKLE_ERROR_PARSING;
+	}
+	if ((line[1] != 'X') && (line[1] != 'x') && (line[1] != ' ')) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component picked state "
+						 "must be either 'X' or ' '."));
+		pickle_error_col(2);
+		return PICKLE_ERROR_PARSING;
+	}
+
+	/* Allocate the brand new component. */
+	*comp = (doc != NULL) ? pickle_doc_component_new(doc) :
+		pickle_component_new();
+	if (*comp == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a new "
+						 "component."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	(*comp)->picked = line[1] != ' ';
+
+	/* Get the quantity. */
+	pickle_scan_init(&scan, line, len, pickle_parser_avail(doc, line, len));
+	cur = line + pickle_scan_skip(&scan, 3, SCAN_WTSPC);
+	if ((cur == end) || (*cur < '0') || (*cur > '9')) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component line does not "
+						 "contain a quantity."));
+		pickle_error_col((cur - line) + 1);
+		goto parsing_error;
+	}
+	(*comp)->quantity = 0;
+	while ((cur < end) && (*cur >= '0') && (*cur <= '9')) {
+		digit = (unsigned int)(*cur - '0');
+		if ((*comp)->quantity > ((UINT_MAX - digit) / 10)) {
+			pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component quantity "
+							 "is too large."));
+			pickle_error_col((cur - line) + 1);
+			goto parsing_error;
+		}
+		(*comp)->quantity = ((*comp)->quantity * 10) + digit;
+		cur++;
+	}
+
+	/* Get the name. */
+	fstart = line + pickle_scan_skip(&scan, cur - line, SCAN_WTSPC);
+	if ((fstart == cur) || (fstart == end)) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component line does not "
+						 "contain a name."));
+		pickle_error_col((fstart - line) + 1);
+		goto parsing_error;
+	}
+	cur = line + pickle_scan_find(&scan, fstart - line, SCAN_WTSPC);
+	if (pickle_parser_strfield(doc, &((*comp)->name), &((*comp)->len_name),
+							   fstart, cur - fstart) != PICKLE_OK) {
+		goto memory_error;
+	}
+	cur = line + pickle_scan_skip(&scan, cur - line, SCAN_WTSPC);
+
+	/* Get the optional value. */
+	if ((cur < end) && (*cur == '(')) {
+		err = pickle_parser_enclstr(&scan, SCAN_RPAREN, cur - line, &fstart,
+									 &fend);
+		IF_PICKLE_ERROR(err) {
+			pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component value is "
+							 "missing its closing parenthesis."));
+			pickle_error_col((cur - line) + 1);
+			goto parsing_error;
+		}
+		if ((err == PICKLE_OK) && (pickle_parser_strfield(doc,
+				&((*comp)->value), &((*comp)->len_value), fstart,
+				fend - fstart) != PICKLE_OK)) {
+			goto memory_error;
+		}
+		cur = line + pickle_scan_skip(&scan, (fend - line) + 1, SCAN_WTSPC);
+	}
+
+	/* Get the optional description. */
+	if ((cur < end) && (*cur == '"')) {
+		err = pickle_parser_enclstr(&scan, SCAN_QUOTE, cur - line, &fstart,
+									 &fend);
+		IF_PICKLE_ERROR(err) {
+			pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component description "
+							 "is missing its closing quote."));
+			pickle_error_col((cur - line) + 1);
+			goto parsing_error;
+		}
+		if ((err == PICKLE_OK) && (pickle_parser_strintern(doc,
+				&((*comp)->description), &((*comp)->len_description), fstart,
+				fend - fstart) != PICKLE_OK)) {
+			goto memory_error;
+		}
+		cur = line + pickle_scan_skip(&scan, (fend - line) + 1, SCAN_WTSPC);
+	}
+
+	/* Get the optional package. */
+	if ((cur < end) && (*cur == '[')) {
+		err = pickle_parser_enclstr(&scan, SCAN_RBRACKET, cur - line, &fstart,
+									 &fend);
+		IF_PICKLE_ERROR(err) {
+			pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Component package is "
+							 "missing its closing bracket."));
+			pickle_error_col((cur - line) + 1);
+			goto parsing_error;
+		}
+		if ((err == PICKLE_OK) && (pickle_parser_strintern(doc,
+				&((*comp)->package), &((*comp)->len_package), fstart,
+				fend - fstart) != PICKLE_OK)) {
+			goto memory_error;
+		}
+		cur = line + pickle_scan_skip(&scan, (fend - line) + 1, SCAN_WTSPC);
+	}
+
+	/* Make sure there's nothing left over. */
+	if (cur != end) {
+		pickle_error_set(PICKLE_ERROR_PARSING, EMSG("Unexpected characters at "
+						 "the end of the component line."));
+		pickle_error_col((cur - line) + 1);
+		goto parsing_error;
+	}
+
+	return PICKLE_OK;
+
+parsing_error:
+	pickle_component_free(*comp);
+	*comp = NULL;
+	return PICKLE_ERROR_PARSING;
+
+memory_error:
+	pickle_component_free(*comp);
+	*comp = NULL;
+	return PICKLE_ERROR_MEMORY;
+}
+
+/**
+ * Parses a reference designators line into a component. Document components
+ * get a single pointer array that refers to designators interned in the
+ * document's string table. Standalone components get a single allocation
+ * holding both the pointer array and the NULL terminated designators.
+ *
+ * @param doc  Document being parsed or NULL if this is a standalone component.
+ * @param line Line to be parsed.
+ * @param len  Length of the line.
+ * @param comp Component to have its reference designators populated.
+ *
+ * @return PICKLE_OK if the reference designators were parsed.
+ *         PICKLE_ERROR_MEMORY if we couldn't allocate the list or intern a
+ *         designator.
+ */
+pickle_err_t pickle_parser_refdes(pickle_doc_t *doc, const char *line, size_t len, pickle_component_t *comp) {
+	pickle_scan_t scan;
+	size_t word;
+	size_t end;
+	size_t count;
+	size_t dlen;
+	size_t i;
+	char *str;
+
+	/* Count the designators. */
+	pickle_scan_init(&scan, line, len, pickle_parser_avail(doc, line, len));
+	count = pickle_scan_words(&scan);
+
+	/* Allocate the list all at once. */
+	if (doc != NULL) {
+		comp->refdes.refdes = (char **)pickle_arena_alloc(&doc->arena,
+			count * sizeof(char *));
+	} else {
+		comp->refdes.refdes = (char **)pickle_mem_alloc(NULL, (count * sizeof(char *)) +
+											  len + 1);
+	}
+	if (comp->refdes.refdes == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "reference designators list."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	comp->refdes.length = count;
+
+	/* Intern each designator for document components or copy them over to the
+	 * end of the list for standalone ones. */
+	str = (char *)(comp->refdes.refdes + count);
+	i = 0;
+	for (word = 0; pickle_scan_word(&scan, &word, &end); word = end) {
+		if (doc != NULL) {
+			if (pickle_parser_strintern(doc, &comp->refdes.refdes[i++], &dlen,
+										line + word, end - word) != PICKLE_OK) {
+				comp->refdes.length = i - 1;
+				return PICKLE_ERROR_MEMORY;
+			}
+			continue;
+		}
+
+		memcpy(str, line + word, end - word);
+		str[end - word] = '\0';
+		comp->refdes.refdes[i++] = str;
+		str += (end - word) + 1;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Stores a parsed string field according to the document's parsing mode. In
+ * view mode the field points straight into in-memory sources. Otherwise (or for
+ * file sources, since their buffer gets reused) a NULL terminated copy is
+ * placed in the document's arena. Standalone objects get an individually
+ * allocated copy.
+ *
+ * @param doc   Document being parsed or NULL for standalone objects.
+ * @param dest  Field to be populated.
+ * @param dlen  Length field to be populated.
+ * @param start Start of the string in the line.
+ * @param len   Length of the string.
+ *
+ * @return PICKLE_OK if the field was stored. PICKLE_ERROR_MEMORY if we couldn't
+ *         allocate its copy.
+ */
+pickle_err_t pickle_parser_strfield(pickle_doc_t *doc, char **dest, size_t *dlen, const char *start, size_t len) {
+	if (doc != NULL) {
+		/* Strings of document objects live with the document. */
+		if (((doc->flags & PICKLE_FLAG_VIEW) &&
+				!SOURCE_IS_STREAM(doc->reader.source)) ||
+				(doc->flags & DOC_FLAG_VALIDATE)) {
+			*dest = (char *)start;
+		} else {
+			*dest = pickle_arena_strndup(&doc->arena, start, len);
+		}
+	} else {
+		/* Make an individual copy of the string. */
+		*dest = (char *)pickle_mem_alloc(NULL, (len + 1) * sizeof(char));
+		if (*dest != NULL) {
+			memcpy(*dest, start, len);
+			(*dest)[len] = '\0';
+		}
+	}
+
+	/* Did we run out of memory? */
+	if (*dest == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a "
+						 "string field."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	*dlen = len;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Stores a parsed string field that's likely to repeat throughout a document.
+ * Document objects get the interned copy of the string, even in view mode,
+ * while standalone and streamed objects are handled just like any other
+ * field.
+ *
+ * @param doc   Document being parsed or NULL for standalone objects.
+ * @param dest  Field to be populated.
+ * @param dlen  Length field to be populated.
+ * @param start Start of the string in the line.
+ * @param len   Length of the string.
+ *
+ * @return PICKLE_OK if the field was stored. PICKLE_ERROR_MEMORY if we couldn't
+ *         intern or copy the string.
+ *
+ * @see pickle_doc_intern
+ */
+pickle_err_t pickle_parser_strintern(pickle_doc_t *doc, char **dest, size_t *dlen, const char *start, size_t len) {
+	/* Interning is pointless for objects that are about to be thrown away. */
+	if ((doc == NULL) || (doc->flags & DOC_FLAG_SCRATCH))
+		return pickle_parser_strfield(doc, dest, dlen, start, len);
+
+	*dest = (char *)pickle_doc_intern(doc, start, len);
+	if (*dest == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't intern a string "
+						 "field."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	*dlen = len;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Gets how many bytes can be safely read from the start of a line, including
+ * the ones that come after it in the reader's buffer.
+ *
+ * @param doc  Document being parsed or NULL if this is a standalone line.
+ * @param line Line that was returned by the reader.
+ * @param len  Length of the line.
+ *
+ * @return Number of bytes that are readable from the start of the line.
+ */
+size_t pickle_parser_avail(const pickle_doc_t *doc, const char *line, size_t len) {
+	const pickle_reader_t *rd;
+
+	/* Standalone lines end where they end. */
+	if (doc == NULL)
+		return len;
+
+	/* Make sure the line is actually in the buffer. */
+	rd = &doc->reader;
+	if ((rd->data == NULL) || (line < rd->data) ||
+			(line + len > rd->data + rd->len)) {
+		return len;
+	}
+
+	return (rd->data + rd->len) - line;
+}
+
+/**
+ * Checks if a line is a category definition.
+ *
+ * @param line Line to be checked.
+ * @param len  Length of the line.
+ *
+ * @return Is this line a properly-formed category definition?
+ */
+bool pickle_parser_iscat(const char *line, size_t len) {
+	/* Perform a simple check if the last character in a line is a colon. */
+	return (len > 0) && (line[len - 1] == ':');
+}
+
+/**
+ * Checks if a line is a component definition.
+ *
+ * @param line Line to be checked.
+ * @param len  Length of the line.
+ *
+ * @return Does this line start like a component definition?
+ */
+bool pickle_parser_iscomp(const char *line, size_t len) {
+	return (len > 0) && (line[0] == '[');
+}
+
+/**
+ * Lexer that extracts a string that's enclosed inside a set of tokens.
+ *
+ * @param scan  Scanner of the line being lexed.
+ * @param close Character class of the closing token.
+ * @param pos   Position of the opening token in the line.
+ * @param start Start of a string that was enclosed in the tokens.
+ * @param end   Closing token of the enclosed string. (Exclusive end)
+ *
+ * @return PICKLE_OK if we were able to lex the string. PICKLE_ERROR_PARSING if
+ *         the closing token wasn't found in the line. PICKLE_FINISHED_PARSING if
+ *         the tokens were found, but nothing was in between them.
+ */
+pickle_err_t pickle_parser_enclstr(pickle_scan_t *scan, unsigned int close, size_t pos, const char **start, const char **end) {
+	size_t found;
+
+	/* Find the closing token. */
+	found = pickle_scan_find(scan, pos + 1, close);
+	if (found == scan->len) {
+		*start = NULL;
+		*end = NULL;
+		return PICKLE_ERROR_PARSING;
+	}
+	*start = scan->line + pos + 1;
+	*end = scan->line + found;
+
+	/* Check if there was nothing in between the tokens. */
+	if (*start == *end)
+		return PICKLE_FINISHED_PARSING;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Sets up a scanner for a line. Blocks are only classified as they're needed.
+ *
+ * @param scan  Scanner to be set up.
+ * @param line  Line to be scanned.
+ * @param len   Length of the line.
+ * @param avail Number of bytes that can be read from the start of the line.
+ *              Letting blocks run past the end of the line saves us from
+ *              having to pad them.
+ */
+void pickle_scan_init(pickle_scan_t *scan, const char *line, size_t len, size_t avail) {
+	scan->line = line;
+	scan->len = len;
+	scan->avail = avail;
+	scan->block = (size_t)-1;
+}
+
+/**
+ * Classifies a block of the line, padding it if we can't read a whole block.
+ *
+ * @param scan  Line scanner.
+ * @param block Offset of the start of the block in the line.
+ */
+void pickle_scan_load(pickle_scan_t *scan, size_t block) {
+#ifdef PICKLE_HAS_SIMD
+	char pad[SCAN_BLOCK_LEN];
+
+	scan->block = block;
+	if ((scan->avail - block) >= SCAN_BLOCK_LEN) {
+		pickle_scan_classify(scan->line + block, scan->masks);
+		return;
+	}
+
+	memset(pad, '\0', SCAN_BLOCK_LEN);
+	memcpy(pad, scan->line + block, scan->len - block);
+	pickle_scan_classify(pad, scan->masks);
+#else
+	/* Without a vector unit we only look at the characters of the line. */
+	scan->block = block;
+	pickle_scan_classify_c(scan->line + block,
+						   ((scan->len - block) < SCAN_BLOCK_LEN) ?
+						   (scan->len - block) : SCAN_BLOCK_LEN, scan->masks);
+#endif /* PICKLE_HAS_SIMD */
+}
+
+/**
+ * Finds the next character that belongs to any of the requested classes.
+ *
+ * @param scan    Line scanner.
+ * @param pos     Position in the line to start looking from.
+ * @param classes Character classes (SCAN_*) to look for.
+ *
+ * @return Position of the character or the length of the line if none was
+ *         found.
+ */
+size_t pickle_scan_find(pickle_scan_t *scan, size_t pos, unsigned int classes) {
+	uint32_t mask;
+	size_t block;
+
+	while (pos < scan->len) {
+		/* Make sure the block is classified. */
+		block = pos - (pos % SCAN_BLOCK_LEN);
+		if (block != scan->block)
+			pickle_scan_load(scan, block);
+
+		/* Look for any of the classes from our position onwards. */
+		mask = SCAN_MASK(scan, classes) >> (pos - block);
+		if (mask != 0) {
+			pos += pickle_scan_ctz(mask);
+			return (pos < scan->len) ? pos : scan->len;
+		}
+
+		pos = block + SCAN_BLOCK_LEN;
+	}
+
+	return scan->len;
+}
+
+/**
+ * Skips over any characters that belong to the requested classes.
+ *
+ * @param scan    Line scanner.
+ * @param pos     Position in the line to start skipping from.
+ * @param classes Character classes (SCAN_*) to be skipped.
+ *
+ * @return Position of the first character that isn't in any of the classes or
+ *         the length of the line if there wasn't one.
+ */
+size_t pickle_scan_skip(pickle_scan_t *scan, size_t pos, unsigned int classes) {
+	uint32_t mask;
+	size_t block;
+
+	while (pos < scan->len) {
+		/* Make sure the block is classified. */
+		block = pos - (pos % SCAN_BLOCK_LEN);
+		if (block != scan->block)
+			pickle_scan_load(scan, block);
+
+		/* Look for anything outside the classes from our position onwards. */
+		mask = (uint32_t)~SCAN_MASK(scan, classes) >> (pos - block);
+		if (mask != 0) {
+			pos += pickle_scan_ctz(mask);
+			return (pos < scan->len) ? pos : scan->len;
+		}
+
+		pos = block + SCAN_BLOCK_LEN;
+	}
+
+	return scan->len;
+}
+
+/**
+ * Counts the whitespace separated words in a line straight from the masks.
+ *
+ * @param scan Line scanner.
+ *
+ * @return Number of words in the line.
+ */
+size_t pickle_scan_words(pickle_scan_t *scan) {
+	uint32_t wtspc;
+	uint32_t starts;
+	uint32_t carry;
+	size_t block;
+	size_t count;
+
+	/* A word starts wherever a non-whitespace follows a whitespace. */
+	count = 0;
+	carry = 1;
+	for (block = 0; block < scan->len; block += SCAN_BLOCK_LEN) {
+		pickle_scan_load(scan, block);
+		wtspc = scan->masks[0];
+		starts = ~wtspc & ((wtspc << 1) | carry);
+		carry = wtspc >> (SCAN_BLOCK_LEN - 1);
+
+		/* Ignore anything past the end of the line. */
+		if ((scan->len - block) < SCAN_BLOCK_LEN)
+			starts &= ((uint32_t)1 << (scan->len - block)) - 1;
+
+		count += pickle_util_popcount(starts);
+	}
+
+	return count;
+}
+
+/**
+ * Gets the next whitespace separated word in a line.
+ *
+ * @param scan Line scanner.
+ * @param pos  Position to start looking from. Will become the start of the
+ *             word.
+ * @param end  End of the word. (Exclusive)
+ *
+ * @return TRUE if a word was found. FALSE if we've reached the end of the line.
+ */
+bool pickle_scan_word(pickle_scan_t *scan, size_t *pos, size_t *end) {
+	*pos = pickle_scan_skip(scan, *pos, SCAN_WTSPC);
+	if (*pos == scan->len)
+		return false;
+
+	*end = pickle_scan_find(scan, *pos, SCAN_WTSPC);
+	return true;
+}
+
+/**
+ * Counts the trailing zeros of a non-zero mask.
+ *
+ * @param mask Mask to be checked.
+ *
+ * @return Position of the lowest bit that is set.
+ */
+unsigned int pickle_scan_ctz(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int)__builtin_ctz(mask);
+#else
+	unsigned int n;
+
+	for (n = 0; !(mask & 1); n++)
+		mask >>= 1;
+
+	return n;
+#endif /* __GNUC__ || __clang__ */
+}
+
+/**
+ * Classifies a block of characters into a bitmask per character class, using
+ * the widest vector unit that's available at runtime. The vector unit is only
+ * looked up the first time around.
+ *
+ * @param block Block of SCAN_BLOCK_LEN characters to be classified.
+ * @param masks Bitmasks of each class. (Bit N is set if character N is in it)
+ */
+void pickle_scan_classify(const char *block, uint32_t *masks) {
+#ifdef PICKLE_HAS_AVX2
+	void (*classify)(const char *block, uint32_t *masks);
+
+	/* Every thread comes to the same conclusion, so racing here is harmless. */
+	classify = __atomic_load_n(&pickle_scan_classifier, __ATOMIC_RELAXED);
+	if (classify == NULL) {
+		classify = (__builtin_cpu_supports("avx2")) ?
+			pickle_scan_classify_avx2 : pickle_scan_classify_sse2;
+		__atomic_store_n(&pickle_scan_classifier, classify, __ATOMIC_RELAXED);
+	}
+	classify(block, masks);
+#elif defined(PICKLE_HAS_SSE2)
+	pickle_scan_classify_sse2(block, masks);
+#elif defined(PICKLE_HAS_NEON)
+	pickle_scan_classify_neon(block, masks);
+#else
+	pickle_scan_classify_c(block, SCAN_BLOCK_LEN, masks);
+#endif /* PICKLE_HAS_AVX2 */
+}
+
+/**
+ * Classifies the characters of a block one at a time. This is the portable
+ * fallback for when there's no vector unit to do it for us.
+ *
+ * @param block Block of characters to be classified.
+ * @param len   Number of characters in the block. (Up to SCAN_BLOCK_LEN)
+ * @param masks Bitmasks of each class.
+ */
+void pickle_scan_classify_c(const char *block, size_t len, uint32_t *masks) {
+	size_t i;
+	uint32_t bit;
+
+	memset(masks, 0, SCAN_CLASSES * sizeof(uint32_t));
+	for (i = 0; i < len; i++) {
+		bit = (uint32_t)1 << i;
+		switch (block[i]) {
+			case ' ':
+			case '\t':
+				masks[0] |= bit;
+				break;
+			case ':':
+				masks[1] |= bit;
+				break;
+			case '"':
+				masks[2] |= bit;
+				break;
+			case ')':
+				masks[3] |= bit;
+				break;
+			case ']':
+				masks[4] |= bit;
+				break;
+		}
+	}
+}
+
+#ifdef PICKLE_HAS_SSE2
+/**
+ * Classifies a block of characters using SSE2.
+ *
+ * @param block Block of SCAN_BLOCK_LEN characters to be classified.
+ * @param masks Bitmasks of each class.
+ */
+void pickle_scan_classify_sse2(const char *block, uint32_t *masks) {
+	__m128i lo;
+	__m128i hi;
+
+	lo = _mm_loadu_si128((const __m128i *)block);
+	hi = _mm_loadu_si128((const __m128i *)(block + 16));
+
+#define SCAN_SSE2_MASK(v, c) \
+	((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8((v), _mm_set1_epi8(c))))
+#define SCAN_SSE2_CLASS(c) \
+	(SCAN_SSE2_MASK(lo, c) | (SCAN_SSE2_MASK(hi, c) << 16))
+	masks[0] = SCAN_SSE2_CLASS(' ') | SCAN_SSE2_CLASS('\t');
+	masks[1] = SCAN_SSE2_CLASS(':');
+	masks[2] = SCAN_SSE2_CLASS('"');
+	masks[3] = SCAN_SSE2_CLASS(')');
+	masks[4] = SCAN_SSE2_CLASS(']');
+#undef SCAN_SSE2_CLASS
+#undef SCAN_SSE2_MASK
+}
+#endif /* PICKLE_HAS_SSE2 */
+
+#ifdef PICKLE_HAS_AVX2
+/**
+ * Classifies a block of characters using AVX2.
+ *
+ * @param block Block of SCAN_BLOCK_LEN characters to be classified.
+ * @param masks Bitmasks of each class.
+ */
+__attribute__((target("avx2")))
+void pickle_scan_classify_avx2(const char *block, uint32_t *masks) {
+	__m256i v;
+
+	v = _mm256_loadu_si256((const __m256i *)block);
+
+#define SCAN_AVX2_CLASS(c) \
+	((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))))
+	masks[0] = SCAN_AVX2_CLASS(' ') | SCAN_AVX2_CLASS('\t');
+	masks[1] = SCAN_AVX2_CLASS(':');
+	masks[2] = SCAN_AVX2_CLASS('"');
+	masks[3] = SCAN_AVX2_CLASS(')');
+	masks[4] = SCAN_AVX2_CLASS(']');
+#undef SCAN_AVX2_CLASS
+}
+#endif /* PICKLE_HAS_AVX2 */
+
+#ifdef PICKLE_HAS_NEON
+/**
+ * Classifies a block of characters using NEON. Since there's no movemask we
+ * weigh each lane by its bit and add them up pairwise.
+ *
+ * @param block Block of SCAN_BLOCK_LEN characters to be classified.
+ * @param masks Bitmasks of each class.
+ */
+void pickle_scan_classify_neon(const char *block, uint32_t *masks) {
+	static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+										 1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t w;
+	uint8x16_t lo;
+	uint8x16_t hi;
+
+	w = vld1q_u8(weights);
+	lo = vld1q_u8((const uint8_t *)block);
+	hi = vld1q_u8((const uint8_t *)(block + 16));
+
+#define SCAN_NEON_EQ(v, c) vandq_u8(vceqq_u8((v), vdupq_n_u8(c)), w)
+#define SCAN_NEON_MASK(v, c) pickle_scan_neon_mask(SCAN_NEON_EQ(v, c))
+#define SCAN_NEON_CLASS(c) \
+	(SCAN_NEON_MASK(lo, c) | (SCAN_NEON_MASK(hi, c) << 16))
+	masks[0] = SCAN_NEON_CLASS(' ') | SCAN_NEON_CLASS('\t');
+	masks[1] = SCAN_NEON_CLASS(':');
+	masks[2] = SCAN_NEON_CLASS('"');
+	masks[3] = SCAN_NEON_CLASS(')');
+	masks[4] = SCAN_NEON_CLASS(']');
+#undef SCAN_NEON_CLASS
+#undef SCAN_NEON_MASK
+#undef SCAN_NEON_EQ
+}
+
+/**
+ * Folds the weighed lanes of a NEON comparison into a 16-bit mask.
+ *
+ * @param v Comparison result with each lane weighed by its bit.
+ *
+ * @return Mask with bit N set if lane N matched.
+ */
+uint32_t pickle_scan_neon_mask(uint8x16_t v) {
+	uint8x8_t sum;
+
+	sum = vpadd_u8(vget_low_u8(v), vget_high_u8(v));
+	sum = vpadd_u8(sum, sum);
+	sum = vpadd_u8(sum, sum);
+
+	return (uint32_t)vget_lane_u8(sum, 0) |
+		((uint32_t)vget_lane_u8(sum, 1) << 8);
+}
+#endif /* PICKLE_HAS_NEON */
+
+/**
+ * Sets the last error that the user can recall later.
+ *
+ * @param code Error code that's about to be returned.
+ * @param msg  Error message to be set.
+ */
+void pickle_error_set(pickle_err_t code, const char *msg) {
+	pickle_error_state.code = code;
+	pickle_error_state.line = 0;
+	pickle_error_state.column = 0;
+	pickle_error_state.offset = 0;
+
+	/* Copy the error message. */
+	strncpy(pickle_error_state.msg, msg, PICKLE_ERROR_MSG_LEN - 1);
+	pickle_error_state.msg[PICKLE_ERROR_MSG_LEN - 1] = '\0';
+}
+
+/**
+ * Sets the last error that the user can later recall using a syntax akin to
+ * printf.
+ *
+ * @param code   Error code that's about to be returned.
+ * @param format Format string just like in printf.
+ * @param ...    Things to place inside the formatted string.
+ */
+void pickle_error_format(pickle_err_t code, const char *format, ...) {
+	va_list args;
+
+	pickle_error_state.code = code;
+	pickle_error_state.line = 0;
+	pickle_error_state.column = 0;
+	pickle_error_state.offset = 0;
+
+	/* Copy our formatted message. (Truncated if it's too long) */
+	va_start(args, format);
+	vsnprintf(pickle_error_state.msg, PICKLE_ERROR_MSG_LEN, format, args);
+	va_end(args);
+	pickle_error_state.msg[PICKLE_ERROR_MSG_LEN - 1] = '\0';
+}
+
+/**
+ * Sets the column of the line where the last error happened.
+ *
+ * @param column Column (1-based byte index) inside the line.
+ */
+void pickle_error_col(size_t column) {
+	pickle_error_state.column = column;
+}
+
+/**
+ * Attaches the location of the last line read by a reader to the last error.
+ *
+ * @param rd Line reader that was used to read the offending line.
+ */
+void pickle_error_loc(const pickle_reader_t *rd) {
+	pickle_error_state.line = rd->line;
+	pickle_error_state.offset = rd->lstart;
+	if (pickle_error_state.column > 0)
+		pickle_error_state.offset += pickle_error_state.column - 1;
+}
+
+/**
+ * Gets the last error that happened in the calling thread.
+ *
+ * @return A read-only pointer to the last error record. Its code is PICKLE_OK
+ *         if nothing went wrong yet.
+ */
+const pickle_error_t *pickle_error_last(void) {
+	return &pickle_error_state;
+}
+
+/**
+ * Forgets about the last error that happened in the calling thread.
+ */
+void pickle_error_clear(void) {
+	pickle_error_state.code = PICKLE_OK;
+	pickle_error_state.line = 0;
+	pickle_error_state.column = 0;
+	pickle_error_state.offset = 0;
+	pickle_error_state.msg[0] = '\0';
+}
+
+/**
+ * Gets the last error message string of the calling thread.
+ *
+ * @return A read-only pointer to the last error message or NULL if there
+ *         hasn't been any errors.
+ */
+const char *pickle_error_msg(void) {
+	if (pickle_error_state.code == PICKLE_OK)
+		return NULL;
+
+	return (const char *)pickle_error_state.msg;
+}
+
+/**
+ * Prints the last error message thrown by the library to STDERR.
+ */
+void pickle_error_print(void) {
+	const pickle_error_t *err;
+
+	/* Include the location of parsing errors. */
+	err = &pickle_error_state;
+	if ((err->line > 0) && (err->column > 0)) {
+		fprintf(stderr, "ERROR: %s (line %lu, column %lu)\n", err->msg,
+				(unsigned long)err->line, (unsigned long)err->column);
+	} else if (err->line > 0) {
+		fprintf(stderr, "ERROR: %s (line %lu)\n", err->msg,
+				(unsigned long)err->line);
+	} else {
+		fprintf(stderr, "ERROR: %s\n", err->msg);
+	}
+}
+
+/**
+ * Checks if a string only contains whitespace.
+ *
+ * @param buf String to be checked.
+ * @param len Length of the string.
+ *
+ * @return Does this string consists only of whitespace?
+ */
+bool pickle_util_iswtspc(const char *buf, size_t len) {
+	pickle_scan_t scan;
+
+	/* Most lines don't even start with whitespace. */
+	if ((len == 0) || ((buf[0] != ' ') && (buf[0] != '\t')))
+		return len == 0;
+
+	pickle_scan_init(&scan, buf, len, len);
+	return pickle_scan_skip(&scan, 0, SCAN_WTSPC) == len;
+}
+
+/**
+ * Counts the bits that are set in a mask.
+ *
+ * @param mask Mask to be checked.
+ *
+ * @return Number of bits set.
+ */
+unsigned int pickle_util_popcount(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int)__builtin_popcount(mask);
+#else
+	unsigned int n;
+
+	for (n = 0; mask != 0; n++)
+		mask &= mask - 1;
+
+	return n;
+#endif /* __GNUC__ || __clang__ */
+}
+
+/**
+ * Allocates a block of memory.
+ *
+ * @param allocator Allocator to get the memory from. (NULL for the global one)
+ * @param size      Number of bytes to allocate.
+ *
+ * @return Allocated block of memory or NULL if we ran out of memory.
+ */
+void *pickle_mem_alloc(const pickle_allocator_t *allocator, size_t size) {
+	void *ptr;
+
+	if (allocator == NULL)
+		allocator = &pickle_allocator_global;
+
+	ptr = allocator->alloc(size, allocator->ctx);
+	STATS_ALLOC(ptr, size);
+
+	return ptr;
+}
+
+/**
+ * Allocates a zeroed out array.
+ *
+ * @param allocator Allocator to get the memory from. (NULL for the global one)
+ * @param nmemb     Number of items in the array.
+ * @param size      Size of a single item.
+ *
+ * @return Allocated array or NULL if we ran out of memory.
+ */
+void *pickle_mem_calloc(const pickle_allocator_t *allocator, size_t nmemb, size_t size) {
+	void *ptr;
+
+	/* Guard against overflows. */
+	if ((size != 0) && (nmemb > ((size_t)-1 / size)))
+		return NULL;
+
+	ptr = pickle_mem_alloc(allocator, nmemb * size);
+	if (ptr != NULL)
+		memset(ptr, 0, nmemb * size);
+
+	return ptr;
+}
+
+/**
+ * Resizes a block of memory.
+ *
+ * @param allocator Allocator that owns the memory. (NULL for the global one)
+ * @param ptr       Block to be resized. NULL behaves like pickle_mem_alloc.
+ * @param size      New size of the block in bytes.
+ *
+ * @return Resized block of memory or NULL if we ran out of memory, in which
+ *         case the original block is left untouched.
+ */
+void *pickle_mem_realloc(const pickle_allocator_t *allocator, void *ptr, size_t size) {
+	if (allocator == NULL)
+		allocator = &pickle_allocator_global;
+
+	/* A resize counts as a whole new block, since it may have to move. */
+	ptr = allocator->realloc(ptr, size, allocator->ctx);
+	STATS_ALLOC(ptr, size);
+
+	return ptr;
+}
+
+/**
+ * Frees up a block of memory.
+ *
+ * @param allocator Allocator that owns the memory. (NULL for the global one)
+ * @param ptr       Block to be free'd. Can be NULL.
+ */
+void pickle_mem_free(const pickle_allocator_t *allocator, void *ptr) {
+	if (ptr == NULL)
+		return;
+	if (allocator == NULL)
+		allocator = &pickle_allocator_global;
+
+	allocator->free(ptr, allocator->ctx);
+}
+
+/**
+ * Default allocation function that simply uses malloc.
+ *
+ * @param size Number of bytes to allocate.
+ * @param ctx  Unused.
+ *
+ * @return Allocated block of memory or NULL if we ran out of memory.
+ */
+void *pickle_mem_default_alloc(size_t size, void *ctx) {
+	(void)ctx;
+	return malloc(size);
+}
+
+/**
+ * Default reallocation function that simply uses realloc.
+ *
+ * @param ptr  Block to be resized.
+ * @param size New size of the block in bytes.
+ * @param ctx  Unused.
+ *
+ * @return Resized block of memory or NULL if we ran out of memory.
+ */
+void *pickle_mem_default_realloc(void *ptr, size_t size, void *ctx) {
+	(void)ctx;
+	return realloc(ptr, size);
+}
+
+/**
+ * Default deallocation function that simply uses free.
+ *
+ * @param ptr Block to be free'd.
+ * @param ctx Unused.
+ */
+void pickle_mem_default_free(void *ptr, void *ctx) {
+	(void)ctx;
+	free(ptr);
+}
+
+/**
+ * Makes sure a dynamic array has room for at least a number of items, growing
+ * its capacity geometrically so that appending is amortized O(1).
+ *
+ * @param allocator Allocator that owns the array. (NULL for the global one)
+ * @param arr       Array to be grown. (Will be reallocated by this function.)
+ * @param cap       Current capacity of the array. (Updated by this function.)
+ * @param need      Number of items the array must be able to hold.
+ * @param size      Size of a single item.
+ *
+ * @return TRUE if the array has enough room. FALSE if we ran out of memory, in
+ *         which case the array is left untouched.
+ */
+bool pickle_util_grow(const pickle_allocator_t *allocator, void **arr, size_t *cap, size_t need, size_t size) {
+	size_t ncap;
+	void *narr;
+
+	/* Do we even need to grow? */
+	if (need <= *cap)
+		return true;
+
+	/* Double the capacity until it's enough. */
+	ncap = (*cap < COLLECTION_MIN_CAP) ? COLLECTION_MIN_CAP : *cap;
+	while (ncap < need)
+		ncap *= 2;
+
+	/* Reallocate the array. */
+	narr = pickle_mem_realloc(allocator, *arr, ncap * size);
+	if (narr == NULL)
+		return false;
+
+	*arr = narr;
+	*cap = ncap;
+	return true;
+}
+
+/**
+ * Hashes a string using the 32-bit FNV-1a algorithm.
+ *
+ * @param str String to be hashed. (Doesn't need to be NULL terminated)
+ * @param len Length of the string.
+ *
+ * @return Hash of the string.
+ */
+uint32_t pickle_util_hash(const char *str, size_t len) {
+	uint32_t hash;
+	size_t i;
+
+	hash = (uint32_t)HASH_FNV_OFFSET;
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= (uint32_t)HASH_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * Continues a FNV-1a hash over another piece of data. Useful for hashing data
+ * that doesn't fit in memory all at once.
+ *
+ * @param hash Hash of the data that came before.
+ * @param str  Data to be hashed.
+ * @param len  Length of the data.
+ *
+ * @return Hash of everything so far.
+ */
+uint32_t pickle_util_hashcont(uint32_t hash, const char *str, size_t len) {
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= (uint32_t)HASH_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * Hashes the entire contents of a file.
+ *
+ * @param fname Path to the file.
+ * @param hash  FNV-1a hash of the file's contents.
+ * @param len   Size of the file.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         file couldn't be read. PICKLE_ERROR_MEMORY if we ran out of memory.
+ */
+pickle_err_t pickle_util_hashfile(const char *fname, uint32_t *hash, size_t *len) {
+	FILE *fh;
+	char *buf;
+	size_t nread;
+	pickle_err_t err;
+
+	/* Open the file. */
+	fh = fopen(fname, "rb");
+	if (fh == NULL) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't open file "
+							"\"%s\": %s."), fname, strerror(errno));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Allocate the block buffer. */
+	buf = (char *)pickle_mem_alloc(NULL, READBUF_BLOCK_LEN * sizeof(char));
+	if (buf == NULL) {
+		fclose(fh);
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "hashing buffer."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Hash the file block by block. */
+	err = PICKLE_OK;
+	*hash = (uint32_t)HASH_FNV_OFFSET;
+	*len = 0;
+	while ((nread = fread(buf, sizeof(char), READBUF_BLOCK_LEN, fh)) > 0) {
+		*hash = pickle_util_hashcont(*hash, buf, nread);
+		*len += nread;
+	}
+	if (ferror(fh)) {
+		pickle_error_format(PICKLE_ERROR_FILE,
+							EMSG("Couldn't read file \"%s\"."), fname);
+		err = PICKLE_ERROR_FILE;
+	}
+
+	pickle_mem_free(NULL, buf);
+	fclose(fh);
+
+	return err;
+}
+
+/**
+ * Gets the size and modification time of a file without reading it.
+ *
+ * @param fname Path to the file.
+ * @param len   Size of the file.
+ * @param mtime Modification time of the file in seconds since the epoch.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         file couldn't be queried. PICKLE_ERROR_NOT_IMPL if files can't be
+ *         queried on this platform.
+ */
+pickle_err_t pickle_util_stat(const char *fname, size_t *len, uint32_t *mtime) {
+#ifdef PICKLE_HAS_STAT
+	STAT_T st;
+
+	if (STAT(fname, &st) != 0) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't query file "
+							"\"%s\": %s."), fname, strerror(errno));
+		return PICKLE_ERROR_FILE;
+	}
+
+	*len = (size_t)st.st_size;
+	*mtime = (uint32_t)st.st_mtime;
+	return PICKLE_OK;
+#else
+	(void)fname;
+	(void)len;
+	(void)mtime;
+
+	pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("Querying files isn't "
+					 "supported on this platform."));
+	return PICKLE_ERROR_NOT_IMPL;
+#endif /* PICKLE_HAS_STAT */
+}
+
+/**
+ * Similar to strcpy except we allocate (reallocate if needed) the destination
+ * string automatically.
+ *
+ * @warning This function will allocate memory for dest. Make sure you free this
+ *          string later.
+ *
+ * @param dest Destination string. (Will be [re]allocated by this function.)
+ * @param src  Source string to be copied.
+ *
+ * @return Number of bytes copied.
+ */
+size_t pickle_util_strcpy(char **dest, const char *src) {
+	size_t len;
+
+	/* Check if we have a valid destination pointer. */
+	if (dest == NULL)
+		return 0;
+
+	/* Allocate space for the new string. */
+	len = strlen(src);
+	*dest = (char *)pickle_mem_realloc(NULL, *dest, (len + 1) * sizeof(char));
+
+	/* Copy the new string over. (Including the terminator) */
+	memcpy(*dest, src, len + 1);
+
+	return len;
+}
+
+/**
+ * Puts an arena allocator in its initial state. Chunks are only allocated when
+ * something is first placed in the arena.
+ *
+ * @param arena Arena to be initialized.
+ */
+void pickle_arena_init(pickle_arena_t *arena) {
+	arena->head = NULL;
+	arena->cur = NULL;
+	arena->allocator = NULL;
+}
+
+/**
+ * Allocates a block of memory from an arena. Everything allocated from an arena
+ * lives until the arena itself is free'd.
+ *
+ * @param arena Arena to allocate the memory from.
+ * @param size  Number of bytes to allocate.
+ *
+ * @return Pointer to the allocated memory or NULL if we ran out of memory.
+ *
+ * @see pickle_arena_free
+ */
+void *pickle_arena_alloc(pickle_arena_t *arena, size_t size) {
+	pickle_arena_chunk_t *chunk;
+	pickle_arena_chunk_t *next;
+	size_t csize;
+	void *ptr;
+
+	/* Keep every allocation aligned. */
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	/* Move on to another chunk if the current one is full. */
+	chunk = arena->cur;
+	if ((chunk == NULL) || ((chunk->used + size) > chunk->size)) {
+		next = (chunk == NULL) ? arena->head : chunk->next;
+		if ((next != NULL) && (size <= next->size)) {
+			/* Reuse a chunk that was kept around by a reset. */
+			chunk = next;
+		} else {
+			/* Get a brand new chunk. */
+			csize = (size > ARENA_CHUNK_LEN) ? size : ARENA_CHUNK_LEN;
+			chunk = (pickle_arena_chunk_t *)pickle_mem_alloc(arena->allocator,
+				ARENA_HEADER_LEN + csize);
+			if (chunk == NULL)
+				return NULL;
+			chunk->size = csize;
+			chunk->used = 0;
+
+			/* Place it right after the current one. */
+			chunk->next = next;
+			if (arena->cur == NULL) {
+				arena->head = chunk;
+			} else {
+				arena->cur->next = chunk;
+			}
+		}
+		arena->cur = chunk;
+	}
+
+	/* Carve our block out of the chunk. */
+	ptr = (char *)chunk + ARENA_HEADER_LEN + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+/**
+ * Copies a string that isn't necessarily NULL terminated into an arena. The
+ * copy will always be NULL terminated.
+ *
+ * @param arena Arena to place the copy in.
+ * @param str   String to be copied.
+ * @param len   Number of characters to copy.
+ *
+ * @return The arena-owned copy of the string or NULL if we ran out of memory.
+ */
+char *pickle_arena_strndup(pickle_arena_t *arena, const char *str, size_t len) {
+	char *dest;
+
+	dest = (char *)pickle_arena_alloc(arena, len + 1);
+	if (dest == NULL)
+		return NULL;
+
+	memcpy(dest, str, len);
+	dest[len] = '\0';
+
+	return dest;
+}
+
+/**
+ * Takes note of the current position of an arena, so that everything allocated
+ * after this point can be thrown away later.
+ *
+ * @param arena Arena to have its position noted.
+ * @param mark  Where to store the position of the arena.
+ *
+ * @see pickle_arena_release
+ */
+void pickle_arena_mark(pickle_arena_t *arena, pickle_arena_mark_t *mark) {
+	mark->chunk = arena->cur;
+	mark->used = (arena->cur != NULL) ? arena->cur->used : 0;
+}
+
+/**
+ * Throws away everything that was allocated from an arena since a mark was
+ * taken. The chunks are kept around to be reused.
+ *
+ * @param arena Arena to be rewound.
+ * @param mark  Position the arena should go back to.
+ *
+ * @see pickle_arena_mark
+ */
+void pickle_arena_release(pickle_arena_t *arena, const pickle_arena_mark_t *mark) {
+	pickle_arena_chunk_t *chunk;
+
+	/* Empty every chunk that came after the mark. */
+	chunk = (mark->chunk != NULL) ? mark->chunk->next : arena->head;
+	for (; chunk != NULL; chunk = chunk->next)
+		chunk->used = 0;
+
+	/* Rewind to the mark. */
+	arena->cur = mark->chunk;
+	if (mark->chunk != NULL)
+		mark->chunk->used = mark->used;
+}
+
+/**
+ * Throws away everything that was allocated from an arena while keeping its
+ * chunks around to be reused.
+ *
+ * @param arena Arena to be reset.
+ */
+void pickle_arena_reset(pickle_arena_t *arena) {
+	pickle_arena_chunk_t *chunk;
+
+	for (chunk = arena->head; chunk != NULL; chunk = chunk->next)
+		chunk->used = 0;
+
+	arena->cur = NULL;
+}
+
+/**
+ * Takes over every chunk that's in use by another arena, which is left empty.
+ * Anything allocated from the other arena will now live and die with this one.
+ *
+ * @param arena Arena that will own the chunks.
+ * @param other Arena to take the chunks from.
+ */
+void pickle_arena_adopt(pickle_arena_t *arena, pickle_arena_t *other) {
+	pickle_arena_chunk_t *chunk;
+	pickle_arena_chunk_t *next;
+
+	/* Chunks the other arena kept around for reuse aren't worth taking. */
+	if (other->cur != NULL) {
+		chunk = other->cur->next;
+		other->cur->next = NULL;
+	} else {
+		chunk = other->head;
+	}
+	for (; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		pickle_mem_free(other->allocator, chunk);
+	}
+
+	/* Splice the used chunks in right before the ones we're free to reuse. */
+	if (other->cur != NULL) {
+		if (arena->cur == NULL) {
+			other->cur->next = arena->head;
+			arena->head = other->head;
+		} else {
+			other->cur->next = arena->cur->next;
+			arena->cur->next = other->head;
+		}
+		arena->cur = other->cur;
+	}
+
+	other->head = NULL;
+	other->cur = NULL;
+}
+
+/**
+ * Frees up every chunk of an arena at once.
+ *
+ * @param arena Arena to be free'd.
+ */
+void pickle_arena_free(pickle_arena_t *arena) {
+	pickle_arena_chunk_t *chunk;
+	pickle_arena_chunk_t *next;
+
+	for (chunk = arena->head; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		pickle_mem_free(arena->allocator, chunk);
+	}
+
+	arena->head = NULL;
+	arena->cur = NULL;
+}
+
+/**
+ * Puts a string interning table in its initial state. The table is only
+ * allocated when the first string gets interned.
+ *
+ * @param tab String table to be initialized.
+ */
+void pickle_strtab_init(pickle_strtab_t *tab) {
+	tab->entries = NULL;
+	tab->len = 0;
+	tab->cap = 0;
+}
+
+/**
+ * Interns a string in a string table. The canonical copy of the string is
+ * placed in an arena the first time it's seen.
+ *
+ * @param tab       String table to intern the string in.
+ * @param allocator Allocator that owns the table. (NULL for the global one)
+ * @param arena     Arena to place the canonical copies in. If NULL the string
+ *                  itself becomes the canonical copy, so it must be NULL
+ *                  terminated and live as long as the table.
+ * @param str       String to be interned.
+ * @param len       Length of the string.
+ *
+ * @return Canonical NULL terminated copy of the string or NULL if we ran out
+ *         of memory.
+ */
+const char *pickle_strtab_intern(pickle_strtab_t *tab, const pickle_allocator_t *allocator, pickle_arena_t *arena, const char *str, size_t len) {
+	pickle_strtab_entry_t *entries;
+	pickle_strtab_entry_t *entry;
+	uint32_t hash;
+	size_t mask;
+	size_t ncap;
+	size_t i;
+	size_t j;
+
+	/* Keep the table at most half full. */
+	if ((tab->len + 1) > (tab->cap / 2)) {
+		ncap = (tab->cap == 0) ? STRTAB_MIN_CAP : tab->cap * 2;
+		entries = (pickle_strtab_entry_t *)pickle_mem_calloc(allocator, ncap,
+			sizeof(pickle_strtab_entry_t));
+		if (entries == NULL)
+			return NULL;
+
+		/* Rehash every entry we already had. */
+		for (i = 0; i < tab->cap; i++) {
+			if (tab->entries[i].str == NULL)
+				continue;
+
+			j = tab->entries[i].hash & (ncap - 1);
+			while (entries[j].str != NULL)
+				j = (j + 1) & (ncap - 1);
+			entries[j] = tab->entries[i];
+		}
+
+		if (tab->entries != NULL)
+			pickle_mem_free(allocator, tab->entries);
+		tab->entries = entries;
+		tab->cap = ncap;
+	}
+
+	/* Look for the string using linear probing. */
+	hash = pickle_util_hash(str, len);
+	mask = tab->cap - 1;
+	for (i = hash & mask; tab->entries[i].str != NULL; i = (i + 1) & mask) {
+		entry = &tab->entries[i];
+		if ((entry->hash == hash) && (entry->len == len) &&
+				(memcmp(entry->str, str, len) == 0)) {
+			return entry->str;
+		}
+	}
+
+	/* First time we've seen this string. */
+	entry = &tab->entries[i];
+	entry->str = (arena != NULL) ? pickle_arena_strndup(arena, str, len) : str;
+	if (entry->str == NULL)
+		return NULL;
+	entry->len = len;
+	entry->hash = hash;
+	tab->len++;
+
+	return entry->str;
+}
+
+/**
+ * Empties a string table while keeping its memory around.
+ *
+ * @param tab String table to be emptied.
+ */
+void pickle_strtab_clear(pickle_strtab_t *tab) {
+	size_t i;
+
+	for (i = 0; i < tab->cap; i++)
+		tab->entries[i].str = NULL;
+	tab->len = 0;
+}
+
+/**
+ * Frees up a string table. The strings themselves live in an arena.
+ *
+ * @param tab       String table to be free'd.
+ * @param allocator Allocator that owns the table. (NULL for the global one)
+ */
+void pickle_strtab_free(pickle_strtab_t *tab, const pickle_allocator_t *allocator) {
+	if (tab->entries != NULL)
+		pickle_mem_free(allocator, tab->entries);
+	pickle_strtab_init(tab);
+}
+
+/**
+ * Puts a collection index in its initial state. The slots are only allocated
+ * when the index is first built.
+ *
+ * @param idx Index to be initialized.
+ */
+void pickle_index_init(pickle_index_t *idx) {
+	idx->slots = NULL;
+	idx->cap = 0;
+	idx->valid = false;
+}
+
+/**
+ * Empties an index and makes sure it has room for a number of items while
+ * staying at most half full. Slots hold the position of an item in the
+ * collection plus one, so that zero means empty.
+ *
+ * @param idx       Index to be emptied.
+ * @param allocator Allocator that owns the index. (NULL for the global one)
+ * @param len       Number of items that will be indexed.
+ *
+ * @return TRUE if the index is ready to be filled. FALSE if we ran out of
+ *         memory.
+ */
+bool pickle_index_reset(pickle_index_t *idx, const pickle_allocator_t *allocator, size_t len) {
+	/* Grow the slots if needed. */
+	idx->valid = false;
+	if (!pickle_index_grow(allocator, (void **)&idx->slots, &idx->cap, len,
+						   sizeof(size_t))) {
+		return false;
+	}
+
+	memset(idx->slots, 0, idx->cap * sizeof(size_t));
+	return true;
+}
+
+/**
+ * Makes sure the slots of a hash table have room for a number of items while
+ * staying at most half full. Unlike pickle_util_grow the contents aren't kept,
+ * since tables get rebuilt from scratch anyway.
+ *
+ * @param allocator Allocator that owns the slots. (NULL for the global one)
+ * @param slots     Slots to be grown. (Will be reallocated by this function.)
+ * @param cap       Number of slots, always a power of two. (Updated by this
+ *                  function.)
+ * @param len       Number of items that will be placed in the table.
+ * @param size      Size of a single slot.
+ *
+ * @return TRUE if the table has enough room. FALSE if we ran out of memory, in
+ *         which case the slots are left untouched.
+ */
+bool pickle_index_grow(const pickle_allocator_t *allocator, void **slots, size_t *cap, size_t len, size_t size) {
+	size_t ncap;
+	void *nslots;
+
+	/* Double the capacity until it's enough. */
+	ncap = (*cap == 0) ? INDEX_MIN_CAP : *cap;
+	while ((len + 1) > (ncap / 2))
+		ncap *= 2;
+	if (ncap == *cap)
+		return true;
+
+	/* Replace the slots. */
+	nslots = pickle_mem_alloc(allocator, ncap * size);
+	if (nslots == NULL)
+		return false;
+	if (*slots != NULL)
+		pickle_mem_free(allocator, *slots);
+	*slots = nslots;
+	*cap = ncap;
+
+	return true;
+}
+
+/**
+ * Frees up the slots of an index.
+ *
+ * @param idx       Index to be free'd.
+ * @param allocator Allocator that owns the index. (NULL for the global one)
+ */
+void pickle_index_free(pickle_index_t *idx, const pickle_allocator_t *allocator) {
+	if (idx->slots != NULL)
+		pickle_mem_free(allocator, idx->slots);
+	pickle_index_init(idx);
+}
+
+/**
+ * Puts a reference designator index in its initial state. The entries are only
+ * allocated when the index is first built.
+ *
+ * @param idx Index to be initialized.
+ */
+void pickle_refdes_index_init(pickle_refdes_index_t *idx) {
+	idx->entries = NULL;
+	idx->cap = 0;
+	idx->valid = false;
+}
+
+/**
+ * Frees up the entries of a reference designator index.
+ *
+ * @param idx       Index to be free'd.
+ * @param allocator Allocator that owns the index. (NULL for the global one)
+ */
+void pickle_refdes_index_free(pickle_refdes_index_t *idx, const pickle_allocator_t *allocator) {
+	if (idx->entries != NULL)
+		pickle_mem_free(allocator, idx->entries);
+	pickle_refdes_index_init(idx);
+}
+
+/**
+ * Runs a job over a range of items on a pool of worker threads. The items are
+ * split evenly between the workers, and workers that run out of items steal
+ * half of what's left from the others. The calling thread is one of the
+ * workers.
+ *
+ * @param len     Number of items.
+ * @param threads Number of workers to use. 0 uses one per processor core.
+ * @param run     Function that processes a single item.
+ * @param ctx     Job context that's available to the workers.
+ * @param flags   Job flags that are available to the workers.
+ *
+ * @return PICKLE_OK if the job was run. PICKLE_ERROR_MEMORY if we couldn't
+ *         allocate the workers.
+ */
+pickle_err_t pickle_worker_run(size_t len, unsigned int threads, void (*run)(pickle_worker_t *worker, size_t index), void *ctx, unsigned int flags) {
+	pickle_worker_t *workers;
+	size_t count;
+	size_t per;
+	size_t i;
+
+	/* Check if we have anything to do. */
+	if (len == 0)
+		return PICKLE_OK;
+
+	/* Figure out how many workers we need. */
+	if (threads == 0)
+		threads = pickle_worker_cores();
+	count = (threads > len) ? len : threads;
+#ifndef PICKLE_HAS_THREADS
+	count = 1;
+#endif /* !PICKLE_HAS_THREADS */
+
+	/* Allocate the workers. */
+	workers = (pickle_worker_t *)pickle_mem_alloc(NULL, count * sizeof(pickle_worker_t));
+	if (workers == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "worker threads."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Split the items evenly between them. */
+	per = len / count;
+	for (i = 0; i < count; i++) {
+		workers[i].run = run;
+		workers[i].ctx = ctx;
+		workers[i].flags = flags;
+		workers[i].workers = workers;
+		workers[i].len_workers = count;
+		workers[i].next = i * per;
+		workers[i].end = (i == (count - 1)) ? len : (i + 1) * per;
+		MUTEX_INIT(&workers[i].lock);
+		workers[i].doc = NULL;
+		workers[i].running = false;
+	}
+
+	/* Start the workers. (If a thread can't be started others pick up) */
+	for (i = 1; i < count; i++)
+		workers[i].running = pickle_worker_start(&workers[i]);
+	pickle_worker_loop(&workers[0]);
+
+	/* Wait for everyone to finish, since anyone may still steal from others. */
+	for (i = 1; i < count; i++) {
+		if (workers[i].running)
+			pickle_worker_join(&workers[i]);
+	}
+
+	/* Clean up. */
+	for (i = 0; i < count; i++) {
+		if (workers[i].doc != NULL)
+			pickle_doc_free(workers[i].doc);
+		MUTEX_FREE(&workers[i].lock);
+	}
+	pickle_mem_free(NULL, workers);
+
+	return PICKLE_OK;
+}
+
+/**
+ * Worker loop. Processes items until there's nothing left to take or steal.
+ *
+ * @param worker Worker thread.
+ */
+void pickle_worker_loop(pickle_worker_t *worker) {
+	size_t index;
+
+	while (pickle_worker_take(worker, &index))
+		worker->run(worker, index);
+}
+
+/**
+ * Takes the next item out of a worker's own range, stealing half of the range
+ * of another worker if its own is empty.
+ *
+ * @param worker Worker thread.
+ * @param index  Index of the item that was taken.
+ *
+ * @return TRUE if an item was taken. FALSE if there's nothing left to do.
+ */
+bool pickle_worker_take(pickle_worker_t *worker, size_t *index) {
+	pickle_worker_t *victim;
+	size_t start;
+	size_t end;
+	size_t i;
+
+	/* Try our own range first. */
+	MUTEX_LOCK(&worker->lock);
+	if (worker->next < worker->end) {
+		*index = worker->next++;
+		MUTEX_UNLOCK(&worker->lock);
+		return true;
+	}
+	MUTEX_UNLOCK(&worker->lock);
+
+	/* Steal the back half of the range of the first worker that has any. */
+	for (i = 1; i < worker->len_workers; i++) {
+		victim = &worker->workers[((worker - worker->workers) + i) %
+								  worker->len_workers];
+
+		MUTEX_LOCK(&victim->lock);
+		start = victim->end;
+		end = victim->end;
+		if (victim->next < victim->end) {
+			start = victim->end - ((victim->end - victim->next + 1) / 2);
+			victim->end = start;
+		}
+		MUTEX_UNLOCK(&victim->lock);
+
+		/* Take the first stolen item and keep the rest for later. */
+		if (start < end) {
+			MUTEX_LOCK(&worker->lock);
+			worker->next = start + 1;
+			worker->end = end;
+			MUTEX_UNLOCK(&worker->lock);
+
+			*index = start;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Parses a single batch item and stores its result.
+ *
+ * @param worker Worker thread.
+ * @param index  Index of the item to be parsed.
+ */
+void pickle_batch_item(pickle_worker_t *worker, size_t index) {
+	pickle_batch_item_t *item;
+	pickle_doc_t *doc;
+	bool keep;
+	pickle_err_t err;
+
+	/* Get a document to parse into. */
+	item = &((pickle_batch_item_t *)worker->ctx)[index];
+	pickle_error_clear();
+	item->doc = NULL;
+	keep = (worker->flags & PICKLE_FLAG_KEEP) != 0;
+	if (keep || (worker->doc == NULL)) {
+		doc = pickle_doc_new();
+		if (doc == NULL) {
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate a "
+							 "document."));
+			item->err = PICKLE_ERROR_MEMORY;
+			item->error = *pickle_error_last();
+			return;
+		}
+		if (!keep)
+			worker->doc = doc;
+	} else {
+		doc = worker->doc;
+	}
+	doc->flags = worker->flags & ~PICKLE_FLAG_KEEP;
+
+	/* Open the source and parse it. */
+	if (item->fname != NULL) {
+#ifdef PICKLE_HAS_MMAP
+		err = pickle_doc_mmap(doc, item->fname);
+#else
+		err = pickle_doc_fopen(doc, item->fname, "r");
+#endif /* PICKLE_HAS_MMAP */
+	} else {
+		err = pickle_doc_open_mem(doc, item->buf, item->len);
+	}
+	if (err == PICKLE_OK)
+		err = pickle_doc_parse(doc);
+	item->err = err;
+	item->error = *pickle_error_last();
+
+	/* Get the document ready for the next item. */
+	if (!keep) {
+		pickle_doc_reset(doc);
+		return;
+	}
+
+	/* Hand the parsed document to the caller. */
+	if (err != PICKLE_OK) {
+		pickle_doc_free(doc);
+		return;
+	}
+	pickle_doc_fclose(doc);
+	item->doc = doc;
+}
+
+/**
+ * Gets the number of processor cores that are available.
+ *
+ * @return Number of cores or 1 if we can't figure it out.
+ */
+unsigned int pickle_worker_cores(void) {
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ?
+		(unsigned int)info.dwNumberOfProcessors : 1;
+#elif defined(PICKLE_HAS_MMAP) && defined(_SC_NPROCESSORS_ONLN)
+	long cores;
+
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cores > 0) ? (unsigned int)cores : 1;
+#else
+	return 1;
+#endif /* _WIN32 */
+}
+
+#if defined(PICKLE_HAS_THREADS) && defined(_WIN32)
+/* Thread entry point for Windows. */
+DWORD WINAPI pickle_worker_entry(LPVOID arg) {
+	pickle_worker_loop((pickle_worker_t *)arg);
+	return 0;
+}
+#elif defined(PICKLE_HAS_THREADS)
+/* Thread entry point for POSIX threads. */
+void *pickle_worker_entry(void *arg) {
+	pickle_worker_loop((pickle_worker_t *)arg);
+	return NULL;
+}
+#endif /* PICKLE_HAS_THREADS */
+
+/**
+ * Starts a worker on its own thread.
+ *
+ * @param worker Worker thread.
+ *
+ * @return TRUE if the thread was started. FALSE otherwise.
+ */
+bool pickle_worker_start(pickle_worker_t *worker) {
+#if defined(PICKLE_HAS_THREADS) && defined(_WIN32)
+	worker->thread = CreateThread(NULL, 0, pickle_worker_entry, worker, 0,
+								  NULL);
+	return worker->thread != NULL;
+#elif defined(PICKLE_HAS_THREADS)
+	return pthread_create(&worker->thread, NULL, pickle_worker_entry,
+						  worker) == 0;
+#else
+	(void)worker;
+	return false;
+#endif /* PICKLE_HAS_THREADS */
+}
+
+/**
+ * Waits for a worker's thread to finish.
+ *
+ * @param worker Worker thread.
+ */
+void pickle_worker_join(pickle_worker_t *worker) {
+#if defined(PICKLE_HAS_THREADS) && defined(_WIN32)
+	WaitForSingleObject(worker->thread, INFINITE);
+	CloseHandle(worker->thread);
+#elif defined(PICKLE_HAS_THREADS)
+	pthread_join(worker->thread, NULL);
+#else
+	(void)worker;
+#endif /* PICKLE_HAS_THREADS */
+}
+
+/**
+ * Puts an empty string pool in its initial state.
+ *
+ * @param pool String pool to be initialized.
+ */
+void pickle_pool_init(pickle_pool_t *pool) {
+	pool->buf = NULL;
+	pool->len = 0;
+	pool->size = 0;
+	pool->slots = NULL;
+	pool->count = 0;
+	pool->cap = 0;
+}
+
+/**
+ * Adds a string to the pool, reusing the copy that's already there if we've
+ * seen the same string before.
+ *
+ * @param pool String pool.
+ * @param str  String to be added. (Doesn't need to be NULL terminated)
+ * @param len  Length of the string.
+ * @param off  Offset of the NULL terminated string in the pool.
+ *
+ * @return TRUE if the operation was successful. FALSE if we ran out of memory
+ *         or the pool got too big for the compiled format.
+ */
+bool pickle_pool_add(pickle_pool_t *pool, const char *str, size_t len, uint32_t *off) {
+	pickle_pool_slot_t *slots;
+	pickle_pool_slot_t *slot;
+	uint32_t hash;
+	size_t mask;
+	size_t ncap;
+	size_t i;
+	size_t j;
+
+	/* Keep the table at most half full. */
+	if ((pool->count + 1) > (pool->cap / 2)) {
+		ncap = (pool->cap == 0) ? STRTAB_MIN_CAP : pool->cap * 2;
+		slots = (pickle_pool_slot_t *)pickle_mem_alloc(NULL, ncap * sizeof(pickle_pool_slot_t));
+		if (slots == NULL)
+			return false;
+		for (i = 0; i < ncap; i++)
+			slots[i].off = (uint32_t)COMPILED_NULL;
+
+		/* Rehash every slot we already had. */
+		for (i = 0; i < pool->cap; i++) {
+			if (pool->slots[i].off == (uint32_t)COMPILED_NULL)
+				continue;
+
+			j = pool->slots[i].hash & (ncap - 1);
+			while (slots[j].off != (uint32_t)COMPILED_NULL)
+				j = (j + 1) & (ncap - 1);
+			slots[j] = pool->slots[i];
+		}
+
+		if (pool->slots != NULL)
+			pickle_mem_free(NULL, pool->slots);
+		pool->slots = slots;
+		pool->cap = ncap;
+	}
+
+	/* Look for the string using linear probing. */
+	hash = pickle_util_hash(str, len);
+	mask = pool->cap - 1;
+	for (i = hash & mask; pool->slots[i].off != (uint32_t)COMPILED_NULL;
+			i = (i + 1) & mask) {
+		slot = &pool->slots[i];
+		if ((slot->hash == hash) && (slot->len == len) &&
+				(memcmp(pool->buf + slot->off, str, len) == 0)) {
+			*off = slot->off;
+			return true;
+		}
+	}
+
+	/* Make sure the offsets still fit in the compiled format. */
+	if ((pool->len + len + 1) >= (size_t)COMPILED_NULL)
+		return false;
+
+	/* Append the string to the pool. */
+	if (!pickle_util_grow(NULL, (void **)&pool->buf, &pool->size,
+						  pool->len + len + 1, sizeof(char))) {
+		return false;
+	}
+	memcpy(pool->buf + pool->len, str, len);
+	pool->buf[pool->len + len] = '\0';
+
+	/* First time we've seen this string. */
+	slot = &pool->slots[i];
+	slot->off = (uint32_t)pool->len;
+	slot->len = (uint32_t)len;
+	slot->hash = hash;
+	pool->len += len + 1;
+	pool->count++;
+
+	*off = slot->off;
+	return true;
+}
+
+/**
+ * Frees up everything allocated by a string pool.
+ *
+ * @param pool String pool to be free'd.
+ */
+void pickle_pool_free(pickle_pool_t *pool) {
+	if (pool->buf != NULL)
+		pickle_mem_free(NULL, pool->buf);
+	if (pool->slots != NULL)
+		pickle_mem_free(NULL, pool->slots);
+	pickle_pool_init(pool);
+}
+
+/**
+ * Hashes the source of a document to identify its compiled version.
+ *
+ * @param doc   PickLE document object.
+ * @param hash  FNV-1a hash of the source.
+ * @param len   Length of the source.
+ * @param mtime Modification time of the source file or 0 if it isn't a file.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         document doesn't have a source we can get to.
+ */
+pickle_err_t pickle_compiled_srchash(pickle_doc_t *doc, uint32_t *hash, size_t *len, uint32_t *mtime) {
+	/* In-memory sources can be hashed right away. */
+	*mtime = 0;
+	if (doc->reader.source == PICKLE_SOURCE_MEM) {
+		*hash = pickle_util_hash(doc->reader.data, doc->reader.len);
+		*len = doc->reader.len;
+
+		return PICKLE_OK;
+	}
+	if (doc->reader.source == PICKLE_SOURCE_MMAP) {
+		if (pickle_util_stat(doc->fname, len, mtime) != PICKLE_OK)
+			*mtime = 0;
+		*hash = pickle_util_hash(doc->reader.data, doc->reader.len);
+		*len = doc->reader.len;
+
+		return PICKLE_OK;
+	}
+
+	/* Go back to the file the document came from. */
+	if (doc->fname == NULL) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Can't identify the source of "
+						 "a document without a file or an open buffer."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	if (pickle_util_stat(doc->fname, len, mtime) != PICKLE_OK)
+		*mtime = 0;
+	return pickle_util_hashfile(doc->fname, hash, len);
+}
+
+/**
+ * Checks if a mapped compiled document was built from the current version of
+ * its source file. The source is only hashed if its size or modification time
+ * changed, or if it was modified so close to when the compiled document was
+ * built that its modification time can't be trusted.
+ *
+ * @param doc   Document with the compiled document mapped.
+ * @param fname Path to the source document file.
+ * @param hash  Gets the hash of the source if it had to be hashed.
+ * @param len   Gets the length of the source if it had to be hashed, 0 if it
+ *              couldn't be hashed or didn't need to.
+ * @param mtime Gets the modification time of the source.
+ *
+ * @return TRUE if the compiled document is up to date.
+ */
+bool pickle_compiled_fresh(const pickle_doc_t *doc, const char *fname, uint32_t *hash, size_t *len, uint32_t *mtime) {
+	const pickle_compiled_hdr_t *hdr;
+	size_t size;
+
+	/* Trust the compiled document if the source looks just like it did. */
+	hdr = (const pickle_compiled_hdr_t *)doc->compiled;
+	*len = 0;
+	if (pickle_util_stat(fname, &size, mtime) == PICKLE_OK) {
+		if ((hdr->src_mtime != 0) && (hdr->src_len == size) &&
+				(hdr->src_mtime == *mtime) && (*mtime < hdr->built)) {
+			return true;
+		}
+	} else {
+		*mtime = 0;
+	}
+
+	/* Compare the contents then. */
+	if (pickle_util_hashfile(fname, hash, len) != PICKLE_OK) {
+		*len = 0;
+		return false;
+	}
+
+	return (hdr->src_hash == *hash) && (hdr->src_len == *len);
+}
+
+/**
+ * Writes the compiled version of a parsed document.
+ *
+ * @param doc   Parsed PickLE document object.
+ * @param cname Path to the compiled document file to be written.
+ * @param hash  Hash of the document's source.
+ * @param len   Length of the document's source.
+ * @param mtime Modification time of the document's source or 0 if unknown.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         file couldn't be written. PICKLE_ERROR_MEMORY if we ran out of memory
+ *         or the document is too big for the compiled format.
+ */
+pickle_err_t pickle_compiled_write(pickle_doc_t *doc, const char *cname, uint32_t hash, size_t len, uint32_t mtime) {
+	pickle_compiled_hdr_t hdr;
+	pickle_compiled_prop_t *props;
+	pickle_compiled_cat_t *cats;
+	pickle_compiled_comp_t *comps;
+	pickle_component_t *comp;
+	uint32_t *refdes;
+	size_t len_refdes;
+	pickle_pool_t pool;
+	bool ok;
+	FILE *fh;
+	size_t cat;
+	size_t i;
+	size_t j;
+	pickle_err_t err;
+
+	/* Check if the document fits in the compiled format. */
+	len_refdes = 0;
+	for (i = 0; i < doc->len_components; i++)
+		len_refdes += doc->components[i]->refdes.length;
+	if ((len >= (size_t)COMPILED_NULL) ||
+			(doc->len_properties >= (size_t)COMPILED_NULL) ||
+			(doc->len_categories >= (size_t)COMPILED_NULL) ||
+			(doc->len_components >= (size_t)COMPILED_NULL) ||
+			(len_refdes >= (size_t)COMPILED_NULL)) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Document is too big to be "
+						 "compiled."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Allocate the records. */
+	pickle_pool_init(&pool);
+	props = (pickle_compiled_prop_t *)pickle_mem_alloc(NULL,
+		(doc->len_properties + 1) * sizeof(pickle_compiled_prop_t));
+	cats = (pickle_compiled_cat_t *)pickle_mem_alloc(NULL,
+		(doc->len_categories + 1) * sizeof(pickle_compiled_cat_t));
+	comps = (pickle_compiled_comp_t *)pickle_mem_alloc(NULL,
+		(doc->len_components + 1) * sizeof(pickle_compiled_comp_t));
+	refdes = (uint32_t *)pickle_mem_alloc(NULL, (len_refdes + 1) * sizeof(uint32_t));
+	ok = (props != NULL) && (cats != NULL) && (comps != NULL) &&
+		 (refdes != NULL);
+
+/* Adds a string field to the pool, dealing with NULL strings. */
+#define POOL_FIELD(str, slen, roff, rlen)                              \
+	do {                                                               \
+		(roff) = (uint32_t)COMPILED_NULL;                              \
+		(rlen) = 0;                                                    \
+		if (ok && ((str) != NULL)) {                                   \
+			ok = pickle_pool_add(&pool, (str), (slen), &(roff));       \
+			(rlen) = (uint32_t)(slen);                                 \
+		}                                                              \
+	} while (0)
+
+	/* Build the property and category records. */
+	for (i = 0; ok && (i < doc->len_properties); i++) {
+		POOL_FIELD(doc->properties[i]->name, doc->properties[i]->len_name,
+				   props[i].name, props[i].len_name);
+		POOL_FIELD(doc->properties[i]->value, doc->properties[i]->len_value,
+				   props[i].value, props[i].len_value);
+	}
+	for (i = 0; ok && (i < doc->len_categories); i++) {
+		POOL_FIELD(doc->categories[i]->name, doc->categories[i]->len_name,
+				   cats[i].name, cats[i].len_name);
+	}
+
+	/* Build the component records. */
+	cat = 0;
+	len_refdes = 0;
+	for (i = 0; ok && (i < doc->len_components); i++) {
+		comp = doc->components[i];
+		comps[i].flags = comp->picked ? COMPILED_PICKED : 0;
+		comps[i].quantity = comp->quantity;
+
+		/* Components usually follow their categories in order. */
+		comps[i].category = (uint32_t)COMPILED_NULL;
+		if (comp->category != NULL) {
+			if ((cat >= doc->len_categories) ||
+					(doc->categories[cat] != comp->category)) {
+				for (cat = 0; cat < doc->len_categories; cat++) {
+					if (doc->categories[cat] == comp->category)
+						break;
+				}
+			}
+			if (cat < doc->len_categories)
+				comps[i].category = (uint32_t)cat;
+		}
+
+		POOL_FIELD(comp->name, comp->len_name, comps[i].name,
+				   comps[i].len_name);
+		POOL_FIELD(comp->value, comp->len_value, comps[i].value,
+				   comps[i].len_value);
+		POOL_FIELD(comp->description, comp->len_description,
+				   comps[i].description, comps[i].len_description);
+		POOL_FIELD(comp->package, comp->len_package, comps[i].package,
+				   comps[i].len_package);
+
+		/* Reference designators. */
+		comps[i].refdes = (uint32_t)len_refdes;
+		comps[i].len_refdes = (uint32_t)comp->refdes.length;
+		for (j = 0; ok && (j < comp->refdes.length); j++) {
+			ok = pickle_pool_add(&pool, comp->refdes.refdes[j],
+								 strlen(comp->refdes.refdes[j]),
+								 &refdes[len_refdes]);
+			len_refdes++;
+		}
+	}
+
+#undef POOL_FIELD
+
+	/* Check if we were able to build everything. */
+	if (!ok) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't build the "
+						 "compiled document."));
+		err = PICKLE_ERROR_MEMORY;
+		goto cleanup;
+	}
+
+	/* Build the header. */
+	memcpy(hdr.magic, COMPILED_MAGIC, 4);
+	hdr.version = COMPILED_VERSION;
+	hdr.byteorder = (uint32_t)COMPILED_BYTEORDER;
+	hdr.src_hash = hash;
+	hdr.src_len = (uint32_t)len;
+	hdr.src_mtime = mtime;
+	hdr.built = (uint32_t)time(NULL);
+	hdr.len_properties = (uint32_t)doc->len_properties;
+	hdr.len_categories = (uint32_t)doc->len_categories;
+	hdr.len_components = (uint32_t)doc->len_components;
+	hdr.len_refdes = (uint32_t)len_refdes;
+	hdr.len_strings = (uint32_t)pool.len;
+
+	/* Write everything out. */
+	err = PICKLE_OK;
+	fh = fopen(cname, "wb");
+	if (fh == NULL) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't open file "
+							"\"%s\": %s."), cname, strerror(errno));
+		err = PICKLE_ERROR_FILE;
+		goto cleanup;
+	}
+	ok = (fwrite(&hdr, sizeof(hdr), 1, fh) == 1) &&
+		 (fwrite(props, sizeof(pickle_compiled_prop_t), doc->len_properties,
+				 fh) == doc->len_properties) &&
+		 (fwrite(cats, sizeof(pickle_compiled_cat_t), doc->len_categories,
+				 fh) == doc->len_categories) &&
+		 (fwrite(comps, sizeof(pickle_compiled_comp_t), doc->len_components,
+				 fh) == doc->len_components) &&
+		 (fwrite(refdes, sizeof(uint32_t), len_refdes, fh) == len_refdes) &&
+		 (fwrite(pool.buf, sizeof(char), pool.len, fh) == pool.len);
+	if ((fclose(fh) != 0) || !ok) {
+		pickle_error_format(PICKLE_ERROR_FILE, EMSG("Couldn't write file "
+							"\"%s\"."), cname);
+		err = PICKLE_ERROR_FILE;
+	}
+
+cleanup:
+	if (props != NULL)
+		pickle_mem_free(NULL, props);
+	if (cats != NULL)
+		pickle_mem_free(NULL, cats);
+	if (comps != NULL)
+		pickle_mem_free(NULL, comps);
+	if (refdes != NULL)
+		pickle_mem_free(NULL, refdes);
+	pickle_pool_free(&pool);
+
+	return err;
+}
+
+/**
+ * Maps a compiled document into memory and checks that its header and size
+ * make sense.
+ *
+ * @param doc   PickLE document object to hold the mapping.
+ * @param cname Path to the compiled document file.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         file couldn't be mapped or isn't a valid compiled document.
+ */
+pickle_err_t pickle_compiled_map(pickle_doc_t *doc, const char *cname) {
+	const pickle_compiled_hdr_t *hdr;
+	size_t len;
+#ifdef PICKLE_HAS_MMAP
+	struct stat st;
+	void *map;
+	int fd;
+
+	/* Open the file and get its size. */
+	fd = open(cname, O_RDONLY);
+	if ((fd < 0) || (fstat(fd, &st) != 0)) {
+		if (fd >= 0)
+			close(fd);
+		return PICKLE_ERROR_FILE;
+	}
+	len = (size_t)st.st_size;
+
+	/* Map the whole file. */
+	if (len < sizeof(pickle_compiled_hdr_t)) {
+		close(fd);
+		return PICKLE_ERROR_FILE;
+	}
+	map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return PICKLE_ERROR_FILE;
+	doc->compiled = (const char *)map;
+	doc->len_compiled = len;
+#else
+	FILE *fh;
+	char *buf;
+
+	/* Read the whole file into memory. */
+	fh = fopen(cname, "rb");
+	if (fh == NULL)
+		return PICKLE_ERROR_FILE;
+	if ((fseek(fh, 0, SEEK_END) != 0) || (ftell(fh) < 0)) {
+		fclose(fh);
+		return PICKLE_ERROR_FILE;
+	}
+	len = (size_t)ftell(fh);
+	rewind(fh);
+	if (len < sizeof(pickle_compiled_hdr_t)) {
+		fclose(fh);
+		return PICKLE_ERROR_FILE;
+	}
+	buf = (char *)pickle_mem_alloc(&doc->allocator, len);
+	if ((buf == NULL) || (fread(buf, 1, len, fh) != len)) {
+		if (buf != NULL)
+			pickle_mem_free(&doc->allocator, buf);
+		fclose(fh);
+		return PICKLE_ERROR_FILE;
+	}
+	fclose(fh);
+	doc->compiled = buf;
+	doc->len_compiled = len;
+#endif /* PICKLE_HAS_MMAP */
+
+	/* Check the header. */
+	hdr = (const pickle_compiled_hdr_t *)doc->compiled;
+	if ((memcmp(hdr->magic, COMPILED_MAGIC, 4) != 0) ||
+			(hdr->version != COMPILED_VERSION) ||
+			(hdr->byteorder != (uint32_t)COMPILED_BYTEORDER)) {
+		pickle_compiled_unmap(doc);
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Check if the file size matches what we expect. (Truncated writes) */
+	if (len != (sizeof(pickle_compiled_hdr_t) +
+			(hdr->len_properties * sizeof(pickle_compiled_prop_t)) +
+			(hdr->len_categories * sizeof(pickle_compiled_cat_t)) +
+			(hdr->len_components * sizeof(pickle_compiled_comp_t)) +
+			(hdr->len_refdes * sizeof(uint32_t)) + hdr->len_strings)) {
+		pickle_compiled_unmap(doc);
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Every string in the pool must be terminated. */
+	if ((hdr->len_strings > 0) && (doc->compiled[len - 1] != '\0')) {
+		pickle_compiled_unmap(doc);
+		return PICKLE_ERROR_FILE;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Releases the compiled document held by a document object.
+ *
+ * @param doc PickLE document object.
+ */
+void pickle_compiled_unmap(pickle_doc_t *doc) {
+	if (doc->compiled == NULL)
+		return;
+
+#ifdef PICKLE_HAS_MMAP
+	munmap((void *)doc->compiled, doc->len_compiled);
+#else
+	pickle_mem_free(&doc->allocator, (void *)doc->compiled);
+#endif /* PICKLE_HAS_MMAP */
+	doc->compiled = NULL;
+	doc->len_compiled = 0;
+}
+
+/**
+ * Gets a string out of the pool of a compiled document, making sure it's
+ * within bounds and properly terminated.
+ *
+ * @param pool     String pool of the compiled document.
+ * @param len_pool Length of the string pool.
+ * @param off      Offset of the string in the pool.
+ * @param len      Length of the string.
+ * @param dest     Pointer to the string or NULL.
+ * @param rlen     Length of the string.
+ *
+ * @return TRUE if the string is valid. FALSE if the compiled document is
+ *         corrupted.
+ */
+bool pickle_compiled_str(const char *pool, uint32_t len_pool, uint32_t off, uint32_t len, char **dest, size_t *rlen) {
+	/* NULL strings. */
+	if (off == (uint32_t)COMPILED_NULL) {
+		*dest = NULL;
+		*rlen = 0;
+		return true;
+	}
+
+	/* Check the bounds of the string. */
+	if ((off >= len_pool) || (len >= (len_pool - off)) ||
+			(pool[off + len] != '\0')) {
+		return false;
+	}
+
+	*dest = (char *)(pool + off);
+	*rlen = len;
+	return true;
+}
+
+/**
+ * Builds the objects of a mapped compiled document and populates the
+ * document's collections with them.
+ *
+ * @param doc PickLE document object holding the mapped compiled document.
+ *
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         compiled document is corrupted. PICKLE_ERROR_MEMORY if we ran out of
+ *         memory.
+ */
+pickle_err_t pickle_compiled_fixup(pickle_doc_t *doc) {
+	const pickle_compiled_hdr_t *hdr;
+	const pickle_compiled_prop_t *rprops;
+	const pickle_compiled_cat_t *rcats;
+	const pickle_compiled_comp_t *rcomps;
+	const uint32_t *rrefdes;
+	const char *pool;
+	pickle_property_t *props;
+	pickle_category_t *cats;
+	pickle_component_t *comps;
+	char **refdes;
+	pickle_arena_mark_t mark;
+	bool ok;
+	size_t i;
+
+	/* Find each one of the sections. */
+	hdr = (const pickle_compiled_hdr_t *)doc->compiled;
+	rprops = (const pickle_compiled_prop_t *)(hdr + 1);
+	rcats = (const pickle_compiled_cat_t *)(rprops + hdr->len_properties);
+	rcomps = (const pickle_compiled_comp_t *)(rcats + hdr->len_categories);
+	rrefdes = (const uint32_t *)(rcomps + hdr->len_components);
+	pool = (const char *)(rrefdes + hdr->len_refdes);
+
+	/* Allocate all of the objects at once. */
+	pickle_arena_mark(&doc->arena, &mark);
+	props = (pickle_property_t *)pickle_arena_alloc(&doc->arena,
+		(hdr->len_properties + 1) * sizeof(pickle_property_t));
+	cats = (pickle_category_t *)pickle_arena_alloc(&doc->arena,
+		(hdr->len_categories + 1) * sizeof(pickle_category_t));
+	comps = (pickle_component_t *)pickle_arena_alloc(&doc->arena,
+		(hdr->len_components + 1) * sizeof(pickle_component_t));
+	refdes = (char **)pickle_arena_alloc(&doc->arena,
+		(hdr->len_refdes + 1) * sizeof(char *));
+	if ((props == NULL) || (cats == NULL) || (comps == NULL) ||
+			(refdes == NULL) ||
+			!pickle_util_grow(&doc->allocator,
+							  (void **)&doc->properties, &doc->cap_properties,
+							  hdr->len_properties,
+							  sizeof(pickle_property_t *)) ||
+			!pickle_util_grow(&doc->allocator,
+							  (void **)&doc->categories, &doc->cap_categories,
+							  hdr->len_categories,
+							  sizeof(pickle_category_t *)) ||
+			!pickle_util_grow(&doc->allocator,
+							  (void **)&doc->components, &doc->cap_components,
+							  hdr->len_components,
+							  sizeof(pickle_component_t *))) {
+		pickle_arena_release(&doc->arena, &mark);
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "compiled document's objects."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	/* Point the objects straight at the strings in the pool. */
+	ok = true;
+	for (i = 0; ok && (i < hdr->len_properties); i++) {
+		props[i].arena = &doc->arena;
+		ok = pickle_compiled_str(pool, hdr->len_strings, rprops[i].name,
+								 rprops[i].len_name, &props[i].name,
+								 &props[i].len_name) &&
+			 pickle_compiled_str(pool, hdr->len_strings, rprops[i].value,
+								 rprops[i].len_value, &props[i].value,
+								 &props[i].len_value);
+	}
+	for (i = 0; ok && (i < hdr->len_categories); i++) {
+		cats[i].arena = &doc->arena;
+		cats[i].first_component = 0;
+		cats[i].len_components = 0;
+		ok = pickle_compiled_str(pool, hdr->len_strings, rcats[i].name,
+								 rcats[i].len_name, &cats[i].name,
+								 &cats[i].len_name);
+	}
+	for (i = 0; ok && (i < hdr->len_refdes); i++) {
+		ok = rrefdes[i] < hdr->len_strings;
+		refdes[i] = (char *)(pool + rrefdes[i]);
+	}
+	for (i = 0; ok && (i < hdr->len_components); i++) {
+		pickle_component_init(&comps[i], &doc->arena);
+		comps[i].picked = (rcomps[i].flags & COMPILED_PICKED) != 0;
+		comps[i].quantity = rcomps[i].quantity;
+		ok = pickle_compiled_str(pool, hdr->len_strings, rcomps[i].name,
+								 rcomps[i].len_name, &comps[i].name,
+								 &comps[i].len_name) &&
+			 pickle_compiled_str(pool, hdr->len_strings, rcomps[i].value,
+								 rcomps[i].len_value, &comps[i].value,
+								 &comps[i].len_value) &&
+			 pickle_compiled_str(pool, hdr->len_strings, rcomps[i].description,
+								 rcomps[i].len_description,
+								 &comps[i].description,
+								 &comps[i].len_description) &&
+			 pickle_compiled_str(pool, hdr->len_strings, rcomps[i].package,
+								 rcomps[i].len_package, &comps[i].package,
+								 &comps[i].len_package);
+
+		/* Category. */
+		if (rcomps[i].category != (uint32_t)COMPILED_NULL) {
+			if (rcomps[i].category >= hdr->len_categories)
+				ok = false;
+			else
+				comps[i].category = &cats[rcomps[i].category];
+		}
+		if (ok && (comps[i].category != NULL))
+			pickle_category_track(comps[i].category, i);
+
+		/* Reference designators. */
+		if ((rcomps[i].refdes > hdr->len_refdes) ||
+				(rcomps[i].len_refdes > (hdr->len_refdes - rcomps[i].refdes))) {
+			ok = false;
+		} else if (rcomps[i].len_refdes > 0) {
+			comps[i].refdes.length = rcomps[i].len_refdes;
+			comps[i].refdes.refdes = &refdes[rcomps[i].refdes];
+		}
+	}
+
+	/* Check if the compiled document was corrupted. */
+	if (!ok) {
+		pickle_arena_release(&doc->arena, &mark);
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Compiled document is "
+						 "corrupted."));
+		return PICKLE_ERROR_FILE;
+	}
+
+	/* Populate the collections. */
+	for (i = 0; i < hdr->len_properties; i++)
+		doc->properties[i] = &props[i];
+	for (i = 0; i < hdr->len_categories; i++)
+		doc->categories[i] = &cats[i];
+	for (i = 0; i < hdr->len_components; i++)
+		doc->components[i] = &comps[i];
+	doc->len_properties = hdr->len_properties;
+	doc->len_categories = hdr->len_categories;
+	doc->len_components = hdr->len_components;
+
+	return PICKLE_OK;
+}
+
+#ifdef PICKLE_STATS
+/**
+ * Starts a parsing phase, taking note of where the document is at.
+ *
+ * @param doc   Document being parsed.
+ * @param phase Phase that is starting.
+ * @param mark  State of the document to be populated.
+ */
+void pickle_stats_begin(pickle_doc_t *doc, pickle_phase_t phase, pickle_stats_mark_t *mark) {
+	if (doc->stats_hook != NULL)
+		doc->stats_hook(&doc->stats, phase, false, doc->stats_userdata);
+
+	mark->phase = phase;
+	mark->offset = pickle_reader_tell(&doc->reader);
+	mark->line = doc->reader.line;
+	mark->allocs = pickle_stats_allocs;
+	mark->allocated = pickle_stats_allocated;
+	mark->ns = pickle_stats_now();
+}
+
+/**
+ * Ends the current parsing phase and starts another one.
+ *
+ * @param doc   Document being parsed.
+ * @param phase Phase that is starting.
+ * @param mark  State of the document at the start of the current phase.
+ */
+void pickle_stats_switch(pickle_doc_t *doc, pickle_phase_t phase, pickle_stats_mark_t *mark) {
+	pickle_stats_end(doc, mark);
+	pickle_stats_begin(doc, phase, mark);
+}
+
+/**
+ * Ends a parsing phase, adding everything that happened during it to the
+ * statistics of the document.
+ *
+ * @param doc  Document being parsed.
+ * @param mark State of the document at the start of the phase.
+ */
+void pickle_stats_end(pickle_doc_t *doc, const pickle_stats_mark_t *mark) {
+	pickle_stats_t *stats;
+	uint64_t now;
+
+	now = pickle_stats_now();
+	stats = &doc->stats;
+	stats->ns[mark->phase] += now - mark->ns;
+	stats->bytes_read += pickle_reader_tell(&doc->reader) - mark->offset;
+	stats->lines += doc->reader.line - mark->line;
+
+	/* Only this thread's allocations happened on behalf of the phase. */
+	stats->allocs += pickle_stats_allocs - mark->allocs;
+	stats->bytes_allocated += pickle_stats_allocated - mark->allocated;
+
+	if (doc->stats_hook != NULL)
+		doc->stats_hook(stats, mark->phase, true, doc->stats_userdata);
+}
+
+/**
+ * Gets the current time with the best resolution we've got.
+ *
+ * @return Time in nanoseconds from an arbitrary point in time.
+ */
+uint64_t pickle_stats_now(void) {
+#if defined(_WIN32)
+	LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)(((double)count.QuadPart * 1000000000.0) /
+					  (double)freq.QuadPart);
+#elif defined(PICKLE_HAS_MMAP)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000UL) + (uint64_t)ts.tv_nsec;
+#else
+	return (uint64_t)(((double)clock() * 1000000000.0) / CLOCKS_PER_SEC);
+#endif /* _WIN32 */
+}
+#endif /* PICKLE_STATS */
+
+/**
+ * Sets up a document writer with its initial block buffer.
+ *
+ * @param wr   Document writer to be set up.
+ * @param sink Where the writer's output goes.
+ *
+ * @return PICKLE_OK if the writer is ready. PICKLE_ERROR_MEMORY if we couldn't
+ *         allocate the block buffer.
+ */
+pickle_err_t pickle_writer_init(pickle_writer_t *wr, pickle_sink_t sink) {
+	wr->sink = sink;
+	wr->fh = NULL;
+	wr->fd = -1;
+	wr->len = 0;
+	wr->size = WRITEBUF_BLOCK_LEN;
+	wr->err = PICKLE_OK;
+
+	wr->buf = (char *)pickle_mem_alloc(NULL, wr->size * sizeof(char));
+	if (wr->buf == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "write buffer."));
+		return PICKLE_ERROR_MEMORY;
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Appends a string to the writer's buffer. Files get their buffer flushed
+ * whenever it fills up, memory buffers simply grow. Nothing else is written
+ * after an error.
+ *
+ * @param wr  Document writer.
+ * @param str String to be written. (Doesn't need to be NULL terminated)
+ * @param len Length of the string.
+ */
+void pickle_writer_put(pickle_writer_t *wr, const char *str, size_t len) {
+	size_t n;
+
+	while ((len > 0) && (wr->err == PICKLE_OK)) {
+		/* Make some room. */
+		if (wr->len == wr->size) {
+			if (wr->sink != PICKLE_SINK_MEM) {
+				pickle_writer_flush(wr);
+			} else if (!pickle_util_grow(NULL, (void **)&wr->buf, &wr->size,
+										 wr->size + 1, sizeof(char))) {
+				pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't grow the "
+								 "write buffer."));
+				wr->err = PICKLE_ERROR_MEMORY;
+			}
+			continue;
+		}
+
+		/* Copy as much as we can fit. */
+		n = ((wr->size - wr->len) < len) ? (wr->size - wr->len) : len;
+		memcpy(wr->buf + wr->len, str, n);
+		wr->len += n;
+		str += n;
+		len -= n;
+	}
+}
+
+/**
+ * Writes a string field of an object wrapped in its delimiters, preceded by a
+ * tab. Fields that weren't set are skipped.
+ *
+ * @param wr    Document writer.
+ * @param open  Opening delimiter of the field. ('\0' for none)
+ * @param str   Contents of the field. (May be NULL, doesn't need to be NULL
+ *              terminated)
+ * @param len   Length of the contents.
+ * @param close Closing delimiter of the field. ('\0' for none)
+ */
+void pickle_writer_field(pickle_writer_t *wr, char open, const char *str, size_t len, char close) {
+	char delim[2];
+
+	if (str == NULL)
+		return;
+
+	delim[0] = '\t';
+	delim[1] = open;
+	pickle_writer_put(wr, delim, (open != '\0') ? 2 : 1);
+	pickle_writer_put(wr, str, len);
+	if (close != '\0')
+		pickle_writer_put(wr, &close, 1);
+}
+
+/**
+ * Writes whatever is in the writer's buffer out to its file.
+ *
+ * @param wr Document writer.
+ */
+void pickle_writer_flush(pickle_writer_t *wr) {
+	const char *cur;
+	size_t left;
+#ifdef PICKLE_HAS_FD
+	long n;
+#endif /* PICKLE_HAS_FD */
+
+	/* Memory buffers are already where they need to be. */
+	if ((wr->sink == PICKLE_SINK_MEM) || (wr->err != PICKLE_OK))
+		return;
+
+	/* Write the buffer out, dealing with partial writes. */
+	cur = wr->buf;
+	left = wr->len;
+	while (left > 0) {
+		if (wr->sink == PICKLE_SINK_FILE) {
+			if (fwrite(cur, sizeof(char), left, wr->fh) != left)
+				break;
+			left = 0;
+		}
+#ifdef PICKLE_HAS_FD
+		else {
+			n = (long)FD_WRITE(wr->fd, cur, left);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			cur += n;
+			left -= (size_t)n;
+		}
+#endif /* PICKLE_HAS_FD */
+	}
+	wr->len = 0;
+
+	/* Check if everything was written. */
+	if (left > 0) {
+		pickle_error_set(PICKLE_ERROR_FILE, EMSG("Couldn't write the document "
+						 "to the file."));
+		wr->err = PICKLE_ERROR_FILE;
+	}
+}
+
+/**
+ * Writes out a whole document in its canonical form: properties, the header
+ * separator, and then every category followed by its components, with a blank
+ * line between each component. Components that aren't listed under any of the
+ * document's categories are written at the end.
+ *
+ * @param wr  Document writer.
+ * @param doc PickLE document object.
+ */
+void pickle_writer_doc(pickle_writer_t *wr, const pickle_doc_t *doc) {
+	const pickle_property_t *prop;
+	const pickle_category_t *cat;
+	size_t covered;
+	size_t written;
+	size_t start;
+	size_t end;
+	size_t i;
+	size_t j;
+	bool ranges;
+	bool blank;
+
+	/* Properties. */
+	for (i = 0; i < doc->len_properties; i++) {
+		prop = doc->properties[i];
+		pickle_writer_put(wr, prop->name, prop->len_name);
+		pickle_writer_put(wr, ": ", 2);
+		pickle_writer_put(wr, prop->value, prop->len_value);
+		pickle_writer_put(wr, "\n", 1);
+	}
+
+	/* Header separator. */
+	if (doc->len_properties > 0)
+		pickle_writer_put(wr, "\n", 1);
+	pickle_writer_put(wr, "---\n", 4);
+	if ((doc->len_categories > 0) || (doc->len_components > 0))
+		pickle_writer_put(wr, "\n", 1);
+
+	/* Can we rely on the component ranges of the categories? */
+	covered = 0;
+	for (i = 0; i < doc->len_categories; i++)
+		covered += doc->categories[i]->len_components;
+	ranges = covered == doc->len_components;
+
+	/* Categories and their components. */
+	blank = false;
+	written = 0;
+	for (i = 0; i < doc->len_categories; i++) {
+		cat = doc->categories[i];
+		if (blank)
+			pickle_writer_put(wr, "\n", 1);
+		pickle_writer_put(wr, cat->name, cat->len_name);
+		pickle_writer_put(wr, ":\n", 2);
+		blank = false;
+
+		/* Go through the components that belong to the category. */
+		start = 0;
+		end = doc->len_components;
+		if (ranges) {
+			start = cat->first_component;
+			end = start + cat->len_components;
+		}
+		for (j = start; j < end; j++) {
+			if (doc->components[j]->category != cat)
+				continue;
+
+			if (blank)
+				pickle_writer_put(wr, "\n", 1);
+			pickle_writer_comp(wr, doc->components[j]);
+			blank = true;
+			written++;
+		}
+	}
 
-	return cat;
+	/* Don't lose the components that weren't listed in any category. */
+	if (written < doc->len_components)
+		pickle_writer_orphans(wr, doc, ranges, blank);
 }
 
 /**
- * Gets the name of a category.
- *
- * @param cat Category to get the name from.
+ * Writes out the components of a document that aren't listed under any of its
+ * categories, either because they don't have one or because their category
+ * isn't part of the document. They're grouped under their own category, or
+ * under WRITER_UNCATEGORIZED if they don't have one.
  *
- * @return Name of the category or NULL if one wasn't defined yet.
+ * @param wr     Document writer.
+ * @param doc    PickLE document object.
+ * @param ranges Were the categories written out using their component ranges?
+ * @param blank  Was the last category followed by any components?
  */
-const char *pickle_category_name_get(const pickle_category_t *cat) {
-	return (const char *)cat->name;
-}
+void pickle_writer_orphans(pickle_writer_t *wr, const pickle_doc_t *doc, bool ranges, bool blank) {
+	const pickle_component_t *comp;
+	const pickle_category_t *last;
+	bool first;
+	size_t i;
 
-/**
- * Sets the name of a category.
- *
- * @param cat  Category to set the name of.
- * @param name Name to be set.
- */
-void pickle_category_name_set(pickle_category_t *cat, const char *name) {
-	pickle_util_strcpy(&cat->name, name);
+	last = NULL;
+	first = true;
+	for (i = 0; i < doc->len_components; i++) {
+		comp = doc->components[i];
+		if (pickle_writer_listed(doc, i, ranges))
+			continue;
+
+		/* Start a new category whenever it changes. */
+		if (first || (comp->category != last)) {
+			if (blank)
+				pickle_writer_put(wr, "\n", 1);
+			if (comp->category != NULL) {
+				pickle_writer_put(wr, comp->category->name,
+								  comp->category->len_name);
+			} else {
+				pickle_writer_put(wr, WRITER_UNCATEGORIZED,
+								  strlen(WRITER_UNCATEGORIZED));
+			}
+			pickle_writer_put(wr, ":\n", 2);
+			last = comp->category;
+			first = false;
+			blank = false;
+		}
+
+		if (blank)
+			pickle_writer_put(wr, "\n", 1);
+		pickle_writer_comp(wr, comp);
+		blank = true;
+	}
 }
 
 /**
- * Frees up the resources allocated by a category object.
+ * Checks if a component was written out under one of the categories of its
+ * document.
  *
- * @param cat Category object to be free'd.
+ * @param doc    PickLE document object.
+ * @param index  Index of the component in the document.
+ * @param ranges Were the categories written out using their component ranges?
  *
- * @return PICKLE_OK if the operation was successful.
+ * @return TRUE if the component has already been written.
  */
-pickle_err_t pickle_category_free(pickle_category_t *cat) {
-	/* Check if we have anything to do. */
+bool pickle_writer_listed(const pickle_doc_t *doc, size_t index, bool ranges) {
+	const pickle_category_t *cat;
+	size_t i;
+
+	cat = doc->components[index]->category;
 	if (cat == NULL)
-		return PICKLE_OK;
+		return false;
 
-	/* Free up any internal allocations first. */
-	if (cat->name != NULL)
-		free(cat->name);
+	for (i = 0; i < doc->len_categories; i++) {
+		if (doc->categories[i] != cat)
+			continue;
 
-	/* Free up our object. */
-	free(cat);
-	cat = NULL;
+		return !ranges || ((index >= cat->first_component) &&
+						   (index < (cat->first_component +
+									 cat->len_components)));
+	}
 
-	return PICKLE_OK;
+	return false;
 }
 
 /**
- * Parses a category line.
- *
- * @warning cat will be allocated by this function and must be free'd by you.
+ * Writes out a component line followed by its reference designators.
  *
- * @param line Line to be parsed.
- * @param cat  Category object to be populated by this function. Will be set to
- *             NULL if there isn't a valid category to parse.
- *
- * @return PICKLE_OK if a category was parsed. PICKLE_PARSED_BLANK if a blank
- *         line was found. PICKLE_ERROR_PARSING if the line we tried to
- *         parse was malformed.
- *
- * @see pickle_doc_parse
+ * @param wr   Document writer.
+ * @param comp Component to be written.
  */
-pickle_err_t pickle_category_parse(const char *line, pickle_category_t **cat) {
-	const char *cur;
-
-	/* Check if line starts with a colon. */
-	if (line[0] == ':') {
-		pickle_error_msg_set(EMSG("Category line must not start with a colon."));
-		return PICKLE_ERROR_PARSING;
-	}
+void pickle_writer_comp(pickle_writer_t *wr, const pickle_component_t *comp) {
+	char num[24];
+	unsigned int qty;
+	size_t i;
 
-	/* Allocate the brand new category. */
-	*cat = pickle_category_new();
+	/* Picked state. */
+	pickle_writer_put(wr, comp->picked ? "[X]\t" : "[ ]\t", 4);
 
-	/* Find the first occurrence of a colon. */
-	cur = strpbrk(line, ":");
-	if (cur == NULL) {
-		pickle_error_msg_set(EMSG("Category line does not contain a colon."));
-		goto parsing_error;
+	/* Quantity, converted backwards in order to avoid going through printf. */
+	i = sizeof(num);
+	qty = comp->quantity;
+	do {
+		num[--i] = (char)('0' + (qty % 10));
+		qty /= 10;
+	} while (qty > 0);
+	pickle_writer_put(wr, num + i, sizeof(num) - i);
+
+	/* Name and the optional fields. */
+	pickle_writer_field(wr, '\0', comp->name, comp->len_name, '\0');
+	pickle_writer_field(wr, '(', comp->value, comp->len_value, ')');
+	pickle_writer_field(wr, '"', comp->description, comp->len_description,
+						'"');
+	pickle_writer_field(wr, '[', comp->package, comp->len_package, ']');
+	pickle_writer_put(wr, "\n", 1);
+
+	/* Reference designators. */
+	if (comp->refdes.length == 0)
+		return;
+	for (i = 0; i < comp->refdes.length; i++) {
+		if (i > 0)
+			pickle_writer_put(wr, " ", 1);
+		pickle_writer_put(wr, comp->refdes.refdes[i],
+						  strlen(comp->refdes.refdes[i]));
 	}
-
-	/* Copy the category name over and return. */
-	pickle_util_strstrcpy(&((*cat)->name), line, cur - 1);
-	return PICKLE_OK;
-
-parsing_error:
-	pickle_category_free(*cat);
-	return PICKLE_ERROR_PARSING;
+	pickle_writer_put(wr, "\n", 1);
 }
 
 /**
- * Parses a component item in the document.
+ * Puts a line reader in its initial state. The block buffer is only allocated
+ * on the first read from a file.
  *
- * @warning comp will be allocated by this function and must be free'd by you.
+ * @param rd Line reader to be initialized.
+ */
+void pickle_reader_init(pickle_reader_t *rd) {
+	rd->source = PICKLE_SOURCE_NONE;
+	rd->fh = NULL;
+	rd->data = NULL;
+	rd->base = 0;
+	rd->len = 0;
+	rd->pos = 0;
+	rd->eof = false;
+	rd->line = 0;
+	rd->lstart = 0;
+	rd->buf = NULL;
+	rd->size = 0;
+	rd->allocator = NULL;
+	rd->codec = NULL;
+}
+
+/**
+ * Closes the source of a line reader. The block buffer is kept around so that
+ * it may be reused by the next source.
  *
- * @param doc  PickLE document object.
- * @param comp Component object to be populated by this function. Will be set to
- *             NULL if there isn't a valid component to parse.
+ * @param rd Line reader to have its source closed.
  *
- * @return PICKLE_OK if a component was parsed. PICKLE_PARSED_BLANK if a blank
- *         line was found. PICKLE_FINISHED_PARSING when there are no more
- *         components to be parsed. PICKLE_ERROR_PARSING if the line we tried to
- *         parse was malformed.
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if an
+ *         error occurred while trying to close the source.
+ */
+pickle_err_t pickle_reader_close(pickle_reader_t *rd) {
+	pickle_err_t err;
+
+	/* Close the source we were reading from. */
+	err = PICKLE_OK;
+	switch (rd->source) {
+	case PICKLE_SOURCE_GZIP:
+	case PICKLE_SOURCE_ZSTD:
+		pickle_codec_close(rd);
+		/* Fall through. */
+	case PICKLE_SOURCE_FILE:
+		if (fclose(rd->fh) != 0)
+			err = PICKLE_ERROR_FILE;
+		break;
+#ifdef PICKLE_HAS_MMAP
+	case PICKLE_SOURCE_MMAP:
+		if ((rd->data != NULL) && (munmap((void *)rd->data, rd->len) != 0))
+			err = PICKLE_ERROR_FILE;
+		break;
+#endif /* PICKLE_HAS_MMAP */
+	default:
+		break;
+	}
+
+	/* Detach from the source. */
+	rd->source = PICKLE_SOURCE_NONE;
+	rd->fh = NULL;
+	rd->data = NULL;
+	rd->base = 0;
+	rd->len = 0;
+	rd->pos = 0;
+	rd->eof = false;
+	rd->line = 0;
+	rd->lstart = 0;
+
+	return err;
+}
+
+/**
+ * Puts a line that was just read back into the reader, so that it's returned
+ * again by the next read.
  *
- * @see pickle_doc_parse
+ * @param rd   Line reader state.
+ * @param line Line that was returned by the last call to pickle_reader_getline.
  */
-pickle_err_t pickle_parse_component(pickle_doc_t *doc, pickle_component_t **comp) {
-	return PICKLE_ERROR_NOT_IMPL;
+void pickle_reader_unget(pickle_reader_t *rd, const char *line) {
+	rd->pos = line - rd->data;
+	rd->line--;
 }
 
 /**
- * Checks if a line is a category definition.
+ * Gets the offset from the start of the source of the next byte to be read.
  *
- * @param line Line to be checked.
+ * @param rd Line reader state.
  *
- * @return Is this line a properly-formed category definition?
+ * @return Byte offset of the next line to be returned by the reader.
  */
-bool pickle_parser_iscat(const char *line) {
-	/* Perform a simple check if the last character in a line is a colon. */
-	return line[strlen(line) - 1] == ':';
+size_t pickle_reader_tell(const pickle_reader_t *rd) {
+	return rd->base + rd->pos;
 }
 
 /**
- * Lexer that extracts strings that are enclosed inside a set of tokens (delim).
+ * Moves the reader to an arbitrary byte offset of its source. Seeking within
+ * the data that's already in the block buffer doesn't touch the file at all.
  *
- * @param delim Tokens that delimit parts of the string.
- * @param str   String to be lexed.
- * @param start Start of a string that was enclosed in one of the tokens.
- * @param end   End of the string that was enclosed in one of the tokens.
+ * @param rd     Line reader state.
+ * @param offset Byte offset from the start of the source. Should always point
+ *               to the start of a line.
+ * @param line   Number of lines that come before the offset.
  *
- * @return PICKLE_OK if we were able to lex the string. PICKLE_ERROR_PARSING if
- *         no tokens were found in the string. PICKLE_FINISHED_PARSING if the
- *         tokens were found, but nothing was in between them.
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         offset is out of bounds or the file couldn't be seeked.
  */
-pickle_err_t pickle_parser_enclstr(const char *delim, const char *buf, const char **start, const char **end) {
-	/* Find the first occurrence of a token. */
-	*start = strpbrk(buf, delim);
+pickle_err_t pickle_reader_seek(pickle_reader_t *rd, size_t offset, size_t line) {
+	size_t nread;
 
-	/* Check if we've reached the end of the string without finding anything. */
-	if (*start[0] == '\0') {
-		*start = *end = NULL;
-		return PICKLE_ERROR_PARSING;
+	/* Are we still inside the data we've got in memory? */
+	if ((offset >= rd->base) && (offset <= (rd->base + rd->len))) {
+		rd->pos = offset - rd->base;
+		rd->line = line;
+		return PICKLE_OK;
 	}
 
-	/* Skip consecutive tokens. */
-	*start += strspn(*start, delim);
+	/* Compressed sources can only be decompressed forward from the start. */
+	if ((rd->source == PICKLE_SOURCE_GZIP) ||
+			(rd->source == PICKLE_SOURCE_ZSTD)) {
+		if (rd->buf == NULL)
+			return PICKLE_ERROR_FILE;
+		if (offset < rd->base) {
+			if (pickle_codec_rewind(rd) != PICKLE_OK)
+				return PICKLE_ERROR_FILE;
+			rd->base = 0;
+			rd->len = 0;
+		}
 
-	/* Find the end of the string enclosed in the tokens. */
-	*end = strpbrk(buf, delim) - 1;
+		/* Decompress our way up to the offset. */
+		rd->eof = false;
+		while (offset > (rd->base + rd->len)) {
+			rd->base += rd->len;
+			rd->len = 0;
+			if ((pickle_reader_read(rd, rd->buf, rd->size, &nread) != 0) ||
+					(nread == 0)) {
+				return PICKLE_ERROR_FILE;
+			}
+			rd->len = nread;
+		}
+		rd->pos = offset - rd->base;
+		rd->line = line;
 
-	/* Check if there was nothing in between the tokens. */
-	if (*start == *end) {
-		*start = *end = NULL;
-		return PICKLE_FINISHED_PARSING;
+		return PICKLE_OK;
 	}
 
+	/* In-memory sources can't go any further than this. */
+	if (rd->source != PICKLE_SOURCE_FILE)
+		return PICKLE_ERROR_FILE;
+
+	/* Move the file and throw away our block buffer. */
+	if (fseek(rd->fh, (long)offset, SEEK_SET) != 0)
+		return PICKLE_ERROR_FILE;
+	rd->base = offset;
+	rd->len = 0;
+	rd->pos = 0;
+	rd->eof = false;
+	rd->line = line;
+
 	return PICKLE_OK;
 }
 
 /**
- * Sets the error message that the user can recall later.
+ * Frees up the block buffer of a line reader.
  *
- * @param msg Error message to be set.
+ * @param rd Line reader to be free'd.
  */
-void pickle_error_msg_set(const char *msg) {
-	/* Make sure we have enough space to store our error message. */
-	pickle_error_msg_buf = (char *)realloc(pickle_error_msg_buf,
-										   (strlen(msg) + 1) * sizeof(char));
-
-	/* Copy the error message. */
-	strcpy(pickle_error_msg_buf, msg);
+void pickle_reader_free(pickle_reader_t *rd) {
+	if (rd->buf != NULL)
+		pickle_mem_free(rd->allocator, rd->buf);
+	rd->buf = NULL;
+	rd->size = 0;
 }
 
 /**
- * Sets the error message that the user can later recall using a syntax akin to
- * printf.
+ * Buffered replacement for getline. Hands back lines straight from the source
+ * (in-memory sources) or from the block buffer (file sources), not including
+ * the newline separator or a trailing CR character. Will treat EOF as a
+ * pseudo-newline. The block buffer is doubled whenever a line doesn't fit in
+ * it, so there's no limit on the length of a line.
  *
- * @param format Format string just like in printf.
- * @param ...    Things to place inside the formatted string.
+ * @warning The returned line isn't NULL terminated and is only valid until the
+ *          next call to this function. Don't free it.
+ *
+ * @param rd   Line reader state.
+ * @param line Pointer to the start of the line.
+ * @param rlen Length of the line.
+ *
+ * @return 0 if the operation was successful. -1 if an error occurred. -2 if
+ *         we've reached EOF. -3 if we ran out of memory. 1 if a fed source
+ *         doesn't have the whole line yet.
  */
-void pickle_error_msg_format(const char *format, ...) {
-	size_t len;
-	va_list args;
+int pickle_reader_getline(pickle_reader_t *rd, const char **line, size_t *rlen) {
+	char *nbuf;
+	const char *start;
+	const char *nl;
+	size_t avail;
+	size_t searched;
+	size_t nread;
 
-	/* Allocate enough space for our message. */
-#ifndef vsnprintf
-	len = VSNPRINTF_MAX_LEN;
-#else
-	va_start(args, format);
-	len = vsnprintf(NULL, 0, format, args) + 1;
-	va_end(args);
-#endif /* vsnprintf */
-	pickle_error_msg_buf = (char *)realloc(pickle_error_msg_buf,
-										   len * sizeof(char));
+	/* Check if we have a valid pointer to work with. */
+	if (line == NULL || rlen == NULL)
+		return -1;
+	*line = NULL;
+	*rlen = 0;
 
-	/* Copy our formatted message. */
-	va_start(args, format);
-	vsprintf(pickle_error_msg_buf, format, args);
-	va_end(args);
+	/* Check if our source is valid. */
+	if ((rd->source == PICKLE_SOURCE_NONE) ||
+			(SOURCE_IS_STREAM(rd->source) && ferror(rd->fh))) {
+		return -1;
+	}
+
+	/* Allocate our block buffer for file sources. */
+	if (SOURCE_IS_STREAM(rd->source) && (rd->buf == NULL)) {
+		rd->buf = (char *)pickle_mem_alloc(rd->allocator,
+			READBUF_BLOCK_LEN * sizeof(char));
+		if (rd->buf == NULL)
+			return -3;
+		rd->size = READBUF_BLOCK_LEN;
+		rd->data = rd->buf;
+		rd->len = 0;
+		rd->pos = 0;
+	}
+
+	/* Look for the end of the line, pulling in more blocks as needed. */
+	searched = 0;
+	for (;;) {
+		start = rd->data + rd->pos;
+		avail = rd->len - rd->pos;
+
+		/* Do we already have a whole line in the buffer? */
+		nl = NULL;
+		if (avail > searched)
+			nl = (const char *)memchr(start + searched, '\n', avail - searched);
+		if (nl != NULL) {
+			*rlen = nl - start;
+			rd->pos += *rlen + 1;
+			break;
+		}
+		searched = avail;
+
+		/* Treat EOF as a pseudo-newline. */
+		if (rd->eof) {
+			if (avail == 0)
+				return -2;
+
+			*rlen = avail;
+			rd->pos = rd->len;
+			break;
+		}
+
+		/* Fed sources have to wait for the rest of the line to arrive. */
+		if (rd->source == PICKLE_SOURCE_FEED)
+			return 1;
+
+		/* Move the partial line to the start of the buffer. */
+		if (rd->pos > 0) {
+			memmove(rd->buf, start, avail);
+			rd->base += rd->pos;
+			rd->len = avail;
+			rd->pos = 0;
+		}
+
+		/* Make room for lines that are longer than our buffer. */
+		if (rd->len == rd->size) {
+			nbuf = (char *)pickle_mem_realloc(rd->allocator, rd->buf,
+											  rd->size * 2 * sizeof(char));
+			if (nbuf == NULL)
+				return -3;
+			rd->buf = nbuf;
+			rd->data = nbuf;
+			rd->size *= 2;
+		}
+
+		/* Read the next block. */
+		if (pickle_reader_read(rd, rd->buf + rd->len, rd->size - rd->len,
+							   &nread) != 0) {
+			return -1;
+		}
+		if (nread == 0)
+			rd->eof = true;
+		rd->len += nread;
+	}
+
+	/* Keep track of where we are in the document. */
+	rd->line++;
+	rd->lstart = rd->base + (start - rd->data);
 
-#ifndef vsnprintf
-	/* Ensure that we have a properly sized string. */
-	len = strlen(pickle_error_msg_buf) + 1;
-	pickle_error_msg_buf = (char *)realloc(pickle_error_msg_buf,
-										   len * sizeof(char));
-#endif /* vsnprintf */
+	/* Ignore the carriage return of CRLF line endings. */
+	*line = start;
+	if ((*rlen > 0) && (start[*rlen - 1] == '\r'))
+		*rlen -= 1;
+
+	return 0;
 }
 
 /**
- * Gets the last error message string.
+ * Reads the next bytes of a file source, decompressing them if needed.
  *
- * @return A read-only pointer to the internal last error message string buffer.
+ * @param rd    Line reader state.
+ * @param dst   Where to place the bytes that were read.
+ * @param len   Maximum number of bytes to read.
+ * @param nread Number of bytes that were actually read. (0 at the end)
+ *
+ * @return 0 if the operation was successful. -1 if an error occurred.
  */
-const char *pickle_error_msg(void) {
-	return (const char *)pickle_error_msg_buf;
-}
+int pickle_reader_read(pickle_reader_t *rd, char *dst, size_t len, size_t *nread) {
+	/* Compressed files have to go through their decompressor. */
+	if (rd->source != PICKLE_SOURCE_FILE)
+		return pickle_codec_read(rd, dst, len, nread);
 
-/**
- * Prints the last error message thrown by the library to STDERR.
- */
-void pickle_error_print(void) {
-	fprintf(stderr, "ERROR: %s\n", pickle_error_msg_buf);
+	*nread = fread(dst, sizeof(char), len, rd->fh);
+	if ((*nread == 0) && ferror(rd->fh))
+		return -1;
+
+	return 0;
 }
 
 /**
- * Frees up the internal error message string buffer.
+ * Identifies the compression format of a file from its first bytes.
+ *
+ * @param magic First bytes of the file.
+ * @param len   Number of bytes available in magic.
+ *
+ * @return PICKLE_SOURCE_GZIP or PICKLE_SOURCE_ZSTD for compressed files,
+ *         PICKLE_SOURCE_FILE for anything else.
  */
-void pickle_error_free(void) {
-	/* Do we even have anything to free? */
-	if (pickle_error_msg_buf == NULL)
-		return;
+pickle_source_t pickle_codec_detect(const unsigned char *magic, size_t len) {
+	if ((len >= 2) && (magic[0] == 0x1F) && (magic[1] == 0x8B))
+		return PICKLE_SOURCE_GZIP;
+	if ((len >= 4) && (magic[0] == 0x28) && (magic[1] == 0xB5) &&
+			(magic[2] == 0x2F) && (magic[3] == 0xFD)) {
+		return PICKLE_SOURCE_ZSTD;
+	}
 
-	/* Free up the error message. */
-	free(pickle_error_msg_buf);
-	pickle_error_msg_buf = NULL;
+	return PICKLE_SOURCE_FILE;
 }
 
 /**
- * Checks if a string only contains whitespace.
+ * Sets up the decompressor of a compressed file source.
  *
- * @param buf String to be checked.
+ * @param rd     Line reader that's about to read a compressed file.
+ * @param source Compression format of the file.
  *
- * @return Does this string consists only of whitespace?
+ * @return PICKLE_OK if the decompressor is ready. PICKLE_ERROR_MEMORY if we
+ *         ran out of memory. PICKLE_ERROR_NOT_IMPL if we weren't built with
+ *         support for the compression format.
  */
-bool pickle_util_iswtspc(const char *buf) {
-	return *(buf + strspn(buf, VALID_WHITESPACE)) == '\0';
+pickle_err_t pickle_codec_open(pickle_reader_t *rd, pickle_source_t source) {
+	pickle_codec_t *codec;
+
+	/* Check if we support this kind of compression. */
+#ifndef PICKLE_WITH_ZLIB
+	if (source == PICKLE_SOURCE_GZIP) {
+		pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("Gzip compressed "
+						 "documents require building with PICKLE_WITH_ZLIB."));
+		return PICKLE_ERROR_NOT_IMPL;
+	}
+#endif /* !PICKLE_WITH_ZLIB */
+#ifndef PICKLE_WITH_ZSTD
+	if (source == PICKLE_SOURCE_ZSTD) {
+		pickle_error_set(PICKLE_ERROR_NOT_IMPL, EMSG("Zstandard compressed "
+						 "documents require building with PICKLE_WITH_ZSTD."));
+		return PICKLE_ERROR_NOT_IMPL;
+	}
+#endif /* !PICKLE_WITH_ZSTD */
+
+	/* Allocate our decompression state. */
+	codec = (pickle_codec_t *)pickle_mem_alloc(rd->allocator,
+											   sizeof(pickle_codec_t));
+	if (codec == NULL) {
+		pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't allocate the "
+						 "decompressor of the document."));
+		return PICKLE_ERROR_MEMORY;
+	}
+	codec->in_len = 0;
+	codec->in_pos = 0;
+	codec->eof = false;
+	codec->inside = false;
+	codec->done = false;
+
+#ifdef PICKLE_WITH_ZLIB
+	if (source == PICKLE_SOURCE_GZIP) {
+		codec->zs.zalloc = pickle_codec_zalloc;
+		codec->zs.zfree = pickle_codec_zfree;
+		codec->zs.opaque = (voidpf)rd->allocator;
+		codec->zs.next_in = Z_NULL;
+		codec->zs.avail_in = 0;
+
+		/* Only accept gzip headers. (15 bit window plus gzip decoding) */
+		if (inflateInit2(&codec->zs, 15 + 16) != Z_OK) {
+			pickle_mem_free(rd->allocator, codec);
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't initialize "
+							 "the gzip decompressor."));
+			return PICKLE_ERROR_MEMORY;
+		}
+	}
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	if (source == PICKLE_SOURCE_ZSTD) {
+		codec->zds = ZSTD_createDStream();
+		if (codec->zds == NULL) {
+			pickle_mem_free(rd->allocator, codec);
+			pickle_error_set(PICKLE_ERROR_MEMORY, EMSG("Couldn't initialize "
+							 "the zstd decompressor."));
+			return PICKLE_ERROR_MEMORY;
+		}
+	}
+#endif /* PICKLE_WITH_ZSTD */
+
+	rd->codec = codec;
+	return PICKLE_OK;
 }
 
 /**
- * Copies one string to another using a start and end portions of an original
- * string. Basically strcpy that accepts substrings. It will always NULL
- * terminate the destination.
+ * Decompresses the next bytes of a compressed file source, pulling in blocks
+ * of compressed data from the file as needed. Concatenated gzip members and
+ * zstd frames are decompressed as a single stream.
  *
- * @warning This function will allocate memory for dest. Make sure you free this
- *          string later.
+ * @param rd    Line reader state.
+ * @param dst   Where to place the decompressed bytes.
+ * @param len   Maximum number of bytes to decompress.
+ * @param nread Number of bytes that were decompressed. (0 at the end)
  *
- * @param dest  Destination string. (Will be allocated by this function.)
- * @param start Start of the string to be copied.
- * @param end   Where should we stop copying the string? (Inclusive)
- *
- * @return Number of bytes copied.
+ * @return 0 if the operation was successful. -1 if an error occurred while
+ *         reading the file or the compressed data is corrupt or truncated.
  */
-size_t pickle_util_strstrcpy(char **dest, const char *start, const char *end) {
-	size_t len;
-	char *dest_buf;
-	const char *src_buf;
-
-	/* Allocate space for the new string. */
-	len = (end - start) + 1;
-	*dest = (char *)malloc(len * sizeof(char));
-
-	/* Copy the new string over. */
-	dest_buf = *dest;
-	src_buf = start;
-	len = 0;
-	do {
-		*dest_buf = *src_buf;
+int pickle_codec_read(pickle_reader_t *rd, char *dst, size_t len, size_t *nread) {
+	pickle_codec_t *codec;
+	size_t before;
+	size_t want;
+
+	codec = (pickle_codec_t *)rd->codec;
+	*nread = 0;
+	while ((*nread < len) && !codec->done) {
+		/* Pull in another block once we've gone through the last one. */
+		if ((codec->in_pos == codec->in_len) && !codec->eof) {
+			codec->in_len = fread(codec->in, sizeof(unsigned char),
+								  READBUF_BLOCK_LEN, rd->fh);
+			codec->in_pos = 0;
+			if (codec->in_len == 0) {
+				if (ferror(rd->fh))
+					return -1;
+				codec->eof = true;
+			}
+		}
 
-		src_buf++;
-		dest_buf++;
-		len++;
-	} while (src_buf <= end);
-	*dest_buf = '\0';
+		/* Decompress at most a block at a time. (Keeps zlib's uInt happy) */
+		before = *nread;
+		want = len - *nread;
+		if (want > READBUF_BLOCK_LEN)
+			want = READBUF_BLOCK_LEN;
+		if (pickle_codec_step(rd, dst + *nread, want, nread) != 0)
+			return -1;
+
+		/* Nothing left to decompress? */
+		if (codec->eof && (codec->in_pos == codec->in_len) &&
+				(*nread == before)) {
+			if (codec->inside)
+				return -1;
+			codec->done = true;
+		}
+	}
 
-	return len;
+	return 0;
 }
 
 /**
- * Similar to strcpy except we allocate (reallocate if needed) the destination
- * string automatically.
- *
- * @warning This function will allocate memory for dest. Make sure you free this
- *          string later.
+ * Runs the decompressor once over the compressed data we've got buffered.
  *
- * @param dest Destination string. (Will be [re]allocated by this function.)
- * @param src  Source string to be copied.
+ * @param rd    Line reader state.
+ * @param dst   Where to place the decompressed bytes.
+ * @param len   Maximum number of bytes to decompress.
+ * @param nread Total number of bytes decompressed. (Incremented)
  *
- * @return Number of bytes copied.
+ * @return 0 if the operation was successful. -1 if the data is corrupt.
  */
-size_t pickle_util_strcpy(char **dest, const char *src) {
-	size_t len;
-	char *dest_buf;
-	const char *src_buf;
+int pickle_codec_step(pickle_reader_t *rd, char *dst, size_t len, size_t *nread) {
+	pickle_codec_t *codec;
+#ifdef PICKLE_WITH_ZLIB
+	int ret;
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	ZSTD_inBuffer zin;
+	ZSTD_outBuffer zout;
+	size_t zret;
+#endif /* PICKLE_WITH_ZSTD */
+
+	codec = (pickle_codec_t *)rd->codec;
+	switch (rd->source) {
+#ifdef PICKLE_WITH_ZLIB
+	case PICKLE_SOURCE_GZIP:
+		codec->zs.next_in = codec->in + codec->in_pos;
+		codec->zs.avail_in = (uInt)(codec->in_len - codec->in_pos);
+		codec->zs.next_out = (Bytef *)dst;
+		codec->zs.avail_out = (uInt)len;
+
+		ret = inflate(&codec->zs, Z_NO_FLUSH);
+		codec->in_pos = codec->in_len - codec->zs.avail_in;
+		*nread += len - codec->zs.avail_out;
+
+		/* Another member may follow the one that just ended. */
+		if (ret == Z_STREAM_END) {
+			codec->inside = false;
+			return (inflateReset(&codec->zs) == Z_OK) ? 0 : -1;
+		} else if (ret == Z_OK) {
+			codec->inside = true;
+		} else if (ret != Z_BUF_ERROR) {
+			return -1;
+		}
 
-	/* Check if we have a valid destination pointer. */
-	if (dest == NULL)
 		return 0;
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	case PICKLE_SOURCE_ZSTD:
+		zin.src = codec->in;
+		zin.size = codec->in_len;
+		zin.pos = codec->in_pos;
+		zout.dst = dst;
+		zout.size = len;
+		zout.pos = 0;
+
+		zret = ZSTD_decompressStream(codec->zds, &zout, &zin);
+		if (ZSTD_isError(zret))
+			return -1;
+
+		/* Without any progress the hint is just asking for the next frame. */
+		if ((zin.pos != codec->in_pos) || (zout.pos > 0))
+			codec->inside = zret != 0;
+		codec->in_pos = zin.pos;
+		*nread += zout.pos;
 
-	/* Allocate space for the new string. */
-	len = strlen(src);
-	*dest = (char *)realloc(*dest, (len + 1) * sizeof(char));
-
-	/* Copy the new string over. */
-	dest_buf = *dest;
-	src_buf = src;
-	do {
-		*dest_buf = *src_buf;
-
-		src_buf++;
-		dest_buf++;
-	} while (*src_buf != '\0');
-
-	return len;
+		return 0;
+#endif /* PICKLE_WITH_ZSTD */
+	default:
+		(void)dst;
+		(void)len;
+		(void)nread;
+		(void)codec;
+		return -1;
+	}
 }
 
 /**
- * Re-implementation of getline for C89 with some modifications. Reads an entire
- * line from a file, not including the newline separator, also ignores CR
- * characters. Will treat EOF as a pseudo-newline.
+ * Takes a compressed file source back to its very beginning.
  *
- * @warning This function will allocate memory for buf. Make sure you free this
- *          string later.
- *
- * @param fh   File handle to read the line from.
- * @param line Buffer that will store the read line. (ALLOCATED BY THIS FUNCTION)
- * @param rlen Number of bytes copied into the buffer.
- * @param mlen Maximum length of a line. (Used to allocate the internal buffer)
+ * @param rd Line reader state.
  *
- * @return 0 if the operation was successful. -1 if an error occurred. 1 if mlen
- *         wasn't big enough to hold an entire line. -2 if we've reached EOF.
+ * @return PICKLE_OK if the operation was successful. PICKLE_ERROR_FILE if the
+ *         file couldn't be seeked or the decompressor couldn't be reset.
  */
-int pickle_util_getline(FILE *fh, char **line, size_t *rlen, size_t mlen) {
-	char *buf;
-	char c;
-
-	/* Check if we have a valid pointer to work with. */
-	if (line == NULL || rlen == NULL)
-		return -1;
+pickle_err_t pickle_codec_rewind(pickle_reader_t *rd) {
+	pickle_codec_t *codec;
 
-	/* Check if our file handle is valid. */
-	if ((fh == NULL) || ferror(fh)) {
-		*line = NULL;
-		*rlen = 0;
-		return -1;
+	codec = (pickle_codec_t *)rd->codec;
+	if (fseek(rd->fh, 0, SEEK_SET) != 0)
+		return PICKLE_ERROR_FILE;
+	codec->in_len = 0;
+	codec->in_pos = 0;
+	codec->eof = false;
+	codec->inside = false;
+	codec->done = false;
+
+#ifdef PICKLE_WITH_ZLIB
+	if ((rd->source == PICKLE_SOURCE_GZIP) &&
+			(inflateReset(&codec->zs) != Z_OK)) {
+		return PICKLE_ERROR_FILE;
 	}
-
-	/* Check if we've reached the end of the file. */
-	if (feof(fh)) {
-		*line = NULL;
-		*rlen = 0;
-		return -2;
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	if ((rd->source == PICKLE_SOURCE_ZSTD) &&
+			ZSTD_isError(ZSTD_DCtx_reset(codec->zds,
+										 ZSTD_reset_session_only))) {
+		return PICKLE_ERROR_FILE;
 	}
+#endif /* PICKLE_WITH_ZSTD */
 
-	/* Allocate our line buffer. */
-	*line = (char *)malloc(mlen * sizeof(char));
-	if (*line == NULL)
-		return -1;
-
-	/* Go through the file character by character. */
-	*rlen = 0;
-	buf = *line;
-	while (((c = (char)getc(fh)) != '\n') && (c != EOF)) {
-		/* Check if we still have space in our buffer. */
-		if (*rlen == (mlen - 1)) {
-			free(*line);
-			*line = NULL;
-			*rlen = 0;
-
-			return 1;
-		}
+	return PICKLE_OK;
+}
 
-		/* Ignore carriage returns. */
-		if (c == '\r')
-			continue;
+/**
+ * Frees up the decompressor of a compressed file source. The file itself is
+ * left for the caller to close.
+ *
+ * @param rd Line reader state.
+ */
+void pickle_codec_close(pickle_reader_t *rd) {
+	pickle_codec_t *codec;
 
-		/* Copy read character over and increase our read counter. */
-		*buf = c;
-		buf++;
-		*rlen += 1;
-	}
+	codec = (pickle_codec_t *)rd->codec;
+	if (codec == NULL)
+		return;
 
-	/* Properly terminate our buffer. */
-	*buf = '\0';
+#ifdef PICKLE_WITH_ZLIB
+	if (rd->source == PICKLE_SOURCE_GZIP)
+		inflateEnd(&codec->zs);
+#endif /* PICKLE_WITH_ZLIB */
+#ifdef PICKLE_WITH_ZSTD
+	if (rd->source == PICKLE_SOURCE_ZSTD)
+		ZSTD_freeDStream(codec->zds);
+#endif /* PICKLE_WITH_ZSTD */
+
+	pickle_mem_free(rd->allocator, codec);
+	rd->codec = NULL;
+}
 
-	/* Resize the output string. */
-	*line = (char *)realloc(*line, (*rlen + 1) * sizeof(char));
-	if (*line == NULL) {
-		*rlen = 0;
-		return -1;
-	}
+#ifdef PICKLE_WITH_ZLIB
+/**
+ * Lets zlib allocate its memory through the allocator of the document.
+ *
+ * @param opaque Allocator of the document.
+ * @param items  Number of items to allocate.
+ * @param size   Size of a single item.
+ *
+ * @return Allocated memory or Z_NULL if we ran out of memory.
+ */
+voidpf pickle_codec_zalloc(voidpf opaque, uInt items, uInt size) {
+	return pickle_mem_calloc((const pickle_allocator_t *)opaque, items, size);
+}
 
-	DEBUG_LOG(*line);
-	return 0;
+/**
+ * Lets zlib free its memory through the allocator of the document.
+ *
+ * @param opaque Allocator of the document.
+ * @param ptr    Memory to be free'd.
+ */
+void pickle_codec_zfree(voidpf opaque, voidpf ptr) {
+	pickle_mem_free((const pickle_allocator_t *)opaque, ptr);
 }
+#endif /* PICKLE_WITH_ZLIB */
@@ -52,75 +52,420 @@ extern "C" {
 
 /* PickLE parser status codes. */
 typedef enum {
-	PICKLE_FINISHED_PARSING = -2,
+	PICKLE_NEED_DATA = -3,
+	PICKLE_FINISHED_PARSING,
 	PICKLE_PARSED_BLANK,
 	PICKLE_OK,
 	PICKLE_ERROR_FILE,
 	PICKLE_ERROR_PARSING,
 	PICKLE_ERROR_UNKNOWN,
-	PICKLE_ERROR_NOT_IMPL
+	PICKLE_ERROR_NOT_IMPL,
+	PICKLE_ERROR_MEMORY
 } pickle_err_t;
 
+/* Maximum length of an error message. */
+#define PICKLE_ERROR_MSG_LEN 512
+
+/* PickLE error record. (Line and column are 1-based, 0 if unknown) */
+typedef struct {
+	pickle_err_t code;
+	size_t line;
+	size_t column;
+	size_t offset;
+	char msg[PICKLE_ERROR_MSG_LEN];
+} pickle_error_t;
+
+/* PickLE document parsing flags. */
+typedef enum {
+	PICKLE_FLAG_VIEW = 1 << 0,
+	PICKLE_FLAG_KEEP = 1 << 1
+} pickle_flag_t;
+
+/* Phases of the parsing of a document. */
+typedef enum {
+	PICKLE_PHASE_PROPERTIES = 0,
+	PICKLE_PHASE_BODY,
+	PICKLE_PHASES
+} pickle_phase_t;
+
+/* Parsing statistics of a document. (Only collected if the library was built
+ * with PICKLE_STATS defined, otherwise always zero) Allocations count every
+ * block the library got from its allocators while parsing, with resizes
+ * counted at their new size, so memory that gets reused isn't counted. */
+typedef struct {
+	size_t bytes_read;
+	size_t lines;
+	size_t blank_lines;
+	size_t allocs;
+	size_t bytes_allocated;
+	uint64_t ns[PICKLE_PHASES];
+} pickle_stats_t;
+
+/* Hook fired at the start and end of each parsing phase. */
+typedef void (*pickle_stats_hook_t)(const pickle_stats_t *stats,
+									pickle_phase_t phase, bool end,
+									void *userdata);
+
+/* Memory allocator used by the library. (ctx is handed to every function, and
+ * it may be called from several threads at once by the parallel functions) */
+typedef struct {
+	void *(*alloc)(size_t size, void *ctx);
+	void *(*realloc)(void *ptr, size_t size, void *ctx);
+	void (*free)(void *ptr, void *ctx);
+	void *ctx;
+} pickle_allocator_t;
+
+/* Arena allocator memory chunk. */
+typedef struct pickle_arena_chunk_s {
+	struct pickle_arena_chunk_s *next;
+	size_t size;
+	size_t used;
+} pickle_arena_chunk_t;
+
+/* Arena allocator. */
+typedef struct {
+	pickle_arena_chunk_t *head;
+	pickle_arena_chunk_t *cur;
+	const pickle_allocator_t *allocator;
+} pickle_arena_t;
+
+/* Position in an arena that can be returned to later. */
+typedef struct {
+	pickle_arena_chunk_t *chunk;
+	size_t used;
+} pickle_arena_mark_t;
+
+/* String interning table entry. */
+typedef struct {
+	const char *str;
+	size_t len;
+	uint32_t hash;
+} pickle_strtab_entry_t;
+
+/* String interning table. */
+typedef struct {
+	pickle_strtab_entry_t *entries;
+	size_t len;
+	size_t cap;
+} pickle_strtab_t;
+
+/* Lazily built hash index over one of the document's collections. */
+typedef struct {
+	size_t *slots;
+	size_t cap;
+	bool valid;
+} pickle_index_t;
+
 /* Reference designator list. */
 typedef struct {
 	size_t length;
 	char **refdes;
 } refdes_list_t;
 
-/* PickLE category object. */
+/* PickLE category object. (Its components are a contiguous range of the
+ * document's components collection) */
 typedef struct {
 	char *name;
+	size_t len_name;
+
+	size_t first_component;
+	size_t len_components;
+
+	pickle_arena_t *arena;
 } pickle_category_t;
 
-/* PickLE component object. */
+/* Marks a component that didn't come from a document's file. */
+#define PICKLE_OFFSET_NONE ((size_t)-1)
+
+/* PickLE component object. (Keeps the location of its picked state marker in
+ * the document's file so that it may be updated in place, and the length of
+ * each of its strings, which is what the writer relies on) */
 typedef struct {
 	bool picked;
+	unsigned int quantity;
 	char *name;
 	char *value;
 	char *description;
 	char *package;
+	size_t len_name;
+	size_t len_value;
+	size_t len_description;
+	size_t len_package;
 	refdes_list_t refdes;
+	size_t offset_picked;
 
 	pickle_category_t *category;
+	pickle_arena_t *arena;
 } pickle_component_t;
 
+/* Reference designator index entry. */
+typedef struct {
+	const char *refdes;
+	pickle_component_t *component;
+	uint32_t hash;
+} pickle_refdes_entry_t;
+
+/* Lazily built index of the components by their reference designators. */
+typedef struct {
+	pickle_refdes_entry_t *entries;
+	size_t cap;
+	bool valid;
+} pickle_refdes_index_t;
+
 /* PickLE property item object. */
 typedef struct {
 	char *name;
 	char *value;
+	size_t len_name;
+	size_t len_value;
+
+	pickle_arena_t *arena;
 } pickle_property_t;
 
+/* Document source types. */
+typedef enum {
+	PICKLE_SOURCE_NONE = 0,
+	PICKLE_SOURCE_FILE,
+	PICKLE_SOURCE_MEM,
+	PICKLE_SOURCE_MMAP,
+	PICKLE_SOURCE_GZIP,
+	PICKLE_SOURCE_ZSTD,
+	PICKLE_SOURCE_FEED
+} pickle_source_t;
+
+/* Buffered line reader state. */
+typedef struct {
+	pickle_source_t source;
+	FILE *fh;
+
+	const char *data;
+	size_t base;
+	size_t len;
+	size_t pos;
+	bool eof;
+
+	size_t line;
+	size_t lstart;
+
+	char *buf;
+	size_t size;
+	const pickle_allocator_t *allocator;
+
+	void *codec;
+} pickle_reader_t;
+
+/* PickLE parser event types. */
+typedef enum {
+	PICKLE_EVENT_NONE = 0,
+	PICKLE_EVENT_PROPERTY,
+	PICKLE_EVENT_CATEGORY,
+	PICKLE_EVENT_COMPONENT
+} pickle_event_type_t;
+
+/* PickLE parser event. */
+typedef struct {
+	pickle_event_type_t type;
+	pickle_property_t *property;
+	pickle_category_t *category;
+	pickle_component_t *component;
+} pickle_event_t;
+
+/* PickLE pull iterator. */
+typedef struct {
+	bool body;
+	pickle_category_t *category;
+	size_t offset;
+	size_t line;
+} pickle_iter_t;
+
+/* PickLE streaming parser callbacks. */
+typedef struct {
+	pickle_err_t (*on_property)(pickle_property_t *prop, void *userdata);
+	pickle_err_t (*on_category)(pickle_category_t *cat, void *userdata);
+	pickle_err_t (*on_component)(pickle_component_t *comp, void *userdata);
+} pickle_handlers_t;
+
+/* Kinds of differences between two documents. */
+typedef enum {
+	PICKLE_DIFF_ADDED = 0,
+	PICKLE_DIFF_REMOVED,
+	PICKLE_DIFF_CHANGED,
+	PICKLE_DIFF_MOVED
+} pickle_diff_type_t;
+
+/* Fields of a component that differ between two documents. */
+typedef enum {
+	PICKLE_DIFF_PICKED      = 1 << 0,
+	PICKLE_DIFF_QUANTITY    = 1 << 1,
+	PICKLE_DIFF_NAME        = 1 << 2,
+	PICKLE_DIFF_VALUE       = 1 << 3,
+	PICKLE_DIFF_DESCRIPTION = 1 << 4,
+	PICKLE_DIFF_PACKAGE     = 1 << 5,
+	PICKLE_DIFF_REFDES      = 1 << 6,
+	PICKLE_DIFF_CATEGORY    = 1 << 7
+} pickle_diff_field_t;
+
+/* PickLE document diff callbacks. (The object from the old document comes
+ * first, either one is NULL for added and removed objects) */
+typedef struct {
+	pickle_err_t (*on_property)(pickle_diff_type_t type, const pickle_property_t *a, const pickle_property_t *b, void *userdata);
+	pickle_err_t (*on_component)(pickle_diff_type_t type, unsigned int fields, const pickle_component_t *a, const pickle_component_t *b, void *userdata);
+} pickle_diff_handlers_t;
+
 /* PickLE document handle. */
 typedef struct {
 	char *fname;
 	FILE *fh;
-	char fmode[3];
+	char fmode[4];
+	pickle_reader_t reader;
+
+	unsigned int flags;
+	pickle_allocator_t allocator;
+	pickle_arena_t arena;
+	pickle_strtab_t strtab;
+	bool adopted;
+
+	const char *compiled;
+	size_t len_compiled;
+	void *views;
 
 	pickle_property_t **properties;
 	size_t len_properties;
+	size_t cap_properties;
+	pickle_index_t index_properties;
 
 	pickle_category_t **categories;
 	size_t len_categories;
+	size_t cap_categories;
 
 	pickle_component_t **components;
 	size_t len_components;
+	size_t cap_components;
+	pickle_refdes_index_t index_refdes;
+
+	pickle_arena_mark_t iter_start;
+	pickle_arena_mark_t iter_end;
+	bool iter_window;
+
+	pickle_stats_t stats;
+	pickle_stats_hook_t stats_hook;
+	void *stats_userdata;
 } pickle_doc_t;
 
+/* PickLE push parser, fed with chunks of a document as they arrive. */
+typedef struct {
+	pickle_doc_t *doc;
+	pickle_iter_t iter;
+	pickle_err_t err;
+
+	pickle_handlers_t handlers;
+	void *userdata;
+
+	pickle_category_t category;
+	char *catbuf;
+	size_t catlen;
+} pickle_parser_t;
+
+/* Marks a missing string or category in a columnar view. */
+#define PICKLE_COLUMN_NULL 0xFFFFFFFFUL
+
+/* Columnar (structure-of-arrays) view of the components of a document. */
+typedef struct {
+	size_t len;
+
+	uint32_t *picked;
+	uint32_t *quantity;
+	uint32_t *category;
+	uint32_t *name;
+	uint32_t *value;
+	uint32_t *description;
+	uint32_t *package;
+
+	char *strings;
+	size_t len_strings;
+} pickle_columns_t;
+
+/* PickLE batch parsing item. */
+typedef struct {
+	const char *fname;
+	const char *buf;
+	size_t len;
+
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	pickle_error_t error;
+} pickle_batch_item_t;
+
+/* PickLE allocator operations. */
+void pickle_allocator_set(const pickle_allocator_t *allocator);
+const pickle_allocator_t *pickle_allocator_get(void);
+void pickle_free(void *ptr);
+
 /* PickLE document operations. */
 pickle_doc_t *pickle_doc_new(void);
+pickle_doc_t *pickle_doc_new_allocator(const pickle_allocator_t *allocator);
 pickle_err_t pickle_doc_fopen(pickle_doc_t *doc, const char *fname, const char *fmode);
+pickle_err_t pickle_doc_open_mem(pickle_doc_t *doc, const char *buf, size_t len);
+pickle_err_t pickle_doc_mmap(pickle_doc_t *doc, const char *fname);
 pickle_err_t pickle_doc_fclose(pickle_doc_t *doc);
 pickle_err_t pickle_doc_free(pickle_doc_t *doc);
+pickle_err_t pickle_doc_reset(pickle_doc_t *doc);
 pickle_err_t pickle_doc_parse(pickle_doc_t *doc);
+pickle_err_t pickle_doc_parse_parallel(pickle_doc_t *doc, unsigned int threads, size_t min_chunk);
+pickle_err_t pickle_doc_reserve(pickle_doc_t *doc, size_t components);
+const pickle_stats_t *pickle_doc_stats(const pickle_doc_t *doc);
+pickle_err_t pickle_doc_stats_hook(pickle_doc_t *doc, pickle_stats_hook_t hook, void *userdata);
+pickle_err_t pickle_doc_save_compiled(pickle_doc_t *doc, const char *cname);
+pickle_err_t pickle_doc_load_compiled(pickle_doc_t *doc, const char *cname, const char *fname);
+pickle_err_t pickle_doc_write(const pickle_doc_t *doc, FILE *fh);
+pickle_err_t pickle_doc_write_fd(const pickle_doc_t *doc, int fd);
+pickle_err_t pickle_doc_write_mem(const pickle_doc_t *doc, char **buf, size_t *len);
+const char *pickle_doc_intern(pickle_doc_t *doc, const char *str, size_t len);
 pickle_err_t pickle_doc_getline(pickle_doc_t *doc, char **line);
+pickle_err_t pickle_doc_nextline(pickle_doc_t *doc, const char **line, size_t *len);
 pickle_err_t pickle_doc_property_add(pickle_doc_t *doc, pickle_property_t *prop);
 pickle_err_t pickle_doc_category_add(pickle_doc_t *doc, pickle_category_t *cat);
+pickle_err_t pickle_doc_component_add(pickle_doc_t *doc, pickle_component_t *comp);
+const pickle_property_t *pickle_doc_property_find(pickle_doc_t *doc, const char *name);
+pickle_component_t *pickle_doc_find_refdes(pickle_doc_t *doc, const char *refdes);
+pickle_err_t pickle_doc_set_picked(pickle_doc_t *doc, pickle_component_t *comp, bool picked);
+pickle_err_t pickle_doc_diff(pickle_doc_t *a, pickle_doc_t *b, const pickle_diff_handlers_t *handlers, void *userdata);
+pickle_err_t pickle_doc_merge(pickle_doc_t *doc, pickle_doc_t **docs, const char **prefixes, size_t len, unsigned int threads);
+
+/* PickLE columnar view operations. */
+pickle_err_t pickle_columns_build(pickle_columns_t *cols, const pickle_doc_t *doc);
+void pickle_columns_free(pickle_columns_t *cols);
+bool pickle_columns_picked(const pickle_columns_t *cols, size_t index);
+size_t pickle_columns_count_picked(const pickle_columns_t *cols);
+const char *pickle_columns_str(const pickle_columns_t *cols, uint32_t off);
 
 /* PickLE parsing operations. */
 pickle_err_t pickle_parse_component(pickle_doc_t *doc, pickle_component_t **comp);
+pickle_err_t pickle_parse_stream(pickle_doc_t *doc, const pickle_handlers_t *handlers, void *userdata);
+pickle_err_t pickle_doc_validate(pickle_doc_t *doc, size_t max_errors, pickle_error_t **errors, size_t *len);
+
+/* PickLE batch operations. */
+pickle_err_t pickle_batch_parse(pickle_batch_item_t *items, size_t len, unsigned int threads, unsigned int flags);
+
+/* PickLE iterator operations. */
+void pickle_iter_init(pickle_iter_t *iter);
+pickle_err_t pickle_iter_next(pickle_doc_t *doc, pickle_iter_t *iter, pickle_event_t *event);
+size_t pickle_iter_tell(const pickle_iter_t *iter);
+
+/* PickLE push parser operations. */
+pickle_err_t pickle_parser_init(pickle_parser_t *parser, const pickle_handlers_t *handlers, void *userdata);
+pickle_err_t pickle_parser_feed(pickle_parser_t *parser, const char *buf, size_t len);
+pickle_err_t pickle_parser_finish(pickle_parser_t *parser);
+void pickle_parser_free(pickle_parser_t *parser);
+
+/* PickLE component operations. */
+pickle_component_t *pickle_component_new(void);
+pickle_component_t *pickle_doc_component_new(pickle_doc_t *doc);
+pickle_err_t pickle_component_free(pickle_component_t *comp);
 
 /* PickLE property operations. */
 pickle_property_t *pickle_property_new(void);
+pickle_property_t *pickle_doc_property_new(pickle_doc_t *doc);
 const char *pickle_property_name_get(const pickle_property_t *prop);
 void pickle_property_name_set(pickle_property_t *prop, const char *name);
 const char *pickle_property_value_get(const pickle_property_t *prop);
@@ -130,12 +475,15 @@ pickle_err_t pickle_property_parse(const char *line, pickle_property_t **prop);
 
 /* PickLE category operations. */
 pickle_category_t *pickle_category_new(void);
+pickle_category_t *pickle_doc_category_new(pickle_doc_t *doc);
 const char *pickle_category_name_get(const pickle_category_t *cat);
 void pickle_category_name_set(pickle_category_t *cat, const char *name);
 pickle_err_t pickle_category_free(pickle_category_t *cat);
 pickle_err_t pickle_category_parse(const char *line, pickle_category_t **cat);
 
 /* Error handling. */
+const pickle_error_t *pickle_error_last(void);
+void pickle_error_clear(void);
 const char *pickle_error_msg(void);
 void pickle_error_print(void);
 
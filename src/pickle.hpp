@@ -0,0 +1,1000 @@
+/**
+ * pickle.hpp
+ * Header-only C++17 wrapper around libpickle. Objects are held by move-only
+ * handles that free whatever they own, errors are thrown as exceptions, and
+ * strings are handed out as views straight into the document.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _PICKLE_HPP
+#define _PICKLE_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#if __has_include(<memory_resource>)
+	#include <memory_resource>
+#endif
+
+#include "pickle.h"
+
+/* std::pmr support. (Define PICKLE_HPP_NO_PMR to leave it out) */
+#if defined(__cpp_lib_memory_resource) && !defined(PICKLE_HPP_NO_PMR)
+	#define PICKLE_HPP_HAS_PMR
+#endif
+
+namespace pickle {
+
+/**
+ * Error reported by the library, along with its location in the document.
+ */
+class Error : public std::runtime_error {
+public:
+	/**
+	 * Wraps an error record of the library.
+	 *
+	 * @param error Error record to be wrapped.
+	 */
+	explicit Error(const pickle_error_t &error) :
+		std::runtime_error(error.msg), m_error(error) {}
+
+	/** @return Status code of the error. */
+	pickle_err_t code() const noexcept { return m_error.code; }
+
+	/** @return 1-based line of the error or 0 if unknown. */
+	std::size_t line() const noexcept { return m_error.line; }
+
+	/** @return 1-based column of the error or 0 if unknown. */
+	std::size_t column() const noexcept { return m_error.column; }
+
+	/** @return Byte offset of the error in the document. */
+	std::size_t offset() const noexcept { return m_error.offset; }
+
+	/** @return Error record of the library. */
+	const pickle_error_t &record() const noexcept { return m_error; }
+
+private:
+	pickle_error_t m_error;
+};
+
+namespace detail {
+
+/**
+ * Throws the last error of the calling thread if a library call failed.
+ *
+ * @param err Status returned by the library.
+ *
+ * @return The status itself when it wasn't an error.
+ */
+inline pickle_err_t check(pickle_err_t err) {
+	IF_PICKLE_ERROR(err) {
+		throw Error(*pickle_error_last());
+	}
+
+	return err;
+}
+
+/**
+ * Makes a view of an optional string of the library.
+ *
+ * @param str String or NULL.
+ * @param len Length of the string.
+ *
+ * @return View of the string or an empty view if it was NULL.
+ */
+inline std::string_view view(const char *str, std::size_t len) noexcept {
+	return (str == NULL) ? std::string_view() : std::string_view(str, len);
+}
+
+/**
+ * Range of borrowed handles over one of the collections of a document.
+ *
+ * @tparam Handle Handle type handed out by the iterators.
+ * @tparam T      Object type stored in the collection.
+ */
+template <typename Handle, typename T>
+class Range {
+public:
+	/** Iterator that hands out borrowed handles by value. */
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = Handle;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = Handle;
+
+		iterator(T *const *pos, const pickle_doc_t *doc) noexcept :
+			m_pos(pos), m_doc(doc) {}
+
+		Handle operator*() const noexcept {
+			return Handle::borrow(*m_pos, m_doc);
+		}
+		iterator &operator++() noexcept { ++m_pos; return *this; }
+		iterator operator++(int) noexcept {
+			iterator prev(*this);
+			++m_pos;
+			return prev;
+		}
+		bool operator==(const iterator &other) const noexcept {
+			return m_pos == other.m_pos;
+		}
+		bool operator!=(const iterator &other) const noexcept {
+			return m_pos != other.m_pos;
+		}
+
+	private:
+		T *const *m_pos;
+		const pickle_doc_t *m_doc;
+	};
+
+	Range(T *const *items, std::size_t len, const pickle_doc_t *doc) noexcept :
+		m_items(items), m_len(len), m_doc(doc) {}
+
+	iterator begin() const noexcept { return iterator(m_items, m_doc); }
+	iterator end() const noexcept { return iterator(m_items + m_len, m_doc); }
+	std::size_t size() const noexcept { return m_len; }
+	bool empty() const noexcept { return m_len == 0; }
+	Handle operator[](std::size_t index) const noexcept {
+		return Handle::borrow(m_items[index], m_doc);
+	}
+
+private:
+	T *const *m_items;
+	std::size_t m_len;
+	const pickle_doc_t *m_doc;
+};
+
+#ifdef PICKLE_HPP_HAS_PMR
+/* Every block starts with its size, since memory resources need it back. */
+constexpr std::size_t pmr_header = ((sizeof(std::size_t) +
+	alignof(std::max_align_t) - 1) / alignof(std::max_align_t)) *
+	alignof(std::max_align_t);
+
+/**
+ * Allocates a block of memory from a memory resource.
+ *
+ * @param size Number of bytes to allocate.
+ * @param ctx  Memory resource to allocate from.
+ *
+ * @return Allocated block of memory or NULL if the resource ran out.
+ */
+inline void *pmr_alloc(std::size_t size, void *ctx) {
+	void *block;
+
+	try {
+		block = static_cast<std::pmr::memory_resource *>(ctx)->allocate(
+			size + pmr_header, alignof(std::max_align_t));
+	} catch (...) {
+		return NULL;
+	}
+	*static_cast<std::size_t *>(block) = size;
+
+	return static_cast<char *>(block) + pmr_header;
+}
+
+/**
+ * Gives a block of memory back to a memory resource.
+ *
+ * @param ptr Block to be free'd. Can be NULL.
+ * @param ctx Memory resource that owns the block.
+ */
+inline void pmr_free(void *ptr, void *ctx) {
+	char *block;
+
+	if (ptr == NULL)
+		return;
+
+	block = static_cast<char *>(ptr) - pmr_header;
+	static_cast<std::pmr::memory_resource *>(ctx)->deallocate(block,
+		*reinterpret_cast<std::size_t *>(block) + pmr_header,
+		alignof(std::max_align_t));
+}
+
+/**
+ * Resizes a block of memory from a memory resource by moving it to a brand
+ * new block.
+ *
+ * @param ptr  Block to be resized or NULL to allocate a new one.
+ * @param size New size of the block.
+ * @param ctx  Memory resource that owns the block.
+ *
+ * @return Resized block of memory or NULL if the resource ran out, in which
+ *         case the original block is left untouched.
+ */
+inline void *pmr_realloc(void *ptr, std::size_t size, void *ctx) {
+	std::size_t old;
+	void *block;
+
+	if (ptr == NULL)
+		return pmr_alloc(size, ctx);
+
+	block = pmr_alloc(size, ctx);
+	if (block == NULL)
+		return NULL;
+	old = *reinterpret_cast<std::size_t *>(static_cast<char *>(ptr) -
+										   pmr_header);
+	std::memcpy(block, ptr, (old < size) ? old : size);
+	pmr_free(ptr, ctx);
+
+	return block;
+}
+#endif /* PICKLE_HPP_HAS_PMR */
+
+} /* namespace detail */
+
+#ifdef PICKLE_HPP_HAS_PMR
+/**
+ * Builds a library allocator that takes its memory from a memory resource.
+ *
+ * @warning Documents parsed with parse_parallel allocate from several threads
+ *          at once, so they need a thread-safe resource such as
+ *          std::pmr::synchronized_pool_resource instead of an
+ *          unsynchronized_pool_resource or a monotonic_buffer_resource.
+ *
+ * @param resource Memory resource to allocate from. Must outlive everything
+ *                 that was allocated with it.
+ *
+ * @return Allocator to be handed to the library.
+ */
+inline pickle_allocator_t pmr_allocator(std::pmr::memory_resource *resource) noexcept {
+	pickle_allocator_t allocator;
+
+	allocator.alloc = detail::pmr_alloc;
+	allocator.realloc = detail::pmr_realloc;
+	allocator.free = detail::pmr_free;
+	allocator.ctx = resource;
+
+	return allocator;
+}
+#endif /* PICKLE_HPP_HAS_PMR */
+
+/**
+ * Property of a document. Standalone properties are owned by their handle,
+ * while the ones of a document are only borrowed from it.
+ */
+class Property {
+public:
+	/**
+	 * Creates a brand new standalone property.
+	 */
+	Property() : m_prop(pickle_property_new()), m_doc(NULL), m_owned(true) {
+		if (m_prop == NULL)
+			throw std::bad_alloc();
+	}
+
+	/**
+	 * Wraps a property of the library.
+	 *
+	 * @param prop  Property to be wrapped.
+	 * @param owned Should the handle free the property?
+	 */
+	explicit Property(pickle_property_t *prop, bool owned = false) noexcept :
+		m_prop(prop), m_doc(NULL), m_owned(owned) {}
+
+	Property(const Property &) = delete;
+	Property &operator=(const Property &) = delete;
+	Property(Property &&other) noexcept :
+		m_prop(std::exchange(other.m_prop, nullptr)), m_doc(other.m_doc),
+		m_owned(std::exchange(other.m_owned, false)) {}
+	Property &operator=(Property &&other) noexcept {
+		if (this != &other) {
+			reset();
+			m_prop = std::exchange(other.m_prop, nullptr);
+			m_doc = other.m_doc;
+			m_owned = std::exchange(other.m_owned, false);
+		}
+
+		return *this;
+	}
+	~Property() { reset(); }
+
+	/**
+	 * Parses a standalone property line.
+	 *
+	 * @param line Line to be parsed.
+	 *
+	 * @return Parsed property.
+	 */
+	static Property parse(std::string_view line) {
+		pickle_property_t *prop;
+
+		prop = NULL;
+		detail::check(pickle_property_parse(std::string(line).c_str(), &prop));
+		return Property(prop, true);
+	}
+
+	/**
+	 * Borrows a property from a document.
+	 *
+	 * @param prop Property of the document.
+	 * @param doc  Document that owns the property.
+	 *
+	 * @return Handle that doesn't own the property.
+	 */
+	static Property borrow(pickle_property_t *prop, const pickle_doc_t *doc) noexcept {
+		Property handle(prop);
+
+		handle.m_doc = doc;
+		return handle;
+	}
+
+	/** @return Name of the property. (Empty if it wasn't defined) */
+	std::string_view name() const noexcept {
+		return detail::view(m_prop->name, m_prop->len_name);
+	}
+
+	/** @return Value of the property. (Empty if it wasn't defined) */
+	std::string_view value() const noexcept {
+		return detail::view(m_prop->value, m_prop->len_value);
+	}
+
+	/** @param name New name of the property. */
+	void set_name(std::string_view name) {
+		pickle_property_name_set(m_prop, std::string(name).c_str());
+	}
+
+	/** @param value New value of the property. */
+	void set_value(std::string_view value) {
+		pickle_property_value_set(m_prop, std::string(value).c_str());
+	}
+
+	/** @return Wrapped property or NULL if the handle is empty. */
+	pickle_property_t *get() const noexcept { return m_prop; }
+
+	/**
+	 * Gives up the ownership of the property.
+	 *
+	 * @return Wrapped property, that's now your responsibility.
+	 */
+	pickle_property_t *release() noexcept {
+		m_owned = false;
+		return std::exchange(m_prop, nullptr);
+	}
+
+	/** @return Does this handle hold a property? */
+	explicit operator bool() const noexcept { return m_prop != NULL; }
+
+private:
+	void reset() noexcept {
+		if (m_owned && (m_prop != NULL))
+			pickle_property_free(m_prop);
+		m_prop = NULL;
+		m_owned = false;
+	}
+
+	pickle_property_t *m_prop;
+	const pickle_doc_t *m_doc;
+	bool m_owned;
+};
+
+class Component;
+
+/**
+ * Category of a document. Categories borrowed from a document know the range
+ * of components that belong to them.
+ */
+class Category {
+public:
+	/**
+	 * Creates a brand new standalone category.
+	 */
+	Category() : m_cat(pickle_category_new()), m_doc(NULL), m_owned(true) {
+		if (m_cat == NULL)
+			throw std::bad_alloc();
+	}
+
+	/**
+	 * Wraps a category of the library.
+	 *
+	 * @param cat   Category to be wrapped.
+	 * @param owned Should the handle free the category?
+	 */
+	explicit Category(pickle_category_t *cat, bool owned = false) noexcept :
+		m_cat(cat), m_doc(NULL), m_owned(owned) {}
+
+	Category(const Category &) = delete;
+	Category &operator=(const Category &) = delete;
+	Category(Category &&other) noexcept :
+		m_cat(std::exchange(other.m_cat, nullptr)), m_doc(other.m_doc),
+		m_owned(std::exchange(other.m_owned, false)) {}
+	Category &operator=(Category &&other) noexcept {
+		if (this != &other) {
+			reset();
+			m_cat = std::exchange(other.m_cat, nullptr);
+			m_doc = other.m_doc;
+			m_owned = std::exchange(other.m_owned, false);
+		}
+
+		return *this;
+	}
+	~Category() { reset(); }
+
+	/**
+	 * Parses a standalone category line.
+	 *
+	 * @param line Line to be parsed.
+	 *
+	 * @return Parsed category.
+	 */
+	static Category parse(std::string_view line) {
+		pickle_category_t *cat;
+
+		cat = NULL;
+		detail::check(pickle_category_parse(std::string(line).c_str(), &cat));
+		return Category(cat, true);
+	}
+
+	/**
+	 * Borrows a category from a document.
+	 *
+	 * @param cat Category of the document or NULL.
+	 * @param doc Document that owns the category.
+	 *
+	 * @return Handle that doesn't own the category.
+	 */
+	static Category borrow(pickle_category_t *cat, const pickle_doc_t *doc) noexcept {
+		Category handle(cat);
+
+		handle.m_doc = doc;
+		return handle;
+	}
+
+	/** @return Name of the category. (Empty if it wasn't defined) */
+	std::string_view name() const noexcept {
+		return detail::view(m_cat->name, m_cat->len_name);
+	}
+
+	/** @param name New name of the category. */
+	void set_name(std::string_view name) {
+		pickle_category_name_set(m_cat, std::string(name).c_str());
+	}
+
+	/**
+	 * Components of the category.
+	 *
+	 * @return Range of the components of the category. Always empty for
+	 *         categories that weren't borrowed from a document.
+	 */
+	detail::Range<Component, pickle_component_t> components() const noexcept;
+
+	/** @return Wrapped category or NULL if the handle is empty. */
+	pickle_category_t *get() const noexcept { return m_cat; }
+
+	/**
+	 * Gives up the ownership of the category.
+	 *
+	 * @return Wrapped category, that's now your responsibility.
+	 */
+	pickle_category_t *release() noexcept {
+		m_owned = false;
+		return std::exchange(m_cat, nullptr);
+	}
+
+	/** @return Does this handle hold a category? */
+	explicit operator bool() const noexcept { return m_cat != NULL; }
+
+private:
+	void reset() noexcept {
+		if (m_owned && (m_cat != NULL))
+			pickle_category_free(m_cat);
+		m_cat = NULL;
+		m_owned = false;
+	}
+
+	pickle_category_t *m_cat;
+	const pickle_doc_t *m_doc;
+	bool m_owned;
+};
+
+/**
+ * Component of a document.
+ */
+class Component {
+public:
+	/** Range of the reference designators of a component. */
+	class Refdes {
+	public:
+		/** Iterator that hands out views of the designators. */
+		class iterator {
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = std::string_view;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = std::string_view;
+
+			explicit iterator(char *const *pos) noexcept : m_pos(pos) {}
+
+			std::string_view operator*() const noexcept {
+				return (*m_pos == NULL) ? std::string_view() :
+					std::string_view(*m_pos);
+			}
+			iterator &operator++() noexcept { ++m_pos; return *this; }
+			iterator operator++(int) noexcept {
+				iterator prev(*this);
+				++m_pos;
+				return prev;
+			}
+			bool operator==(const iterator &other) const noexcept {
+				return m_pos == other.m_pos;
+			}
+			bool operator!=(const iterator &other) const noexcept {
+				return m_pos != other.m_pos;
+			}
+
+		private:
+			char *const *m_pos;
+		};
+
+		explicit Refdes(const refdes_list_t &list) noexcept : m_list(list) {}
+
+		iterator begin() const noexcept { return iterator(m_list.refdes); }
+		iterator end() const noexcept {
+			return iterator(m_list.refdes + m_list.length);
+		}
+		std::size_t size() const noexcept { return m_list.length; }
+		bool empty() const noexcept { return m_list.length == 0; }
+		std::string_view operator[](std::size_t index) const noexcept {
+			return *iterator(m_list.refdes + index);
+		}
+
+	private:
+		const refdes_list_t &m_list;
+	};
+
+	/**
+	 * Creates a brand new standalone component.
+	 */
+	Component() : m_comp(pickle_component_new()), m_doc(NULL), m_owned(true) {
+		if (m_comp == NULL)
+			throw std::bad_alloc();
+	}
+
+	/**
+	 * Wraps a component of the library.
+	 *
+	 * @param comp  Component to be wrapped.
+	 * @param owned Should the handle free the component?
+	 */
+	explicit Component(pickle_component_t *comp, bool owned = false) noexcept :
+		m_comp(comp), m_doc(NULL), m_owned(owned) {}
+
+	Component(const Component &) = delete;
+	Component &operator=(const Component &) = delete;
+	Component(Component &&other) noexcept :
+		m_comp(std::exchange(other.m_comp, nullptr)), m_doc(other.m_doc),
+		m_owned(std::exchange(other.m_owned, false)) {}
+	Component &operator=(Component &&other) noexcept {
+		if (this != &other) {
+			reset();
+			m_comp = std::exchange(other.m_comp, nullptr);
+			m_doc = other.m_doc;
+			m_owned = std::exchange(other.m_owned, false);
+		}
+
+		return *this;
+	}
+	~Component() { reset(); }
+
+	/**
+	 * Borrows a component from a document.
+	 *
+	 * @param comp Component of the document or NULL.
+	 * @param doc  Document that owns the component.
+	 *
+	 * @return Handle that doesn't own the component.
+	 */
+	static Component borrow(pickle_component_t *comp, const pickle_doc_t *doc) noexcept {
+		Component handle(comp);
+
+		handle.m_doc = doc;
+		return handle;
+	}
+
+	/** @return Has the component been picked? */
+	bool picked() const noexcept { return m_comp->picked; }
+
+	/** @return Quantity of the component. */
+	unsigned int quantity() const noexcept { return m_comp->quantity; }
+
+	/** @return Name of the component. (Empty if it wasn't defined) */
+	std::string_view name() const noexcept {
+		return detail::view(m_comp->name, m_comp->len_name);
+	}
+
+	/** @return Value of the component. (Empty if it doesn't have one) */
+	std::string_view value() const noexcept {
+		return detail::view(m_comp->value, m_comp->len_value);
+	}
+
+	/** @return Description of the component. (Empty if it doesn't have one) */
+	std::string_view description() const noexcept {
+		return detail::view(m_comp->description, m_comp->len_description);
+	}
+
+	/** @return Package of the component. (Empty if it doesn't have one) */
+	std::string_view package() const noexcept {
+		return detail::view(m_comp->package, m_comp->len_package);
+	}
+
+	/** @return Reference designators of the component. */
+	Refdes refdes() const noexcept { return Refdes(m_comp->refdes); }
+
+	/** @return Category of the component. (Empty handle if it has none) */
+	Category category() const noexcept {
+		return Category::borrow(m_comp->category, m_doc);
+	}
+
+	/** @return Wrapped component or NULL if the handle is empty. */
+	pickle_component_t *get() const noexcept { return m_comp; }
+
+	/**
+	 * Gives up the ownership of the component.
+	 *
+	 * @return Wrapped component, that's now your responsibility.
+	 */
+	pickle_component_t *release() noexcept {
+		m_owned = false;
+		return std::exchange(m_comp, nullptr);
+	}
+
+	/** @return Does this handle hold a component? */
+	explicit operator bool() const noexcept { return m_comp != NULL; }
+
+private:
+	void reset() noexcept {
+		if (m_owned && (m_comp != NULL))
+			pickle_component_free(m_comp);
+		m_comp = NULL;
+		m_owned = false;
+	}
+
+	pickle_component_t *m_comp;
+	const pickle_doc_t *m_doc;
+	bool m_owned;
+};
+
+inline detail::Range<Component, pickle_component_t> Category::components() const noexcept {
+	if ((m_doc == NULL) || (m_cat == NULL) || (m_cat->len_components == 0))
+		return detail::Range<Component, pickle_component_t>(NULL, 0, m_doc);
+
+	return detail::Range<Component, pickle_component_t>(
+		m_doc->components + m_cat->first_component, m_cat->len_components,
+		m_doc);
+}
+
+/**
+ * PickLE document. Owns the document handle and everything that lives in it.
+ */
+class Document {
+public:
+	/**
+	 * Creates a brand new document that uses the global allocator.
+	 */
+	Document() : m_doc(pickle_doc_new()) {
+		if (m_doc == NULL)
+			throw std::bad_alloc();
+	}
+
+	/**
+	 * Creates a brand new document that uses its own allocator for everything.
+	 *
+	 * @param allocator Allocator to be used by the document. (Copied)
+	 */
+	explicit Document(const pickle_allocator_t &allocator) :
+		m_doc(pickle_doc_new_allocator(&allocator)) {
+		if (m_doc == NULL)
+			throw std::bad_alloc();
+	}
+
+#ifdef PICKLE_HPP_HAS_PMR
+	/**
+	 * Creates a brand new document whose arena (and everything else) takes its
+	 * memory from a memory resource.
+	 *
+	 * @param resource Memory resource to allocate from. Must outlive the
+	 *                 document, and be thread-safe if it's going to be parsed
+	 *                 with parse_parallel.
+	 */
+	explicit Document(std::pmr::memory_resource *resource) :
+		Document(pmr_allocator(resource)) {}
+#endif /* PICKLE_HPP_HAS_PMR */
+
+	/**
+	 * Takes ownership of a document of the library.
+	 *
+	 * @param doc Document to be owned.
+	 */
+	explicit Document(pickle_doc_t *doc) noexcept : m_doc(doc) {}
+
+	Document(const Document &) = delete;
+	Document &operator=(const Document &) = delete;
+	Document(Document &&other) noexcept :
+		m_doc(std::exchange(other.m_doc, nullptr)) {}
+	Document &operator=(Document &&other) noexcept {
+		if (this != &other) {
+			if (m_doc != NULL)
+				pickle_doc_free(m_doc);
+			m_doc = std::exchange(other.m_doc, nullptr);
+		}
+
+		return *this;
+	}
+	~Document() {
+		if (m_doc != NULL)
+			pickle_doc_free(m_doc);
+	}
+
+	/**
+	 * Opens a document file.
+	 *
+	 * @param fname Path to the document file.
+	 * @param fmode Mode to open the file with.
+	 */
+	void open(const std::string &fname, const char *fmode = "r") {
+		detail::check(pickle_doc_fopen(m_doc, fname.c_str(), fmode));
+	}
+
+	/**
+	 * Opens an in-memory document.
+	 *
+	 * @warning The buffer must outlive the document.
+	 *
+	 * @param buf Contents of the document.
+	 */
+	void open_mem(std::string_view buf) {
+		detail::check(pickle_doc_open_mem(m_doc, buf.data(), buf.size()));
+	}
+
+	/**
+	 * Opens a document file by mapping it into memory.
+	 *
+	 * @param fname Path to the document file.
+	 */
+	void mmap(const std::string &fname) {
+		detail::check(pickle_doc_mmap(m_doc, fname.c_str()));
+	}
+
+	/**
+	 * Closes the document's file. Objects parsed in view mode from a mapped
+	 * file stay valid, since its mapping is only released by reset() or when
+	 * the document goes away.
+	 */
+	void close() { detail::check(pickle_doc_fclose(m_doc)); }
+
+	/** Throws away everything that was parsed and rewinds the document. */
+	void reset() { detail::check(pickle_doc_reset(m_doc)); }
+
+	/** Parses the whole document. */
+	void parse() { detail::check(pickle_doc_parse(m_doc)); }
+
+	/**
+	 * Parses the document using several threads.
+	 *
+	 * @warning The document's allocator is used by every thread at once, so it
+	 *          must be thread-safe. (see pmr_allocator)
+	 *
+	 * @param threads   Number of workers to use. 0 uses one per processor core.
+	 * @param min_chunk Smallest piece of the document worth its own worker. 0
+	 *                  for the default.
+	 */
+	void parse_parallel(unsigned int threads = 0, std::size_t min_chunk = 0) {
+		detail::check(pickle_doc_parse_parallel(m_doc, threads, min_chunk));
+	}
+
+	/**
+	 * Checks if the document is well-formed without building any objects.
+	 *
+	 * @param max_errors Stop after this many errors. 0 to go through the whole
+	 *                   document.
+	 *
+	 * @return Every error that was found. Empty if the document is valid.
+	 */
+	std::vector<pickle_error_t> validate(std::size_t max_errors = 0) {
+		std::vector<pickle_error_t> errors;
+		pickle_error_t *list;
+		std::size_t len;
+		pickle_err_t err;
+
+		err = pickle_doc_validate(m_doc, max_errors, &list, &len);
+		if (err != PICKLE_ERROR_PARSING)
+			detail::check(err);
+		if (list != NULL) {
+			try {
+				errors.assign(list, list + len);
+			} catch (...) {
+				pickle_free(list);
+				throw;
+			}
+			pickle_free(list);
+		}
+
+		return errors;
+	}
+
+	/**
+	 * Writes the document out as canonical PickLE text.
+	 *
+	 * @return Contents of the document.
+	 */
+	std::string write() const {
+		std::string str;
+		char *buf;
+		std::size_t len;
+
+		detail::check(pickle_doc_write_mem(m_doc, &buf, &len));
+		try {
+			str.assign(buf, len);
+		} catch (...) {
+			pickle_free(buf);
+			throw;
+		}
+		pickle_free(buf);
+
+		return str;
+	}
+
+	/** @return Range of the properties of the document. */
+	detail::Range<Property, pickle_property_t> properties() const noexcept {
+		return detail::Range<Property, pickle_property_t>(
+			m_doc->properties, m_doc->len_properties, m_doc);
+	}
+
+	/** @return Range of the categories of the document. */
+	detail::Range<Category, pickle_category_t> categories() const noexcept {
+		return detail::Range<Category, pickle_category_t>(
+			m_doc->categories, m_doc->len_categories, m_doc);
+	}
+
+	/** @return Range of the components of the document. */
+	detail::Range<Component, pickle_component_t> components() const noexcept {
+		return detail::Range<Component, pickle_component_t>(
+			m_doc->components, m_doc->len_components, m_doc);
+	}
+
+	/**
+	 * Finds a property of the document by its name.
+	 *
+	 * @param name Name of the property. (Case-sensitive)
+	 *
+	 * @return Borrowed property or an empty handle if there isn't one.
+	 */
+	Property find_property(std::string_view name) const {
+		return Property::borrow(const_cast<pickle_property_t *>(
+			pickle_doc_property_find(m_doc, std::string(name).c_str())), m_doc);
+	}
+
+	/**
+	 * Finds the component that has a reference designator.
+	 *
+	 * @param refdes Reference designator to look for.
+	 *
+	 * @return Borrowed component or an empty handle if there isn't one.
+	 */
+	Component find_refdes(std::string_view refdes) const {
+		return Component::borrow(pickle_doc_find_refdes(m_doc,
+			std::string(refdes).c_str()), m_doc);
+	}
+
+	/**
+	 * Sets the picked state of a component, updating the document's file in
+	 * place when possible.
+	 *
+	 * @param comp   Component of the document.
+	 * @param picked Has the component been picked?
+	 */
+	void set_picked(const Component &comp, bool picked) {
+		detail::check(pickle_doc_set_picked(m_doc, comp.get(), picked));
+	}
+
+	/**
+	 * Interns a string in the document's string table.
+	 *
+	 * @param str String to be interned.
+	 *
+	 * @return View of the canonical copy of the string, which lives as long as
+	 *         the document.
+	 */
+	std::string_view intern(std::string_view str) {
+		const char *interned;
+
+		interned = pickle_doc_intern(m_doc, str.data(), str.size());
+		if (interned == NULL)
+			throw std::bad_alloc();
+
+		return std::string_view(interned, str.size());
+	}
+
+	/** @return Brand new property that lives in the document's arena. */
+	Property new_property() {
+		pickle_property_t *prop;
+
+		prop = pickle_doc_property_new(m_doc);
+		if (prop == NULL)
+			throw std::bad_alloc();
+
+		return Property::borrow(prop, m_doc);
+	}
+
+	/** @return Brand new category that lives in the document's arena. */
+	Category new_category() {
+		pickle_category_t *cat;
+
+		cat = pickle_doc_category_new(m_doc);
+		if (cat == NULL)
+			throw std::bad_alloc();
+
+		return Category::borrow(cat, m_doc);
+	}
+
+	/** @return Brand new component that lives in the document's arena. */
+	Component new_component() {
+		pickle_component_t *comp;
+
+		comp = pickle_doc_component_new(m_doc);
+		if (comp == NULL)
+			throw std::bad_alloc();
+
+		return Component::borrow(comp, m_doc);
+	}
+
+	/**
+	 * Appends a property to the document, which takes ownership of it.
+	 *
+	 * @param prop Property to be appended.
+	 */
+	void add(Property &&prop) {
+		detail::check(pickle_doc_property_add(m_doc, prop.get()));
+		prop.release();
+	}
+
+	/**
+	 * Appends a category to the document, which takes ownership of it.
+	 *
+	 * @param cat Category to be appended.
+	 */
+	void add(Category &&cat) {
+		detail::check(pickle_doc_category_add(m_doc, cat.get()));
+		cat.release();
+	}
+
+	/**
+	 * Appends a component to the document, which takes ownership of it.
+	 *
+	 * @param comp Component to be appended.
+	 */
+	void add(Component &&comp) {
+		detail::check(pickle_doc_component_add(m_doc, comp.get()));
+		comp.release();
+	}
+
+	/** @return Wrapped document. */
+	pickle_doc_t *get() const noexcept { return m_doc; }
+
+	/**
+	 * Gives up the ownership of the document.
+	 *
+	 * @return Wrapped document, that's now your responsibility.
+	 */
+	pickle_doc_t *release() noexcept {
+		return std::exchange(m_doc, nullptr);
+	}
+
+	/** @return Does this object hold a document? */
+	explicit operator bool() const noexcept { return m_doc != NULL; }
+
+private:
+	pickle_doc_t *m_doc;
+};
+
+} /* namespace pickle */
+
+#endif /* _PICKLE_HPP */
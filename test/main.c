@@ -60,6 +60,26 @@ int main(int argc, char **argv) {
 		printf("\t- %s\n", cat->name);
 	}
 
+	/* Print the components. */
+	printf("Got %lu components!\n", doc->len_components);
+	for (i = 0; i < doc->len_components; i++) {
+		const pickle_component_t *comp = doc->components[i];
+		size_t j;
+
+		printf("\t[%c] %u %s", (comp->picked) ? 'X' : ' ', comp->quantity,
+			   comp->name);
+		if (comp->value != NULL)
+			printf(" (%s)", comp->value);
+		if (comp->description != NULL)
+			printf(" \"%s\"", comp->description);
+		if (comp->package != NULL)
+			printf(" [%s]", comp->package);
+		printf(" <%s>\n\t   ", comp->category->name);
+		for (j = 0; j < comp->refdes.length; j++)
+			printf(" %s", comp->refdes.refdes[j]);
+		printf("\n");
+	}
+
 	/* Close everything up. */
 	err = pickle_doc_free(doc);
 	IF_PICKLE_ERROR(err) {
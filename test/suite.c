@@ -0,0 +1,1791 @@
+/**
+ * libpickle Unit Tests
+ * Checks the behaviour of the library against small known documents and exits
+ * with a non-zero status if anything didn't turn out as expected.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/pickle.h"
+
+/* Checks a condition and records it if it failed. */
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+/* Test case. */
+typedef struct {
+	const char *name;
+	void (*run)(void);
+} test_case_t;
+
+/* Everything a push parser has handed to its callbacks. */
+typedef struct {
+	char text[1024];
+	size_t len;
+	size_t longest;
+} push_log_t;
+
+/* Number of objects a streaming parser has handed to its callbacks. */
+typedef struct {
+	size_t properties;
+	size_t categories;
+	size_t components;
+	size_t kept;
+	size_t stop_at;
+	pickle_err_t stop_with;
+} stream_count_t;
+
+/* Document used throughout the tests. */
+static const char *test_doc =
+	"Name: Test Board\n"
+	"Revision: A\n"
+	"\n"
+	"---\n"
+	"\n"
+	"Capacitor:\n"
+	"[X]\t6\tC0805\t(0.1u)\t\"Ceramic Capacitor\"\t[C0805]\n"
+	"C1 C2 C3 C4 C5 C6\n"
+	"\n"
+	"[ ]\t1\tC0805\t(1u)\t\"Ceramic Capacitor\"\t[C0805]\n"
+	"C7\n"
+	"\n"
+	"Resistor:\n"
+	"[ ]\t2\tR0805\t(10k)\t\"Resistor\"\t[R0805]\n"
+	"R1 R2\n"
+	"\n"
+	"[X]\t1\tR0805\t(100)\n"
+	"R3\n";
+
+/* Test document compressed with gzip. */
+static const unsigned char test_doc_gz[] = {
+	0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x85, 0xCE,
+	0x31, 0x0F, 0x82, 0x30, 0x10, 0x05, 0xE0, 0xF9, 0xDE, 0xAF, 0xB8, 0x30,
+	0xC9, 0x80, 0x69, 0x41, 0xD4, 0xB0, 0xE9, 0xED, 0x0E, 0x8D, 0x83, 0x09,
+	0x61, 0x68, 0xB0, 0x43, 0x63, 0x10, 0x43, 0xD1, 0xDF, 0x6F, 0x03, 0xA2,
+	0xA3, 0xF3, 0xBD, 0xEF, 0xDD, 0x3B, 0xD9, 0xCE, 0x55, 0x7C, 0x76, 0x61,
+	0xE4, 0x63, 0x6F, 0x87, 0x2B, 0x8C, 0x7B, 0xF9, 0xE0, 0xFB, 0x7B, 0xC5,
+	0x07, 0x20, 0xCB, 0x32, 0x40, 0xEC, 0xC3, 0xB6, 0x7E, 0xEC, 0x87, 0x0A,
+	0xF5, 0xA5, 0xA1, 0x2D, 0x89, 0xDA, 0xAB, 0x92, 0x56, 0x6A, 0xAD, 0x9F,
+	0x29, 0x25, 0xE2, 0x06, 0xDB, 0xF9, 0x96, 0xBF, 0xB1, 0x84, 0xEA, 0x29,
+	0xD1, 0x40, 0x34, 0x4B, 0xCE, 0x52, 0xB0, 0x6C, 0x58, 0x4A, 0x96, 0x2D,
+	0x50, 0x73, 0x43, 0x7A, 0x69, 0xF8, 0xEB, 0x77, 0x88, 0x7B, 0x82, 0x0F,
+	0xF3, 0xF3, 0x48, 0x73, 0x32, 0x1F, 0xAA, 0x6E, 0xD1, 0x2E, 0xC7, 0x48,
+	0xCC, 0x4C, 0x8C, 0x66, 0x93, 0x63, 0x1A, 0xAA, 0x7F, 0x59, 0x95, 0xC2,
+	0x14, 0x78, 0x03, 0xF9, 0x98, 0x21, 0xEF, 0xEC, 0x00, 0x00, 0x00,
+};
+
+/* Assertion bookkeeping. */
+static unsigned int checks = 0;
+static unsigned int failures = 0;
+
+/* Number of allocations the failing allocator still lets through. */
+static unsigned int alloc_budget = 0;
+
+/* Library internals that are checked directly. (Not part of the public API) */
+void pickle_scan_classify(const char *block, uint32_t *masks);
+void pickle_scan_classify_c(const char *block, size_t len, uint32_t *masks);
+
+/* Private methods. */
+void check(int cond, const char *expr, const char *file, int line);
+pickle_doc_t *parse_str(const char *str, pickle_err_t *err);
+pickle_doc_t *parse_buf(const char *buf, size_t len, unsigned int threads, pickle_err_t *err);
+pickle_err_t validate_str(const char *str, size_t max_errors, pickle_error_t **errors, size_t *len);
+void *failing_alloc(size_t size, void *ctx);
+void *failing_realloc(void *ptr, size_t size, void *ctx);
+void failing_free(void *ptr, void *ctx);
+bool is_test_doc(const pickle_doc_t *doc);
+char *gen_doc(size_t categories, size_t components, size_t *len);
+char *gen_fillers(const char *head, char prefix, size_t fillers, size_t *len);
+pickle_doc_t *merge_docs(pickle_doc_t **docs, const char **prefixes, size_t len, unsigned int threads);
+bool write_file(const char *fname, const char *str);
+bool write_data(const char *fname, const void *data, size_t len);
+void push_record(push_log_t *log, char tag, const char *str, size_t len);
+pickle_err_t push_property(pickle_property_t *prop, void *userdata);
+pickle_err_t push_category(pickle_category_t *cat, void *userdata);
+pickle_err_t push_component(pickle_component_t *comp, void *userdata);
+pickle_err_t push_chunked(const char *str, size_t len, size_t chunk, push_log_t *log);
+pickle_err_t stream_property(pickle_property_t *prop, void *userdata);
+pickle_err_t stream_category(pickle_category_t *cat, void *userdata);
+pickle_err_t stream_component(pickle_component_t *comp, void *userdata);
+pickle_err_t stream_str(const char *str, stream_count_t *count);
+pickle_err_t diff_property(pickle_diff_type_t type, const pickle_property_t *a, const pickle_property_t *b, void *userdata);
+pickle_err_t diff_component(pickle_diff_type_t type, unsigned int fields, const pickle_component_t *a, const pickle_component_t *b, void *userdata);
+void test_parse(void);
+void test_quantity(void);
+void test_oom(void);
+void test_iter(void);
+void test_refdes(void);
+void test_compiled(void);
+void test_simd(void);
+void test_writer(void);
+void test_picked(void);
+void test_stats(void);
+void test_batch(void);
+void test_push(void);
+void test_merge(void);
+void test_diff(void);
+void test_validate(void);
+void test_parallel(void);
+void test_view(void);
+void test_columns(void);
+void test_property_find(void);
+void test_stream(void);
+void test_reserve(void);
+void test_mmap(void);
+void test_intern(void);
+
+/* Every test case, in the order they are run. */
+static const test_case_t tests[] = {
+	{ "parse", test_parse },
+	{ "quantity", test_quantity },
+	{ "oom", test_oom },
+	{ "iter", test_iter },
+	{ "refdes", test_refdes },
+	{ "compiled", test_compiled },
+	{ "simd", test_simd },
+	{ "writer", test_writer },
+	{ "picked", test_picked },
+	{ "stats", test_stats },
+	{ "batch", test_batch },
+	{ "push", test_push },
+	{ "merge", test_merge },
+	{ "diff", test_diff },
+	{ "validate", test_validate },
+	{ "parallel", test_parallel },
+	{ "view", test_view },
+	{ "columns", test_columns },
+	{ "property_find", test_property_find },
+	{ "stream", test_stream },
+	{ "reserve", test_reserve },
+	{ "mmap", test_mmap },
+	{ "intern", test_intern },
+	{ NULL, NULL }
+};
+
+int main(int argc, char **argv) {
+	const test_case_t *test;
+
+	(void)argc;
+	(void)argv;
+
+	printf("libpickle Unit Tests\n\n");
+
+	/* Run every test case. */
+	for (test = tests; test->name != NULL; test++) {
+		unsigned int before;
+
+		before = failures;
+		test->run();
+		printf("%s %s\n", (failures == before) ? "[ OK ]" : "[FAIL]",
+			   test->name);
+	}
+
+	printf("\n%u checks, %u failed.\n", checks, failures);
+	return (failures == 0) ? 0 : 1;
+}
+
+/**
+ * Records the result of a check and reports it if it failed.
+ *
+ * @param cond Result of the check.
+ * @param expr Expression that was checked.
+ * @param file Source file where the check is.
+ * @param line Line where the check is.
+ */
+void check(int cond, const char *expr, const char *file, int line) {
+	checks++;
+	if (cond)
+		return;
+
+	failures++;
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+}
+
+/**
+ * Parses a document from a string.
+ *
+ * @param str String with the whole document.
+ * @param err Gets the status of the parsing.
+ *
+ * @return Parsed document. It must always be free'd, even when parsing failed.
+ */
+pickle_doc_t *parse_str(const char *str, pickle_err_t *err) {
+	pickle_doc_t *doc;
+
+	doc = pickle_doc_new();
+	*err = pickle_doc_open_mem(doc, str, strlen(str));
+	IF_PICKLE_ERROR(*err)
+		return doc;
+	*err = pickle_doc_parse(doc);
+
+	return doc;
+}
+
+/**
+ * Parses a document from a buffer, optionally on several threads.
+ *
+ * @param buf     Document to be parsed.
+ * @param len     Length of the document.
+ * @param threads Number of threads to use or 0 to parse it serially.
+ * @param err     Where the result of the parse is stored.
+ *
+ * @return Newly allocated document, even if parsing failed.
+ */
+pickle_doc_t *parse_buf(const char *buf, size_t len, unsigned int threads, pickle_err_t *err) {
+	pickle_doc_t *doc;
+
+	doc = pickle_doc_new();
+	*err = pickle_doc_open_mem(doc, buf, len);
+	IF_PICKLE_ERROR(*err)
+		return doc;
+	if (threads == 0) {
+		*err = pickle_doc_parse(doc);
+	} else {
+		*err = pickle_doc_parse_parallel(doc, threads, 4096);
+	}
+
+	return doc;
+}
+
+/**
+ * Validates a document from a string.
+ *
+ * @param str        Document to be validated.
+ * @param max_errors Stop after this many errors. 0 for no limit.
+ * @param errors     Where to store the errors or NULL.
+ * @param len        Number of errors that were found. May be NULL.
+ *
+ * @return Same as pickle_doc_validate.
+ */
+pickle_err_t validate_str(const char *str, size_t max_errors, pickle_error_t **errors, size_t *len) {
+	pickle_doc_t *doc;
+	pickle_err_t err;
+
+	doc = pickle_doc_new();
+	err = pickle_doc_open_mem(doc, str, strlen(str));
+	if (err == PICKLE_OK)
+		err = pickle_doc_validate(doc, max_errors, errors, len);
+	pickle_doc_free(doc);
+
+	return err;
+}
+
+/**
+ * Allocation function that fails once the allocation budget is exhausted.
+ *
+ * @param size Size of the block.
+ * @param ctx  Unused.
+ *
+ * @return Allocated block or NULL if we're over budget.
+ */
+void *failing_alloc(size_t size, void *ctx) {
+	(void)ctx;
+	if (alloc_budget == 0)
+		return NULL;
+
+	alloc_budget--;
+	return malloc(size);
+}
+
+/**
+ * Reallocation function that fails once the allocation budget is exhausted.
+ *
+ * @param ptr  Block to be resized.
+ * @param size New size of the block.
+ * @param ctx  Unused.
+ *
+ * @return Resized block or NULL if we're over budget.
+ */
+void *failing_realloc(void *ptr, size_t size, void *ctx) {
+	(void)ctx;
+	if (alloc_budget == 0)
+		return NULL;
+
+	alloc_budget--;
+	return realloc(ptr, size);
+}
+
+/**
+ * Deallocation function of the failing allocator.
+ *
+ * @param ptr Block to be free'd.
+ * @param ctx Unused.
+ */
+void failing_free(void *ptr, void *ctx) {
+	(void)ctx;
+	free(ptr);
+}
+
+/**
+ * Checks if a document holds everything that's in the test document.
+ *
+ * @param doc Document to be checked.
+ *
+ * @return TRUE if the document matches the test document.
+ */
+bool is_test_doc(const pickle_doc_t *doc) {
+	size_t i;
+	size_t j;
+
+	if ((doc->len_properties != 2) || (doc->len_categories != 2) ||
+			(doc->len_components != 4)) {
+		return false;
+	}
+
+	for (i = 0; i < doc->len_properties; i++) {
+		if ((doc->properties[i]->name == NULL) ||
+				(doc->properties[i]->value == NULL)) {
+			return false;
+		}
+	}
+	for (i = 0; i < doc->len_categories; i++) {
+		if (doc->categories[i]->name == NULL)
+			return false;
+	}
+	for (i = 0; i < doc->len_components; i++) {
+		const pickle_component_t *comp = doc->components[i];
+
+		if ((comp->name == NULL) || (comp->value == NULL) ||
+				(comp->refdes.length == 0)) {
+			return false;
+		}
+		for (j = 0; j < comp->refdes.length; j++) {
+			if (comp->refdes.refdes[j] == NULL)
+				return false;
+		}
+	}
+
+	return (doc->components[0]->description != NULL) &&
+		(doc->components[0]->package != NULL);
+}
+
+/**
+ * Generates a large document where the components of each category are
+ * numbered. (C<category>_<component>)
+ *
+ * @param categories Number of categories.
+ * @param components Number of components in each category.
+ * @param len        Gets the length of the document.
+ *
+ * @return Generated document. (Free it with free)
+ */
+char *gen_doc(size_t categories, size_t components, size_t *len) {
+	char *buf;
+	size_t i;
+	size_t j;
+
+	buf = (char *)malloc((categories * 16) + (categories * components * 80) +
+						 32);
+	*len = sprintf(buf, "Name: Generated\n\n---\n");
+	for (i = 0; i < categories; i++) {
+		*len += sprintf(buf + *len, "\nCat%lu:\n", (unsigned long)i);
+		for (j = 0; j < components; j++) {
+			*len += sprintf(buf + *len, "[%c] %lu C%lu_%lu (%lu) "
+							"\"Description\" [PKG]\nR%lu U%lu\n",
+							(j % 2) ? 'X' : ' ', (unsigned long)(j + 1),
+							(unsigned long)i, (unsigned long)j,
+							(unsigned long)j, (unsigned long)j,
+							(unsigned long)j);
+		}
+	}
+
+	return buf;
+}
+
+/**
+ * Counts a property handed to us by a streaming parser.
+ *
+ * @param prop     Property that was parsed.
+ * @param userdata Streaming parser counts.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t stream_property(pickle_property_t *prop, void *userdata) {
+	(void)prop;
+	((stream_count_t *)userdata)->properties++;
+	return PICKLE_OK;
+}
+
+/**
+ * Counts a category handed to us by a streaming parser.
+ *
+ * @param cat      Category that was parsed.
+ * @param userdata Streaming parser counts.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t stream_category(pickle_category_t *cat, void *userdata) {
+	(void)cat;
+	((stream_count_t *)userdata)->categories++;
+	return PICKLE_OK;
+}
+
+/**
+ * Counts a component handed to us by a streaming parser and stops the parser
+ * once the requested number of them was reached.
+ *
+ * @param comp     Component that was parsed.
+ * @param userdata Streaming parser counts.
+ *
+ * @return PICKLE_OK or whatever we were asked to stop the parser with.
+ */
+pickle_err_t stream_component(pickle_component_t *comp, void *userdata) {
+	stream_count_t *count;
+
+	(void)comp;
+	count = (stream_count_t *)userdata;
+	count->components++;
+	if (count->components == count->stop_at)
+		return count->stop_with;
+
+	return PICKLE_OK;
+}
+
+/**
+ * Parses a document from a string as a stream of events and counts them.
+ *
+ * @param str   Document to be parsed.
+ * @param count Counts of the objects, along with when to stop the parser.
+ *              Also gets how many objects ended up in the document.
+ *
+ * @return Same as pickle_parse_stream.
+ */
+pickle_err_t stream_str(const char *str, stream_count_t *count) {
+	pickle_handlers_t handlers;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+
+	handlers.on_property = stream_property;
+	handlers.on_category = stream_category;
+	handlers.on_component = stream_component;
+	count->properties = 0;
+	count->categories = 0;
+	count->components = 0;
+
+	doc = pickle_doc_new();
+	err = pickle_doc_open_mem(doc, str, strlen(str));
+	if (err == PICKLE_OK)
+		err = pickle_parse_stream(doc, &handlers, count);
+	count->kept = doc->len_properties + doc->len_categories +
+		doc->len_components;
+	pickle_doc_free(doc);
+
+	return err;
+}
+
+/**
+ * Logs a property that differs between two documents.
+ *
+ * @param type     Kind of difference.
+ * @param a        Property of the old document or NULL.
+ * @param b        Property of the new document or NULL.
+ * @param userdata Log where the difference is recorded.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t diff_property(pickle_diff_type_t type, const pickle_property_t *a, const pickle_property_t *b, void *userdata) {
+	char tag;
+
+	tag = (char)('0' + type);
+	if (b != NULL) {
+		push_record((push_log_t *)userdata, tag, b->name, b->len_name);
+	} else {
+		push_record((push_log_t *)userdata, tag, a->name, a->len_name);
+	}
+
+	return PICKLE_OK;
+}
+
+/**
+ * Logs a component that differs between two documents.
+ *
+ * @param type     Kind of difference.
+ * @param fields   Fields that differ. (see pickle_diff_field_t)
+ * @param a        Component of the old document or NULL.
+ * @param b        Component of the new document or NULL.
+ * @param userdata Log where the difference is recorded.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t diff_component(pickle_diff_type_t type, unsigned int fields, const pickle_component_t *a, const pickle_component_t *b, void *userdata) {
+	const pickle_component_t *comp;
+	char buf[32];
+
+	comp = (b != NULL) ? b : a;
+	sprintf(buf, "%c%02X:%s", (char)('0' + type), fields,
+			(comp->refdes.length > 0) ? comp->refdes.refdes[0] : "");
+	push_record((push_log_t *)userdata, 'c', buf, strlen(buf));
+
+	return PICKLE_OK;
+}
+
+/**
+ * Generates a document that starts with a fixed head and is followed by a lot
+ * of components that show up only once.
+ *
+ * @param head    Start of the document, up to the category of the fillers.
+ * @param prefix  Prefix of the names of the fillers.
+ * @param fillers Number of filler components.
+ * @param len     Gets the length of the document.
+ *
+ * @return Document. Free it with free.
+ */
+char *gen_fillers(const char *head, char prefix, size_t fillers, size_t *len) {
+	char *buf;
+	size_t i;
+
+	buf = (char *)malloc(strlen(head) + (fillers * 48) + 1);
+	strcpy(buf, head);
+	*len = strlen(head);
+	for (i = 0; i < fillers; i++) {
+		*len += sprintf(buf + *len, "[X] 1 %c%lu\n%c%lu\n", prefix,
+						(unsigned long)i, prefix, (unsigned long)i);
+	}
+
+	return buf;
+}
+
+/**
+ * Merges documents into a brand new one.
+ *
+ * @param docs     Documents to be merged.
+ * @param prefixes Prefix of the reference designators of each document.
+ * @param len      Number of documents.
+ * @param threads  Number of workers to use.
+ *
+ * @return Merged document or NULL if the merge failed.
+ */
+pickle_doc_t *merge_docs(pickle_doc_t **docs, const char **prefixes, size_t len, unsigned int threads) {
+	pickle_doc_t *doc;
+
+	doc = pickle_doc_new();
+	if (pickle_doc_merge(doc, docs, prefixes, len, threads) != PICKLE_OK) {
+		pickle_doc_free(doc);
+		return NULL;
+	}
+
+	return doc;
+}
+
+/**
+ * Writes a string out to a file.
+ *
+ * @param fname Path to the file.
+ * @param str   Contents of the file.
+ *
+ * @return TRUE if the file was written.
+ */
+bool write_file(const char *fname, const char *str) {
+	return write_data(fname, str, strlen(str));
+}
+
+/**
+ * Writes a block of data out to a file.
+ *
+ * @param fname Path to the file.
+ * @param data  Contents of the file.
+ * @param len   Length of the contents.
+ *
+ * @return TRUE if the file was written.
+ */
+bool write_data(const char *fname, const void *data, size_t len) {
+	FILE *fh;
+	bool ok;
+
+	fh = fopen(fname, "wb");
+	if (fh == NULL)
+		return false;
+	ok = fwrite(data, 1, len, fh) == len;
+	return (fclose(fh) == 0) && ok;
+}
+
+/**
+ * Appends a field to the log of a push parser.
+ *
+ * @param log Push parser log.
+ * @param tag Character that identifies the field.
+ * @param str Contents of the field. (May be NULL)
+ * @param len Length of the contents.
+ */
+void push_record(push_log_t *log, char tag, const char *str, size_t len) {
+	if (len > log->longest)
+		log->longest = len;
+	if ((str == NULL) || ((log->len + len + 3) > sizeof(log->text)))
+		len = 0;
+
+	log->text[log->len++] = tag;
+	if (len > 0)
+		memcpy(log->text + log->len, str, len);
+	log->len += len;
+	log->text[log->len++] = ';';
+	log->text[log->len] = '\0';
+}
+
+/**
+ * Logs a property handed to us by a push parser.
+ *
+ * @param prop     Property that was parsed.
+ * @param userdata Push parser log.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t push_property(pickle_property_t *prop, void *userdata) {
+	push_record((push_log_t *)userdata, 'P', prop->name, prop->len_name);
+	push_record((push_log_t *)userdata, '=', prop->value, prop->len_value);
+	return PICKLE_OK;
+}
+
+/**
+ * Logs a category handed to us by a push parser.
+ *
+ * @param cat      Category that was parsed.
+ * @param userdata Push parser log.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t push_category(pickle_category_t *cat, void *userdata) {
+	push_record((push_log_t *)userdata, 'C', cat->name, cat->len_name);
+	return PICKLE_OK;
+}
+
+/**
+ * Logs a component handed to us by a push parser.
+ *
+ * @param comp     Component that was parsed.
+ * @param userdata Push parser log.
+ *
+ * @return PICKLE_OK.
+ */
+pickle_err_t push_component(pickle_component_t *comp, void *userdata) {
+	push_log_t *log;
+	char buf[64];
+
+	log = (push_log_t *)userdata;
+	sprintf(buf, "%c%u/%lu", (comp->picked) ? 'X' : ' ', comp->quantity,
+			(unsigned long)comp->refdes.length);
+	push_record(log, 'c', comp->name, comp->len_name);
+	push_record(log, '(', comp->value, comp->len_value);
+	push_record(log, '"', comp->description, comp->len_description);
+	push_record(log, '[', comp->package, comp->len_package);
+	push_record(log, '#', buf, strlen(buf));
+	return PICKLE_OK;
+}
+
+/**
+ * Feeds a document to a push parser in chunks of a fixed size.
+ *
+ * @param str   Contents of the document.
+ * @param len   Length of the document.
+ * @param chunk Size of each chunk.
+ * @param log   Gets everything that was handed to the callbacks.
+ *
+ * @return Result of the whole parsing.
+ */
+pickle_err_t push_chunked(const char *str, size_t len, size_t chunk, push_log_t *log) {
+	pickle_handlers_t handlers;
+	pickle_parser_t parser;
+	pickle_err_t err;
+	size_t i;
+
+	handlers.on_property = push_property;
+	handlers.on_category = push_category;
+	handlers.on_component = push_component;
+	memset(log, 0, sizeof(push_log_t));
+	err = pickle_parser_init(&parser, &handlers, log);
+	if (err != PICKLE_OK)
+		return err;
+
+	for (i = 0; (err == PICKLE_OK) && (i < len); i += chunk)
+		err = pickle_parser_feed(&parser, str + i, ((len - i) < chunk) ?
+								 (len - i) : chunk);
+	if (err == PICKLE_OK)
+		err = pickle_parser_finish(&parser);
+	pickle_parser_free(&parser);
+
+	return err;
+}
+
+/**
+ * Parses the test document and checks that everything ended up where it should.
+ */
+void test_parse(void) {
+	pickle_doc_t *doc;
+	pickle_err_t err;
+
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(doc->len_properties == 2);
+	CHECK(doc->len_categories == 2);
+	CHECK(doc->len_components == 4);
+	if (doc->len_components == 4) {
+		CHECK(doc->components[0]->picked);
+		CHECK(doc->components[0]->quantity == 6);
+		CHECK(strcmp(doc->components[0]->value, "0.1u") == 0);
+		CHECK(doc->components[0]->refdes.length == 6);
+		CHECK(doc->components[3]->description == NULL);
+		CHECK(doc->components[3]->package == NULL);
+		CHECK(doc->components[3]->category == doc->categories[1]);
+	}
+
+	pickle_doc_free(doc);
+}
+
+/**
+ * Checks that quantities are parsed up to UINT_MAX and rejected beyond it.
+ */
+void test_quantity(void) {
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	char buf[128];
+
+	/* Largest quantity that fits. */
+	sprintf(buf, "---\nCat:\n[ ] %u R0805\nR1\n", UINT_MAX);
+	doc = parse_str(buf, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK((doc->len_components == 1) &&
+		  (doc->components[0]->quantity == UINT_MAX));
+	pickle_doc_free(doc);
+
+	/* Anything past it. */
+	sprintf(buf, "---\nCat:\n[ ] %u0 R0805\nR1\n", UINT_MAX / 10 + 1);
+	doc = parse_str(buf, &err);
+	CHECK(err == PICKLE_ERROR_PARSING);
+	CHECK(doc->len_components == 0);
+	pickle_doc_free(doc);
+}
+
+/**
+ * Runs the parser out of memory at every allocation it makes and checks that it
+ * always reports it instead of leaving holes in the document.
+ */
+void test_oom(void) {
+	const char *fname = "../build/suite_oom.pkl";
+	pickle_allocator_t allocator;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	unsigned int budget;
+
+	allocator.alloc = failing_alloc;
+	allocator.realloc = failing_realloc;
+	allocator.free = failing_free;
+	allocator.ctx = NULL;
+
+	for (budget = 0; budget < 1000; budget++) {
+		alloc_budget = budget;
+		doc = pickle_doc_new_allocator(&allocator);
+		if (doc == NULL)
+			continue;
+
+		err = pickle_doc_open_mem(doc, test_doc, strlen(test_doc));
+		if (err == PICKLE_OK)
+			err = pickle_doc_parse(doc);
+		if ((err != PICKLE_OK) && (err != PICKLE_ERROR_MEMORY)) {
+			CHECK((err == PICKLE_OK) || (err == PICKLE_ERROR_MEMORY));
+			pickle_doc_free(doc);
+			break;
+		}
+		if (err == PICKLE_OK) {
+			CHECK(is_test_doc(doc));
+			pickle_doc_free(doc);
+			break;
+		}
+
+		pickle_doc_free(doc);
+	}
+	CHECK(budget < 1000);
+
+	/* Same thing, but with the line buffer of a file. */
+	CHECK(write_file(fname, test_doc));
+	for (budget = 0; budget < 1000; budget++) {
+		alloc_budget = budget;
+		doc = pickle_doc_new_allocator(&allocator);
+		if (doc == NULL)
+			continue;
+
+		err = pickle_doc_fopen(doc, fname, "r");
+		if (err == PICKLE_OK)
+			err = pickle_doc_parse(doc);
+		if ((err != PICKLE_OK) && (err != PICKLE_ERROR_MEMORY)) {
+			CHECK((err == PICKLE_OK) || (err == PICKLE_ERROR_MEMORY));
+			pickle_doc_free(doc);
+			break;
+		}
+		if (err == PICKLE_OK) {
+			CHECK(is_test_doc(doc));
+			pickle_doc_free(doc);
+			break;
+		}
+
+		pickle_doc_free(doc);
+	}
+	CHECK(budget < 1000);
+	remove(fname);
+}
+
+/**
+ * Walks a large document with an iterator, both on its own and interleaved
+ * with another one, checking that every object comes out right and that the
+ * arena doesn't keep growing with every event.
+ */
+void test_iter(void) {
+	const pickle_arena_chunk_t *chunk;
+	pickle_event_t ea;
+	pickle_event_t eb;
+	pickle_iter_t a;
+	pickle_iter_t b;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	unsigned long cat;
+	unsigned long comp;
+	unsigned int chunks;
+	size_t count;
+	size_t len;
+	char name[64];
+	char *buf;
+	bool same;
+
+	buf = gen_doc(4, 5000, &len);
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_open_mem(doc, buf, len) == PICKLE_OK);
+
+	/* Walk the whole document. */
+	pickle_iter_init(&a);
+	count = 0;
+	cat = 0;
+	comp = 0;
+	same = true;
+	while ((err = pickle_iter_next(doc, &a, &ea)) == PICKLE_OK) {
+		if (ea.type == PICKLE_EVENT_CATEGORY) {
+			sscanf(ea.category->name, "Cat%lu", &cat);
+			comp = 0;
+		} else if (ea.type == PICKLE_EVENT_COMPONENT) {
+			sprintf(name, "C%lu_%lu", cat, comp);
+			sprintf(name + 32, "Cat%lu", cat);
+			same = same && (strcmp(ea.component->name, name) == 0) &&
+				(strcmp(ea.component->category->name, name + 32) == 0) &&
+				(ea.component->refdes.length == 2) &&
+				(ea.component->quantity == comp + 1);
+			comp++;
+			count++;
+		}
+	}
+	CHECK(err == PICKLE_FINISHED_PARSING);
+	CHECK(count == 4 * 5000);
+	CHECK(same);
+
+	/* Objects of old events are thrown away. */
+	chunks = 0;
+	for (chunk = doc->arena.head; chunk != NULL; chunk = chunk->next)
+		chunks++;
+	CHECK(chunks == 1);
+
+	/* Walk it again with two interleaved iterators, one an object ahead. */
+	pickle_iter_init(&a);
+	pickle_iter_init(&b);
+	CHECK(pickle_iter_next(doc, &b, &eb) == PICKLE_OK);
+	CHECK(eb.type == PICKLE_EVENT_PROPERTY);
+	strcpy(name, eb.property->name);
+	same = true;
+	count = 0;
+	for (;;) {
+		err = pickle_iter_next(doc, &a, &ea);
+		if (err != PICKLE_OK)
+			break;
+		same = same && (strcmp(name, (ea.type == PICKLE_EVENT_COMPONENT) ?
+			ea.component->name : ((ea.type == PICKLE_EVENT_CATEGORY) ?
+			ea.category->name : ea.property->name)) == 0);
+		count++;
+
+		err = pickle_iter_next(doc, &b, &eb);
+		if (err != PICKLE_OK)
+			break;
+		strcpy(name, (eb.type == PICKLE_EVENT_COMPONENT) ?
+			eb.component->name : ((eb.type == PICKLE_EVENT_CATEGORY) ?
+			eb.category->name : eb.property->name));
+	}
+	CHECK(err == PICKLE_FINISHED_PARSING);
+	CHECK(count == 1 + 4 + (4 * 5000));
+	CHECK(same);
+
+	pickle_doc_free(doc);
+	free(buf);
+}
+
+/**
+ * Goes through the life of a compiled document: built from a parse, loaded
+ * back, and thrown away once its source changes.
+ */
+void test_compiled(void) {
+	const char *srcname = "../build/suite_compiled.pkl";
+	const char *cname = "../build/suite_compiled.pklc";
+	pickle_doc_t *doc;
+	char *buf;
+	char *pos;
+
+	remove(cname);
+	CHECK(write_file(srcname, test_doc));
+
+	/* Nothing to load yet, so it gets parsed and compiled. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_load_compiled(doc, cname, srcname) == PICKLE_OK);
+	CHECK(doc->compiled == NULL);
+	CHECK(is_test_doc(doc));
+	pickle_doc_free(doc);
+
+	/* Now it's loaded from the compiled version. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_load_compiled(doc, cname, srcname) == PICKLE_OK);
+	CHECK(doc->compiled != NULL);
+	CHECK(is_test_doc(doc));
+	pickle_doc_free(doc);
+
+	/* Change the source without changing its size. */
+	buf = (char *)malloc(strlen(test_doc) + 1);
+	strcpy(buf, test_doc);
+	pos = strstr(buf, "\t6\t");
+	pos[1] = '7';
+	CHECK(write_file(srcname, buf));
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_load_compiled(doc, cname, srcname) == PICKLE_OK);
+	CHECK(doc->compiled == NULL);
+	CHECK((doc->len_components == 4) && (doc->components[0]->quantity == 7));
+	pickle_doc_free(doc);
+
+	/* The refreshed compiled version holds the change. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_load_compiled(doc, cname, srcname) == PICKLE_OK);
+	CHECK(doc->compiled != NULL);
+	CHECK((doc->len_components == 4) && (doc->components[0]->quantity == 7));
+	pickle_doc_free(doc);
+
+	/* Compiled documents can be trusted without a source. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_load_compiled(doc, cname, NULL) == PICKLE_OK);
+	CHECK(doc->compiled != NULL);
+	pickle_doc_free(doc);
+
+	free(buf);
+	remove(srcname);
+	remove(cname);
+}
+
+/**
+ * Checks that the vectorized character classification agrees with the portable
+ * one on random blocks, at every alignment.
+ */
+void test_simd(void) {
+	const char *alphabet = " \t:\")]([\"aZ09-\r\n\x80\xff";
+	uint32_t vmasks[5];
+	uint32_t cmasks[5];
+	unsigned long seed;
+	char buf[32 + 16];
+	unsigned int block;
+	unsigned int i;
+	bool same;
+
+	seed = 1;
+	same = true;
+	for (block = 0; block < 10000; block++) {
+		for (i = 0; i < sizeof(buf); i++) {
+			seed = (seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+			buf[i] = alphabet[(seed >> 16) % strlen(alphabet)];
+		}
+
+		pickle_scan_classify(buf + (block % 16), vmasks);
+		pickle_scan_classify_c(buf + (block % 16), 32, cmasks);
+		same = same && (memcmp(vmasks, cmasks, sizeof(vmasks)) == 0);
+	}
+	CHECK(same);
+}
+
+/**
+ * Looks components up by their reference designators, both in a small document
+ * and in one that makes the index grow.
+ */
+void test_refdes(void) {
+	const pickle_component_t *comp;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	size_t len;
+	char *buf;
+
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(pickle_doc_find_refdes(doc, "C3") == doc->components[0]);
+	CHECK(pickle_doc_find_refdes(doc, "C7") == doc->components[1]);
+	CHECK(pickle_doc_find_refdes(doc, "R3") == doc->components[3]);
+	CHECK(pickle_doc_find_refdes(doc, "R4") == NULL);
+	CHECK(pickle_doc_find_refdes(doc, "") == NULL);
+	pickle_doc_free(doc);
+
+	/* Designators that repeat belong to the first component that has them. */
+	buf = gen_doc(2, 3000, &len);
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_open_mem(doc, buf, len) == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	comp = pickle_doc_find_refdes(doc, "U2999");
+	CHECK((comp != NULL) && (strcmp(comp->name, "C0_2999") == 0));
+	comp = pickle_doc_find_refdes(doc, "R0");
+	CHECK((comp != NULL) && (strcmp(comp->name, "C0_0") == 0));
+	CHECK(pickle_doc_find_refdes(doc, "R3000") == NULL);
+	pickle_doc_free(doc);
+	free(buf);
+}
+
+/**
+ * Writes documents back out and checks that parsing them again gives the same
+ * thing, including components that don't belong to any category.
+ */
+void test_writer(void) {
+	pickle_component_t *comp;
+	pickle_doc_t *other;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	size_t len;
+	char *buf;
+
+	/* Round trip of the test document. */
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(pickle_doc_write_mem(doc, &buf, &len) == PICKLE_OK);
+	CHECK(strlen(buf) == len);
+	other = parse_str(buf, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(is_test_doc(other));
+	pickle_doc_free(other);
+	pickle_free(buf);
+
+	/* Component that was added without a category. */
+	comp = pickle_component_new();
+	CHECK(comp != NULL);
+	comp->quantity = 1;
+	comp->len_name = strlen("U1_MCU");
+	comp->name = (char *)malloc(comp->len_name + 1);
+	memcpy(comp->name, "U1_MCU", comp->len_name + 1);
+	CHECK(pickle_doc_component_add(doc, comp) == PICKLE_OK);
+	CHECK(pickle_doc_write_mem(doc, &buf, &len) == PICKLE_OK);
+	other = parse_str(buf, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(other->len_categories == 3);
+	CHECK(other->len_components == 5);
+	if (other->len_components == 5) {
+		CHECK(strcmp(other->components[4]->name, "U1_MCU") == 0);
+		CHECK(strcmp(other->components[4]->category->name,
+					 "Uncategorized") == 0);
+		CHECK(other->components[3]->category == other->categories[1]);
+	}
+	pickle_doc_free(other);
+	pickle_free(buf);
+	pickle_doc_free(doc);
+}
+
+/**
+ * Patches picked states straight in a document's file, but only when it was
+ * opened in a mode that can update it in place.
+ */
+void test_picked(void) {
+	const char *fname = "../build/suite_picked.pkl";
+	pickle_doc_t *doc;
+
+	CHECK(write_file(fname, test_doc));
+
+	/* Update it in place. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_fopen(doc, fname, "r+") == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(doc->len_components == 4);
+	if (doc->len_components == 4) {
+		CHECK(pickle_doc_set_picked(doc, doc->components[0], false) ==
+			  PICKLE_OK);
+		CHECK(pickle_doc_set_picked(doc, doc->components[1], true) ==
+			  PICKLE_OK);
+		CHECK(!doc->components[0]->picked && doc->components[1]->picked);
+	}
+	pickle_doc_free(doc);
+
+	/* Read it back. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_fopen(doc, fname, "r") == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(doc->len_components == 4);
+	if (doc->len_components == 4) {
+		CHECK(!doc->components[0]->picked && doc->components[1]->picked);
+		CHECK(!doc->components[2]->picked && doc->components[3]->picked);
+		CHECK(pickle_doc_set_picked(doc, doc->components[0], true) ==
+			  PICKLE_ERROR_FILE);
+	}
+	pickle_doc_free(doc);
+
+	/* Appending would write the marker at the end of the file instead. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_fopen(doc, fname, "a+") == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(doc->len_components == 4);
+	if (doc->len_components == 4) {
+		CHECK(pickle_doc_set_picked(doc, doc->components[0], true) ==
+			  PICKLE_ERROR_FILE);
+		CHECK(!doc->components[0]->picked);
+	}
+	pickle_doc_free(doc);
+
+	/* Binary update modes are fine too. */
+	doc = pickle_doc_new();
+	CHECK(pickle_doc_fopen(doc, fname, "rb+") == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(doc->len_components == 4);
+	if (doc->len_components == 4) {
+		CHECK(pickle_doc_set_picked(doc, doc->components[0], true) ==
+			  PICKLE_OK);
+	}
+	pickle_doc_free(doc);
+
+	remove(fname);
+}
+
+/**
+ * Checks that the parsing statistics account for every allocation made while
+ * parsing. (Only when the library was built with PICKLE_STATS)
+ */
+void test_stats(void) {
+	const pickle_stats_t *stats;
+	pickle_allocator_t allocator;
+	pickle_doc_t *doc;
+	size_t allocs;
+	size_t len;
+	char *buf;
+
+	allocator.alloc = failing_alloc;
+	allocator.realloc = failing_realloc;
+	allocator.free = failing_free;
+	allocator.ctx = NULL;
+
+	buf = gen_doc(4, 2000, &len);
+	alloc_budget = UINT_MAX;
+	doc = pickle_doc_new_allocator(&allocator);
+	CHECK(pickle_doc_open_mem(doc, buf, len) == PICKLE_OK);
+	if (pickle_doc_stats_hook(doc, NULL, NULL) == PICKLE_ERROR_NOT_IMPL) {
+		pickle_doc_free(doc);
+		free(buf);
+		return;
+	}
+
+	alloc_budget = UINT_MAX;
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	stats = pickle_doc_stats(doc);
+	CHECK(stats->bytes_read == len);
+	CHECK(stats->allocs == (UINT_MAX - alloc_budget));
+	CHECK(stats->bytes_allocated > len);
+	allocs = stats->allocs;
+
+	/* Parsing it again reuses the memory that's already there. */
+	CHECK(pickle_doc_reset(doc) == PICKLE_OK);
+	CHECK(pickle_doc_open_mem(doc, buf, len) == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(stats->allocs < allocs);
+	pickle_doc_free(doc);
+	free(buf);
+}
+
+/**
+ * Parses a batch of files and buffers, including a compressed file that has to
+ * be decompressed instead of being parsed straight from its mapping.
+ */
+void test_batch(void) {
+	const char *fname = "../build/suite_batch.pkl";
+	const char *gzname = "../build/suite_batch.pkl.gz";
+	pickle_batch_item_t items[5];
+	pickle_err_t gzerr;
+	pickle_err_t first;
+	size_t i;
+
+	CHECK(write_file(fname, test_doc));
+	CHECK(write_data(gzname, test_doc_gz, sizeof(test_doc_gz)));
+	memset(items, 0, sizeof(items));
+	items[0].fname = fname;
+	items[1].buf = test_doc;
+	items[1].len = strlen(test_doc);
+	items[2].fname = gzname;
+	items[3].buf = "---\nCat:\n[?] 1 R1\nR1\n";
+	items[3].len = strlen(items[3].buf);
+	items[4].buf = (const char *)test_doc_gz;
+	items[4].len = sizeof(test_doc_gz);
+
+#ifdef PICKLE_WITH_ZLIB
+	gzerr = PICKLE_OK;
+#else
+	gzerr = PICKLE_ERROR_NOT_IMPL;
+#endif /* PICKLE_WITH_ZLIB */
+	first = (gzerr != PICKLE_OK) ? gzerr : PICKLE_ERROR_PARSING;
+
+	/* Only validate them. */
+	CHECK(pickle_batch_parse(items, 5, 2, 0) == first);
+	CHECK(items[0].err == PICKLE_OK);
+	CHECK(items[1].err == PICKLE_OK);
+	CHECK(items[2].err == gzerr);
+	CHECK(items[3].err == PICKLE_ERROR_PARSING);
+	CHECK(items[4].err == PICKLE_ERROR_NOT_IMPL);
+	for (i = 0; i < 5; i++)
+		CHECK(items[i].doc == NULL);
+
+	/* Keep the documents around. */
+	CHECK(pickle_batch_parse(items, 5, 2, PICKLE_FLAG_KEEP) == first);
+	CHECK((items[0].doc != NULL) && is_test_doc(items[0].doc));
+	CHECK((items[1].doc != NULL) && is_test_doc(items[1].doc));
+	CHECK((items[2].err != PICKLE_OK) ||
+		  ((items[2].doc != NULL) && is_test_doc(items[2].doc)));
+	CHECK(items[3].doc == NULL);
+	CHECK(items[4].doc == NULL);
+	for (i = 0; i < 5; i++) {
+		if (items[i].doc != NULL)
+			pickle_doc_free(items[i].doc);
+	}
+
+	remove(fname);
+	remove(gzname);
+}
+
+/**
+ * Feeds documents to a push parser in chunks of every size, down to a single
+ * byte at a time, and checks that it always hands out the same objects.
+ */
+void test_push(void) {
+	static const size_t chunks[] = { 1, 2, 3, 7, 64, 100000 };
+	push_log_t whole;
+	push_log_t log;
+	size_t len;
+	size_t i;
+	char *buf;
+
+	/* Test document in one go. */
+	len = strlen(test_doc);
+	CHECK(push_chunked(test_doc, len, len, &whole) == PICKLE_OK);
+	CHECK(strncmp(whole.text, "PName;=Test Board;PRevision;=A;CCapacitor;"
+				  "cC0805;(0.1u;\"Ceramic Capacitor;[C0805;#X6/6;", 64) == 0);
+	CHECK(strstr(whole.text, "cR0805;(100;\";[;#X1/1;") != NULL);
+
+	/* Every other chunk size gives the same thing. */
+	for (i = 0; i < (sizeof(chunks) / sizeof(chunks[0])); i++) {
+		CHECK(push_chunked(test_doc, len, chunks[i], &log) == PICKLE_OK);
+		CHECK(strcmp(log.text, whole.text) == 0);
+	}
+
+	/* A very long line fed a byte at a time. */
+	len = 200000;
+	buf = (char *)malloc(len + 32);
+	strcpy(buf, "---\nCat:\n[ ] 1 R1 (");
+	i = strlen(buf);
+	memset(buf + i, 'x', len - i - 5);
+	strcpy(buf + len - 5, ")\nR1\n");
+	CHECK(push_chunked(buf, strlen(buf), 1, &log) == PICKLE_OK);
+	CHECK(log.longest == (len - i - 5));
+	free(buf);
+}
+
+/**
+ * Merges small and large orders, checking the folded parts and that merging
+ * groups of documents in parallel gives the exact same thing as merging them
+ * one after the other.
+ */
+void test_merge(void) {
+	const char *prefixes[3] = { "B1-", "B2-", NULL };
+	const pickle_component_t *comp;
+	pickle_doc_t *docs[3];
+	pickle_doc_t *serial;
+	pickle_doc_t *grouped;
+	pickle_err_t err;
+	char *sbuf;
+	char *gbuf;
+	size_t slen;
+	size_t glen;
+	size_t len;
+	size_t i;
+	char *buf;
+
+	/* Small order that folds parts together. */
+	docs[0] = parse_str(test_doc, &err);
+	docs[1] = parse_str(test_doc, &err);
+	sprintf(buf = (char *)malloc(128), "---\nResistor:\n[X] %u R0805 (10k) "
+			"[R0805]\nR9\n", UINT_MAX);
+	docs[2] = parse_str(buf, &err);
+	free(buf);
+	serial = merge_docs(docs, prefixes, 3, 1);
+	CHECK(serial != NULL);
+	if (serial != NULL) {
+		CHECK(serial->len_categories == 2);
+		CHECK(serial->len_components == 4);
+		comp = pickle_doc_find_refdes(serial, "B2-C3");
+		CHECK((comp != NULL) && (comp->quantity == 12) && comp->picked);
+		comp = pickle_doc_find_refdes(serial, "R9");
+		CHECK((comp != NULL) && (comp->quantity == UINT_MAX) && !comp->picked);
+		CHECK((comp != NULL) && (comp->refdes.length == 5) &&
+			  (strcmp(comp->refdes.refdes[0], "B1-R1") == 0) &&
+			  (strcmp(comp->refdes.refdes[4], "R9") == 0));
+		CHECK(pickle_doc_merge(serial, docs, NULL, 1, 1) ==
+			  PICKLE_ERROR_UNKNOWN);
+		pickle_doc_free(serial);
+	}
+	for (i = 0; i < 3; i++)
+		pickle_doc_free(docs[i]);
+
+	/* Large order where a part shows up first in another category. */
+	buf = gen_fillers("---\nA:\n[ ] 1 X\nX1\n", 'F', 70000, &len);
+	docs[0] = parse_str(buf, &err);
+	CHECK(err == PICKLE_OK);
+	free(buf);
+	buf = gen_fillers("---\nB:\n[ ] 1 X\nX2\n\nC:\n[ ] 1 Y\nY1\n\nB:\n"
+					  "[ ] 1 Z\nZ1\n\nD:\n", 'G', 70000, &len);
+	docs[1] = parse_str(buf, &err);
+	CHECK(err == PICKLE_OK);
+	free(buf);
+
+	serial = merge_docs(docs, prefixes, 2, 1);
+	grouped = merge_docs(docs, prefixes, 2, 4);
+	CHECK((serial != NULL) && (grouped != NULL));
+	if ((serial != NULL) && (grouped != NULL)) {
+		CHECK(serial->len_categories == 4);
+		CHECK((serial->len_categories == 4) &&
+			  (strcmp(serial->categories[0]->name, "A") == 0) &&
+			  (strcmp(serial->categories[1]->name, "C") == 0) &&
+			  (strcmp(serial->categories[2]->name, "B") == 0) &&
+			  (strcmp(serial->categories[3]->name, "D") == 0));
+		CHECK(pickle_doc_write_mem(serial, &sbuf, &slen) == PICKLE_OK);
+		CHECK(pickle_doc_write_mem(grouped, &gbuf, &glen) == PICKLE_OK);
+		CHECK((slen == glen) && (memcmp(sbuf, gbuf, slen) == 0));
+		pickle_free(sbuf);
+		pickle_free(gbuf);
+	}
+	pickle_doc_free(serial);
+	pickle_doc_free(grouped);
+	pickle_doc_free(docs[0]);
+	pickle_doc_free(docs[1]);
+}
+
+/**
+ * Compares two revisions of the test document and checks that every change
+ * is reported, in order.
+ */
+void test_diff(void) {
+	pickle_diff_handlers_t handlers;
+	pickle_doc_t *a;
+	pickle_doc_t *b;
+	pickle_err_t err;
+	push_log_t log;
+
+	a = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	b = parse_str(
+		"Revision: B\n"
+		"Author: Someone\n"
+		"\n"
+		"---\n"
+		"\n"
+		"Capacitor:\n"
+		"[X]\t6\tC0805\t(0.1u)\t\"Ceramic Capacitor\"\t[C0805]\n"
+		"C1 C2 C3 C4 C5 C6\n"
+		"\n"
+		"[X]\t1\tC0805\t(2.2u)\t\"Ceramic Capacitor\"\t[C0805]\n"
+		"C7\n"
+		"\n"
+		"Passives:\n"
+		"[ ]\t2\tR0805\t(10k)\t\"Resistor\"\t[R0805]\n"
+		"R1 R2\n"
+		"\n"
+		"[ ]\t1\tATmega328\n"
+		"U1\n", &err);
+	CHECK(err == PICKLE_OK);
+
+	handlers.on_property = diff_property;
+	handlers.on_component = diff_component;
+	memset(&log, 0, sizeof(log));
+	CHECK(pickle_doc_diff(a, b, &handlers, &log) == PICKLE_OK);
+	CHECK(strcmp(log.text, "2Revision;0Author;1Name;"
+		"c209:C7;c380:R1;c000:U1;c100:R3;") == 0);
+
+	/* Nothing changed between a document and itself. */
+	memset(&log, 0, sizeof(log));
+	CHECK(pickle_doc_diff(a, a, &handlers, &log) == PICKLE_OK);
+	CHECK(log.len == 0);
+
+	pickle_doc_free(a);
+	pickle_doc_free(b);
+}
+
+/**
+ * Validates documents and checks that every error is reported along with where
+ * it happened, up to the requested limit.
+ */
+void test_validate(void) {
+	const char *bad;
+	pickle_error_t *errors;
+	size_t len;
+
+	/* Well-formed document. */
+	errors = NULL;
+	len = 1;
+	CHECK(validate_str(test_doc, 0, &errors, &len) == PICKLE_OK);
+	CHECK((errors == NULL) && (len == 0));
+
+	/* Every error in order. */
+	bad = "Name: A\n---\nCat:\n[?] 1 R1\nR1\n\n[ ] x R2\nR2\n\n[X] 1 R3\nR3\n";
+	CHECK(validate_str(bad, 0, &errors, &len) == PICKLE_ERROR_PARSING);
+	CHECK((errors != NULL) && (len == 2));
+	if ((errors != NULL) && (len == 2)) {
+		CHECK(errors[0].code == PICKLE_ERROR_PARSING);
+		CHECK((errors[0].line == 4) && (errors[1].line == 7));
+		CHECK((errors[0].msg[0] != '\0') && (errors[1].msg[0] != '\0'));
+	}
+	pickle_free(errors);
+
+	/* Stopping at the limit. */
+	errors = NULL;
+	CHECK(validate_str(bad, 1, &errors, &len) == PICKLE_ERROR_PARSING);
+	CHECK((errors != NULL) && (len == 1));
+	CHECK((errors != NULL) && (errors[0].line == 4));
+	pickle_free(errors);
+
+	/* Only asking whether it's valid. */
+	CHECK(validate_str(bad, 0, NULL, NULL) == PICKLE_ERROR_PARSING);
+	CHECK(pickle_error_last()->line == 4);
+}
+
+/**
+ * Parses a large document on several threads and checks that it comes out
+ * exactly the same as when it's parsed serially, errors included.
+ */
+void test_parallel(void) {
+	pickle_doc_t *serial;
+	pickle_doc_t *parallel;
+	pickle_err_t err;
+	char *buf;
+	char *str;
+	char *other;
+	size_t len;
+	size_t line;
+
+	buf = gen_doc(32, 250, &len);
+	serial = parse_buf(buf, len, 0, &err);
+	CHECK(err == PICKLE_OK);
+	parallel = parse_buf(buf, len, 4, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(parallel->len_categories == 32);
+	CHECK(parallel->len_components == serial->len_components);
+	CHECK(pickle_doc_write_mem(serial, &str, &len) == PICKLE_OK);
+	CHECK(pickle_doc_write_mem(parallel, &other, &len) == PICKLE_OK);
+	CHECK(strcmp(str, other) == 0);
+	pickle_free(str);
+	pickle_free(other);
+	pickle_doc_free(serial);
+	pickle_doc_free(parallel);
+
+	/* Errors in a later piece are reported at the same line. */
+	len = strlen(buf);
+	str = strstr(buf + (len / 2) + (len / 4), "[ ]");
+	str[1] = '?';
+	serial = parse_buf(buf, len, 0, &err);
+	CHECK(err == PICKLE_ERROR_PARSING);
+	line = pickle_error_last()->line;
+	parallel = parse_buf(buf, len, 4, &err);
+	CHECK(err == PICKLE_ERROR_PARSING);
+	CHECK((line > 0) && (pickle_error_last()->line == line));
+	pickle_doc_free(serial);
+	pickle_doc_free(parallel);
+
+	free(buf);
+}
+
+/**
+ * Parses the test document in view mode, from memory and from a mapped file,
+ * and checks that its strings point straight into the source and outlive the
+ * document being closed.
+ */
+void test_view(void) {
+	const char *fname = "../build/suite_view.pkl";
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	char *expected;
+	char *buf;
+	size_t len;
+
+	/* What the document should look like when it's written out. */
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(pickle_doc_write_mem(doc, &expected, &len) == PICKLE_OK);
+	pickle_doc_free(doc);
+
+	/* Strings point into the buffer and are only delimited by their length. */
+	len = strlen(test_doc);
+	doc = pickle_doc_new();
+	doc->flags = PICKLE_FLAG_VIEW;
+	CHECK(pickle_doc_open_mem(doc, test_doc, len) == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(is_test_doc(doc));
+	CHECK((doc->properties[0]->name >= test_doc) &&
+		  (doc->properties[0]->name < (test_doc + len)));
+	CHECK((doc->properties[0]->len_name == 4) &&
+		  (doc->properties[0]->len_value == 10));
+	CHECK(strncmp(doc->properties[0]->value, "Test Board", 10) == 0);
+	CHECK((doc->categories[1]->name >= test_doc) &&
+		  (doc->categories[1]->name < (test_doc + len)));
+	CHECK(doc->categories[1]->len_name == 8);
+	CHECK((doc->components[1]->value >= test_doc) &&
+		  (doc->components[1]->value < (test_doc + len)));
+	CHECK((doc->components[1]->len_name == 5) &&
+		  (doc->components[1]->len_value == 2));
+	CHECK(pickle_doc_write_mem(doc, &buf, &len) == PICKLE_OK);
+	CHECK(strcmp(buf, expected) == 0);
+	pickle_free(buf);
+	pickle_doc_free(doc);
+
+	/* Same thing from a mapped file, which must outlive closing it. */
+	CHECK(write_file(fname, test_doc));
+	doc = pickle_doc_new();
+	doc->flags = PICKLE_FLAG_VIEW;
+	err = pickle_doc_mmap(doc, fname);
+	CHECK((err == PICKLE_OK) || (err == PICKLE_ERROR_NOT_IMPL));
+	if (err == PICKLE_OK) {
+		CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+		CHECK(is_test_doc(doc));
+		CHECK(doc->properties[0]->value == (doc->reader.data + 6));
+		CHECK(pickle_doc_fclose(doc) == PICKLE_OK);
+		CHECK(doc->reader.source == PICKLE_SOURCE_NONE);
+		CHECK(strncmp(doc->properties[0]->value, "Test Board", 10) == 0);
+		CHECK(pickle_doc_write_mem(doc, &buf, &len) == PICKLE_OK);
+		CHECK(strcmp(buf, expected) == 0);
+		pickle_free(buf);
+
+		/* Closed documents may be reused. */
+		CHECK(pickle_doc_reset(doc) == PICKLE_OK);
+		CHECK(pickle_doc_mmap(doc, fname) == PICKLE_OK);
+		CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+		CHECK(is_test_doc(doc));
+	}
+	pickle_doc_free(doc);
+	remove(fname);
+
+	pickle_free(expected);
+}
+
+/**
+ * Builds the columnar view of the test document and checks it against the
+ * components it was built from.
+ */
+void test_columns(void) {
+	pickle_columns_t cols;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	size_t i;
+
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(pickle_columns_build(&cols, doc) == PICKLE_OK);
+	CHECK(cols.len == 4);
+	CHECK(pickle_columns_count_picked(&cols) == 2);
+	CHECK(pickle_columns_picked(&cols, 0) && !pickle_columns_picked(&cols, 1) &&
+		  !pickle_columns_picked(&cols, 2) && pickle_columns_picked(&cols, 3));
+	CHECK((cols.category[0] == 0) && (cols.category[1] == 0) &&
+		  (cols.category[2] == 1) && (cols.category[3] == 1));
+	CHECK((cols.quantity[0] == 6) && (cols.quantity[3] == 1));
+	CHECK((cols.description[3] == PICKLE_COLUMN_NULL) &&
+		  (cols.package[3] == PICKLE_COLUMN_NULL));
+	CHECK(pickle_columns_str(&cols, cols.package[3]) == NULL);
+
+	/* Pooled strings are the same as the originals. */
+	for (i = 0; (i < cols.len) && (i < doc->len_components); i++) {
+		CHECK(strcmp(pickle_columns_str(&cols, cols.name[i]),
+					 doc->components[i]->name) == 0);
+		CHECK(strcmp(pickle_columns_str(&cols, cols.value[i]),
+					 doc->components[i]->value) == 0);
+	}
+	CHECK(strcmp(pickle_columns_str(&cols, cols.description[0]),
+				 "Ceramic Capacitor") == 0);
+	CHECK(strcmp(pickle_columns_str(&cols, cols.package[2]), "R0805") == 0);
+
+	/* Equal strings share the same spot in the pool. */
+	CHECK(cols.description[0] == cols.description[1]);
+
+	pickle_columns_free(&cols);
+	pickle_doc_free(doc);
+}
+
+/**
+ * Looks properties up by name, including ones that were added after the index
+ * was built and enough of them for the index to have to grow.
+ */
+void test_property_find(void) {
+	const pickle_property_t *found;
+	pickle_property_t *prop;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+	char name[16];
+	size_t i;
+
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	found = pickle_doc_property_find(doc, "Revision");
+	CHECK((found != NULL) && (strcmp(found->value, "A") == 0));
+	CHECK(pickle_doc_property_find(doc, "Name") == doc->properties[0]);
+	CHECK(pickle_doc_property_find(doc, "Missing") == NULL);
+	CHECK(pickle_doc_property_find(doc, "name") == NULL);
+	CHECK(pickle_doc_property_find(doc, "") == NULL);
+
+	/* Adding a property throws the index away. */
+	prop = pickle_doc_property_new(doc);
+	pickle_property_name_set(prop, "Author");
+	pickle_property_value_set(prop, "Someone");
+	CHECK(pickle_doc_property_add(doc, prop) == PICKLE_OK);
+	CHECK(pickle_doc_property_find(doc, "Author") == prop);
+	CHECK(pickle_doc_property_find(doc, "Revision") == doc->properties[1]);
+
+	/* Many more properties than the index starts out with. */
+	for (i = 0; i < 100; i++) {
+		sprintf(name, "Prop%lu", (unsigned long)i);
+		prop = pickle_doc_property_new(doc);
+		pickle_property_name_set(prop, name);
+		pickle_property_value_set(prop, name);
+		if (pickle_doc_property_add(doc, prop) != PICKLE_OK)
+			break;
+	}
+	CHECK(i == 100);
+	for (i = 0; i < 100; i++) {
+		sprintf(name, "Prop%lu", (unsigned long)i);
+		found = pickle_doc_property_find(doc, name);
+		if ((found == NULL) || (strcmp(found->value, name) != 0))
+			break;
+	}
+	CHECK(i == 100);
+	CHECK(doc->index_properties.cap > doc->len_properties);
+	CHECK(pickle_doc_property_find(doc, "Prop100") == NULL);
+	CHECK(pickle_doc_property_find(doc, "Author") == doc->properties[2]);
+
+	pickle_doc_free(doc);
+}
+
+/**
+ * Streams the test document through the callbacks and checks that everything
+ * gets to them, and that they can stop the parser.
+ */
+void test_stream(void) {
+	stream_count_t count;
+
+	/* Every object is handed over and none are kept. */
+	count.stop_at = 0;
+	count.stop_with = PICKLE_OK;
+	CHECK(stream_str(test_doc, &count) == PICKLE_OK);
+	CHECK((count.properties == 2) && (count.categories == 2) &&
+		  (count.components == 4));
+	CHECK(count.kept == 0);
+
+	/* Stopping early isn't an error. */
+	count.stop_at = 1;
+	count.stop_with = PICKLE_FINISHED_PARSING;
+	CHECK(stream_str(test_doc, &count) == PICKLE_OK);
+	CHECK((count.categories == 1) && (count.components == 1));
+
+	/* Errors from the callbacks abort the parse and are handed back. */
+	count.stop_at = 3;
+	count.stop_with = PICKLE_ERROR_NOT_IMPL;
+	CHECK(stream_str(test_doc, &count) == PICKLE_ERROR_NOT_IMPL);
+	CHECK((count.categories == 2) && (count.components == 3));
+
+	/* Malformed documents are still reported. */
+	count.stop_at = 0;
+	CHECK(stream_str("---\nCat:\n[?] 1 R1\nR1\n", &count) ==
+		  PICKLE_ERROR_PARSING);
+	CHECK(count.components == 0);
+}
+
+/**
+ * Reserves space for the components of a document and checks that parsing
+ * fewer of them than that doesn't have to reallocate the collection.
+ */
+void test_reserve(void) {
+	pickle_component_t **comps;
+	pickle_doc_t *doc;
+
+	doc = pickle_doc_new();
+	CHECK((pickle_doc_reserve(doc, 1000) == PICKLE_OK) &&
+		  (doc->cap_components == 1000));
+	comps = doc->components;
+
+	/* Asking for less than what's there is a no-op. */
+	CHECK(pickle_doc_reserve(doc, 10) == PICKLE_OK);
+	CHECK((doc->cap_components == 1000) && (doc->components == comps));
+
+	/* Parsing fills the collection in place. */
+	CHECK(pickle_doc_open_mem(doc, test_doc, strlen(test_doc)) == PICKLE_OK);
+	CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+	CHECK(is_test_doc(doc));
+	CHECK((doc->cap_components == 1000) && (doc->components == comps));
+
+	pickle_doc_free(doc);
+}
+
+/**
+ * Parses the test document from a mapped file and checks that a document can't
+ * be opened twice.
+ */
+void test_mmap(void) {
+	const char *fname = "../build/suite_mmap.pkl";
+	pickle_doc_t *doc;
+	pickle_err_t err;
+
+	CHECK(write_file(fname, test_doc));
+	doc = pickle_doc_new();
+	err = pickle_doc_mmap(doc, fname);
+	CHECK((err == PICKLE_OK) || (err == PICKLE_ERROR_NOT_IMPL));
+	if (err == PICKLE_OK) {
+		CHECK(doc->reader.source == PICKLE_SOURCE_MMAP);
+		CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+		CHECK(is_test_doc(doc));
+
+		/* Only one source at a time. */
+		CHECK(pickle_doc_mmap(doc, fname) == PICKLE_ERROR_FILE);
+		CHECK(pickle_doc_open_mem(doc, test_doc, strlen(test_doc)) ==
+			  PICKLE_ERROR_FILE);
+		CHECK(pickle_doc_fopen(doc, fname, "r") == PICKLE_ERROR_FILE);
+
+		/* Until the document is closed. */
+		CHECK(pickle_doc_reset(doc) == PICKLE_OK);
+		CHECK(pickle_doc_mmap(doc, fname) == PICKLE_OK);
+		CHECK(pickle_doc_parse(doc) == PICKLE_OK);
+		CHECK(is_test_doc(doc));
+		CHECK(pickle_doc_fclose(doc) == PICKLE_OK);
+
+		/* Files that aren't there. */
+		CHECK(pickle_doc_mmap(doc, "../build/suite_missing.pkl") ==
+			  PICKLE_ERROR_FILE);
+	}
+	pickle_doc_free(doc);
+	remove(fname);
+}
+
+/**
+ * Checks that the repeated fields of the test document share a single copy, so
+ * that they may be compared by pointer.
+ */
+void test_intern(void) {
+	const char *str;
+	pickle_doc_t *doc;
+	pickle_err_t err;
+
+	doc = parse_str(test_doc, &err);
+	CHECK(err == PICKLE_OK);
+	CHECK(doc->components[0]->package == doc->components[1]->package);
+	CHECK(doc->components[0]->description ==
+		  doc->components[1]->description);
+	CHECK(doc->components[0]->package != doc->components[2]->package);
+	CHECK(doc->components[3]->package == NULL);
+
+	/* Interning by hand hands out the same copy. */
+	str = pickle_doc_intern(doc, "R0805 and more", 5);
+	CHECK((str != NULL) && (strcmp(str, "R0805") == 0));
+	CHECK(str == doc->components[2]->package);
+	CHECK(pickle_doc_intern(doc, "R0805", 5) == str);
+	str = pickle_doc_intern(doc, "New", 3);
+	CHECK((str != NULL) && (pickle_doc_intern(doc, "New", 3) == str));
+	pickle_doc_free(doc);
+}
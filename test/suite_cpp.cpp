@@ -0,0 +1,326 @@
+/**
+ * libpickle C++ Wrapper Tests
+ * Checks the behaviour of pickle.hpp against the same kind of small known
+ * documents as the C suite, and exits with a non-zero status if anything
+ * didn't turn out as expected.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../src/pickle.hpp"
+
+/* Checks a condition and records it if it failed. */
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+
+namespace {
+
+/* Test case. */
+struct TestCase {
+	const char *name;
+	void (*run)();
+};
+
+/* Document used throughout the tests. */
+constexpr std::string_view test_doc =
+	"Name: Test Board\n"
+	"Revision: A\n"
+	"\n"
+	"---\n"
+	"\n"
+	"Capacitor:\n"
+	"[X]\t6\tC0805\t(0.1u)\t\"Ceramic Capacitor\"\t[C0805]\n"
+	"C1 C2 C3 C4 C5 C6\n"
+	"\n"
+	"[ ]\t1\tC0805\t(1u)\t\"Ceramic Capacitor\"\t[C0805]\n"
+	"C7\n"
+	"\n"
+	"Resistor:\n"
+	"[ ]\t2\tR0805\t(10k)\t\"Resistor\"\t[R0805]\n"
+	"R1 R2\n"
+	"\n"
+	"[X]\t1\tR0805\t(100)\n"
+	"R3\n";
+
+/* Assertion bookkeeping. */
+unsigned int checks = 0;
+unsigned int failures = 0;
+
+#ifdef PICKLE_HPP_HAS_PMR
+/**
+ * Memory resource that keeps track of what's still allocated from it. Safe to
+ * use from several threads at once.
+ */
+class CountingResource : public std::pmr::memory_resource {
+public:
+	/** @return Number of blocks that were allocated. */
+	std::size_t allocs() const noexcept { return m_allocs; }
+
+	/** @return Number of bytes that are still allocated. */
+	std::size_t outstanding() const noexcept { return m_outstanding; }
+
+private:
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+		void *ptr;
+
+		ptr = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		m_allocs++;
+		m_outstanding += bytes;
+
+		return ptr;
+	}
+
+	void do_deallocate(void *ptr, std::size_t bytes,
+					   std::size_t alignment) override {
+		m_outstanding -= bytes;
+		std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const
+		noexcept override {
+		return this == &other;
+	}
+
+	std::atomic<std::size_t> m_allocs{0};
+	std::atomic<std::size_t> m_outstanding{0};
+};
+#endif /* PICKLE_HPP_HAS_PMR */
+
+/**
+ * Records the result of a check and reports it if it failed.
+ *
+ * @param cond Result of the check.
+ * @param expr Expression that was checked.
+ * @param file Source file where the check is.
+ * @param line Line where the check is.
+ */
+void check(bool cond, const char *expr, const char *file, int line) {
+	checks++;
+	if (cond)
+		return;
+
+	failures++;
+	std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+}
+
+/**
+ * Generates a document with a lot of categories and components.
+ *
+ * @param categories Number of categories.
+ * @param components Number of components in each category.
+ *
+ * @return Contents of the document.
+ */
+std::string gen_doc(std::size_t categories, std::size_t components) {
+	std::string str;
+	std::size_t i;
+	std::size_t j;
+
+	str = "Name: Generated\n\n---\n";
+	for (i = 0; i < categories; i++) {
+		str += "\nCat" + std::to_string(i) + ":\n";
+		for (j = 0; j < components; j++) {
+			str += "[ ] " + std::to_string(j + 1) + " C" + std::to_string(i) +
+				"_" + std::to_string(j) + " (1k) [R0805]\nR" +
+				std::to_string(j) + " U" + std::to_string(j) + "\n\n";
+		}
+	}
+
+	return str;
+}
+
+/**
+ * Parses the test document and goes through it with the wrapper's ranges.
+ */
+void test_parse() {
+	pickle::Document doc;
+	std::vector<std::string_view> refdes;
+
+	doc.open_mem(test_doc);
+	doc.parse();
+	CHECK(doc.properties().size() == 2);
+	CHECK(doc.find_property("Name").value() == "Test Board");
+	CHECK(!doc.find_property("Missing"));
+	CHECK(doc.categories().size() == 2);
+	CHECK(doc.categories()[1].name() == "Resistor");
+	CHECK(doc.components().size() == 4);
+	if (doc.components().size() != 4)
+		return;
+
+	auto comp = doc.components()[0];
+	CHECK(comp.picked() && (comp.quantity() == 6));
+	CHECK((comp.name() == "C0805") && (comp.value() == "0.1u"));
+	CHECK(comp.description() == "Ceramic Capacitor");
+	CHECK(comp.category().name() == "Capacitor");
+	for (auto str : comp.refdes())
+		refdes.push_back(str);
+	CHECK((refdes.size() == 6) && (refdes[5] == "C6"));
+	CHECK(doc.components()[3].description().empty());
+	CHECK(doc.find_refdes("R2").value() == "10k");
+	CHECK(!doc.find_refdes("R4"));
+}
+
+/**
+ * Checks that failures are thrown along with where they happened.
+ */
+void test_errors() {
+	pickle::Document doc;
+	bool thrown;
+
+	thrown = false;
+	doc.open_mem("---\nCat:\n[?] 1 R1\nR1\n");
+	try {
+		doc.parse();
+	} catch (const pickle::Error &e) {
+		thrown = true;
+		CHECK(e.code() == PICKLE_ERROR_PARSING);
+		CHECK(e.line() == 3);
+	}
+	CHECK(thrown);
+
+	/* Validation hands back every error instead. */
+	pickle::Document other;
+	other.open_mem("Name: A\n---\nCat:\n[?] 1 R1\nR1\n\n[ ] x R2\nR2\n");
+	auto errors = other.validate();
+	CHECK(errors.size() == 2);
+	CHECK((errors.size() == 2) && (errors[0].line == 4) &&
+		  (errors[1].line == 7));
+}
+
+/**
+ * Writes documents out, including one that was put together by hand.
+ */
+void test_write() {
+	pickle::Document doc;
+	pickle::Document again;
+	std::string str;
+
+	doc.open_mem(test_doc);
+	doc.parse();
+	str = doc.write();
+	again.open_mem(str);
+	again.parse();
+	CHECK(again.write() == str);
+	CHECK(again.components().size() == 4);
+
+	/* Objects added through the wrapper. */
+	pickle::Document built;
+	auto prop = built.new_property();
+	prop.set_name("Board");
+	prop.set_value("Main");
+	built.add(std::move(prop));
+	CHECK(!prop);
+
+	auto comp = built.new_component();
+	auto name = built.intern("U1");
+	comp.get()->quantity = 1;
+	comp.get()->name = const_cast<char *>(name.data());
+	comp.get()->len_name = name.size();
+	built.add(std::move(comp));
+	str = built.write();
+	CHECK(str == "Board: Main\n\n---\n\nUncategorized:\n[ ]\t1\tU1\n");
+
+	/* Moving a document hands over everything. */
+	pickle::Document moved(std::move(built));
+	CHECK(!built && moved && (moved.components().size() == 1));
+}
+
+/**
+ * Parses a large document on several threads and checks that it comes out the
+ * same as when it's parsed on a single one.
+ */
+void test_parallel() {
+	pickle::Document serial;
+	pickle::Document parallel;
+	std::string str;
+
+	str = gen_doc(32, 250);
+	serial.open_mem(str);
+	serial.parse();
+	parallel.open_mem(str);
+	parallel.parse_parallel(4, 4096);
+	CHECK(parallel.components().size() == 8000);
+	CHECK(parallel.categories().size() == 32);
+	CHECK(parallel.write() == serial.write());
+	CHECK(parallel.find_refdes("U249").name() == "C0_249");
+}
+
+#ifdef PICKLE_HPP_HAS_PMR
+/**
+ * Parses documents with their memory coming from memory resources, on several
+ * threads, and checks that everything is given back.
+ */
+void test_pmr() {
+	CountingResource counting;
+	std::string str;
+	std::string serial;
+
+	str = gen_doc(16, 500);
+	{
+		pickle::Document doc(&counting);
+
+		doc.open_mem(str);
+		doc.parse();
+		serial = doc.write();
+		CHECK(doc.components().size() == 8000);
+	}
+	CHECK(counting.allocs() > 0);
+	CHECK(counting.outstanding() == 0);
+
+	/* Parallel parsing needs a thread-safe resource. */
+	{
+		std::pmr::synchronized_pool_resource pool(&counting);
+		pickle::Document doc(&pool);
+
+		doc.open_mem(str);
+		doc.parse_parallel(4, 4096);
+		CHECK(doc.write() == serial);
+	}
+	CHECK(counting.outstanding() == 0);
+}
+#endif /* PICKLE_HPP_HAS_PMR */
+
+/* Every test case, in the order they are run. */
+const TestCase tests[] = {
+	{ "parse", test_parse },
+	{ "errors", test_errors },
+	{ "write", test_write },
+	{ "parallel", test_parallel },
+#ifdef PICKLE_HPP_HAS_PMR
+	{ "pmr", test_pmr },
+#endif /* PICKLE_HPP_HAS_PMR */
+	{ NULL, NULL }
+};
+
+} /* namespace */
+
+int main() {
+	const TestCase *test;
+
+	std::printf("libpickle C++ Wrapper Tests\n\n");
+
+	/* Run every test case. */
+	for (test = tests; test->name != NULL; test++) {
+		unsigned int before;
+
+		before = failures;
+		try {
+			test->run();
+		} catch (const std::exception &e) {
+			failures++;
+			std::fprintf(stderr, "%s: unexpected exception: %s\n", test->name,
+						 e.what());
+		}
+		std::printf("%s %s\n", (failures == before) ? "[ OK ]" : "[FAIL]",
+					test->name);
+	}
+
+	std::printf("\n%u checks, %u failed.\n", checks, failures);
+	return (failures == 0) ? 0 : 1;
+}
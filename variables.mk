@@ -12,11 +12,13 @@ PLATFORM := $(shell uname -s)
 # Directories and Paths
 SRCDIR     := src
 TESTDIR    := test
+BENCHDIR   := bench
 BUILDDIR   := build
 PKLEXAMPLE ?= example.pkl
 
 # Tools
 CC    = gcc
+CXX   = g++
 AR    = ar
 GDB   = gdb
 RM    = rm -f
@@ -26,9 +28,22 @@ TOUCH = touch
 # Handle OS X-specific tools.
 ifeq ($(PLATFORM), Darwin)
 	CC  = clang
+	CXX = clang++
 	GDB = lldb
 endif
 
 # Flags
-CFLAGS  = -Wall -Wno-psabi --std=c89
-LDFLAGS =
+CFLAGS   = -Wall -Wno-psabi --std=c89
+CXXFLAGS = -Wall -Wno-psabi --std=c++17
+LDFLAGS = -pthread
+LDLIBS  =
+
+# Optional support for compressed documents. (make WITH_ZLIB=1 WITH_ZSTD=1)
+ifdef WITH_ZLIB
+	CFLAGS += -DPICKLE_WITH_ZLIB
+	LDLIBS += -lz
+endif
+ifdef WITH_ZSTD
+	CFLAGS += -DPICKLE_WITH_ZSTD
+	LDLIBS += -lzstd
+endif